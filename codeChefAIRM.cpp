@@ -1,31 +1,36 @@
-#include <iostream>
-#include <unordered_map>
-// #include <vector>
+#include <algorithm>
+#include <vector>
+
+#include "fastIO.h"
+#include "modeCounter.h"
+
 using namespace std;
 
 int main() {
+  FastInput in;
+  FastOutput out;
   int t;
   int n;
-  int schedule;
 
-  cin >> t;
+  // one counter and one buffer for every test: ModeCounter only clears
+  // what a test used, instead of a new unordered_map each time
+  ModeCounter counter;
+  vector<int32_t> schedule;
 
-  for (int i = 0; i < t; i++) {
-    cin >> n;
+  in >> t;
 
-    int highestFreq = 1;
-    unordered_map<int, int> freqMap;
+  for (int i = 0; i < t; i++) {
+    in >> n;
 
     // arrival
+    schedule.resize(2 * max(n, 0));
     for (int j = 0; j < 2 * n; j++) {
-      cin >> schedule;
-
-      if (++freqMap[schedule] > highestFreq) {
-        highestFreq = freqMap[schedule];
-      }
+      in >> schedule[j];
     }
 
-    cout << highestFreq << endl;
+    uint32_t highestFreq =
+        counter.highestFrequency(schedule.data(), schedule.size());
+    out << max(highestFreq, 1u) << '\n';
   }
 
   return 0;
@@ -1,28 +1,30 @@
-#include <iostream>
+#include "fastIO.h"
 
 using namespace std;
 
 int main() {
+  FastInput in;
+  FastOutput out;
   int T;
   int N, C, Q;
   int L, R;
   int i, j;
   int b;
 
-  cin >> T;
+  in >> T;
   for (i = 0; i < T; i++) {
-    cin >> N >> C >> Q;
+    in >> N >> C >> Q;
 
     b = C;
     for (j = 0; j < Q; j++) {
-      cin >> L >> R;
+      in >> L >> R;
 
       if (b >= L && b <=R) {
         b = R - (b - L);
       }
     }
 
-    cout << b << endl;
+    out << b << '\n';
   }
 
   return 0;
@@ -0,0 +1,163 @@
+/*
+ * assembles 8085 sources to Intel HEX, a directory at a time
+ *
+ *   ./asm8085.out [-j N] [-o DIR] [--check] [--repeat N] FILE|DIR ...
+ *
+ * every FILE.asm becomes FILE.asm.hex (next to it, or in DIR). files are
+ * handed out to N threads (default: one per core). --check writes nothing
+ * and compares against the .hex files already there. --repeat assembles
+ * every file N times, for a steadier lines/sec figure.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "asm8085.h"
+
+namespace fs = std::filesystem;
+
+struct Job {
+  fs::path src;
+  std::string text;
+
+  // filled by the worker
+  bool ok;
+  std::vector<std::string> errors;
+  std::string hex;
+  size_t lines;
+};
+
+bool readFile(const fs::path &path, std::string &out) {
+  std::ifstream in(path, std::ios::binary);
+  if (!in) return false;
+  std::ostringstream ss;
+  ss << in.rdbuf();
+  out = ss.str();
+  return true;
+}
+
+int main(int argc, char *argv[]) {
+  unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+  int repeat = 1;
+  bool check = false;
+  fs::path outDir;
+  std::vector<fs::path> inputs;
+
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "-j" && i + 1 < argc) {
+      threads = std::max(1, atoi(argv[++i]));
+    } else if (arg == "-o" && i + 1 < argc) {
+      outDir = argv[++i];
+    } else if (arg == "--repeat" && i + 1 < argc) {
+      repeat = std::max(1, atoi(argv[++i]));
+    } else if (arg == "--check") {
+      check = true;
+    } else {
+      inputs.push_back(arg);
+    }
+  }
+
+  if (inputs.empty()) {
+    std::cerr << "usage: " << argv[0]
+              << " [-j N] [-o DIR] [--check] [--repeat N] FILE|DIR ...\n";
+    return 1;
+  }
+
+  std::vector<Job> jobs;
+  for (auto &in : inputs) {
+    std::vector<fs::path> files;
+    if (fs::is_directory(in)) {
+      for (auto &e : fs::directory_iterator(in))
+        if (e.is_regular_file() && e.path().extension() == ".asm")
+          files.push_back(e.path());
+      std::sort(files.begin(), files.end());
+    } else {
+      files.push_back(in);
+    }
+
+    for (auto &f : files) {
+      Job job;
+      job.src = f;
+      if (!readFile(f, job.text)) {
+        std::cerr << "asm8085: cannot read " << f << "\n";
+        return 1;
+      }
+      jobs.push_back(std::move(job));
+    }
+  }
+
+  // sources are read up front so the timing is assembling only
+  std::atomic<size_t> next{0};
+  auto worker = [&]() {
+    auto as = std::make_unique<Assembler8085>();
+    size_t i;
+    while ((i = next++) < jobs.size()) {
+      Job &job = jobs[i];
+      std::string name = job.src.filename().string();
+      job.lines = 0;
+      for (int r = 0; r < repeat; r++) {
+        job.ok = as->assemble(job.text, name);
+        job.lines += as->linesRead;
+      }
+      job.errors = as->errors;
+      if (job.ok) job.hex = as->toHex();
+    }
+  };
+
+  threads = std::min<size_t>(threads, std::max<size_t>(1, jobs.size()));
+  auto start = std::chrono::steady_clock::now();
+  std::vector<std::thread> pool;
+  for (unsigned t = 0; t < threads; t++) pool.emplace_back(worker);
+  for (auto &t : pool) t.join();
+  double sec =
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - start)
+          .count();
+
+  int failed = 0, differs = 0;
+  size_t lines = 0;
+  for (auto &job : jobs) {
+    lines += job.lines;
+    for (size_t e = 0; e < job.errors.size() && e < 10; e++)
+      std::cerr << job.errors[e] << "\n";
+    if (job.errors.size() > 10)
+      std::cerr << job.src.filename().string() << ": "
+                << job.errors.size() - 10 << " more errors\n";
+    if (!job.ok) {
+      failed++;
+      continue;
+    }
+
+    fs::path out = job.src;
+    out += ".hex";
+    if (!outDir.empty()) out = outDir / out.filename();
+
+    if (check) {
+      std::string ref;
+      const char *verdict = "no .hex to compare";
+      if (readFile(out, ref)) {
+        verdict = (ref == job.hex) ? "identical" : "DIFFERS";
+        if (ref != job.hex) differs++;
+      }
+      printf("%-28s %s\n", job.src.filename().c_str(), verdict);
+    } else {
+      std::ofstream(out, std::ios::binary) << job.hex;
+    }
+  }
+
+  printf("%zu files, %zu lines in %.3f ms on %u threads: %.0f lines/s\n",
+         jobs.size(), lines, sec * 1e3, threads, lines / sec);
+  if (failed) printf("%d file(s) with errors\n", failed);
+
+  return (failed || differs) ? 1 : 0;
+}
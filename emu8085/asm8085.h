@@ -0,0 +1,774 @@
+/*
+ * two pass 8085 assembler for the sources in `Microprocessor 8085/`
+ *
+ * source conventions of those files:
+ *   - numbers are hex with or without the H suffix (MVI B,0A / MVI B,2FH)
+ *   - labels end with ':' and may share the line with an instruction
+ *   - comments start with ';' or '//'
+ *   - any mix of tabs and spaces, any case
+ *
+ * pass 1 lexes every line once (character class table), sizes each
+ * statement and puts labels in the symbol table; pass 2 walks the stored
+ * statements and encodes them. directives: ORG, DB, DW, DS, EQU, END.
+ *
+ * toHex() writes Intel HEX the way the lab's tool did for 5SEPT24-2.asm.hex:
+ * 16 byte records over every 16 byte block that holds code (gaps filled
+ * with 00), CRLF line ends, no newline after the end record.
+ */
+
+#ifndef ASM8085_H
+#define ASM8085_H
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// ---------------------------------------------------------------------------
+// lexer
+
+enum CharClass8085 : uint8_t {
+  CC_OTHER,
+  CC_SPACE,
+  CC_WORD,  // letters, digits, '_', '$', '.'
+  CC_COLON,
+  CC_COMMA,
+  CC_PLUS,
+  CC_MINUS,
+  CC_SEMI,   // ; comment
+  CC_SLASH,  // '//' comment
+  CC_QUOTE,
+};
+
+struct CharTable8085 {
+  uint8_t cls[256];
+
+  constexpr CharTable8085() : cls() {
+    for (int c = 0; c < 256; c++) {
+      uint8_t k = CC_OTHER;
+      if (c == ' ' || c == '\t' || c == '\r' || c == '\f' || c == '\v')
+        k = CC_SPACE;
+      else if ((c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') ||
+               (c >= '0' && c <= '9') || c == '_' || c == '$' || c == '.')
+        k = CC_WORD;
+      else if (c == ':')
+        k = CC_COLON;
+      else if (c == ',')
+        k = CC_COMMA;
+      else if (c == '+')
+        k = CC_PLUS;
+      else if (c == '-')
+        k = CC_MINUS;
+      else if (c == ';')
+        k = CC_SEMI;
+      else if (c == '/')
+        k = CC_SLASH;
+      else if (c == '\'')
+        k = CC_QUOTE;
+      cls[c] = k;
+    }
+  }
+};
+
+inline constexpr CharTable8085 charTable8085{};
+
+struct Tok8085 {
+  uint8_t kind;  // CharClass8085 of the token (CC_WORD, CC_COLON, ...)
+  std::string_view text;
+};
+
+// ---------------------------------------------------------------------------
+// instruction table
+
+enum OperandKind8085 : uint8_t {
+  K_NONE,     // NOP
+  K_REG_LO,   // ADD r       base | r
+  K_REG_MID,  // INR r       base | r << 3
+  K_MOV,      // MOV d,s
+  K_MVI,      // MVI r,d8
+  K_LXI,      // LXI rp,d16
+  K_RP,       // DAD/INX/DCX rp (SP allowed)
+  K_PUSHPOP,  // PUSH/POP rp (PSW allowed)
+  K_BD,       // LDAX/STAX B|D
+  K_IMM8,     // ADI d8, IN/OUT port
+  K_ADDR,     // JMP a16
+  K_RST,      // RST n
+  K_ORG,
+  K_DB,
+  K_DW,
+  K_DS,
+  K_EQU,
+  K_END,
+};
+
+struct Insn8085 {
+  const char *name;
+  uint8_t opcode;
+  uint8_t kind;
+};
+
+inline constexpr Insn8085 insnTable8085[] = {
+    {"NOP", 0x00, K_NONE},   {"HLT", 0x76, K_NONE},   {"RLC", 0x07, K_NONE},
+    {"RRC", 0x0F, K_NONE},   {"RAL", 0x17, K_NONE},   {"RAR", 0x1F, K_NONE},
+    {"DAA", 0x27, K_NONE},   {"CMA", 0x2F, K_NONE},   {"STC", 0x37, K_NONE},
+    {"CMC", 0x3F, K_NONE},   {"RIM", 0x20, K_NONE},   {"SIM", 0x30, K_NONE},
+    {"RET", 0xC9, K_NONE},   {"RNZ", 0xC0, K_NONE},   {"RZ", 0xC8, K_NONE},
+    {"RNC", 0xD0, K_NONE},   {"RC", 0xD8, K_NONE},    {"RPO", 0xE0, K_NONE},
+    {"RPE", 0xE8, K_NONE},   {"RP", 0xF0, K_NONE},    {"RM", 0xF8, K_NONE},
+    {"XTHL", 0xE3, K_NONE},  {"PCHL", 0xE9, K_NONE},  {"XCHG", 0xEB, K_NONE},
+    {"SPHL", 0xF9, K_NONE},  {"DI", 0xF3, K_NONE},    {"EI", 0xFB, K_NONE},
+
+    {"ADD", 0x80, K_REG_LO}, {"ADC", 0x88, K_REG_LO}, {"SUB", 0x90, K_REG_LO},
+    {"SBB", 0x98, K_REG_LO}, {"ANA", 0xA0, K_REG_LO}, {"XRA", 0xA8, K_REG_LO},
+    {"ORA", 0xB0, K_REG_LO}, {"CMP", 0xB8, K_REG_LO},
+
+    {"INR", 0x04, K_REG_MID}, {"DCR", 0x05, K_REG_MID},
+    {"MOV", 0x40, K_MOV},     {"MVI", 0x06, K_MVI},
+    {"LXI", 0x01, K_LXI},     {"DAD", 0x09, K_RP},
+    {"INX", 0x03, K_RP},      {"DCX", 0x0B, K_RP},
+    {"PUSH", 0xC5, K_PUSHPOP}, {"POP", 0xC1, K_PUSHPOP},
+    {"LDAX", 0x0A, K_BD},     {"STAX", 0x02, K_BD},
+
+    {"ADI", 0xC6, K_IMM8},   {"ACI", 0xCE, K_IMM8},   {"SUI", 0xD6, K_IMM8},
+    {"SBI", 0xDE, K_IMM8},   {"ANI", 0xE6, K_IMM8},   {"XRI", 0xEE, K_IMM8},
+    {"ORI", 0xF6, K_IMM8},   {"CPI", 0xFE, K_IMM8},   {"IN", 0xDB, K_IMM8},
+    {"OUT", 0xD3, K_IMM8},
+
+    {"JMP", 0xC3, K_ADDR},   {"JNZ", 0xC2, K_ADDR},   {"JZ", 0xCA, K_ADDR},
+    {"JNC", 0xD2, K_ADDR},   {"JC", 0xDA, K_ADDR},    {"JPO", 0xE2, K_ADDR},
+    {"JPE", 0xEA, K_ADDR},   {"JP", 0xF2, K_ADDR},    {"JM", 0xFA, K_ADDR},
+    {"CALL", 0xCD, K_ADDR},  {"CNZ", 0xC4, K_ADDR},   {"CZ", 0xCC, K_ADDR},
+    {"CNC", 0xD4, K_ADDR},   {"CC", 0xDC, K_ADDR},    {"CPO", 0xE4, K_ADDR},
+    {"CPE", 0xEC, K_ADDR},   {"CP", 0xF4, K_ADDR},    {"CM", 0xFC, K_ADDR},
+    {"LDA", 0x3A, K_ADDR},   {"STA", 0x32, K_ADDR},   {"LHLD", 0x2A, K_ADDR},
+    {"SHLD", 0x22, K_ADDR},
+
+    {"RST", 0xC7, K_RST},
+
+    {"ORG", 0, K_ORG},       {"DB", 0, K_DB},         {"DW", 0, K_DW},
+    {"DS", 0, K_DS},         {"EQU", 0, K_EQU},       {"END", 0, K_END},
+};
+
+// up to 4 upper cased chars packed in a word: the key of both hash tables
+inline uint32_t packName8085(std::string_view s) {
+  if (s.size() > 4 || s.empty()) return 0;
+  uint32_t k = 0;
+  for (char c : s) k = k << 8 | (uint8_t)((c >= 'a' && c <= 'z') ? c - 32 : c);
+  return k;
+}
+
+// open addressing, built once: mnemonic -> index in insnTable8085
+class MnemonicTable8085 {
+ private:
+  static constexpr int SIZE = 256;
+  uint32_t keys[SIZE];
+  uint8_t vals[SIZE];
+
+  static uint32_t slot(uint32_t k) { return (k * 2654435761u) >> 24; }
+
+ public:
+  MnemonicTable8085() {
+    memset(keys, 0, sizeof(keys));
+    int n = sizeof(insnTable8085) / sizeof(insnTable8085[0]);
+    for (int i = 0; i < n; i++) {
+      uint32_t k = packName8085(insnTable8085[i].name);
+      uint32_t s = slot(k);
+      while (keys[s]) s = (s + 1) & (SIZE - 1);
+      keys[s] = k;
+      vals[s] = i;
+    }
+  }
+
+  const Insn8085 *find(std::string_view name) const {
+    uint32_t k = packName8085(name);
+    if (!k) return nullptr;
+    for (uint32_t s = slot(k); keys[s]; s = (s + 1) & (SIZE - 1))
+      if (keys[s] == k) return &insnTable8085[vals[s]];
+    return nullptr;
+  }
+};
+
+// labels: open addressing on FNV-1a of the upper cased name, grows at 1/2
+class SymbolTable8085 {
+ private:
+  struct Entry {
+    std::string_view name;  // points into the source text
+    uint32_t hash;
+    int32_t value;  // -1: free slot
+  };
+
+  std::vector<Entry> slots;
+  size_t used = 0;
+
+  static uint32_t hashOf(std::string_view s) {
+    uint32_t h = 2166136261u;
+    for (char c : s) {
+      h ^= (uint8_t)((c >= 'a' && c <= 'z') ? c - 32 : c);
+      h *= 16777619u;
+    }
+    return h;
+  }
+
+  static bool sameName(std::string_view a, std::string_view b) {
+    if (a.size() != b.size()) return false;
+    for (size_t i = 0; i < a.size(); i++) {
+      char x = (a[i] >= 'a' && a[i] <= 'z') ? a[i] - 32 : a[i];
+      char y = (b[i] >= 'a' && b[i] <= 'z') ? b[i] - 32 : b[i];
+      if (x != y) return false;
+    }
+    return true;
+  }
+
+  size_t findSlot(std::string_view name, uint32_t h) const {
+    size_t mask = slots.size() - 1;
+    size_t s = h & mask;
+    while (slots[s].value >= 0 &&
+           !(slots[s].hash == h && sameName(slots[s].name, name)))
+      s = (s + 1) & mask;
+    return s;
+  }
+
+  void grow() {
+    std::vector<Entry> old = std::move(slots);
+    slots.assign(old.size() * 2, Entry{{}, 0, -1});
+    for (auto &e : old)
+      if (e.value >= 0) slots[findSlot(e.name, e.hash)] = e;
+  }
+
+ public:
+  SymbolTable8085() { slots.assign(64, Entry{{}, 0, -1}); }
+
+  void clear() {
+    for (auto &e : slots) e.value = -1;
+    used = 0;
+  }
+
+  // false if the name is already defined
+  bool define(std::string_view name, uint16_t value) {
+    if ((used + 1) * 2 > slots.size()) grow();
+    uint32_t h = hashOf(name);
+    size_t s = findSlot(name, h);
+    if (slots[s].value >= 0) return false;
+    slots[s] = Entry{name, h, value};
+    used++;
+    return true;
+  }
+
+  // -1 if undefined
+  int32_t lookup(std::string_view name) const {
+    uint32_t h = hashOf(name);
+    return slots[findSlot(name, h)].value;
+  }
+};
+
+// ---------------------------------------------------------------------------
+
+class Assembler8085 {
+ private:
+  struct Stmt {
+    const Insn8085 *insn;
+    uint16_t addr;
+    int line;
+    uint32_t firstTok;  // operand tokens in `toks`
+    uint32_t numToks;
+  };
+
+  const MnemonicTable8085 &mnemonics() {
+    static const MnemonicTable8085 table;
+    return table;
+  }
+
+  std::string_view fileName;
+  std::vector<Tok8085> toks;
+  std::vector<Stmt> stmts;
+  SymbolTable8085 symbols;
+  uint16_t pc;
+  bool pass2;
+
+  void error(int line, const std::string &msg) {
+    errors.push_back(std::string(fileName) + ":" + std::to_string(line) +
+                     ": " + msg);
+  }
+
+  // splits one line into tokens, stops at a comment
+  void lexLine(const char *p, const char *end, std::vector<Tok8085> &out) {
+    const uint8_t *cls = charTable8085.cls;
+    while (p < end) {
+      uint8_t k = cls[(uint8_t)*p];
+      const char *start = p;
+
+      switch (k) {
+        case CC_SPACE:
+          p++;
+          continue;
+        case CC_SEMI:
+          return;
+        case CC_SLASH:
+          if (p + 1 < end && p[1] == '/') return;
+          p++;
+          break;
+        case CC_WORD:
+          while (p < end && cls[(uint8_t)*p] == CC_WORD) p++;
+          break;
+        case CC_QUOTE:
+          p++;
+          while (p < end && *p != '\'') p++;
+          if (p < end) p++;
+          break;
+        default:
+          p++;
+          break;
+      }
+      out.push_back(Tok8085{k, std::string_view(start, p - start)});
+    }
+  }
+
+  static bool isHexWord(std::string_view w, uint32_t &v) {
+    if (w.empty()) return false;
+    if (w.size() > 1 && (w.back() == 'H' || w.back() == 'h'))
+      w.remove_suffix(1);
+    if (w.size() > 8) return false;
+
+    v = 0;
+    for (char c : w) {
+      int d;
+      if (c >= '0' && c <= '9')
+        d = c - '0';
+      else if (c >= 'A' && c <= 'F')
+        d = c - 'A' + 10;
+      else if (c >= 'a' && c <= 'f')
+        d = c - 'a' + 10;
+      else
+        return false;
+      v = v << 4 | d;
+    }
+    return true;
+  }
+
+  // term (('+' | '-') term)*, a term is a label, a hex number or '$'.
+  // labels win over hex-looking words, so a label called ADD1 still works.
+  // in pass 1 unknown labels evaluate to 0
+  bool expr(const Tok8085 *&t, const Tok8085 *end, int line, int32_t &out) {
+    int32_t total = 0;
+    int sign = 1;
+
+    while (true) {
+      if (t < end && (t->kind == CC_PLUS || t->kind == CC_MINUS)) {
+        if (t->kind == CC_MINUS) sign = -sign;
+        t++;
+        continue;
+      }
+      if (t >= end || (t->kind != CC_WORD && t->kind != CC_QUOTE)) {
+        error(line, "expected a value");
+        return false;
+      }
+
+      int32_t v;
+      uint32_t num;
+      if (t->kind == CC_QUOTE && t->text.size() == 3) {
+        v = (uint8_t)t->text[1];
+      } else if (t->text == "$") {
+        v = pc;
+      } else if ((v = symbols.lookup(t->text)) >= 0) {
+      } else if (isHexWord(t->text, num)) {
+        v = num;
+      } else if (!pass2) {
+        v = 0;
+      } else {
+        error(line, "undefined symbol " + std::string(t->text));
+        return false;
+      }
+      total += sign * v;
+      t++;
+
+      if (t < end && (t->kind == CC_PLUS || t->kind == CC_MINUS)) {
+        sign = (t->kind == CC_MINUS) ? -1 : 1;
+        t++;
+        continue;
+      }
+      out = total;
+      return true;
+    }
+  }
+
+  // B C D E H L M A -> 0..7
+  static int reg(const Tok8085 &t) {
+    if (t.kind != CC_WORD || t.text.size() != 1) return -1;
+    switch (t.text[0] & ~0x20) {
+      case 'B':
+        return 0;
+      case 'C':
+        return 1;
+      case 'D':
+        return 2;
+      case 'E':
+        return 3;
+      case 'H':
+        return 4;
+      case 'L':
+        return 5;
+      case 'M':
+        return 6;
+      case 'A':
+        return 7;
+    }
+    return -1;
+  }
+
+  // B D H -> 0 1 2, SP or PSW -> 3 (whichever `alt` allows)
+  static int regPair(const Tok8085 &t, const char *alt) {
+    if (t.kind != CC_WORD) return -1;
+    uint32_t k = packName8085(t.text);
+    if (k == 'B') return 0;
+    if (k == 'D') return 1;
+    if (k == 'H') return 2;
+    if (alt && k == packName8085(alt)) return 3;
+    return -1;
+  }
+
+  static int sizeOf(const Insn8085 *in) {
+    switch (in->kind) {
+      case K_MVI:
+      case K_IMM8:
+        return 2;
+      case K_LXI:
+      case K_ADDR:
+        return 3;
+      case K_ORG:
+      case K_DB:
+      case K_DW:
+      case K_DS:
+      case K_EQU:
+      case K_END:
+        return 0;
+      default:
+        return 1;
+    }
+  }
+
+  void emit(uint16_t addr, uint8_t v) {
+    image[addr] = v;
+    used[addr >> 3] |= 1 << (addr & 7);
+  }
+
+  bool expectComma(const Tok8085 *&t, const Tok8085 *end, int line) {
+    if (t < end && t->kind == CC_COMMA) {
+      t++;
+      return true;
+    }
+    error(line, "expected ','");
+    return false;
+  }
+
+  // data directives size themselves in both passes
+  void data(const Stmt &s) {
+    const Tok8085 *t = &toks[s.firstTok], *end = t + s.numToks;
+    while (t < end) {
+      if (s.insn->kind == K_DB && t->kind == CC_QUOTE && t->text.size() != 3) {
+        std::string_view str = t->text.substr(1);
+        if (!str.empty() && str.back() == '\'') str.remove_suffix(1);
+        for (char c : str) {
+          if (pass2) emit(pc, c);
+          pc++;
+        }
+        t++;
+      } else {
+        int32_t v;
+        if (!expr(t, end, s.line, v)) return;
+        if (s.insn->kind == K_DB) {
+          if (pass2) emit(pc, v);
+          pc++;
+        } else {
+          if (pass2) {
+            emit(pc, v);
+            emit(pc + 1, v >> 8);
+          }
+          pc += 2;
+        }
+      }
+      if (t < end && !expectComma(t, end, s.line)) return;
+    }
+  }
+
+  // next operand as a register / register pair, -1 (reported) if it isn't
+  int regOperand(const Tok8085 *&t, const Tok8085 *end, int line) {
+    int r = (t < end) ? reg(*t) : -1;
+    if (r < 0)
+      error(line, "expected a register");
+    else
+      t++;
+    return r;
+  }
+
+  int pairOperand(const Tok8085 *&t, const Tok8085 *end, int line,
+                  const char *alt) {
+    int r = (t < end) ? regPair(*t, alt) : -1;
+    if (r < 0)
+      error(line, std::string("expected B, D, H") + (alt ? " or " : "") +
+                      (alt ? alt : ""));
+    else
+      t++;
+    return r;
+  }
+
+  void encode(const Stmt &s) {
+    const Tok8085 *t = &toks[s.firstTok], *end = t + s.numToks;
+    const Insn8085 *in = s.insn;
+    uint8_t op = in->opcode;
+    int32_t v = 0;
+    int r, r2;
+
+    switch (in->kind) {
+      case K_NONE:
+        break;
+      case K_REG_LO:
+        if ((r = regOperand(t, end, s.line)) < 0) return;
+        op |= r;
+        break;
+      case K_REG_MID:
+        if ((r = regOperand(t, end, s.line)) < 0) return;
+        op |= r << 3;
+        break;
+      case K_MOV:
+        if ((r = regOperand(t, end, s.line)) < 0) return;
+        if (!expectComma(t, end, s.line)) return;
+        if ((r2 = regOperand(t, end, s.line)) < 0) return;
+        if (r == 6 && r2 == 6) {
+          error(s.line, "MOV M,M is HLT");
+          return;
+        }
+        op |= r << 3 | r2;
+        break;
+      case K_MVI:
+        if ((r = regOperand(t, end, s.line)) < 0) return;
+        if (!expectComma(t, end, s.line) || !expr(t, end, s.line, v)) return;
+        op |= r << 3;
+        break;
+      case K_LXI:
+        if ((r = pairOperand(t, end, s.line, "SP")) < 0) return;
+        if (!expectComma(t, end, s.line) || !expr(t, end, s.line, v)) return;
+        op |= r << 4;
+        break;
+      case K_RP:
+        if ((r = pairOperand(t, end, s.line, "SP")) < 0) return;
+        op |= r << 4;
+        break;
+      case K_PUSHPOP:
+        if ((r = pairOperand(t, end, s.line, "PSW")) < 0) return;
+        op |= r << 4;
+        break;
+      case K_BD:
+        if ((r = pairOperand(t, end, s.line, nullptr)) < 0) return;
+        if (r > 1) {
+          error(s.line, "expected B or D");
+          return;
+        }
+        op |= r << 4;
+        break;
+      case K_IMM8:
+      case K_ADDR:
+        if (!expr(t, end, s.line, v)) return;
+        break;
+      case K_RST:
+        if (!expr(t, end, s.line, v)) return;
+        if (v < 0 || v > 7) {
+          error(s.line, "RST takes 0-7");
+          return;
+        }
+        op |= v << 3;
+        break;
+    }
+
+    if (t != end) {
+      error(s.line, "unexpected " + std::string(t->text));
+      return;
+    }
+
+    int size = sizeOf(in);
+    if (size == 2 && (v > 0xFF || v < -0x80)) {
+      error(s.line, "value does not fit in a byte");
+      return;
+    }
+
+    emit(s.addr, op);
+    if (size >= 2) emit(s.addr + 1, v);
+    if (size == 3) emit(s.addr + 2, v >> 8);
+  }
+
+  // pass 1: lex, size, define labels
+  void scan(std::string_view src) {
+    std::vector<Tok8085> line;
+    const char *p = src.data(), *end = p + src.size();
+    int lineNo = 0;
+
+    while (p < end) {
+      const char *eol = (const char *)memchr(p, '\n', end - p);
+      if (!eol) eol = end;
+      lineNo++;
+
+      line.clear();
+      lexLine(p, eol, line);
+      p = eol + 1;
+      linesRead++;
+
+      size_t i = 0;
+      std::string_view label;
+      if (line.size() >= 2 && line[0].kind == CC_WORD &&
+          line[1].kind == CC_COLON) {
+        label = line[0].text;
+        i = 2;
+      } else if (line.size() >= 2 && line[0].kind == CC_WORD &&
+                 mnemonics().find(line[0].text) == nullptr &&
+                 line[1].kind == CC_WORD &&
+                 packName8085(line[1].text) == packName8085("EQU")) {
+        label = line[0].text;  // NAME EQU value
+        i = 1;
+      }
+
+      const Insn8085 *in = nullptr;
+      if (i < line.size()) {
+        if (line[i].kind != CC_WORD ||
+            (in = mnemonics().find(line[i].text)) == nullptr) {
+          error(lineNo, "unknown instruction " + std::string(line[i].text));
+          continue;
+        }
+        i++;
+      }
+
+      Stmt s{in, pc, lineNo, (uint32_t)toks.size(),
+             (uint32_t)(line.size() - i)};
+      toks.insert(toks.end(), line.begin() + i, line.end());
+
+      if (in && in->kind == K_EQU) {
+        const Tok8085 *t = &toks[s.firstTok], *te = t + s.numToks;
+        int32_t v;
+        pass2 = true;  // no forward references in an EQU
+        if (label.empty()) {
+          error(lineNo, "EQU needs a name");
+        } else if (expr(t, te, lineNo, v) && !symbols.define(label, v)) {
+          error(lineNo, "duplicate symbol " + std::string(label));
+        }
+        pass2 = false;
+        continue;
+      }
+
+      if (!label.empty() && !symbols.define(label, pc))
+        error(lineNo, "duplicate label " + std::string(label));
+      if (!in) continue;
+
+      if (in->kind == K_END) break;
+      if (in->kind == K_ORG || in->kind == K_DS) {
+        const Tok8085 *t = &toks[s.firstTok], *te = t + s.numToks;
+        int32_t v;
+        if (expr(t, te, lineNo, v)) pc = (in->kind == K_ORG) ? v : pc + v;
+        stmts.push_back(s);
+        continue;
+      }
+      if (in->kind == K_DB || in->kind == K_DW) {
+        data(s);
+        stmts.push_back(s);
+        continue;
+      }
+
+      stmts.push_back(s);
+      pc += sizeOf(in);
+    }
+  }
+
+ public:
+  uint8_t image[0x10000];
+  uint8_t used[0x10000 / 8];  // bit per address that got a byte
+  std::vector<std::string> errors;
+  size_t linesRead;
+
+  // returns true when there were no errors
+  bool assemble(std::string_view src, std::string_view name = "<source>") {
+    fileName = name;
+    toks.clear();
+    stmts.clear();
+    symbols.clear();
+    errors.clear();
+    memset(image, 0, sizeof(image));
+    memset(used, 0, sizeof(used));
+    linesRead = 0;
+
+    pc = 0;
+    pass2 = false;
+    scan(src);
+    if (!errors.empty()) return false;
+
+    pass2 = true;
+    for (const Stmt &s : stmts) {
+      pc = s.addr;
+      switch (s.insn->kind) {
+        case K_ORG:
+        case K_DS:
+          break;
+        case K_DB:
+        case K_DW:
+          data(s);
+          break;
+        default:
+          encode(s);
+      }
+    }
+    return errors.empty();
+  }
+
+  // (source line, address) of every instruction in source order, to put
+  // emulator results back on the source
+  std::vector<std::pair<int, uint16_t>> insnLines() const {
+    std::vector<std::pair<int, uint16_t>> out;
+    for (const Stmt &s : stmts)
+      if (s.insn->kind < K_ORG) out.push_back({s.line, s.addr});
+    return out;
+  }
+
+  bool isUsed(uint16_t addr) const {
+    return used[addr >> 3] >> (addr & 7) & 1;
+  }
+
+  // [lo, hi) of the assembled bytes, for loading into the emulator
+  void extent(uint32_t &lo, uint32_t &hi) const {
+    lo = 0x10000;
+    hi = 0;
+    for (uint32_t a = 0; a < 0x10000; a++) {
+      if (!isUsed(a)) continue;
+      if (a < lo) lo = a;
+      hi = a + 1;
+    }
+  }
+
+  std::string toHex() const {
+    static const char digits[] = "0123456789ABCDEF";
+    std::string out;
+    auto byte = [&](uint8_t b) {
+      out.push_back(digits[b >> 4]);
+      out.push_back(digits[b & 15]);
+    };
+
+    for (uint32_t block = 0; block < 0x10000; block += 16) {
+      // 16 addresses = 2 bytes of the bitmap
+      if (!used[block >> 3] && !used[(block >> 3) + 1]) continue;
+
+      uint8_t sum = 16 + (block >> 8) + (block & 0xFF);
+      out.push_back(':');
+      byte(16);
+      byte(block >> 8);
+      byte(block & 0xFF);
+      byte(0x00);
+      for (int i = 0; i < 16; i++) {
+        byte(image[block + i]);
+        sum += image[block + i];
+      }
+      byte(-sum);
+      out += "\r\n";
+    }
+    out += ":00000001FF";
+    return out;
+  }
+};
+
+#endif
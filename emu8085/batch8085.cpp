@@ -0,0 +1,385 @@
+/*
+ * grades a pile of 8085 programs against a reference solution
+ *
+ *   ./batch8085.out --ref REF.asm --out ADDR:LEN [--out ...]
+ *                   (--cases FILE | --random N ADDR:LEN) [--seed S]
+ *                   [-j N] [--limit INSNS] [--full-copy] FILE|DIR ...
+ *
+ * every FILE.asm (or every .asm in DIR) is assembled once and run from 0000
+ * on every input case, as is the reference; a run passes if it stops on
+ * RST 1 or HLT with the --out regions equal to the reference's. a cases
+ * file has one case per line, ADDR=BYTES with the bytes in hex stored from
+ * ADDR on (2000=05 2001=0903020807); ';' starts a comment. --random makes N
+ * cases of random bytes at ADDR:LEN instead.
+ *
+ * the assembled images are shared read-only by all threads. each thread
+ * keeps one Cpu8085 and before the next instance only puts back the 256
+ * byte pages the last one stored to (Cpu8085::dirty) or had its input in,
+ * so an instance costs its own writes rather than a 64 KB copy. --full-copy
+ * copies the whole image every time instead, for comparison.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "asm8085.h"
+#include "cpu8085.h"
+
+namespace fs = std::filesystem;
+
+struct Program {
+  std::string name;
+  std::vector<uint8_t> image;  // 64 KB, never written after assembling
+};
+
+// bytes stored from addr on before the run
+struct Poke {
+  uint16_t addr;
+  std::vector<uint8_t> bytes;
+};
+typedef std::vector<Poke> Case;
+
+struct Region {
+  uint16_t addr;
+  int len;
+};
+
+// outcome of one program on one case
+struct Result {
+  Stop8085 why;
+  bool pass;
+  int32_t at;  // first differing address, -1 if none
+  uint64_t insns;
+};
+
+bool readFile(const fs::path &path, std::string &out) {
+  std::ifstream in(path, std::ios::binary);
+  if (!in) return false;
+  std::ostringstream ss;
+  ss << in.rdbuf();
+  out = ss.str();
+  return true;
+}
+
+bool assembleFile(Assembler8085 &as, const fs::path &path, Program &prog) {
+  std::string src;
+  if (!readFile(path, src)) {
+    std::cerr << "batch8085: cannot read " << path << "\n";
+    return false;
+  }
+  prog.name = path.filename().string();
+  if (!as.assemble(src, prog.name)) {
+    for (auto &e : as.errors) std::cerr << e << "\n";
+    return false;
+  }
+  prog.image.assign(as.image, as.image + 0x10000);
+  for (uint32_t a = 0; a < 0x10000; a++)
+    if (!as.isUsed(a)) prog.image[a] = 0;
+  return true;
+}
+
+// all of s as a hex number no bigger than max
+bool parseHex(const std::string &s, unsigned long max, unsigned long &v) {
+  if (s.empty() || !isxdigit((unsigned char)s[0])) return false;
+  char *end;
+  errno = 0;
+  v = strtoul(s.c_str(), &end, 16);
+  return *end == '\0' && errno == 0 && v <= max;
+}
+
+bool parseRegion(const std::string &s, Region &r) {
+  size_t colon = s.find(':');
+  unsigned long addr, len;
+  if (colon == std::string::npos ||
+      !parseHex(s.substr(0, colon), 0xFFFF, addr) ||
+      !parseHex(s.substr(colon + 1), 0x10000, len))
+    return false;
+  r.addr = addr;
+  r.len = len;
+  return r.len > 0 && r.addr + r.len <= 0x10000;
+}
+
+bool parsePoke(const std::string &tok, Poke &p) {
+  size_t eq = tok.find('=');
+  std::string hex = eq == std::string::npos ? "" : tok.substr(eq + 1);
+  unsigned long addr, b;
+  if (hex.empty() || hex.size() % 2 ||
+      !parseHex(tok.substr(0, eq), 0xFFFF, addr))
+    return false;
+  p.addr = addr;
+  p.bytes.clear();
+  for (size_t i = 0; i < hex.size(); i += 2) {
+    if (!parseHex(hex.substr(i, 2), 0xFF, b)) return false;
+    p.bytes.push_back(b);
+  }
+  return true;
+}
+
+bool readCases(const std::string &path, std::vector<Case> &cases) {
+  std::ifstream in(path);
+  if (!in) {
+    std::cerr << "batch8085: cannot open " << path << "\n";
+    return false;
+  }
+  std::string line;
+  int lineNo = 0;
+  while (std::getline(in, line)) {
+    lineNo++;
+    line = line.substr(0, line.find(';'));
+    std::istringstream ss(line);
+    std::string tok;
+    Case c;
+    while (ss >> tok) {
+      Poke p;
+      if (!parsePoke(tok, p)) {
+        std::cerr << "batch8085: " << path << ":" << lineNo << " bad '" << tok
+                  << "'\n";
+        return false;
+      }
+      c.push_back(std::move(p));
+    }
+    if (!c.empty()) cases.push_back(std::move(c));
+  }
+  return true;
+}
+
+const char *stopName(Stop8085 s) {
+  switch (s) {
+    case STOP_BUDGET:
+      return "instruction limit";
+    case STOP_HALT:
+      return "HLT";
+    case STOP_RST1:
+      return "RST 1";
+    case STOP_ILLEGAL:
+      return "illegal opcode";
+  }
+  return "";
+}
+
+// one thread's machine: a Cpu8085 whose memory is the image of `loaded`
+// except for the pages marked in cpu->dirty
+struct Machine {
+  std::unique_ptr<Cpu8085> cpu = std::make_unique<Cpu8085>();
+  const Program *loaded = nullptr;
+
+  void start(const Program &prog, const Case &c, bool fullCopy) {
+    Cpu8085 &m = *cpu;
+    if (&prog != loaded || fullCopy) {
+      memcpy(m.mem, prog.image.data(), 0x10000);
+      loaded = &prog;
+    } else {
+      for (int p = 0; p < 256; p++)
+        if (m.dirty[p]) memcpy(m.mem + p * 256, &prog.image[p * 256], 256);
+    }
+    m.clearDirty();
+    for (const Poke &p : c)
+      for (size_t i = 0; i < p.bytes.size(); i++) {
+        uint16_t a = p.addr + i;
+        m.mem[a] = p.bytes[i];
+        m.dirty[a >> 8] = 1;
+      }
+    m.reset();
+  }
+};
+
+int main(int argc, char *argv[]) {
+  unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+  uint64_t limit = 1000000;
+  bool fullCopy = false;
+  std::string refPath, casesPath;
+  int randomCases = 0;
+  Region randomAt{0, 0};
+  unsigned seed = 8085;
+  std::vector<Region> outs;
+  std::vector<fs::path> inputs;
+
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    Region r;
+    if (arg == "-j" && i + 1 < argc) {
+      threads = std::max(1, atoi(argv[++i]));
+    } else if (arg == "--ref" && i + 1 < argc) {
+      refPath = argv[++i];
+    } else if (arg == "--out" && i + 1 < argc) {
+      if (!parseRegion(argv[++i], r)) {
+        std::cerr << "batch8085: bad region " << argv[i] << "\n";
+        return 1;
+      }
+      outs.push_back(r);
+    } else if (arg == "--cases" && i + 1 < argc) {
+      casesPath = argv[++i];
+    } else if (arg == "--random" && i + 2 < argc) {
+      randomCases = std::max(1, atoi(argv[++i]));
+      if (!parseRegion(argv[++i], randomAt)) {
+        std::cerr << "batch8085: bad region " << argv[i] << "\n";
+        return 1;
+      }
+    } else if (arg == "--seed" && i + 1 < argc) {
+      seed = strtoul(argv[++i], nullptr, 0);
+    } else if (arg == "--limit" && i + 1 < argc) {
+      limit = std::max(1LL, atoll(argv[++i]));
+    } else if (arg == "--full-copy") {
+      fullCopy = true;
+    } else {
+      inputs.push_back(arg);
+    }
+  }
+
+  if (refPath.empty() || outs.empty() || inputs.empty() ||
+      casesPath.empty() == !randomCases) {
+    std::cerr << "usage: " << argv[0]
+              << " --ref REF.asm --out ADDR:LEN [--out ...]"
+              << " (--cases FILE | --random N ADDR:LEN) [--seed S]"
+              << " [-j N] [--limit INSNS] [--full-copy] FILE|DIR ...\n";
+    return 1;
+  }
+
+  std::vector<Case> cases;
+  if (!casesPath.empty()) {
+    if (!readCases(casesPath, cases)) return 1;
+  } else {
+    std::mt19937 rng(seed);
+    for (int i = 0; i < randomCases; i++) {
+      Poke p{randomAt.addr, std::vector<uint8_t>(randomAt.len)};
+      for (auto &b : p.bytes) b = rng();
+      cases.push_back({p});
+    }
+  }
+  if (cases.empty()) {
+    std::cerr << "batch8085: no cases\n";
+    return 1;
+  }
+
+  // programs[0] is the reference
+  auto as = std::make_unique<Assembler8085>();
+  std::vector<Program> programs(1);
+  if (!assembleFile(*as, refPath, programs[0])) return 1;
+  for (auto &in : inputs) {
+    std::vector<fs::path> files;
+    if (fs::is_directory(in)) {
+      for (auto &e : fs::directory_iterator(in))
+        if (e.is_regular_file() && e.path().extension() == ".asm")
+          files.push_back(e.path());
+      std::sort(files.begin(), files.end());
+    } else {
+      files.push_back(in);
+    }
+    for (auto &f : files) {
+      Program prog;
+      if (assembleFile(*as, f, prog)) programs.push_back(std::move(prog));
+    }
+  }
+
+  size_t outLen = 0;
+  for (auto &o : outs) outLen += o.len;
+  const size_t nCases = cases.size();
+
+  // the reference's output regions, back to back per case
+  std::vector<uint8_t> want(nCases * outLen);
+  std::vector<Result> results(programs.size() * nCases);
+
+  // job j is program j / nCases on case j % nCases, so a thread mostly
+  // stays on one image and only restores the pages the last run touched
+  unsigned workers = 0;  // threads the last runJobs() started
+  auto runJobs = [&](size_t first, size_t last) {
+    std::atomic<size_t> next{first};
+    auto worker = [&]() {
+      Machine mc;
+      size_t j;
+      while ((j = next++) < last) {
+        const Program &prog = programs[j / nCases];
+        size_t c = j % nCases;
+        mc.start(prog, cases[c], fullCopy);
+
+        Cpu8085 &cpu = *mc.cpu;
+        Result &res = results[j];
+        res.why = cpu.run(limit);
+        res.insns = cpu.executed;
+        res.at = -1;
+
+        uint8_t *w = &want[c * outLen];
+        for (auto &o : outs) {
+          for (int i = 0; i < o.len; i++, w++) {
+            uint8_t got = cpu.mem[(uint16_t)(o.addr + i)];
+            if (j < nCases)
+              *w = got;
+            else if (got != *w && res.at < 0)
+              res.at = (uint16_t)(o.addr + i);
+          }
+        }
+        res.pass =
+            (res.why == STOP_RST1 || res.why == STOP_HALT) && res.at < 0;
+      }
+    };
+
+    unsigned n = std::min<size_t>(threads, last - first);
+    if (n) workers = n;
+    std::vector<std::thread> pool;
+    for (unsigned t = 0; t < n; t++) pool.emplace_back(worker);
+    for (auto &t : pool) t.join();
+  };
+
+  auto start = std::chrono::steady_clock::now();
+  runJobs(0, nCases);
+  for (size_t c = 0; c < nCases; c++)
+    if (!results[c].pass) {
+      std::cerr << "batch8085: " << programs[0].name << " stopped on "
+                << stopName(results[c].why) << " on case " << c + 1 << "\n";
+      return 1;
+    }
+  runJobs(nCases, results.size());
+  double sec =
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - start)
+          .count();
+
+  uint64_t insns = 0;
+  for (auto &res : results) insns += res.insns;
+
+  int failed = 0;
+  for (size_t p = 1; p < programs.size(); p++) {
+    const Result *res = &results[p * nCases];
+    size_t pass = 0, firstBad = nCases;
+    for (size_t c = 0; c < nCases; c++) {
+      if (res[c].pass)
+        pass++;
+      else if (firstBad == nCases)
+        firstBad = c;
+    }
+
+    printf("%-28s %6zu/%zu", programs[p].name.c_str(), pass, nCases);
+    if (firstBad < nCases) {
+      const Result &bad = res[firstBad];
+      printf("   case %zu: ", firstBad + 1);
+      if (bad.at >= 0 && (bad.why == STOP_RST1 || bad.why == STOP_HALT))
+        printf("%04X differs", bad.at);
+      else
+        printf("%s", stopName(bad.why));
+      failed++;
+    }
+    printf("\n");
+  }
+
+  size_t runs = results.size();
+  printf("%zu programs x %zu inputs = %zu runs, %llu instructions in %.3f ms"
+         " on %u threads: %.0f runs/s, %.1f MIPS\n",
+         programs.size(), nCases, runs, (unsigned long long)insns, sec * 1e3,
+         workers, runs / sec, insns / sec / 1e6);
+  if (failed) printf("%d program(s) failed\n", failed);
+
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,1177 @@
+/*
+ * Intel 8085 CPU core for running the programs in `Microprocessor 8085/`.
+ *
+ * 64 KB flat memory, 256 I/O ports, no interrupts. RST 1 (the monitor break
+ * the lab programs end with) and HLT stop the run.
+ *
+ * the opcode semantics live in cpu8085ops.inc and are compiled twice: once
+ * as a plain switch loop (runSwitch, also used by step) and once as a 256
+ * entry computed goto dispatch table (runDispatch) on compilers that have
+ * labels-as-values. run() picks the fastest one available. runThreaded
+ * is a third copy running pre-decoded (direct threaded) code, runLazy
+ * a fourth that computes the flags only when something reads them, and
+ * runProfiled a switch loop that counts executions and T-states per
+ * address. runMapped is run() with every data load and store going
+ * through a 256 entry page table, so that address ranges registered with
+ * mapIo() reach callbacks (memory-mapped I/O); the other loops only see
+ * mem[].
+ *
+ * every loop marks the 256 byte pages it stores to in dirty[];
+ * dirtyPages() packs that into a bitmap and changedSince() diffs those
+ * pages against an earlier image.
+ *
+ * flags: S Z AC P CY in the usual 8085 bits, bit 1 reads as 1, bits 3 and 5
+ * as 0. AC is bit 4 of (a ^ operand ^ result) for both add and subtract type
+ * instructions, i.e. a borrow for SUB/SBB/CMP/DCR, and ANA/ANI set AC.
+ */
+
+#ifndef CPU8085_H
+#define CPU8085_H
+
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <vector>
+
+#if defined(__GNUC__) && !defined(CPU8085_NO_COMPUTED_GOTO)
+#define CPU8085_COMPUTED_GOTO 1
+#endif
+
+enum Flag8085 : uint8_t {
+  FLAG_CY = 0x01,
+  FLAG_P = 0x04,
+  FLAG_AC = 0x10,
+  FLAG_Z = 0x40,
+  FLAG_S = 0x80,
+};
+
+// bit 1 of the flag register always reads back as 1
+constexpr uint8_t FLAG_FIXED = 0x02;
+
+enum Stop8085 {
+  STOP_BUDGET,   // ran the requested number of instructions
+  STOP_HALT,     // HLT
+  STOP_RST1,     // RST 1, end of the lab programs
+  STOP_ILLEGAL,  // undocumented opcode, PC points at it
+};
+
+struct Regs8085 {
+  // low byte of each pair first, so BC/DE/HL/PSW read as little endian words
+  uint8_t c, b, e, d, l, h, f, a;
+  uint16_t sp, pc;
+
+  uint16_t bc() const { return b << 8 | c; }
+  uint16_t de() const { return d << 8 | e; }
+  uint16_t hl() const { return h << 8 | l; }
+  uint16_t psw() const { return a << 8 | f; }
+};
+
+// flags that depend only on the result byte, computed at compile time
+struct FlagTables8085 {
+  uint8_t szp[256];  // S, Z, P of a result (+ fixed bit)
+  uint8_t inr[256];  // S, Z, AC, P after an INR that gave this result
+  uint8_t dcr[256];  // S, Z, AC, P after a DCR that gave this result
+  // S, Z, P, CY for runLazy's result word: a result byte with the carry in
+  // bit 8, or (bit 9 set) S Z P given directly after POP PSW
+  uint8_t lazy[0x400];
+
+  constexpr FlagTables8085() : szp(), inr(), dcr(), lazy() {
+    for (int v = 0; v < 256; v++) {
+      int bits = 0;
+      for (int i = 0; i < 8; i++) bits += (v >> i) & 1;
+
+      uint8_t f = FLAG_FIXED;
+      if (v & 0x80) f |= FLAG_S;
+      if (v == 0) f |= FLAG_Z;
+      if ((bits & 1) == 0) f |= FLAG_P;
+
+      szp[v] = f;
+      inr[v] = f | (((v & 0x0F) == 0x00) ? FLAG_AC : 0);
+      dcr[v] = f | (((v & 0x0F) == 0x0F) ? FLAG_AC : 0);
+    }
+    for (int w = 0; w < 0x400; w++) {
+      uint8_t cy = w >> 8 & FLAG_CY;
+      lazy[w] = (w & 0x200) ? (w & (FLAG_S | FLAG_Z | FLAG_P)) | FLAG_FIXED | cy
+                            : szp[w & 0xFF] | cy;
+    }
+  }
+};
+
+inline constexpr FlagTables8085 flagTables8085{};
+
+// instruction length, whether it can transfer control (jumps, calls,
+// returns, RST, PCHL, HLT and the undocumented opcodes, which stop the run)
+// and its T-states from the 8085 data sheet. tstates is the time when a
+// condition fails (or there is none), tstatesTaken when Jcc/Ccc/Rcc go
+enum OpClass8085 : uint8_t { OPC_ENDS_BLOCK = 0x01 };
+
+struct OpInfo8085 {
+  uint8_t len[256];
+  uint8_t cls[256];
+  uint8_t tstates[256];
+  uint8_t tstatesTaken[256];
+
+  constexpr OpInfo8085() : len(), cls(), tstates(), tstatesTaken() {
+    for (int op = 0; op < 256; op++) {
+      int lo = op & 7, mid = op >> 3 & 7;
+      bool undoc = (op < 0x40 && lo == 0 && mid != 0 && mid != 4 &&
+                    mid != 6) ||
+                   op == 0xCB || op == 0xD9 || op == 0xDD || op == 0xED ||
+                   op == 0xFD;
+      len[op] = 1;
+      cls[op] = undoc || op == 0x76 ? OPC_ENDS_BLOCK : 0;
+      tstates[op] = tstatesTaken[op] = 4;
+      if (undoc) continue;
+
+      int t = 4, taken = 0;
+      if (op < 0x40) {
+        // MVI; LXI, SHLD, LHLD, STA, LDA
+        if (lo == 6) len[op] = 2;
+        if ((op & 0xCF) == 0x01 || (op & 0xE7) == 0x22) len[op] = 3;
+
+        if (lo == 1) t = 10;                               // LXI, DAD
+        if (lo == 2) t = op < 0x20 ? 7 : op < 0x30 ? 16 : 13;
+        if (lo == 3) t = 6;                                // INX, DCX
+        if (lo == 4 || lo == 5) t = mid == 6 ? 10 : 4;     // INR, DCR
+        if (lo == 6) t = mid == 6 ? 10 : 7;                // MVI
+      } else if (op < 0x80) {
+        t = op == 0x76 ? 5 : (lo == 6 || mid == 6) ? 7 : 4;  // HLT, MOV
+      } else if (op < 0xC0) {
+        t = lo == 6 ? 7 : 4;
+      } else {
+        // immediate ALU ops, IN, OUT; Jcc, Ccc, JMP, CALL
+        if (lo == 6 || op == 0xD3 || op == 0xDB) len[op] = 2;
+        if (lo == 2 || lo == 4 || op == 0xC3 || op == 0xCD) len[op] = 3;
+        // Rcc, Jcc, Ccc, RST, JMP, RET, CALL, PCHL
+        if (lo == 0 || lo == 2 || lo == 4 || lo == 7 || op == 0xC3 ||
+            op == 0xC9 || op == 0xCD || op == 0xE9)
+          cls[op] = OPC_ENDS_BLOCK;
+
+        switch (lo) {
+          case 0:  // Rcc
+            t = 6, taken = 12;
+            break;
+          case 1:  // POP, RET; PCHL, SPHL
+            t = op == 0xE9 || op == 0xF9 ? 6 : 10;
+            break;
+          case 2:  // Jcc
+            t = 7, taken = 10;
+            break;
+          case 3:  // JMP, OUT, IN; XTHL; XCHG, DI, EI
+            t = op == 0xE3 ? 16 : op >= 0xE8 ? 4 : 10;
+            break;
+          case 4:  // Ccc
+            t = 9, taken = 18;
+            break;
+          case 5:  // PUSH, CALL
+            t = op == 0xCD ? 18 : 12;
+            break;
+          case 6:
+            t = 7;
+            break;
+          case 7:  // RST
+            t = 12;
+            break;
+        }
+      }
+      tstates[op] = t;
+      tstatesTaken[op] = taken ? taken : t;
+    }
+  }
+};
+
+inline constexpr OpInfo8085 opInfo8085{};
+
+// one pre-decoded instruction for runThreaded: the handler to jump to and
+// its operand already assembled from the bytes after the opcode
+struct Decoded8085 {
+  const void *handler;
+  uint16_t imm;
+};
+
+// what runProfiled collects, by the address of each instruction's opcode
+struct Profile8085 {
+  uint64_t count[0x10000];    // times executed
+  uint64_t tstates[0x10000];  // T-states spent there
+  uint64_t total;             // T-states of the whole run
+
+  void clear() { memset(this, 0, sizeof(*this)); }
+};
+
+// a set of 256 byte pages, 64 to a word
+struct Pages8085 {
+  uint64_t w[4] = {0, 0, 0, 0};
+
+  void set(int p) { w[p >> 6] |= 1ull << (p & 63); }
+  bool has(int p) const { return w[p >> 6] >> (p & 63) & 1; }
+  int count() const {
+    return __builtin_popcountll(w[0]) + __builtin_popcountll(w[1]) +
+           __builtin_popcountll(w[2]) + __builtin_popcountll(w[3]);
+  }
+
+  // f(page) for each page in the set, lowest first
+  template <class F>
+  void each(F f) const {
+    for (int i = 0; i < 4; i++)
+      for (uint64_t b = w[i]; b; b &= b - 1) f(i * 64 + __builtin_ctzll(b));
+  }
+};
+
+// ---------------------------------------------------------------------------
+// macros used by cpu8085ops.inc. they work on the interpreter's locals:
+// A F B C D E H L (uint8_t), PC SP (uint16_t), m (memory), SZP/INRF/DCRF
+
+#define RD(a) m[(uint16_t)(a)]
+#define WR(a, v) (m[(uint16_t)(a)] = (v), DIRTY[(uint16_t)(a) >> 8] = 1)
+
+// operands of the current instruction (PC points just past the opcode)
+#define IMM8() RD(PC)
+#define IMM16() ((uint16_t)(RD(PC) | RD(PC + 1) << 8))
+#define B_PAIR ((uint16_t)(B << 8 | C))
+#define D_PAIR ((uint16_t)(D << 8 | E))
+#define H_PAIR ((uint16_t)(H << 8 | L))
+#define HL H_PAIR
+
+// every flag access goes through these, so runLazy can swap them out.
+// SET_FLAGS takes an 8 bit result with the carry/borrow in bit 8 and
+// aux = a ^ operand: AC is bit 4 of aux ^ result
+#define FLAGS() F
+#define CARRY (F & FLAG_CY)
+#define HALFC (F & FLAG_AC)
+#define SET_CY(c) (F = (F & ~FLAG_CY) | (c))
+#define SET_FLAGS(res, aux)                                                   \
+  (F = SZP[(uint8_t)(res)] | (((aux) ^ (res)) & FLAG_AC) |                    \
+       (((res) >> 8) & FLAG_CY))
+
+#define COND_NZ (!(F & FLAG_Z))
+#define COND_Z (F & FLAG_Z)
+#define COND_NC (!(F & FLAG_CY))
+#define COND_C (F & FLAG_CY)
+#define COND_PO (!(F & FLAG_P))
+#define COND_PE (F & FLAG_P)
+#define COND_P (!(F & FLAG_S))
+#define COND_M (F & FLAG_S)
+
+#define LXI(hi, lo)                                                           \
+  {                                                                           \
+    uint16_t v_ = IMM16();                                                    \
+    lo = v_;                                                                  \
+    hi = v_ >> 8;                                                             \
+    PC += 2;                                                                  \
+  }
+#define INX(hi, lo)                                                           \
+  {                                                                           \
+    if (++lo == 0) hi++;                                                      \
+  }
+#define DCX(hi, lo)                                                           \
+  {                                                                           \
+    if (lo-- == 0) hi--;                                                      \
+  }
+
+#define PUSH16(v)                                                             \
+  {                                                                           \
+    uint16_t p_ = (v);                                                        \
+    WR(SP - 1, p_ >> 8);                                                      \
+    WR(SP - 2, p_);                                                           \
+    SP -= 2;                                                                  \
+  }
+#define POP16(x)                                                              \
+  {                                                                           \
+    x = RD(SP) | RD(SP + 1) << 8;                                             \
+    SP += 2;                                                                  \
+  }
+#define POP_RP(hi, lo)                                                        \
+  {                                                                           \
+    lo = RD(SP);                                                              \
+    hi = RD(SP + 1);                                                          \
+    SP += 2;                                                                  \
+  }
+#define POP_PSW()                                                             \
+  {                                                                           \
+    F = (RD(SP) & 0xD5) | FLAG_FIXED;                                         \
+    A = RD(SP + 1);                                                           \
+    SP += 2;                                                                  \
+  }
+#define CALL_IF(cond)                                                         \
+  if (cond) {                                                                 \
+    uint16_t a_ = IMM16();                                                    \
+    PUSH16(PC + 2);                                                           \
+    PC = a_;                                                                  \
+  } else {                                                                    \
+    PC += 2;                                                                  \
+  }
+
+#define SHLD()                                                                \
+  {                                                                           \
+    uint16_t a_ = IMM16();                                                    \
+    PC += 2;                                                                  \
+    WR(a_, L);                                                                \
+    WR(a_ + 1, H);                                                            \
+  }
+#define LHLD()                                                                \
+  {                                                                           \
+    uint16_t a_ = IMM16();                                                    \
+    PC += 2;                                                                  \
+    L = RD(a_);                                                               \
+    H = RD(a_ + 1);                                                           \
+  }
+#define XTHL()                                                                \
+  {                                                                           \
+    uint8_t t_ = RD(SP);                                                      \
+    WR(SP, L);                                                                \
+    L = t_;                                                                   \
+    t_ = RD(SP + 1);                                                          \
+    WR(SP + 1, H);                                                            \
+    H = t_;                                                                   \
+  }
+#define XCHG()                                                                \
+  {                                                                           \
+    uint8_t t_ = H;                                                           \
+    H = D;                                                                    \
+    D = t_;                                                                   \
+    t_ = L;                                                                   \
+    L = E;                                                                    \
+    E = t_;                                                                   \
+  }
+
+#define ADD_CARRY(v, cy)                                                      \
+  {                                                                           \
+    uint8_t v_ = (v);                                                         \
+    unsigned r_ = A + v_ + (cy);                                              \
+    SET_FLAGS(r_, A ^ v_);                                                    \
+    A = r_;                                                                   \
+  }
+#define SUB_BORROW(v, cy, store)                                              \
+  {                                                                           \
+    uint8_t v_ = (v);                                                         \
+    unsigned r_ = A - v_ - (cy);                                              \
+    SET_FLAGS(r_, A ^ v_);                                                    \
+    if (store) A = r_;                                                        \
+  }
+#define ADD(v) ADD_CARRY(v, 0)
+#define ADC(v) ADD_CARRY(v, CARRY)
+#define SUB(v) SUB_BORROW(v, 0, true)
+#define SBB(v) SUB_BORROW(v, CARRY, true)
+#define CMP(v) SUB_BORROW(v, 0, false)
+#define ANA(v)                                                                \
+  {                                                                           \
+    A &= (v);                                                                 \
+    SET_FLAGS(A, A ^ FLAG_AC);                                                \
+  }
+#define XRA(v)                                                                \
+  {                                                                           \
+    A ^= (v);                                                                 \
+    SET_FLAGS(A, A);                                                          \
+  }
+#define ORA(v)                                                                \
+  {                                                                           \
+    A |= (v);                                                                 \
+    SET_FLAGS(A, A);                                                          \
+  }
+#define INR(x)                                                                \
+  {                                                                           \
+    x++;                                                                      \
+    F = CARRY | INRF[x];                                                      \
+  }
+#define DCR(x)                                                                \
+  {                                                                           \
+    x--;                                                                      \
+    F = CARRY | DCRF[x];                                                      \
+  }
+#define DAD(v)                                                                \
+  {                                                                           \
+    uint32_t r_ = HL + (v);                                                   \
+    H = r_ >> 8;                                                              \
+    L = r_;                                                                   \
+    SET_CY(r_ >> 16);                                                         \
+  }
+
+#define RLC()                                                                 \
+  {                                                                           \
+    A = A << 1 | A >> 7;                                                      \
+    SET_CY(A & 1);                                                            \
+  }
+#define RRC()                                                                 \
+  {                                                                           \
+    SET_CY(A & 1);                                                            \
+    A = A >> 1 | A << 7;                                                      \
+  }
+#define RAL()                                                                 \
+  {                                                                           \
+    uint8_t c_ = A >> 7;                                                      \
+    A = A << 1 | CARRY;                                                       \
+    SET_CY(c_);                                                               \
+  }
+#define RAR()                                                                 \
+  {                                                                           \
+    uint8_t c_ = A & 1;                                                       \
+    A = A >> 1 | CARRY << 7;                                                  \
+    SET_CY(c_);                                                               \
+  }
+#define DAA()                                                                 \
+  {                                                                           \
+    uint8_t cor_ = 0, cy_ = CARRY;                                            \
+    if ((A & 0x0F) > 9 || HALFC) cor_ |= 0x06;                                \
+    if (A > 0x99 || cy_) {                                                    \
+      cor_ |= 0x60;                                                           \
+      cy_ = 1;                                                                \
+    }                                                                         \
+    uint8_t r_ = A + cor_;                                                    \
+    SET_FLAGS(r_ | cy_ << 8, A ^ cor_);                                       \
+    A = r_;                                                                   \
+  }
+
+#define INP(port) ports[port]
+#define OUTP(port, v) (ports[port] = (v))
+
+// interpreter state in locals: with the registers as members every store to
+// memory (uint8_t, may alias anything) would force them back to `this`
+#define CPU8085_LOAD_LOCALS                                                   \
+  uint8_t A = r.a, F = r.f, B = r.b, C = r.c, D = r.d,                        \
+          E = r.e, H = r.h, L = r.l;                                          \
+  uint16_t PC = r.pc, SP = r.sp;                                              \
+  uint8_t *m = mem;                                                           \
+  uint8_t *DIRTY = dirty;                                                     \
+  const uint8_t *SZP = flagTables8085.szp;                                    \
+  const uint8_t *INRF = flagTables8085.inr;                                   \
+  const uint8_t *DCRF = flagTables8085.dcr;
+
+#define CPU8085_STORE_LOCALS                                                  \
+  r.a = A;                                                                    \
+  r.f = F;                                                                    \
+  r.b = B;                                                                    \
+  r.c = C;                                                                    \
+  r.d = D;                                                                    \
+  r.e = E;                                                                    \
+  r.h = H;                                                                    \
+  r.l = L;                                                                    \
+  r.pc = PC;                                                                  \
+  r.sp = SP;
+
+class Cpu8085 {
+ public:
+  Regs8085 r;
+  bool ie;
+  uint8_t ports[256];
+
+  // instructions retired since the last reset
+  uint64_t executed;
+
+  alignas(64) uint8_t mem[0x10000];
+
+  // 256 byte pages the run loops have stored to since clearDirty(). load()
+  // and stores through mem[] from outside don't count
+  uint8_t dirty[256];
+
+  Cpu8085() {
+    memset(mem, 0, sizeof(mem));
+    clearDirty();
+    memset(codePage, 0, sizeof(codePage));
+    memset(ioPage, 0, sizeof(ioPage));
+    reset();
+  }
+
+  // registers, ports and counters; memory is left alone
+  void reset(uint16_t pc = 0x0000) {
+    memset(&r, 0, sizeof(r));
+    r.f = FLAG_FIXED;
+    r.sp = 0xFFFF;
+    r.pc = pc;
+    ie = false;
+    memset(ports, 0, sizeof(ports));
+    executed = 0;
+  }
+
+  // stores through mem[] from outside the CPU, or made by the other run
+  // loops, don't invalidate runThreaded's translations; load() does,
+  // anything else needs flushTranslations()
+  void load(uint16_t addr, const uint8_t *bytes, size_t n) {
+    while (n) {
+      size_t k = n < 0x10000u - addr ? n : 0x10000u - addr;  // wraps at 64K
+      memcpy(mem + addr, bytes, k);
+      for (int p = addr >> 8; p <= (int)((addr + k - 1) >> 8); p++)
+        if (codePage[p]) invalidatePage(p);
+      addr += k, bytes += k, n -= k;
+    }
+  }
+
+  void flushTranslations() {
+    for (int p = 0; p < 256; p++)
+      if (codePage[p]) invalidatePage(p);
+  }
+
+  void clearDirty() { memset(dirty, 0, sizeof(dirty)); }
+
+  Pages8085 dirtyPages() const {
+    Pages8085 s;
+    for (int p = 0; p < 256; p++)
+      if (dirty[p]) s.set(p);
+    return s;
+  }
+
+  // addresses whose byte differs from before[] (a whole 64 KB image),
+  // looking only at the pages stored to since clearDirty()
+  std::vector<uint16_t> changedSince(const uint8_t *before) const {
+    std::vector<uint16_t> out;
+    dirtyPages().each([&](int p) {
+      const uint8_t *now = mem + p * 256, *was = before + p * 256;
+      if (memcmp(now, was, 256) == 0) return;
+      for (int i = 0; i < 256; i++)
+        if (now[i] != was[i]) out.push_back(p * 256 + i);
+    });
+    return out;
+  }
+
+  // memory-mapped I/O for runMapped: data loads from [first, last] call
+  // read and stores call write instead of going to mem[]. with no read the
+  // load sees mem[], with no write the store is dropped. the rest of a page
+  // a region is on stays plain memory, only slower; pages without a region
+  // cost one table lookup per access. the first region that matches wins
+  void mapIo(uint16_t first, uint16_t last,
+             std::function<uint8_t(uint16_t)> read,
+             std::function<void(uint16_t, uint8_t)> write) {
+    io.push_back({first, last, std::move(read), std::move(write)});
+    for (int p = first >> 8; p <= last >> 8; p++) ioPage[p] = 1;
+  }
+
+  void unmapIo() {
+    io.clear();
+    memset(ioPage, 0, sizeof(ioPage));
+  }
+
+  uint8_t rim() const { return ie ? 0x08 : 0x00; }
+  void sim(uint8_t) {}
+
+  Stop8085 step() { return runSwitch(1); }
+
+  Stop8085 run(uint64_t maxInsns = UINT64_MAX) {
+#ifdef CPU8085_COMPUTED_GOTO
+    return runDispatch(maxInsns);
+#else
+    return runSwitch(maxInsns);
+#endif
+  }
+
+  // fetch, switch, repeat
+  Stop8085 runSwitch(uint64_t maxInsns) {
+    CPU8085_LOAD_LOCALS
+    uint64_t left = maxInsns;
+    Stop8085 why = STOP_BUDGET;
+
+    while (left) {
+      left--;
+      switch (RD(PC++)) {
+#define OP(n) case n:
+#define NEXT continue
+#define HALT(s)                                                               \
+  {                                                                           \
+    why = s;                                                                  \
+    goto out;                                                                 \
+  }
+#define ILLEGAL()                                                             \
+  {                                                                           \
+    PC--;                                                                     \
+    left++;                                                                   \
+    why = STOP_ILLEGAL;                                                       \
+    goto out;                                                                 \
+  }
+#include "cpu8085ops.inc"
+#undef OP
+#undef NEXT
+#undef HALT
+#undef ILLEGAL
+      }
+    }
+
+  out:
+    CPU8085_STORE_LOCALS
+    executed += maxInsns - left;
+    return why;
+  }
+
+  // run() with the loads and stores of data looked up in the page table
+  // that mapIo() fills in: the dispatch loop where there is one, else the
+  // switch. instructions are fetched straight from mem[], which keeps the
+  // check off the fetch path; code can't run from an I/O region
+  Stop8085 runMapped(uint64_t maxInsns) {
+    CPU8085_LOAD_LOCALS
+    const uint8_t *IOPAGE = ioPage;
+    uint64_t left = maxInsns;
+    Stop8085 why = STOP_BUDGET;
+
+    auto rd = [this, m, IOPAGE](uint16_t a) -> uint8_t {
+      return __builtin_expect(IOPAGE[a >> 8], 0) ? ioRead(a) : m[a];
+    };
+    auto wr = [this, m, DIRTY, IOPAGE](uint16_t a, uint8_t v) {
+      if (__builtin_expect(IOPAGE[a >> 8], 0)) {
+        ioWrite(a, v);
+      } else {
+        m[a] = v;
+        DIRTY[a >> 8] = 1;
+      }
+    };
+
+#pragma push_macro("RD")
+#pragma push_macro("WR")
+#undef RD
+#undef WR
+#define RD(a) rd((uint16_t)(a))
+#define WR(a, v) wr((uint16_t)(a), (v))
+#pragma push_macro("IMM8")
+#pragma push_macro("IMM16")
+#undef IMM8
+#undef IMM16
+#define IMM8() m[PC]
+#define IMM16() ((uint16_t)(m[PC] | m[(uint16_t)(PC + 1)] << 8))
+#ifdef CPU8085_COMPUTED_GOTO
+#define ROW(h)                                                                \
+  &&mp_##h##0, &&mp_##h##1, &&mp_##h##2, &&mp_##h##3, &&mp_##h##4,            \
+      &&mp_##h##5, &&mp_##h##6, &&mp_##h##7, &&mp_##h##8, &&mp_##h##9,        \
+      &&mp_##h##A, &&mp_##h##B, &&mp_##h##C, &&mp_##h##D, &&mp_##h##E,        \
+      &&mp_##h##F
+    static const void *const dispatch[256] = {
+        ROW(0x0), ROW(0x1), ROW(0x2), ROW(0x3), ROW(0x4), ROW(0x5),
+        ROW(0x6), ROW(0x7), ROW(0x8), ROW(0x9), ROW(0xA), ROW(0xB),
+        ROW(0xC), ROW(0xD), ROW(0xE), ROW(0xF)};
+#undef ROW
+
+    if (left == 0) goto out;
+    goto *dispatch[m[PC++]];
+
+#define OP(n) mp_##n:
+#define NEXT                                                                  \
+  {                                                                           \
+    if (--left == 0) goto out;                                                \
+    goto *dispatch[m[PC++]];                                                 \
+  }
+#define HALT(s)                                                               \
+  {                                                                           \
+    left--;                                                                   \
+    why = s;                                                                  \
+    goto out;                                                                 \
+  }
+#define ILLEGAL()                                                             \
+  {                                                                           \
+    PC--;                                                                     \
+    why = STOP_ILLEGAL;                                                       \
+    goto out;                                                                 \
+  }
+#include "cpu8085ops.inc"
+#else
+    while (left) {
+      left--;
+      switch (m[PC++]) {
+#define OP(n) case n:
+#define NEXT continue
+#define HALT(s)                                                               \
+  {                                                                           \
+    why = s;                                                                  \
+    goto out;                                                                 \
+  }
+#define ILLEGAL()                                                             \
+  {                                                                           \
+    PC--;                                                                     \
+    left++;                                                                   \
+    why = STOP_ILLEGAL;                                                       \
+    goto out;                                                                 \
+  }
+#include "cpu8085ops.inc"
+      }
+    }
+#endif
+#undef OP
+#undef NEXT
+#undef HALT
+#undef ILLEGAL
+#pragma pop_macro("RD")
+#pragma pop_macro("WR")
+#pragma pop_macro("IMM8")
+#pragma pop_macro("IMM16")
+
+  out:
+    CPU8085_STORE_LOCALS
+    executed += maxInsns - left;
+    return why;
+  }
+
+  // runSwitch counting every instruction and its T-states into prof (which
+  // is added to, not cleared). a separate loop so that the others pay
+  // nothing for it
+  Stop8085 runProfiled(uint64_t maxInsns, Profile8085 &prof) {
+    CPU8085_LOAD_LOCALS
+    uint64_t left = maxInsns;
+    Stop8085 why = STOP_BUDGET;
+    bool taken;
+
+#pragma push_macro("COND_NZ")
+#pragma push_macro("COND_Z")
+#pragma push_macro("COND_NC")
+#pragma push_macro("COND_C")
+#pragma push_macro("COND_PO")
+#pragma push_macro("COND_PE")
+#pragma push_macro("COND_P")
+#pragma push_macro("COND_M")
+#undef COND_NZ
+#undef COND_Z
+#undef COND_NC
+#undef COND_C
+#undef COND_PO
+#undef COND_PE
+#undef COND_P
+#undef COND_M
+#define COND_NZ (taken = !(F & FLAG_Z))
+#define COND_Z (taken = F & FLAG_Z)
+#define COND_NC (taken = !(F & FLAG_CY))
+#define COND_C (taken = F & FLAG_CY)
+#define COND_PO (taken = !(F & FLAG_P))
+#define COND_PE (taken = F & FLAG_P)
+#define COND_P (taken = !(F & FLAG_S))
+#define COND_M (taken = F & FLAG_S)
+#define PROFILE()                                                             \
+  {                                                                           \
+    uint8_t t_ = (taken ? opInfo8085.tstatesTaken : opInfo8085.tstates)[op]; \
+    prof.count[at]++;                                                         \
+    prof.tstates[at] += t_;                                                   \
+    prof.total += t_;                                                         \
+  }
+
+    while (left) {
+      left--;
+      uint16_t at = PC;
+      uint8_t op = RD(PC++);
+      taken = false;
+      switch (op) {
+#define OP(n) case n:
+#define NEXT break
+#define HALT(s)                                                               \
+  {                                                                           \
+    why = s;                                                                  \
+    PROFILE();                                                                \
+    goto out;                                                                 \
+  }
+#define ILLEGAL()                                                             \
+  {                                                                           \
+    PC--;                                                                     \
+    left++;                                                                   \
+    why = STOP_ILLEGAL;                                                       \
+    goto out;                                                                 \
+  }
+#include "cpu8085ops.inc"
+#undef OP
+#undef NEXT
+#undef HALT
+#undef ILLEGAL
+      }
+      PROFILE();
+    }
+
+#undef PROFILE
+#pragma pop_macro("COND_NZ")
+#pragma pop_macro("COND_Z")
+#pragma pop_macro("COND_NC")
+#pragma pop_macro("COND_C")
+#pragma pop_macro("COND_PO")
+#pragma pop_macro("COND_PE")
+#pragma pop_macro("COND_P")
+#pragma pop_macro("COND_M")
+
+  out:
+    CPU8085_STORE_LOCALS
+    executed += maxInsns - left;
+    return why;
+  }
+
+#ifdef CPU8085_COMPUTED_GOTO
+  // every handler ends by jumping straight to the next opcode's handler, so
+  // each one gets its own indirect branch (and branch predictor entry)
+  Stop8085 runDispatch(uint64_t maxInsns) {
+#define ROW(h)                                                                \
+  &&op_##h##0, &&op_##h##1, &&op_##h##2, &&op_##h##3, &&op_##h##4,            \
+      &&op_##h##5, &&op_##h##6, &&op_##h##7, &&op_##h##8, &&op_##h##9,        \
+      &&op_##h##A, &&op_##h##B, &&op_##h##C, &&op_##h##D, &&op_##h##E,        \
+      &&op_##h##F
+    static const void *const dispatch[256] = {
+        ROW(0x0), ROW(0x1), ROW(0x2), ROW(0x3), ROW(0x4), ROW(0x5),
+        ROW(0x6), ROW(0x7), ROW(0x8), ROW(0x9), ROW(0xA), ROW(0xB),
+        ROW(0xC), ROW(0xD), ROW(0xE), ROW(0xF)};
+#undef ROW
+
+    CPU8085_LOAD_LOCALS
+    uint64_t left = maxInsns;
+    Stop8085 why = STOP_BUDGET;
+
+    if (left == 0) goto out;
+    goto *dispatch[RD(PC++)];
+
+#define OP(n) op_##n:
+#define NEXT                                                                  \
+  {                                                                           \
+    if (--left == 0) goto out;                                                \
+    goto *dispatch[RD(PC++)];                                                 \
+  }
+#define HALT(s)                                                               \
+  {                                                                           \
+    left--;                                                                   \
+    why = s;                                                                  \
+    goto out;                                                                 \
+  }
+#define ILLEGAL()                                                             \
+  {                                                                           \
+    PC--;                                                                     \
+    why = STOP_ILLEGAL;                                                       \
+    goto out;                                                                 \
+  }
+#include "cpu8085ops.inc"
+#undef OP
+#undef NEXT
+#undef HALT
+#undef ILLEGAL
+
+  out:
+    CPU8085_STORE_LOCALS
+    executed += maxInsns - left;
+    return why;
+  }
+
+  // direct threaded code: each address that gets executed is translated
+  // once into the handler address plus its pre-assembled operand, so the
+  // steady state is a load from tcache[PC] and a jump. translation runs a
+  // basic block ahead; stores into a page that holds translated code throw
+  // that page's translations away (and so does load())
+  Stop8085 runThreaded(uint64_t maxInsns) {
+#define ROW(h)                                                                \
+  &&th_##h##0, &&th_##h##1, &&th_##h##2, &&th_##h##3, &&th_##h##4,            \
+      &&th_##h##5, &&th_##h##6, &&th_##h##7, &&th_##h##8, &&th_##h##9,        \
+      &&th_##h##A, &&th_##h##B, &&th_##h##C, &&th_##h##D, &&th_##h##E,        \
+      &&th_##h##F
+    static const void *const handlers[256] = {
+        ROW(0x0), ROW(0x1), ROW(0x2), ROW(0x3), ROW(0x4), ROW(0x5),
+        ROW(0x6), ROW(0x7), ROW(0x8), ROW(0x9), ROW(0xA), ROW(0xB),
+        ROW(0xC), ROW(0xD), ROW(0xE), ROW(0xF)};
+#undef ROW
+
+    if (tcache.empty()) {
+      untranslated = &&translate;
+      tcache.assign(0x10000, Decoded8085{untranslated, 0});
+    }
+
+    CPU8085_LOAD_LOCALS
+    Decoded8085 *tc = tcache.data();
+    const Decoded8085 *ip;
+    uint64_t left = maxInsns;
+    Stop8085 why = STOP_BUDGET;
+
+#pragma push_macro("IMM8")
+#pragma push_macro("IMM16")
+#pragma push_macro("WR")
+#undef IMM8
+#undef IMM16
+#undef WR
+#define IMM8() ((uint8_t)ip->imm)
+#define IMM16() (ip->imm)
+#define WR(a, v)                                                              \
+  (m[(uint16_t)(a)] = (v), DIRTY[(uint16_t)(a) >> 8] = 1,                     \
+   codePage[(uint16_t)(a) >> 8] ? invalidatePage((uint16_t)(a) >> 8)          \
+                                : (void)0)
+#define DISPATCH()                                                            \
+  {                                                                           \
+    ip = &tc[PC++];                                                           \
+    goto *ip->handler;                                                        \
+  }
+
+    if (left == 0) goto out;
+    DISPATCH();
+
+  // PC is one past an opcode nobody has translated yet: decode from there to
+  // the end of its basic block, then run it
+  translate:
+    PC--;
+    for (uint16_t a = PC;;) {
+      uint8_t op = RD(a), len = opInfo8085.len[op];
+      tc[a].handler = handlers[op];
+      tc[a].imm = (len > 1 ? RD(a + 1) : 0) | (len > 2 ? RD(a + 2) << 8 : 0);
+      codePage[a >> 8] = codePage[(uint16_t)(a + len - 1) >> 8] = true;
+      a += len;
+      if (opInfo8085.cls[op] & OPC_ENDS_BLOCK) break;
+      if (tc[a].handler != untranslated) break;
+    }
+    DISPATCH();
+
+#define OP(n) th_##n:
+#define NEXT                                                                  \
+  {                                                                           \
+    if (--left == 0) goto out;                                                \
+    DISPATCH();                                                               \
+  }
+#define HALT(s)                                                               \
+  {                                                                           \
+    left--;                                                                   \
+    why = s;                                                                  \
+    goto out;                                                                 \
+  }
+#define ILLEGAL()                                                             \
+  {                                                                           \
+    PC--;                                                                     \
+    why = STOP_ILLEGAL;                                                       \
+    goto out;                                                                 \
+  }
+#include "cpu8085ops.inc"
+#undef OP
+#undef NEXT
+#undef HALT
+#undef ILLEGAL
+#undef DISPATCH
+#pragma pop_macro("IMM8")
+#pragma pop_macro("IMM16")
+#pragma pop_macro("WR")
+
+  out:
+    CPU8085_STORE_LOCALS
+    executed += maxInsns - left;
+    return why;
+  }
+
+  // lazy flags: flag setting instructions only record their result word
+  // (result byte, carry in bit 8) and a ^ operand for AC. conditional
+  // jumps look at the bit they need and PUSH PSW rebuilds F
+  Stop8085 runLazy(uint64_t maxInsns) {
+#define ROW(h)                                                                \
+  &&lz_##h##0, &&lz_##h##1, &&lz_##h##2, &&lz_##h##3, &&lz_##h##4,            \
+      &&lz_##h##5, &&lz_##h##6, &&lz_##h##7, &&lz_##h##8, &&lz_##h##9,        \
+      &&lz_##h##A, &&lz_##h##B, &&lz_##h##C, &&lz_##h##D, &&lz_##h##E,        \
+      &&lz_##h##F
+    static const void *const dispatch[256] = {
+        ROW(0x0), ROW(0x1), ROW(0x2), ROW(0x3), ROW(0x4), ROW(0x5),
+        ROW(0x6), ROW(0x7), ROW(0x8), ROW(0x9), ROW(0xA), ROW(0xB),
+        ROW(0xC), ROW(0xD), ROW(0xE), ROW(0xF)};
+#undef ROW
+
+    CPU8085_LOAD_LOCALS
+    (void)SZP, (void)INRF, (void)DCRF;
+    const uint8_t *LZF = flagTables8085.lazy;
+    unsigned LR, LX;
+    uint64_t left = maxInsns;
+    Stop8085 why = STOP_BUDGET;
+
+#pragma push_macro("FLAGS")
+#pragma push_macro("CARRY")
+#pragma push_macro("HALFC")
+#pragma push_macro("SET_CY")
+#pragma push_macro("SET_FLAGS")
+#pragma push_macro("INR")
+#pragma push_macro("DCR")
+#pragma push_macro("POP_PSW")
+#pragma push_macro("COND_NZ")
+#pragma push_macro("COND_Z")
+#pragma push_macro("COND_NC")
+#pragma push_macro("COND_C")
+#pragma push_macro("COND_PO")
+#pragma push_macro("COND_PE")
+#pragma push_macro("COND_P")
+#pragma push_macro("COND_M")
+#undef FLAGS
+#undef CARRY
+#undef HALFC
+#undef SET_CY
+#undef SET_FLAGS
+#undef INR
+#undef DCR
+#undef POP_PSW
+#undef COND_NZ
+#undef COND_Z
+#undef COND_NC
+#undef COND_C
+#undef COND_PO
+#undef COND_PE
+#undef COND_P
+#undef COND_M
+#define FLAGS() (F = LZF[LR] | ((LX ^ LR) & FLAG_AC))
+#define CARRY ((LR >> 8) & 1)
+#define HALFC ((LX ^ LR) & FLAG_AC)
+#define SET_CY(c) (LR = (LR & ~0x100u) | (c) << 8)
+#define SET_FLAGS(res, aux) (LR = (res) & 0x1FF, LX = (aux))
+#define INR(x)                                                                \
+  {                                                                           \
+    LX = x ^ 1;                                                               \
+    x++;                                                                      \
+    LR = (LR & 0x100) | x;                                                    \
+  }
+#define DCR(x)                                                                \
+  {                                                                           \
+    LX = x ^ 1;                                                               \
+    x--;                                                                      \
+    LR = (LR & 0x100) | x;                                                    \
+  }
+#define LAZY_FROM_F(f)                                                        \
+  {                                                                           \
+    LR = 0x200 | ((f) & FLAG_CY) << 8 | ((f) & (FLAG_S | FLAG_Z | FLAG_P));   \
+    LX = (f) & FLAG_AC;                                                       \
+  }
+#define POP_PSW()                                                             \
+  {                                                                           \
+    LAZY_FROM_F(RD(SP));                                                      \
+    A = RD(SP + 1);                                                           \
+    SP += 2;                                                                  \
+  }
+#define COND_NZ (!(LZF[LR] & FLAG_Z))
+#define COND_Z (LZF[LR] & FLAG_Z)
+#define COND_NC (!(LR & 0x100))
+#define COND_C (LR & 0x100)
+#define COND_PO (!(LZF[LR] & FLAG_P))
+#define COND_PE (LZF[LR] & FLAG_P)
+#define COND_P (!(LZF[LR] & FLAG_S))
+#define COND_M (LZF[LR] & FLAG_S)
+
+    LAZY_FROM_F(F);
+    if (left == 0) goto out;
+    goto *dispatch[RD(PC++)];
+
+#define OP(n) lz_##n:
+#define NEXT                                                                  \
+  {                                                                           \
+    if (--left == 0) goto out;                                                \
+    goto *dispatch[RD(PC++)];                                                 \
+  }
+#define HALT(s)                                                               \
+  {                                                                           \
+    left--;                                                                   \
+    why = s;                                                                  \
+    goto out;                                                                 \
+  }
+#define ILLEGAL()                                                             \
+  {                                                                           \
+    PC--;                                                                     \
+    why = STOP_ILLEGAL;                                                       \
+    goto out;                                                                 \
+  }
+#include "cpu8085ops.inc"
+#undef OP
+#undef NEXT
+#undef HALT
+#undef ILLEGAL
+
+  out:
+    FLAGS();
+#undef LAZY_FROM_F
+#pragma pop_macro("FLAGS")
+#pragma pop_macro("CARRY")
+#pragma pop_macro("HALFC")
+#pragma pop_macro("SET_CY")
+#pragma pop_macro("SET_FLAGS")
+#pragma pop_macro("INR")
+#pragma pop_macro("DCR")
+#pragma pop_macro("POP_PSW")
+#pragma pop_macro("COND_NZ")
+#pragma pop_macro("COND_Z")
+#pragma pop_macro("COND_NC")
+#pragma pop_macro("COND_C")
+#pragma pop_macro("COND_PO")
+#pragma pop_macro("COND_PE")
+#pragma pop_macro("COND_P")
+#pragma pop_macro("COND_M")
+    CPU8085_STORE_LOCALS
+    executed += maxInsns - left;
+    return why;
+  }
+#endif
+
+ private:
+  // runThreaded's translation cache, one entry per address, allocated on
+  // first use; `untranslated` is its translate stub
+  std::vector<Decoded8085> tcache;
+  const void *untranslated = nullptr;
+  bool codePage[256];
+
+  // runMapped's page table: pages with an I/O region on them
+  struct Mmio8085 {
+    uint16_t first, last;
+    std::function<uint8_t(uint16_t)> read;
+    std::function<void(uint16_t, uint8_t)> write;
+  };
+  std::vector<Mmio8085> io;
+  uint8_t ioPage[256];
+
+  __attribute__((noinline)) uint8_t ioRead(uint16_t a) {
+    for (Mmio8085 &r : io)
+      if (a >= r.first && a <= r.last) return r.read ? r.read(a) : mem[a];
+    return mem[a];
+  }
+
+  __attribute__((noinline)) void ioWrite(uint16_t a, uint8_t v) {
+    for (Mmio8085 &r : io) {
+      if (a < r.first || a > r.last) continue;
+      if (r.write) r.write(a, v);
+      return;
+    }
+    mem[a] = v;
+    dirty[a >> 8] = 1;
+  }
+
+  // an instruction starting in the last two bytes of the page before may
+  // have its operands on this one
+  void invalidatePage(int page) {
+    codePage[page] = false;
+    if (tcache.empty()) return;
+    for (int i = -2; i < 0x100; i++)
+      tcache[((page << 8) + i) & 0xFFFF].handler = untranslated;
+  }
+};
+
+// the opcode macros are private to this header
+#undef RD
+#undef WR
+#undef IMM8
+#undef IMM16
+#undef B_PAIR
+#undef D_PAIR
+#undef H_PAIR
+#undef HL
+#undef FLAGS
+#undef CARRY
+#undef HALFC
+#undef SET_CY
+#undef SET_FLAGS
+#undef COND_NZ
+#undef COND_Z
+#undef COND_NC
+#undef COND_C
+#undef COND_PO
+#undef COND_PE
+#undef COND_P
+#undef COND_M
+#undef LXI
+#undef INX
+#undef DCX
+#undef PUSH16
+#undef POP16
+#undef POP_RP
+#undef POP_PSW
+#undef CALL_IF
+#undef SHLD
+#undef LHLD
+#undef XTHL
+#undef XCHG
+#undef ADD_CARRY
+#undef SUB_BORROW
+#undef ADD
+#undef ADC
+#undef SUB
+#undef SBB
+#undef CMP
+#undef ANA
+#undef XRA
+#undef ORA
+#undef INR
+#undef DCR
+#undef DAD
+#undef RLC
+#undef RRC
+#undef RAL
+#undef RAR
+#undef DAA
+#undef INP
+#undef OUTP
+#undef CPU8085_LOAD_LOCALS
+#undef CPU8085_STORE_LOCALS
+
+#endif
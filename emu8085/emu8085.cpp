@@ -0,0 +1,768 @@
+/*
+ * runs an 8085 program (Intel HEX, or .asm through asm8085.h) and dumps the
+ * result
+ *
+ *   ./emu8085.out prog.hex|prog.asm [ADDR=BYTE ...] [dump=ADDR:LEN]
+ *                 [watch=ADDR:LEN ...] [--changes] [--profile]
+ *   ./emu8085.out --bench
+ *   ./emu8085.out --diff [TRIALS]
+ *   ./emu8085.out --record [INTERVAL]
+ *
+ * addresses and bytes are hex, as in the lab sheets (3000=0F, dump=4000:2).
+ * watch= maps the range as I/O (runMapped) and prints every store to it
+ * as it happens; the bytes still land in memory. --changes lists the bytes
+ * the run changed, found by diffing the pages it stored to.
+ * --profile runs with runProfiled and prints the T-states the program takes
+ * on real hardware and the source (or, for .hex, every executed address)
+ * with execution counts and T-states per line, hottest lines last.
+ * --bench reports emulated MIPS for the multiplication and bubble sort
+ * programs with each interpreter loop (switch, run(), threaded code, lazy
+ * flags, and runMapped with an empty I/O map and with a region on a page
+ * the programs don't use, against the flat mem[] of the others) and the
+ * JIT. --diff runs random memory images and the
+ * multiplication program over all 256x256 inputs on every one of them and
+ * compares registers, memory and instruction counts with runSwitch.
+ * --record runs a 255 byte bubble sort and a random image under a
+ * Recorder8085 taking a snapshot every INTERVAL instructions, reports the
+ * cost against a plain run() and checks seek() and stepBack() against
+ * states saved on a plain run. the timed runs use the default 64 slot
+ * ring, so dropping and folding old snapshots are part of the cost: best
+ * of 5, it came to 1-10% at INTERVAL 10000 and 20-40% at 1000 here, and
+ * has been measured at over 20% at 10000 on random code elsewhere.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "asm8085.h"
+#include "cpu8085.h"
+#include "hex8085.h"
+#include "jit8085.h"
+#include "replay8085.h"
+
+// Intel HEX through hex8085.h, a piece at a time
+bool loadHex(Cpu8085 &cpu, const std::string &path) {
+  std::ifstream in(path, std::ios::binary);
+  if (!in) {
+    std::cerr << "emu8085: cannot open " << path << "\n";
+    return false;
+  }
+
+  HexReader8085 rd(path);
+  char buf[65536];
+  while (in) {
+    in.read(buf, sizeof(buf));
+    if (!rd.feed(buf, in.gcount(), HexToCpu8085{cpu})) break;
+  }
+  if (!rd.finish()) {
+    std::cerr << "emu8085: " << rd.error << "\n";
+    return false;
+  }
+  return true;
+}
+
+// src and lines (see Assembler8085::insnLines) are kept for --profile
+bool loadAsm(Cpu8085 &cpu, const std::string &path, std::string &src,
+             std::vector<std::pair<int, uint16_t>> &lines) {
+  std::ifstream in(path, std::ios::binary);
+  if (!in) {
+    std::cerr << "emu8085: cannot open " << path << "\n";
+    return false;
+  }
+  std::ostringstream ss;
+  ss << in.rdbuf();
+  src = ss.str();
+
+  auto as = std::make_unique<Assembler8085>();
+  if (!as->assemble(src, path)) {
+    for (auto &e : as->errors) std::cerr << e << "\n";
+    return false;
+  }
+  for (uint32_t a = 0; a < 0x10000; a++)
+    if (as->isUsed(a)) cpu.mem[a] = as->image[a];
+  lines = as->insnLines();
+  return true;
+}
+
+void dumpRegs(const Cpu8085 &cpu) {
+  const Regs8085 &r = cpu.r;
+  printf("A=%02X B=%02X C=%02X D=%02X E=%02X H=%02X L=%02X  ", r.a, r.b, r.c,
+         r.d, r.e, r.h, r.l);
+  printf("S=%d Z=%d AC=%d P=%d CY=%d  SP=%04X PC=%04X\n", !!(r.f & FLAG_S),
+         !!(r.f & FLAG_Z), !!(r.f & FLAG_AC), !!(r.f & FLAG_P),
+         !!(r.f & FLAG_CY), r.sp, r.pc);
+}
+
+void dumpMem(const Cpu8085 &cpu, uint16_t addr, int len) {
+  for (int i = 0; i < len; i++) {
+    if (i % 16 == 0) printf("%s%04X:", i ? "\n" : "", (uint16_t)(addr + i));
+    printf(" %02X", cpu.mem[(uint16_t)(addr + i)]);
+  }
+  printf("\n");
+}
+
+const char *stopName(Stop8085 s) {
+  switch (s) {
+    case STOP_BUDGET:
+      return "instruction limit";
+    case STOP_HALT:
+      return "HLT";
+    case STOP_RST1:
+      return "RST 1";
+    case STOP_ILLEGAL:
+      return "illegal opcode";
+  }
+  return "";
+}
+
+// 8085 kits of the lab's kind clock the CPU at 6.144 MHz / 2
+const double clockMHz = 3.072;
+
+void printProfile(const Profile8085 &prof, const std::string &src,
+                  const std::vector<std::pair<int, uint16_t>> &insns) {
+  printf("\n%llu T-states, %.3f ms at %.3f MHz\n\n",
+         (unsigned long long)prof.total, prof.total / clockMHz / 1e3,
+         clockMHz);
+  double total = prof.total ? prof.total : 1;
+
+  // one row per source line, or per executed address without a source
+  struct Row {
+    int line;
+    uint16_t addr;
+    uint64_t count, tstates;
+    std::string text;
+  };
+  std::vector<Row> rows;
+  if (!src.empty()) {
+    // count and T-states by line number
+    std::vector<std::pair<uint64_t, uint64_t>> per(
+        std::count(src.begin(), src.end(), '\n') + 2);
+    for (auto &[line, addr] : insns) {
+      per[line].first += prof.count[addr];
+      per[line].second += prof.tstates[addr];
+    }
+    std::istringstream in(src);
+    std::string text;
+    for (int line = 1; std::getline(in, text); line++) {
+      if (!text.empty() && text.back() == '\r') text.pop_back();
+      rows.push_back({line, 0, per[line].first, per[line].second, text});
+    }
+  } else {
+    for (uint32_t a = 0; a < 0x10000; a++)
+      if (prof.count[a]) rows.push_back({0, (uint16_t)a, prof.count[a],
+                                         prof.tstates[a], ""});
+  }
+
+  printf("%10s %12s %6s  %s\n", "count", "T-states", "%",
+         src.empty() ? "address" : "source");
+  for (auto &r : rows) {
+    if (r.count)
+      printf("%10llu %12llu %5.1f%%", (unsigned long long)r.count,
+             (unsigned long long)r.tstates, r.tstates * 100 / total);
+    else
+      printf("%30s", "");
+    if (src.empty())
+      printf("  %04X\n", r.addr);
+    else
+      printf("  %4d  %s\n", r.line, r.text.c_str());
+  }
+
+  std::vector<const Row *> hot;
+  for (auto &r : rows)
+    if (r.tstates) hot.push_back(&r);
+  std::stable_sort(hot.begin(), hot.end(), [](const Row *a, const Row *b) {
+    return a->tstates > b->tstates;
+  });
+  if (hot.size() > 10) hot.resize(10);
+
+  printf("\nhottest:\n");
+  for (auto *r : hot) {
+    printf("%5.1f%% %12llu T  ", r->tstates * 100 / total,
+           (unsigned long long)r->tstates);
+    if (src.empty())
+      printf("%04X\n", r->addr);
+    else
+      printf("%4d  %s\n", r->line, r->text.c_str());
+  }
+}
+
+// ---------------------------------------------------------------------------
+// bench programs, assembled at 0000H
+
+// 5SEPT24-2.asm: [4001:4000] = [3000] * [3001] by repeated addition
+const uint8_t multProg[] = {
+    0x3A, 0x00, 0x30,  //       LDA 3000
+    0x4F,              //       MOV C,A
+    0x3A, 0x01, 0x30,  //       LDA 3001
+    0x47,              //       MOV B,A
+    0x16, 0x00,        //       MVI D,00
+    0x3E, 0x00,        //       MVI A,00
+    0x61,              //       MOV H,C
+    0x80,              // MULT: ADD B
+    0xD2, 0x12, 0x00,  //       JNC CONT
+    0x14,              //       INR D
+    0x25,              // CONT: DCR H
+    0xC2, 0x0D, 0x00,  //       JNZ MULT
+    0x32, 0x00, 0x40,  //       STA 4000
+    0x7A,              //       MOV A,D
+    0x32, 0x01, 0x40,  //       STA 4001
+    0xCF,              //       RST 1
+};
+
+// 12 SEPt 24-3.asm: bubble sort of [2000] bytes starting at 2001
+const uint8_t sortProg[] = {
+    0x21, 0x00, 0x20,  //        LXI H,2000
+    0x4E,              //        MOV C,M
+    0x0D,              //        DCR C
+    0x21, 0x01, 0x20,  // PLOOP: LXI H,2001
+    0x7E,              // CLOOP: MOV A,M
+    0x23,              //        INX H
+    0xBE,              //        CMP M
+    0xDA, 0x17, 0x00,  //        JC CONT
+    0xCA, 0x17, 0x00,  //        JZ CONT
+    0x47,              //        MOV B,A
+    0x7E,              //        MOV A,M
+    0x2B,              //        DCX H
+    0x77,              //        MOV M,A
+    0x23,              //        INX H
+    0x70,              //        MOV M,B
+    0x0D,              // CONT:  DCR C
+    0xC2, 0x08, 0x00,  //        JNZ CLOOP
+    0x4D,              //        MOV C,L
+    0x0D,              //        DCR C
+    0x0D,              //        DCR C
+    0xC2, 0x05, 0x00,  //        JNZ PLOOP
+    0xCF,              //        RST 1
+};
+
+void setupMult(Cpu8085 &cpu) {
+  cpu.load(0x0000, multProg, sizeof(multProg));
+  cpu.mem[0x3000] = 0xFF;
+  cpu.mem[0x3001] = 0xFF;
+}
+
+void setupSortN(Cpu8085 &cpu, int n) {
+  cpu.load(0x0000, sortProg, sizeof(sortProg));
+  cpu.mem[0x2000] = n;
+  for (int i = 0; i < n; i++) cpu.mem[0x2001 + i] = 0xFF - i;  // worst case
+}
+
+void setupSort(Cpu8085 &cpu) { setupSortN(cpu, 0x40); }
+
+bool checkMult(const Cpu8085 &cpu) {
+  return (cpu.mem[0x4001] << 8 | cpu.mem[0x4000]) == 0xFF * 0xFF;
+}
+
+bool checkSort(const Cpu8085 &cpu) {
+  for (int i = 1; i < cpu.mem[0x2000]; i++)
+    if (cpu.mem[0x2000 + i] > cpu.mem[0x2001 + i]) return false;
+  return true;
+}
+
+template <class Runner>
+double benchProgram(void (*setup)(Cpu8085 &), bool (*check)(const Cpu8085 &),
+                    Runner run) {
+  auto owned = std::make_unique<Cpu8085>();
+  Cpu8085 &cpu = *owned;
+  uint64_t total = 0;
+  auto start = std::chrono::steady_clock::now();
+  double sec = 0;
+
+  while (sec < 1.0) {
+    for (int rep = 0; rep < 100; rep++) {
+      setup(cpu);
+      cpu.reset();
+      if (run(cpu) != STOP_RST1 || !check(cpu)) {
+        std::cerr << "emu8085: bench program gave a wrong result\n";
+        exit(1);
+      }
+      total += cpu.executed;
+    }
+    sec = std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                        start)
+              .count();
+  }
+  return total / sec / 1e6;
+}
+
+#ifdef CPU8085_JIT
+// a JIT for the Cpu8085 benchProgram hands it. setup() stores the same
+// program bytes every time, so the translations stay valid between reps
+struct JitRunner {
+  std::unique_ptr<Jit8085> jit;
+
+  Stop8085 operator()(Cpu8085 &cpu) {
+    if (!jit) jit = std::make_unique<Jit8085>(cpu);
+    return jit->run();
+  }
+};
+#endif
+
+int bench() {
+  auto runSwitch = [](Cpu8085 &cpu) { return cpu.runSwitch(UINT64_MAX); };
+  auto run = [](Cpu8085 &cpu) { return cpu.run(); };
+  auto runMapped = [](Cpu8085 &cpu) { return cpu.runMapped(UINT64_MAX); };
+  // a device register on a page the programs never touch
+  auto runMappedIo = [](Cpu8085 &cpu) {
+    cpu.unmapIo();
+    cpu.mapIo(0xE000, 0xE000, [](uint16_t) { return 0; }, nullptr);
+    return cpu.runMapped(UINT64_MAX);
+  };
+
+#ifdef CPU8085_COMPUTED_GOTO
+  auto runThreaded = [](Cpu8085 &cpu) {
+    return cpu.runThreaded(UINT64_MAX);
+  };
+  auto runLazy = [](Cpu8085 &cpu) { return cpu.runLazy(UINT64_MAX); };
+  printf("%-14s %12s %12s %14s %10s", "program", "switch MIPS", "run() MIPS",
+         "threaded MIPS", "lazy MIPS");
+#else
+  printf("%-14s %12s %12s", "program", "switch MIPS", "run() MIPS");
+#endif
+  printf(" %12s %15s", "mapped MIPS", "mapped+io MIPS");
+#ifdef CPU8085_JIT
+  printf(" %10s", "JIT MIPS");
+#endif
+  printf("\n");
+
+  struct {
+    const char *name;
+    void (*setup)(Cpu8085 &);
+    bool (*check)(const Cpu8085 &);
+  } progs[] = {{"mult FFxFF", setupMult, checkMult},
+               {"bubble sort 64", setupSort, checkSort}};
+
+  for (auto &p : progs) {
+    printf("%-14s %12.1f %12.1f", p.name,
+           benchProgram(p.setup, p.check, runSwitch),
+           benchProgram(p.setup, p.check, run));
+#ifdef CPU8085_COMPUTED_GOTO
+    printf(" %14.1f %10.1f", benchProgram(p.setup, p.check, runThreaded),
+           benchProgram(p.setup, p.check, runLazy));
+#endif
+    printf(" %12.1f %15.1f", benchProgram(p.setup, p.check, runMapped),
+           benchProgram(p.setup, p.check, runMappedIo));
+#ifdef CPU8085_JIT
+    printf(" %10.1f", benchProgram(p.setup, p.check, JitRunner()));
+#endif
+    printf("\n");
+  }
+#ifndef CPU8085_COMPUTED_GOTO
+  printf("(no computed goto on this compiler, run() is the switch loop)\n");
+#endif
+  return 0;
+}
+
+bool sameState(const Cpu8085 &a, const Cpu8085 &b, Stop8085 sa, Stop8085 sb) {
+  return sa == sb && a.executed == b.executed &&
+         memcmp(&a.r, &b.r, sizeof(a.r)) == 0 &&
+         memcmp(a.mem, b.mem, sizeof(a.mem)) == 0;
+}
+
+void showDiff(const char *name, const Cpu8085 &ref, const Cpu8085 &cpu,
+              Stop8085 sr, Stop8085 sc) {
+  printf("  runSwitch: %s after %llu\n  ", stopName(sr),
+         (unsigned long long)ref.executed);
+  dumpRegs(ref);
+  printf("  %s: %s after %llu\n  ", name, stopName(sc),
+         (unsigned long long)cpu.executed);
+  dumpRegs(cpu);
+  for (int a = 0; a < 0x10000; a++)
+    if (ref.mem[a] != cpu.mem[a])
+      printf("  mem[%04X] %02X vs %02X\n", a, ref.mem[a], cpu.mem[a]);
+}
+
+// one of the ways of running a program, checked against runSwitch
+struct Engine {
+  const char *name;
+  std::unique_ptr<Cpu8085> cpu;
+  std::function<Stop8085(uint64_t)> run;
+  std::function<void()> flush;  // after the host stored into code
+  double sec;
+};
+
+std::vector<Engine> engines() {
+  std::vector<Engine> es;
+  auto add = [&](const char *name) {
+    es.push_back({name, std::make_unique<Cpu8085>(), nullptr, [] {}, 0});
+    return es.back().cpu.get();
+  };
+
+  Cpu8085 *c = add("run()");
+  es.back().run = [c](uint64_t n) { return c->run(n); };
+#ifdef CPU8085_COMPUTED_GOTO
+  c = add("threaded");
+  es.back().run = [c](uint64_t n) { return c->runThreaded(n); };
+  es.back().flush = [c] { c->flushTranslations(); };
+  c = add("lazy flags");
+  es.back().run = [c](uint64_t n) { return c->runLazy(n); };
+#endif
+  // a pass-through region, so the I/O path runs too but changes nothing
+  c = add("mapped");
+  c->mapIo(
+      0xE000, 0xE0FF, [c](uint16_t a) { return c->mem[a]; },
+      [c](uint16_t a, uint8_t v) { c->mem[a] = v, c->dirty[a >> 8] = 1; });
+  es.back().run = [c](uint64_t n) { return c->runMapped(n); };
+  c = add("profiled");
+  auto prof = std::make_shared<Profile8085>();
+  es.back().run = [c, prof](uint64_t n) { return c->runProfiled(n, *prof); };
+#ifdef CPU8085_JIT
+  c = add("JIT");
+  auto jit = std::make_shared<Jit8085>(*c);
+  es.back().run = [jit](uint64_t n) { return jit->run(n); };
+  es.back().flush = [jit] { jit->flush(); };
+#endif
+  return es;
+}
+
+// HLT, RST 1 and the undocumented opcodes
+bool endsRun(uint8_t op) {
+  switch (op) {
+    case 0x08: case 0x10: case 0x18: case 0x28: case 0x38: case 0x76:
+    case 0xCB: case 0xCF: case 0xD9: case 0xDD: case 0xED: case 0xFD:
+      return true;
+  }
+  return false;
+}
+
+// a machine state to compare a seek() against
+struct SavedState {
+  Regs8085 r;
+  uint64_t executed;
+  std::vector<uint8_t> mem;
+};
+
+int recordOne(const char *name, void (*setup)(Cpu8085 &), uint64_t insns,
+              uint64_t interval, std::mt19937 &rng) {
+  auto plain = std::make_unique<Cpu8085>();
+  auto timed = std::make_unique<Cpu8085>();
+  auto cpu = std::make_unique<Cpu8085>();
+  setup(*plain);
+  plain->reset();
+  memcpy(timed->mem, plain->mem, sizeof(timed->mem));
+  timed->reset();
+  memcpy(cpu->mem, plain->mem, sizeof(cpu->mem));
+  cpu->reset();
+
+  // plain run, stopping at sorted random positions to save the state
+  std::vector<uint64_t> at;
+  for (int i = 0; i < 100; i++) at.push_back(rng() % insns);
+  std::sort(at.begin(), at.end());
+  std::vector<SavedState> saved;
+  Stop8085 plainWhy = STOP_BUDGET;
+  for (uint64_t a : at) {
+    plainWhy = plain->run(a - plain->executed);
+    if (plain->executed != a) break;
+    saved.push_back({plain->r, plain->executed,
+                     std::vector<uint8_t>(plain->mem, plain->mem + 0x10000)});
+  }
+  if (plainWhy == STOP_BUDGET) plain->run(insns - plain->executed);
+  uint64_t end = plain->executed;
+
+  // the timings: best of 5 uninterrupted runs from the start image, plain
+  // and under a recorder with the default ring, so once that is full every
+  // snapshot also drops the oldest and folds the next one into the base
+  // image
+  std::vector<uint8_t> image(cpu->mem, cpu->mem + 0x10000);
+  auto restart = [&] {
+    memcpy(timed->mem, image.data(), 0x10000);
+    timed->reset();
+    return std::chrono::steady_clock::now();
+  };
+  auto since = [](std::chrono::steady_clock::time_point t) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - t)
+        .count();
+  };
+  double plainSec = 1e9, recSec = 1e9;
+  uint64_t snaps = 0;
+  size_t ringBytes = 0;
+  for (int rep = 0; rep < 5; rep++) {
+    auto t0 = restart();
+    timed->run(insns);
+    plainSec = std::min(plainSec, since(t0));
+
+    t0 = restart();
+    Recorder8085 timedRec(*timed, interval);
+    timedRec.run(insns);
+    recSec = std::min(recSec, since(t0));
+    snaps = timedRec.snapshotsTaken;
+    ringBytes = timedRec.bytes();
+  }
+
+  // the run again with a ring holding all of it, so every saved state is
+  // reachable by going back
+  Recorder8085 rec(*cpu, interval, end / interval + 2);
+  rec.run(insns);
+  if (cpu->executed != end || timed->executed != end) {
+    printf("%s: recorded run stopped after %llu, not %llu\n", name,
+           (unsigned long long)cpu->executed, (unsigned long long)end);
+    return 1;
+  }
+
+  auto same = [&](const SavedState &s) {
+    return cpu->executed == s.executed &&
+           memcmp(&cpu->r, &s.r, sizeof(s.r)) == 0 &&
+           memcmp(cpu->mem, s.mem.data(), 0x10000) == 0;
+  };
+
+  // random order, so seeks go back and forth. only the ones going back
+  // are timed, the others are mostly running forward
+  std::vector<size_t> order(saved.size());
+  for (size_t i = 0; i < order.size(); i++) order[i] = i;
+  std::shuffle(order.begin(), order.end(), rng);
+  double backSec = 0;
+  int backs = 0;
+  for (size_t i : order) {
+    bool back = saved[i].executed < cpu->executed;
+    auto t0 = std::chrono::steady_clock::now();
+    bool ok = rec.seek(saved[i].executed);
+    if (back) {
+      backSec += std::chrono::duration<double>(
+                     std::chrono::steady_clock::now() - t0)
+                     .count();
+      backs++;
+    }
+    if (!ok || !same(saved[i])) {
+      printf("%s: seek to %llu gave a different state\n", name,
+             (unsigned long long)saved[i].executed);
+      return 1;
+    }
+  }
+
+  // stepping back to a saved state one instruction at a time
+  for (int k = 0; k < 10 && !saved.empty(); k++) {
+    const SavedState &s = saved[rng() % saved.size()];
+    uint64_t ahead = std::min<uint64_t>(20, end - s.executed);
+    if (!rec.seek(s.executed + ahead)) return 1;
+    for (uint64_t b = 0; b < ahead; b++) rec.stepBack();
+    if (!same(s)) {
+      printf("%s: stepping back to %llu gave a different state\n", name,
+             (unsigned long long)s.executed);
+      return 1;
+    }
+  }
+
+  double plainMips = end / plainSec / 1e6, recMips = end / recSec / 1e6;
+  printf("%-16s %10llu %9.1f %9.1f %8.1f%% %7llu %9.1f %9.1f\n", name,
+         (unsigned long long)end, plainMips, recMips,
+         (1 - recMips / plainMips) * 100,
+         (unsigned long long)snaps, ringBytes / 1024.0,
+         backs ? backSec / backs * 1e6 : 0.0);
+  return 0;
+}
+
+// worst case for the snapshots: random code storing all over memory
+void setupRandom(Cpu8085 &cpu) {
+  std::mt19937 rng(8085);
+  for (auto &b : cpu.mem) {
+    b = rng();
+    if (endsRun(b)) b = 0x00;
+  }
+}
+
+int record(uint64_t interval) {
+  std::mt19937 rng(8085);
+  printf("snapshot every %llu instructions\n", (unsigned long long)interval);
+  printf("%-16s %10s %9s %9s %9s %7s %9s %9s\n", "program", "insns",
+         "run MIPS", "rec MIPS", "overhead", "snaps", "ring KB", "back us");
+  auto sort255 = [](Cpu8085 &cpu) { setupSortN(cpu, 0xFF); };
+  if (recordOne("bubble sort 255", sort255, 10000000, interval, rng) ||
+      recordOne("random code", setupRandom, 10000000, interval, rng))
+    return 1;
+  printf("seek() and stepBack() matched the plain run\n");
+  return 0;
+}
+
+int diff(int trials) {
+  static Cpu8085 ref;
+  std::vector<Engine> es = engines();
+  std::mt19937 rng(8085);
+  uint64_t compared = 0;
+
+  // random memory is random code: every opcode, wild jumps, stores into
+  // code. half the images have HLT, RST 1 and the undocumented opcodes
+  // turned into NOPs so they run into the instruction limit instead
+  for (int t = 0; t < trials; t++) {
+    for (auto &b : ref.mem) b = rng();
+    if (t & 1)
+      for (auto &b : ref.mem)
+        if (endsRun(b)) b = 0x00;
+
+    ref.reset(rng());
+    ref.r.a = rng(), ref.r.b = rng(), ref.r.c = rng(), ref.r.d = rng();
+    ref.r.e = rng(), ref.r.h = rng(), ref.r.l = rng();
+    ref.r.f = (rng() & 0xD5) | FLAG_FIXED;
+    ref.r.sp = rng();
+
+    for (auto &e : es) {
+      memcpy(e.cpu->mem, ref.mem, sizeof(ref.mem));
+      memcpy(e.cpu->ports, ref.ports, sizeof(ref.ports));
+      e.cpu->r = ref.r;
+      e.cpu->ie = ref.ie;
+      e.cpu->executed = 0;
+      e.flush();
+    }
+
+    uint64_t budget = 1 + rng() % 5000;
+    Stop8085 sr = ref.runSwitch(budget);
+    compared += ref.executed;
+
+    for (auto &e : es) {
+      Stop8085 se = e.run(budget);
+      if (!sameState(ref, *e.cpu, sr, se)) {
+        printf("random image %d (budget %llu): %s differs\n", t,
+               (unsigned long long)budget, e.name);
+        showDiff(e.name, ref, *e.cpu, sr, se);
+        return 1;
+      }
+    }
+  }
+  printf("%d random images, %llu instructions: all the same\n", trials,
+         (unsigned long long)compared);
+
+  // every input of the multiplication program (a 0 in 3000H counts down
+  // from 256). only data changes, so translations are kept
+  double refSec = 0;
+  uint64_t insns = 0;
+  for (auto &e : es) e.flush();
+  for (int x = 0; x < 256; x++) {
+    for (int y = 0; y < 256; y++) {
+      setupMult(ref);
+      ref.mem[0x3000] = x;
+      ref.mem[0x3001] = y;
+      ref.reset();
+      for (auto &e : es) {
+        setupMult(*e.cpu);
+        memcpy(e.cpu->mem + 0x3000, ref.mem + 0x3000, 2);
+        e.cpu->reset();
+      }
+
+      auto t0 = std::chrono::steady_clock::now();
+      Stop8085 sr = ref.runSwitch(UINT64_MAX);
+      refSec += std::chrono::duration<double>(
+                    std::chrono::steady_clock::now() - t0)
+                    .count();
+      insns += ref.executed;
+      if ((ref.mem[0x4001] << 8 | ref.mem[0x4000]) != (x ? x : 256) * y) {
+        printf("mult %02X x %02X: wrong product\n", x, y);
+        return 1;
+      }
+
+      for (auto &e : es) {
+        t0 = std::chrono::steady_clock::now();
+        Stop8085 se = e.run(UINT64_MAX);
+        e.sec += std::chrono::duration<double>(
+                     std::chrono::steady_clock::now() - t0)
+                     .count();
+        if (!sameState(ref, *e.cpu, sr, se)) {
+          printf("mult %02X x %02X: %s differs\n", x, y, e.name);
+          showDiff(e.name, ref, *e.cpu, sr, se);
+          return 1;
+        }
+      }
+    }
+  }
+  printf("mult, all 65536 inputs, %llu instructions: all the same\n",
+         (unsigned long long)insns);
+  printf("  %-12s %8.1f MIPS\n", "runSwitch", insns / refSec / 1e6);
+  for (auto &e : es)
+    printf("  %-12s %8.1f MIPS\n", e.name, insns / e.sec / 1e6);
+  return 0;
+}
+
+int main(int argc, char *argv[]) {
+  if (argc < 2) {
+    std::cerr << "usage: " << argv[0]
+              << " prog.hex|prog.asm [ADDR=BYTE ...] [dump=ADDR:LEN]"
+              << " [watch=ADDR:LEN ...] [--changes] [--profile]"
+              << " | --bench | --diff [TRIALS]"
+              << " | --record [INTERVAL]\n";
+    return 1;
+  }
+
+  if (std::string(argv[1]) == "--bench") return bench();
+  if (std::string(argv[1]) == "--diff")
+    return diff(argc > 2 ? atoi(argv[2]) : 2000);
+  if (std::string(argv[1]) == "--record")
+    return record(argc > 2 ? std::max(1LL, atoll(argv[2])) : 10000);
+
+  static Cpu8085 cpu;
+  std::string path = argv[1], src;
+  std::vector<std::pair<int, uint16_t>> lines;
+  bool isAsm = path.size() > 4 && path.substr(path.size() - 4) == ".asm";
+  if (!(isAsm ? loadAsm(cpu, path, src, lines) : loadHex(cpu, path)))
+    return 1;
+
+  std::unique_ptr<Profile8085> prof;
+  std::vector<std::pair<uint16_t, int>> dumps, watches;
+  bool changes = false;
+  for (int i = 2; i < argc; i++) {
+    std::string arg = argv[i];
+    size_t eq = arg.find('=');
+    size_t colon = arg.find(':');
+
+    if (arg == "--profile") {
+      prof = std::make_unique<Profile8085>();
+      prof->clear();
+    } else if (arg == "--changes") {
+      changes = true;
+    } else if (arg.rfind("dump=", 0) == 0 && colon != std::string::npos) {
+      dumps.push_back({std::stoi(arg.substr(5, colon - 5), nullptr, 16),
+                       std::stoi(arg.substr(colon + 1), nullptr, 16)});
+    } else if (arg.rfind("watch=", 0) == 0 && colon != std::string::npos) {
+      watches.push_back({std::stoi(arg.substr(6, colon - 6), nullptr, 16),
+                         std::stoi(arg.substr(colon + 1), nullptr, 16)});
+    } else if (eq != std::string::npos) {
+      cpu.mem[std::stoi(arg.substr(0, eq), nullptr, 16) & 0xFFFF] =
+          std::stoi(arg.substr(eq + 1), nullptr, 16);
+    } else {
+      std::cerr << "emu8085: don't know what to do with " << arg << "\n";
+      return 1;
+    }
+  }
+
+  if (prof && !watches.empty()) {
+    std::cerr << "emu8085: --profile doesn't go with watch=\n";
+    return 1;
+  }
+  for (auto &w : watches) {
+    int last = std::min(w.first + std::max(w.second, 1) - 1, 0xFFFF);
+    cpu.mapIo(w.first, last, nullptr, [](uint16_t a, uint8_t v) {
+      printf("  %04X <- %02X\n", a, v);
+      cpu.mem[a] = v;
+      cpu.dirty[a >> 8] = 1;
+    });
+  }
+
+  std::vector<uint8_t> before;
+  if (changes) before.assign(cpu.mem, cpu.mem + 0x10000);
+  cpu.clearDirty();
+
+  const uint64_t limit = 100000000;
+  Stop8085 why = prof              ? cpu.runProfiled(limit, *prof)
+                 : watches.empty() ? cpu.run(limit)
+                                   : cpu.runMapped(limit);
+  printf("stopped: %s after %llu instructions\n", stopName(why),
+         (unsigned long long)cpu.executed);
+  dumpRegs(cpu);
+  for (auto &d : dumps) dumpMem(cpu, d.first, d.second);
+  if (changes) {
+    std::vector<uint16_t> diff = cpu.changedSince(before.data());
+    printf("changed: %zu bytes\n", diff.size());
+    for (uint16_t a : diff)
+      printf("  %04X: %02X -> %02X\n", a, before[a], cpu.mem[a]);
+  }
+  if (prof) printProfile(*prof, src, lines);
+
+  return (why == STOP_ILLEGAL) ? 1 : 0;
+}
@@ -0,0 +1,309 @@
+/*
+ * converts between Intel HEX and flat binaries, a batch at a time, with
+ * hex8085.h
+ *
+ *   ./hex8085.out [-j N] [-o DIR] [--base ADDR] [--check] FILE|DIR ...
+ *   ./hex8085.out --bench [MB]
+ *
+ * FILE.hex becomes FILE.bin (the bytes from the lowest address written to
+ * the highest, gaps 00), any other FILE becomes FILE.hex loaded at --base
+ * (hex, default 0). a DIR means every .hex in it. files go to N threads
+ * (default: one per core). --check reads and validates the .hex files and
+ * writes nothing.
+ *
+ * --bench synthesizes MB megabytes (default 64) of random bytes, writes
+ * them as HEX, reads that back whole and in 64 KB pieces and compares,
+ * and also times a getline + stoi reader of the kind emu8085 used to have
+ * and loading 64 KB images into a Cpu8085. speeds are MB of HEX text per
+ * second.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "cpu8085.h"
+#include "hex8085.h"
+
+namespace fs = std::filesystem;
+
+struct Job {
+  fs::path src;
+
+  // filled by the worker
+  bool ok;
+  std::string error, summary;
+  size_t bytesIn;
+};
+
+bool readFile(const fs::path &path, std::string &out) {
+  std::ifstream in(path, std::ios::binary);
+  if (!in) return false;
+  std::ostringstream ss;
+  ss << in.rdbuf();
+  out = ss.str();
+  return true;
+}
+
+static bool isHex(const fs::path &p) {
+  std::string ext = p.extension().string();
+  for (char &c : ext) c = tolower(c);
+  return ext == ".hex";
+}
+
+static void convert(Job &job, const fs::path &outDir, uint32_t base,
+                    bool check) {
+  std::string text;
+  job.ok = false;
+  if (!readFile(job.src, text)) {
+    job.error = "hex8085: cannot read " + job.src.string();
+    return;
+  }
+  job.bytesIn = text.size();
+  fs::path out = job.src;
+  char line[128];
+
+  if (isHex(job.src)) {
+    HexReader8085 rd(job.src.filename().string());
+    HexImage8085 img;
+    if (!rd.feed(text.data(), text.size(), img) || !rd.finish()) {
+      job.error = rd.error;
+      return;
+    }
+    snprintf(line, sizeof(line), "%llu records, %llu bytes at %04X..%04X",
+             (unsigned long long)rd.recordsRead,
+             (unsigned long long)rd.dataBytes, (unsigned)img.base,
+             (unsigned)(img.base + img.bytes.size() - !img.bytes.empty()));
+    job.summary = line;
+    if (!check) {
+      out.replace_extension(".bin");
+      if (!outDir.empty()) out = outDir / out.filename();
+      std::ofstream(out, std::ios::binary)
+          .write((const char *)img.bytes.data(), img.bytes.size());
+    }
+  } else {
+    if (check) {
+      job.ok = true;
+      job.summary = "not a .hex, skipped";
+      return;
+    }
+    HexWriter8085 wr;
+    wr.data(base, (const uint8_t *)text.data(), text.size());
+    wr.end();
+    snprintf(line, sizeof(line), "%zu bytes at %04X", text.size(),
+             (unsigned)base);
+    job.summary = line;
+    out += ".hex";
+    if (!outDir.empty()) out = outDir / out.filename();
+    std::ofstream(out, std::ios::binary) << wr.out;
+  }
+  job.ok = true;
+}
+
+static double seconds(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                       start)
+      .count();
+}
+
+// the loader emu8085 had before hex8085.h: a line at a time, std::stoi on
+// every pair of digits. data and end records only
+static bool naiveRead(const std::string &text, std::vector<uint8_t> &img) {
+  std::istringstream in(text);
+  std::string line;
+  uint32_t base = 0;
+  while (std::getline(in, line)) {
+    if (!line.empty() && line.back() == '\r') line.pop_back();
+    if (line.empty()) continue;
+    if (line[0] != ':' || line.size() < 11) return false;
+    std::vector<uint8_t> rec;
+    for (size_t i = 1; i + 1 < line.size(); i += 2)
+      rec.push_back(std::stoi(line.substr(i, 2), nullptr, 16));
+    uint8_t sum = 0;
+    for (uint8_t b : rec) sum += b;
+    if (sum != 0 || rec.size() != rec[0] + 5u) return false;
+    if (rec[3] == 0x01) break;
+    if (rec[3] == 0x04) base = (rec[4] << 8 | rec[5]) << 16;
+    if (rec[3] != 0x00) continue;
+    uint32_t a = base + (rec[1] << 8 | rec[2]);
+    if (a + rec[0] > img.size()) img.resize(a + rec[0]);
+    memcpy(&img[a], &rec[4], rec[0]);
+  }
+  return true;
+}
+
+static int bench(size_t mb) {
+  std::vector<uint8_t> data(mb << 20);
+  std::mt19937_64 rng(8085);
+  for (size_t i = 0; i < data.size(); i += 8) {
+    uint64_t v = rng();
+    memcpy(&data[i], &v, std::min<size_t>(8, data.size() - i));
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  HexWriter8085 wr;
+  wr.data(0, data.data(), data.size());
+  wr.end();
+  double sec = seconds(start);
+  const std::string &text = wr.out;
+  double textMb = text.size() / 1e6;
+  printf("%zu MB of data is %.1f MB of HEX\n", mb, textMb);
+  printf("  write            %8.0f MB/s\n", textMb / sec);
+
+  auto same = [&](const HexImage8085 &img) {
+    return img.base == 0 && img.bytes == data;
+  };
+  int status = 0;
+
+  {
+    start = std::chrono::steady_clock::now();
+    HexReader8085 rd;
+    HexImage8085 img;
+    img.bytes.reserve(data.size());
+    bool ok = rd.feed(text.data(), text.size(), img) && rd.finish();
+    sec = seconds(start);
+    ok = ok && same(img);
+    printf("  read, whole      %8.0f MB/s%s\n", textMb / sec,
+           ok ? "" : "  WRONG");
+    if (!ok) status = 1;
+  }
+  {
+    start = std::chrono::steady_clock::now();
+    HexReader8085 rd;
+    HexImage8085 img;
+    img.bytes.reserve(data.size());
+    bool ok = true;
+    for (size_t at = 0; ok && at < text.size(); at += 65536)
+      ok = rd.feed(text.data() + at, std::min<size_t>(65536, text.size() - at),
+                   img);
+    ok = ok && rd.finish();
+    sec = seconds(start);
+    ok = ok && same(img);
+    printf("  read, 64 KB      %8.0f MB/s%s\n", textMb / sec,
+           ok ? "" : "  WRONG");
+    if (!ok) status = 1;
+  }
+  {
+    // the old way is slow enough that a slice of the text is plenty
+    size_t cut = std::min<size_t>(text.size(), 8 << 20);
+    cut = text.rfind('\n', cut) + 1;
+    std::string slice = text.substr(0, cut) + ":00000001FF";
+    std::vector<uint8_t> img;
+    start = std::chrono::steady_clock::now();
+    bool ok = naiveRead(slice, img);
+    sec = seconds(start);
+    ok = ok && img.size() <= data.size() &&
+         std::equal(img.begin(), img.end(), data.begin());
+    printf("  getline + stoi   %8.0f MB/s%s\n", slice.size() / 1e6 / sec,
+           ok ? "" : "  WRONG");
+    if (!ok) status = 1;
+  }
+  {
+    HexWriter8085 one;
+    one.data(0, data.data(), std::min<size_t>(data.size(), 0x10000));
+    one.end();
+    auto cpu = std::make_unique<Cpu8085>();
+    int images = 0;
+    bool ok = true;
+    start = std::chrono::steady_clock::now();
+    while ((sec = seconds(start)) < 0.5 && ok) {
+      for (int i = 0; i < 64; i++, images++) {
+        HexReader8085 rd;
+        ok = ok && rd.feed(one.out.data(), one.out.size(), HexToCpu8085{*cpu});
+      }
+    }
+    ok = ok && memcmp(cpu->mem, data.data(),
+                      std::min<size_t>(data.size(), 0x10000)) == 0;
+    printf("  into a Cpu8085   %8.0f MB/s, %.0f 64 KB images/s%s\n",
+           images * one.out.size() / 1e6 / sec, images / sec,
+           ok ? "" : "  WRONG");
+    if (!ok) status = 1;
+  }
+  return status;
+}
+
+int main(int argc, char *argv[]) {
+  unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+  uint32_t base = 0;
+  bool check = false;
+  fs::path outDir;
+  std::vector<fs::path> inputs;
+
+  if (argc > 1 && std::string(argv[1]) == "--bench")
+    return bench(argc > 2 ? std::max(1, atoi(argv[2])) : 64);
+
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "-j" && i + 1 < argc) {
+      threads = std::max(1, atoi(argv[++i]));
+    } else if (arg == "-o" && i + 1 < argc) {
+      outDir = argv[++i];
+    } else if (arg == "--base" && i + 1 < argc) {
+      base = strtoul(argv[++i], nullptr, 16);
+    } else if (arg == "--check") {
+      check = true;
+    } else {
+      inputs.push_back(arg);
+    }
+  }
+
+  if (inputs.empty()) {
+    std::cerr << "usage: " << argv[0]
+              << " [-j N] [-o DIR] [--base ADDR] [--check] FILE|DIR ...\n"
+              << "       " << argv[0] << " --bench [MB]\n";
+    return 1;
+  }
+
+  std::vector<Job> jobs;
+  for (auto &in : inputs) {
+    std::vector<fs::path> files;
+    if (fs::is_directory(in)) {
+      for (auto &e : fs::directory_iterator(in))
+        if (e.is_regular_file() && isHex(e.path())) files.push_back(e.path());
+      std::sort(files.begin(), files.end());
+    } else {
+      files.push_back(in);
+    }
+    for (auto &f : files) jobs.push_back(Job{f, false, "", "", 0});
+  }
+
+  std::atomic<size_t> next{0};
+  auto worker = [&]() {
+    size_t i;
+    while ((i = next++) < jobs.size()) convert(jobs[i], outDir, base, check);
+  };
+
+  threads = std::min<size_t>(threads, std::max<size_t>(1, jobs.size()));
+  auto start = std::chrono::steady_clock::now();
+  std::vector<std::thread> pool;
+  for (unsigned t = 0; t < threads; t++) pool.emplace_back(worker);
+  for (auto &t : pool) t.join();
+  double sec = seconds(start);
+
+  int failed = 0;
+  size_t bytes = 0;
+  for (auto &job : jobs) {
+    bytes += job.bytesIn;
+    if (!job.ok) {
+      std::cerr << job.error << "\n";
+      failed++;
+      continue;
+    }
+    printf("%-28s %s\n", job.src.filename().c_str(), job.summary.c_str());
+  }
+
+  printf("%zu files, %zu bytes in %.3f ms on %u threads: %.1f MB/s\n",
+         jobs.size(), bytes, sec * 1e3, threads, bytes / 1e6 / sec);
+  if (failed) printf("%d file(s) with errors\n", failed);
+  return failed ? 1 : 0;
+}
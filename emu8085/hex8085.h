@@ -0,0 +1,304 @@
+/*
+ * streaming Intel HEX reader and writer for 8085 images
+ *
+ * HexReader8085 takes the text in pieces of any size (a whole file, or
+ * one read() at a time) and hands every data record to a sink with its
+ * full address. record types: 00 data, 01 end, 02 extended segment address
+ * (base = value * 16), 04 extended linear address (base = value << 16),
+ * 03/05 start address (kept in `start`). each pair of digits goes through
+ * a 256 entry table that gives the nibble, or 0x100 for anything that
+ * isn't a hex digit; the checksum is summed as the bytes are decoded, so
+ * every character is looked at once. the first error stops the reader.
+ *
+ * sinks are called as sink(addr, bytes, n) and return false to stop. data
+ * records that carry on where the one before ended are decoded into one
+ * buffer and handed over together, up to 4 KB at a time.
+ * HexImage8085 collects a flat binary, HexToCpu8085 stores into a Cpu8085
+ * and refuses anything past 64 KB.
+ *
+ * HexWriter8085 goes the other way: records of up to 16 bytes on 16 byte
+ * boundaries, an 04 record whenever the upper address bits change, CRLF
+ * line ends and no newline after the end record, like asm8085.h's toHex().
+ */
+
+#ifndef HEX8085_H
+#define HEX8085_H
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "cpu8085.h"
+
+struct HexDigits8085 {
+  uint16_t value[256];  // 0..15, or 0x100 for a character that isn't one
+  char digit[16];
+
+  constexpr HexDigits8085() : value(), digit() {
+    for (int c = 0; c < 256; c++) value[c] = 0x100;
+    for (int i = 0; i < 10; i++) value['0' + i] = i;
+    for (int i = 0; i < 6; i++) value['A' + i] = value['a' + i] = 10 + i;
+    for (int i = 0; i < 16; i++) digit[i] = "0123456789ABCDEF"[i];
+  }
+};
+
+inline constexpr HexDigits8085 hexDigits8085{};
+
+class HexReader8085 {
+ public:
+  std::string error;  // "name:line: what", empty while all is well
+  bool ended = false;  // the 01 record has been read
+  bool hasStart = false;
+  uint32_t start = 0;  // from an 03 (CS:IP, CS in the upper half) or 05
+  uint64_t recordsRead = 0, dataBytes = 0;
+
+  explicit HexReader8085(std::string name = "hex") : name(std::move(name)) {}
+
+  // the next n characters. records may be split anywhere between calls
+  template <class Sink>
+  bool feed(const char *p, size_t n, Sink &&sink) {
+    if (!error.empty()) return false;
+    const char *end = p + n;
+
+    if (!carry.empty()) {
+      // finish the split record with enough of this piece for any record
+      size_t had = carry.size(), take = n < 600 ? n : 600;
+      carry.append(p, take);
+      const char *b = carry.data(), *e = b + carry.size();
+      const char *q = parse(b, e, sink, b + had);
+      if (!q) return false;
+      if ((size_t)(q - b) < had || (q == e && take == n)) {
+        carry.erase(0, q - b);
+        if (take < n) return fail("record too long");
+        return true;
+      }
+      p += (q - b) - had;
+      carry.clear();
+    }
+
+    const char *q = parse(p, end, sink, nullptr);
+    if (!q) return false;
+    carry.assign(q, end - q);
+    return true;
+  }
+
+  // end of the text: a record cut short or no end record is an error
+  bool finish() {
+    if (!error.empty()) return false;
+    if (!carry.empty()) return fail("record cut short");
+    if (!ended) return fail("no end record");
+    return true;
+  }
+
+ private:
+  std::string name;
+  std::string carry;  // the start of a record the last piece cut off
+  uint32_t base = 0;
+  uint64_t line = 1;
+
+  // data records that follow on from each other are decoded into one run
+  // and handed to the sink together
+  static constexpr size_t RUN = 4096;
+  uint8_t run[RUN + 255];
+  uint32_t runAt = 0;
+  size_t runLen = 0;
+
+  bool fail(const char *what) {
+    error = name + ":" + std::to_string(line) + ": " + what;
+    return false;
+  }
+
+  template <class Sink>
+  bool flush(Sink &sink) {
+    bool ok = !runLen || sink(runAt, run, runLen);
+    runLen = 0;
+    return ok || fail("data outside the image");
+  }
+
+  // reads whole records from [p, e) and returns where the first incomplete
+  // one starts (e if there's none), or, once past `stop`, where the next
+  // record starts. nullptr after an error
+  template <class Sink>
+  const char *parse(const char *p, const char *e, Sink &sink,
+                    const char *stop) {
+    const char *q = records(p, e, sink, stop);
+    return flush(sink) ? q : nullptr;
+  }
+
+  template <class Sink>
+  const char *records(const char *p, const char *e, Sink &sink,
+                      const char *stop) {
+    // a byte, or above 0xFF if either character isn't a hex digit
+    const uint16_t *V = hexDigits8085.value;
+    auto pair = [V](const char *s) -> unsigned {
+      return V[(uint8_t)s[0]] << 4 | V[(uint8_t)s[1]];
+    };
+    while (p < e) {
+      if (stop && p >= stop) return p;
+      char c = *p;
+      if (c == '\n') {
+        line++;
+        p++;
+        continue;
+      }
+      if (c == '\r' || c == ' ' || c == '\t') {
+        p++;
+        continue;
+      }
+      if (ended) return e;  // whatever follows the end record
+      if (c != ':') return fail("expected ':'"), nullptr;
+      if (e - p < 3) return p;
+
+      unsigned len = pair(p + 1);
+      if (len > 0xFF) return fail("bad hex digit"), nullptr;
+      if ((size_t)(e - p) < 11 + 2 * len) return p;
+
+      unsigned hi = pair(p + 3), lo = pair(p + 5), type = pair(p + 7);
+      unsigned bad = hi | lo | type;
+      unsigned sum = len + hi + lo + type;
+      const char *d = p + 9;
+      uint8_t *bytes = run + runLen;
+      for (unsigned i = 0; i < len; i++, d += 2) {
+        unsigned v = pair(d);
+        bad |= v;
+        bytes[i] = v;
+        sum += v;
+      }
+      unsigned check = pair(d);
+      bad |= check;
+      if (bad > 0xFF) return fail("bad hex digit"), nullptr;
+      if ((uint8_t)(sum + check)) return fail("bad checksum"), nullptr;
+      p = d + 2;
+      recordsRead++;
+
+      uint32_t word = len >= 2 ? bytes[0] << 8 | bytes[1] : 0;
+      switch (type) {
+        case 0x00: {
+          uint32_t at = base + (hi << 8 | lo);
+          if (runLen && at != runAt + runLen) {
+            uint8_t keep[255];
+            memcpy(keep, bytes, len);
+            if (!flush(sink)) return nullptr;
+            memcpy(run, keep, len);
+          }
+          if (!runLen) runAt = at;
+          runLen += len;
+          if (runLen >= RUN && !flush(sink)) return nullptr;
+          dataBytes += len;
+          break;
+        }
+        case 0x01:
+          if (len) return fail("end record with data"), nullptr;
+          ended = true;
+          break;
+        case 0x02:
+        case 0x04:
+          if (len != 2) return fail("address record not 2 bytes"), nullptr;
+          base = type == 0x02 ? word << 4 : word << 16;
+          break;
+        case 0x03:
+        case 0x05:
+          if (len != 4) return fail("start record not 4 bytes"), nullptr;
+          hasStart = true;
+          start = word << 16 | bytes[2] << 8 | bytes[3];
+          break;
+        default:
+          return fail("unknown record type"), nullptr;
+      }
+    }
+    return p;
+  }
+};
+
+// a flat binary from the lowest address written to the highest, gaps
+// filled with `fill`
+struct HexImage8085 {
+  uint32_t base = 0;  // address of bytes[0]
+  std::vector<uint8_t> bytes;
+  uint8_t fill = 0x00;
+
+  bool operator()(uint32_t addr, const uint8_t *p, size_t n) {
+    if (bytes.empty()) {
+      base = addr;
+    } else if (addr < base) {
+      bytes.insert(bytes.begin(), base - addr, fill);
+      base = addr;
+    }
+    size_t off = addr - base;
+    if (off == bytes.size()) {  // the usual case, records in order
+      bytes.insert(bytes.end(), p, p + n);
+      return true;
+    }
+    if (off + n > bytes.size()) bytes.resize(off + n, fill);
+    memcpy(&bytes[off], p, n);
+    return true;
+  }
+};
+
+struct HexToCpu8085 {
+  Cpu8085 &cpu;
+
+  bool operator()(uint32_t addr, const uint8_t *p, size_t n) {
+    if ((uint64_t)addr + n > 0x10000) return false;
+    cpu.load(addr, p, n);
+    return true;
+  }
+};
+
+class HexWriter8085 {
+ public:
+  std::string out;
+
+  // n bytes from addr on
+  void data(uint32_t addr, const uint8_t *p, size_t n) {
+    // 45 characters a full record, one more record if addr isn't aligned,
+    // and an 04 record per 64 KB
+    out.reserve(out.size() + (n / 16 + 2) * 45 + (n >> 16) * 17);
+    while (n) {
+      if (addr >> 16 != upper) {
+        upper = addr >> 16;
+        uint8_t ext[2] = {(uint8_t)(upper >> 8), (uint8_t)upper};
+        record(0, 0x04, ext, 2);
+      }
+      // 16 byte aligned, so a record never crosses into the next 64 KB
+      size_t k = 16 - (addr & 15);
+      if (k > n) k = n;
+      record(addr & 0xFFFF, 0x00, p, k);
+      addr += k, p += k, n -= k;
+    }
+  }
+
+  void end() { out += ":00000001FF"; }
+
+ private:
+  uint32_t upper = 0;
+
+  void record(uint16_t addr, uint8_t type, const uint8_t *p, size_t n) {
+    const char *D = hexDigits8085.digit;
+    size_t at = out.size();
+    out.resize(at + 13 + 2 * n);
+    char *o = &out[at];
+    uint8_t sum = n + (addr >> 8) + addr + type;
+    auto put = [&](uint8_t b) {
+      *o++ = D[b >> 4];
+      *o++ = D[b & 15];
+    };
+    *o++ = ':';
+    put(n);
+    put(addr >> 8);
+    put(addr);
+    put(type);
+    for (size_t i = 0; i < n; i++) {
+      put(p[i]);
+      sum += p[i];
+    }
+    put(-sum);
+    *o++ = '\r';
+    *o++ = '\n';
+  }
+};
+
+#endif
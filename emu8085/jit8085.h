@@ -0,0 +1,715 @@
+/*
+ * x86-64 basic block translator for the 8085 core in cpu8085.h.
+ *
+ * each 8085 basic block (straight line code up to a jump, call, return or
+ * RST) becomes native code in an mmap'd RWX buffer. the 8085 registers live
+ * in the x86 registers the 8086 inherited them as:
+ *
+ *   A = al    BC = cx (B = ch, C = cl)    DE = dx    HL = bx    SP = edi
+ *   rsi = memory, rbp = JitState8085, r8 = instruction budget, ah = scratch
+ *
+ * so M is [rsi + rbx] and the pairs are whole 16 bit registers, which keeps
+ * every instruction free of REX prefixes (those make ah/bh/ch/dh unusable).
+ *
+ * flags: x86 SF ZF AF PF CF sit in the same bits as the 8085's S Z AC P CY
+ * (lahf even sets bit 1), and ADD/SUB/INR/DCR/rotates/STC/CMC set them the
+ * same way as cpu8085.h. inside a block they are left in EFLAGS and only
+ * stored to F (lahf) when they leave the block or PUSH PSW / DAD need them;
+ * instructions that keep some flags (INR, DCR, ADC, RAL, ...) reload EFLAGS
+ * from F with sahf only if nothing earlier in the block set them.
+ *
+ * every block starts by taking its length off the budget and bails out to
+ * the interpreter for the last few instructions if that goes negative. jumps
+ * to a known address leave through a stub that asks for the target; once it
+ * is translated the jump is patched to go there directly. stores check a
+ * byte per address map of translated code and leave the block if they hit
+ * it, and then the whole cache is thrown away (self modifying code is rare
+ * in the lab programs). DAA, XTHL, IN, OUT, EI, DI, RIM, SIM, HLT, RST 1
+ * and the undocumented opcodes end a block and are run by the interpreter.
+ *
+ * stores into translated code from outside (Cpu8085::mem, load()) need
+ * flush(); the map only sees stores made by the generated code and by the
+ * interpreter steps run() takes. stores made by the generated code don't
+ * mark Cpu8085::dirty either.
+ */
+
+#ifndef JIT8085_H
+#define JIT8085_H
+
+#include "cpu8085.h"
+
+#if defined(__x86_64__) && defined(__unix__)
+#define CPU8085_JIT 1
+
+#include <sys/mman.h>
+
+#include <cstddef>
+#include <new>
+#include <vector>
+
+// what the generated code sees through rbp
+struct JitState8085 {
+  Regs8085 r;
+  uint8_t reason;  // why the last block returned to the host, JIT_EXIT_*
+  int32_t patch;   // for JIT_EXIT_CHAIN: offset of the rel32 to patch
+  int64_t budget;  // instructions left
+  // nonzero where a translated instruction (or one of its operands) lives.
+  // one spare byte at the end mirrors [0] so SP+1 needs no wrap
+  uint8_t codeMap[0x10001];
+};
+
+enum JitExit8085 : uint8_t {
+  JIT_EXIT_CHAIN,     // jump to a fixed address; the site can be patched
+  JIT_EXIT_INDIRECT,  // RET / PCHL, target in r.pc
+  JIT_EXIT_BUDGET,    // not enough budget left for the block at r.pc
+  JIT_EXIT_SMC,       // a store hit translated code
+};
+
+class Jit8085 {
+ public:
+  uint64_t blocksTranslated = 0;
+  uint64_t flushes = 0;
+
+  explicit Jit8085(Cpu8085 &cpu) : cpu(cpu), blockAt(0x10000, -1) {
+    void *p = mmap(nullptr, CODE_SIZE, PROT_READ | PROT_WRITE | PROT_EXEC,
+                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED) throw std::bad_alloc();
+    code = (uint8_t *)p;
+    memset(&js, 0, sizeof(js));
+    emitTrampolines();
+  }
+
+  ~Jit8085() { munmap(code, CODE_SIZE); }
+
+  Jit8085(const Jit8085 &) = delete;
+  Jit8085 &operator=(const Jit8085 &) = delete;
+
+  // same contract as Cpu8085::run: stops after maxInsns instructions or at
+  // HLT / RST 1 / an undocumented opcode, and counts into cpu.executed
+  Stop8085 run(uint64_t maxInsns = UINT64_MAX) {
+    Stop8085 why = STOP_BUDGET;
+    uint64_t left = maxInsns;
+    js.r = cpu.r;
+
+    while (left) {
+      int32_t blk = blockFor(js.r.pc);
+      if (blk < 0) {
+        left--;
+        if ((why = interpStep()) != STOP_BUDGET) break;
+        continue;
+      }
+
+      int64_t given = left > (uint64_t)INT64_MAX ? INT64_MAX : left;
+      js.budget = given;
+      enter(&js, cpu.mem, code + blk);
+      uint64_t done = given - js.budget;
+      cpu.executed += done;
+      left -= done;
+
+      if (js.reason == JIT_EXIT_CHAIN) {
+        chain(js.patch);
+      } else if (js.reason == JIT_EXIT_SMC) {
+        flush();
+      } else if (js.reason == JIT_EXIT_BUDGET) {
+        // fewer instructions left than the block holds
+        while (left && why == STOP_BUDGET) {
+          left--;
+          why = interpStep();
+        }
+        break;
+      }
+    }
+
+    cpu.r = js.r;
+    return why;
+  }
+
+  void flush() {
+    used = trampolineEnd;
+    std::fill(blockAt.begin(), blockAt.end(), -1);
+    memset(js.codeMap, 0, sizeof(js.codeMap));
+    flushes++;
+  }
+
+ private:
+  static constexpr size_t CODE_SIZE = 4 << 20;
+  static constexpr int MAX_BLOCK = 32;
+
+  // x86 register numbers; the 8 bit ones with 4..7 being ah ch dh bh
+  enum { AL, CL, DL, BL, AH, CH, DH, BH };
+  enum { RAX, RCX, RDX, RBX, RSP, RBP, RSI, RDI };
+  enum { NO_INDEX = -1 };
+
+  // JitState8085 fields, as rbp displacements
+  static constexpr int32_t ST_F = offsetof(JitState8085, r.f);
+  static constexpr int32_t ST_PC = offsetof(JitState8085, r.pc);
+  static constexpr int32_t ST_REASON = offsetof(JitState8085, reason);
+  static constexpr int32_t ST_PATCH = offsetof(JitState8085, patch);
+  static constexpr int32_t ST_MAP = offsetof(JitState8085, codeMap);
+
+  // where the flags are between two translated instructions
+  enum FlagLoc { IN_F, IN_EFLAGS, IN_BOTH };
+  // x86 leaves AF undefined after and/or/xor; the 8085 sets or clears AC
+  enum AcFix { AC_EXACT, AC_SET, AC_CLEAR };
+
+  struct Stub {
+    uint32_t site;  // rel32 that jumps here
+    uint8_t reason;
+    uint16_t pc;        // 8085 address to continue at
+    int32_t giveBack;   // budget taken for instructions that didn't run
+    bool ahHoldsFlags;  // JIT_EXIT_SMC from IN_EFLAGS: lahf already done
+    AcFix fix;
+  };
+
+  using Entry = void (*)(JitState8085 *, uint8_t *, const uint8_t *);
+
+  Cpu8085 &cpu;
+  JitState8085 js;
+  uint8_t *code;
+  size_t used = 0, trampolineEnd = 0;
+  Entry enter;
+  uint32_t epilogue;
+  std::vector<int32_t> blockAt;
+
+  // per block state while translating
+  FlagLoc loc;
+  AcFix acFix;
+  std::vector<Stub> stubs;
+
+  // -------------------------------------------------------------------------
+  // emitting
+
+  void b(uint8_t x) { code[used++] = x; }
+  void d16(uint16_t x) {
+    memcpy(code + used, &x, 2);
+    used += 2;
+  }
+  void d32(uint32_t x) {
+    memcpy(code + used, &x, 4);
+    used += 4;
+  }
+
+  // [base + index + disp32], always through a SIB byte
+  void modrmMem(int reg, int base, int index, int32_t disp) {
+    b(0x80 | reg << 3 | 4);
+    b((index == NO_INDEX ? 4 : index) << 3 | base);
+    d32(disp);
+  }
+  void modrmReg(int reg, int rm) { b(0xC0 | reg << 3 | rm); }
+
+  // 8085 memory: [rsi + pair] or [rsi + addr]
+  void mem8085(int reg, int pair) { modrmMem(reg, RSI, pair, 0); }
+  void memAbs(int reg, uint16_t addr) { modrmMem(reg, RSI, NO_INDEX, addr); }
+  void state(int reg, int32_t off) { modrmMem(reg, RBP, NO_INDEX, off); }
+
+  uint32_t jcc32(int cc) {
+    b(0x0F);
+    b(0x80 | cc);
+    d32(0);
+    return used - 4;
+  }
+  uint32_t jmp32() {
+    b(0xE9);
+    d32(0);
+    return used - 4;
+  }
+  void setRel(uint32_t site, size_t target) {
+    int32_t rel = (int32_t)(target - (site + 4));
+    memcpy(code + site, &rel, 4);
+  }
+
+  void emitTrampolines() {
+    // enter(state = rdi, mem = rsi, block = rdx)
+    enter = (Entry)(code + used);
+    b(0x53);                            // push rbx
+    b(0x55);                            // push rbp
+    b(0x48), b(0x89), b(0xFD);          // mov rbp, rdi
+    b(0x4C), b(0x8B), b(0x45), b(0x18);  // mov r8, [rbp+budget]
+    b(0x49), b(0x89), b(0xD1);          // mov r9, rdx
+    b(0x0F), b(0xB6), b(0x45), b(0x07);  // movzx eax, byte [rbp+a]
+    b(0x0F), b(0xB7), b(0x4D), b(0x00);  // movzx ecx, word [rbp+bc]
+    b(0x0F), b(0xB7), b(0x55), b(0x02);  // movzx edx, word [rbp+de]
+    b(0x0F), b(0xB7), b(0x5D), b(0x04);  // movzx ebx, word [rbp+hl]
+    b(0x0F), b(0xB7), b(0x7D), b(0x08);  // movzx edi, word [rbp+sp]
+    b(0x41), b(0xFF), b(0xE1);          // jmp r9
+
+    epilogue = used;
+    b(0x88), b(0x45), b(0x07);           // mov [rbp+a], al
+    b(0x66), b(0x89), b(0x4D), b(0x00);  // mov [rbp+bc], cx
+    b(0x66), b(0x89), b(0x55), b(0x02);  // mov [rbp+de], dx
+    b(0x66), b(0x89), b(0x5D), b(0x04);  // mov [rbp+hl], bx
+    b(0x66), b(0x89), b(0x7D), b(0x08);  // mov [rbp+sp], di
+    b(0x4C), b(0x89), b(0x45), b(0x18);  // mov [rbp+budget], r8
+    b(0x5D);                             // pop rbp
+    b(0x5B);                             // pop rbx
+    b(0xC3);                             // ret
+
+    static_assert(offsetof(JitState8085, r.a) == 7, "");
+    static_assert(offsetof(JitState8085, r.c) == 0, "");
+    static_assert(offsetof(JitState8085, r.e) == 2, "");
+    static_assert(offsetof(JitState8085, r.l) == 4, "");
+    static_assert(offsetof(JitState8085, r.sp) == 8, "");
+    static_assert(offsetof(JitState8085, budget) == 0x18, "");
+    trampolineEnd = used;
+  }
+
+  // -------------------------------------------------------------------------
+  // flags
+
+  // F <- EFLAGS
+  void materialize() {
+    if (loc != IN_EFLAGS) return;
+    b(0x9F);                                         // lahf
+    if (acFix == AC_SET) b(0x80), b(0xCC), b(0x10);  // or ah, AC
+    if (acFix == AC_CLEAR) b(0x80), b(0xE4), b(0xEF);  // and ah, ~AC
+    b(0x88), state(AH, ST_F);                        // mov [F], ah
+    loc = acFix == AC_EXACT ? IN_BOTH : IN_F;
+  }
+
+  // EFLAGS <- F, for instructions that keep some of the flags
+  void needEflags() {
+    if (loc != IN_F) return;
+    b(0x8A), state(AH, ST_F);  // mov ah, [F]
+    b(0x9E);                   // sahf
+    loc = IN_BOTH;
+    acFix = AC_EXACT;
+  }
+
+  void flagsSet(AcFix fix) {
+    loc = IN_EFLAGS;
+    acFix = fix;
+  }
+
+  // jump if the 8085 condition (NZ Z NC C PO PE P M) holds, or fails
+  uint32_t condJump(int cond, bool invert) {
+    static const uint8_t x86cc[8] = {0x5, 0x4, 0x3, 0x2, 0xB, 0xA, 0x9, 0x8};
+    static const uint8_t mask[8] = {FLAG_Z, FLAG_Z, FLAG_CY, FLAG_CY,
+                                    FLAG_P, FLAG_P, FLAG_S,  FLAG_S};
+    if (loc == IN_BOTH) return jcc32(x86cc[cond] ^ invert);
+    b(0xF6), state(0, ST_F), b(mask[cond]);  // test byte [F], mask
+    return jcc32((cond & 1 ? 0x5 : 0x4) ^ invert);
+  }
+
+  // -------------------------------------------------------------------------
+  // exits
+
+  void exitChain(uint16_t target) {
+    uint32_t site = jmp32();
+    stubs.push_back({site, JIT_EXIT_CHAIN, target, 0, false, AC_EXACT});
+  }
+
+  void exitIndirect() {
+    b(0xC6), state(0, ST_REASON), b(JIT_EXIT_INDIRECT);
+    setRel(jmp32(), epilogue);
+  }
+
+  // after a store to [rsi + index + disp]: leave if it hit translated code
+  void writeCheck(int index, int32_t disp, uint16_t nextPc, int giveBack) {
+    bool save = loc == IN_EFLAGS;
+    if (save) b(0x9F);                                     // lahf
+    b(0x80), modrmMem(7, RBP, index, ST_MAP + disp), b(0);  // cmp [map], 0
+    uint32_t site = jcc32(0x5);
+    stubs.push_back(
+        {site, JIT_EXIT_SMC, nextPc, giveBack, save, save ? acFix : AC_EXACT});
+    if (save) b(0x9E);  // sahf
+    else loc = IN_F;
+  }
+
+  void emitStubs() {
+    for (const Stub &s : stubs) {
+      setRel(s.site, used);
+      if (s.ahHoldsFlags) {
+        if (s.fix == AC_SET) b(0x80), b(0xCC), b(0x10);
+        if (s.fix == AC_CLEAR) b(0x80), b(0xE4), b(0xEF);
+        b(0x88), state(AH, ST_F);
+      }
+      if (s.giveBack) b(0x49), b(0x81), b(0xC0), d32(s.giveBack);  // add r8
+      b(0x66), b(0xC7), state(0, ST_PC), d16(s.pc);
+      b(0xC6), state(0, ST_REASON), b(s.reason);
+      if (s.reason == JIT_EXIT_CHAIN)
+        b(0xC7), state(0, ST_PATCH), d32(s.site);
+      setRel(jmp32(), epilogue);
+    }
+    stubs.clear();
+  }
+
+  // -------------------------------------------------------------------------
+  // stack, with SP wrapping at 16 bits and no flags touched
+
+  void spStep(int8_t by) {
+    b(0x8D), b(0x7F), b((uint8_t)by);  // lea edi, [rdi+by]
+    b(0x0F), b(0xB7), b(0xFF);         // movzx edi, di
+  }
+
+  // push hi, lo from 8 bit registers (or a constant when reg < 0)
+  void push16(int hiReg, int loReg, uint16_t value, uint16_t nextPc,
+              int giveBack) {
+    spStep(-1);
+    if (hiReg < 0) b(0xC6), mem8085(0, RDI), b(value >> 8);
+    else b(0x88), mem8085(hiReg, RDI);
+    spStep(-1);
+    if (loReg < 0) b(0xC6), mem8085(0, RDI), b(value);
+    else b(0x88), mem8085(loReg, RDI);
+    writeCheck(RDI, 0, nextPc, giveBack);
+    writeCheck(RDI, 1, nextPc, giveBack);
+  }
+
+  void pop16(int hiReg, int loReg) {
+    b(0x8A), mem8085(loReg, RDI);
+    spStep(1);
+    b(0x8A), mem8085(hiReg, RDI);
+    spStep(1);
+  }
+
+  // RET: pop straight into r.pc through ah
+  void popPc() {
+    b(0x8A), mem8085(AH, RDI);
+    b(0x88), state(AH, ST_PC);
+    spStep(1);
+    b(0x8A), mem8085(AH, RDI);
+    b(0x88), state(AH, ST_PC + 1);
+    spStep(1);
+  }
+
+  // -------------------------------------------------------------------------
+  // translation
+
+  static bool supported(uint8_t op) {
+    switch (op) {
+      case 0x08: case 0x10: case 0x18: case 0x28: case 0x38:  // undocumented
+      case 0xCB: case 0xD9: case 0xDD: case 0xED: case 0xFD:
+      case 0x20: case 0x30:                // RIM SIM
+      case 0x27: case 0xE3:                // DAA XTHL
+      case 0x76: case 0xCF:                // HLT RST 1
+      case 0xD3: case 0xDB:                // OUT IN
+      case 0xF3: case 0xFB:                // DI EI
+        return false;
+    }
+    return true;
+  }
+
+  void mark(uint16_t addr, int len) {
+    for (int i = 0; i < len; i++) js.codeMap[(uint16_t)(addr + i)] = 1;
+    js.codeMap[0x10000] = js.codeMap[0];
+  }
+
+  int32_t blockFor(uint16_t pc) {
+    int32_t blk = blockAt[pc];
+    return blk >= 0 ? blk : translate(pc);
+  }
+
+  void chain(int32_t site) {
+    uint64_t gen = flushes;
+    int32_t blk = blockFor(js.r.pc);
+    if (blk >= 0 && gen == flushes) setRel(site, blk);
+  }
+
+  int32_t translate(uint16_t start) {
+    struct Insn {
+      uint16_t pc;
+      uint8_t op;
+      uint16_t imm;
+    } insns[MAX_BLOCK];
+    int n = 0;
+
+    uint16_t pc = start;
+    while (n < MAX_BLOCK) {
+      uint8_t op = cpu.mem[pc], len = opInfo8085.len[op];
+      if (!supported(op)) break;
+      uint16_t imm = (len > 1 ? cpu.mem[(uint16_t)(pc + 1)] : 0) |
+                     (len > 2 ? cpu.mem[(uint16_t)(pc + 2)] << 8 : 0);
+      insns[n++] = {pc, op, imm};
+      pc += len;
+      if (opInfo8085.cls[op] & OPC_ENDS_BLOCK) break;
+    }
+    if (n == 0) return -1;
+
+    if (CODE_SIZE - used < 256 * (size_t)n + 256) flush();
+    for (int i = 0; i < n; i++)
+      mark(insns[i].pc, opInfo8085.len[insns[i].op]);
+
+    int32_t entry = used;
+    loc = IN_F;
+    acFix = AC_EXACT;
+
+    b(0x49), b(0x81), b(0xE8), d32(n);  // sub r8, n
+    stubs.push_back({jcc32(0xC), JIT_EXIT_BUDGET, start, n, false, AC_EXACT});
+
+    bool ended = false;
+    for (int i = 0; i < n; i++) {
+      const Insn &in = insns[i];
+      uint16_t next = in.pc + opInfo8085.len[in.op];
+      ended = emitInsn(in.op, in.imm, next, n - i - 1);
+    }
+    if (!ended) {
+      materialize();
+      exitChain(pc);
+    }
+    emitStubs();
+
+    blockAt[start] = entry;
+    blocksTranslated++;
+    return entry;
+  }
+
+  // returns true if the instruction left the block on every path
+  bool emitInsn(uint8_t op, uint16_t imm, uint16_t next, int after) {
+    // 8085 register field (B C D E H L M A) -> x86 byte register
+    static const int8_t reg8[8] = {CH, CL, DH, DL, BH, BL, -1, AL};
+    // 8085 pair field (BC DE HL SP) -> x86 register
+    static const int8_t pair[4] = {RCX, RDX, RBX, RDI};
+    // ADD ADC SUB SBB ANA XRA ORA CMP -> x86 opcode (r/m8, r8 form)
+    static const uint8_t alu[8] = {0x00, 0x10, 0x28, 0x18,
+                                   0x20, 0x30, 0x08, 0x38};
+    static const AcFix aluFix[8] = {AC_EXACT, AC_EXACT, AC_EXACT, AC_EXACT,
+                                    AC_SET,   AC_CLEAR, AC_CLEAR, AC_EXACT};
+
+    int dst = op >> 3 & 7, src = op & 7, rp = op >> 4 & 3;
+
+    if (op >= 0x40 && op < 0x80) {  // MOV
+      if (dst == 6) {
+        b(0x88), mem8085(reg8[src], RBX);
+        writeCheck(RBX, 0, next, after);
+      } else if (src == 6) {
+        b(0x8A), mem8085(reg8[dst], RBX);
+      } else if (src != dst) {
+        b(0x88), modrmReg(reg8[src], reg8[dst]);
+      }
+      return false;
+    }
+
+    if (op >= 0x80 && op < 0xC0) {  // ALU A, r
+      if (dst == 1 || dst == 3) needEflags();
+      if (src == 6) b(alu[dst] + 2), mem8085(AL, RBX);
+      else b(alu[dst]), modrmReg(reg8[src], AL);
+      flagsSet(aluFix[dst]);
+      return false;
+    }
+
+    if (op >= 0xC0 && (op & 7) == 6) {  // ALU A, imm
+      if (dst == 1 || dst == 3) needEflags();
+      b(alu[dst] + 4), b(imm);
+      flagsSet(aluFix[dst]);
+      return false;
+    }
+
+    if (op < 0x40) {
+      switch (op & 0x0F) {
+        case 0x01:  // LXI
+          b(0xB8 + pair[rp]), d32(imm);
+          return false;
+        case 0x03:  // INX
+        case 0x0B:  // DCX
+          b(0x8D), b(0x40 | pair[rp] << 3 | pair[rp]);
+          b((op & 8) ? 0xFF : 0x01);
+          b(0x0F), b(0xB7), modrmReg(pair[rp], pair[rp]);
+          return false;
+        case 0x09:  // DAD
+          materialize();
+          b(0x66), b(0x01), modrmReg(pair[rp], RBX);  // add bx, rp
+          b(0x0F), b(0x92), b(0xC4);                  // setc ah
+          b(0x80), state(4, ST_F), b(0xFE);           // and byte [F], ~CY
+          b(0x08), state(AH, ST_F);                   // or [F], ah
+          loc = IN_F;
+          return false;
+      }
+
+      if ((op & 7) == 4 || (op & 7) == 5) {  // INR, DCR
+        int sub = op & 1;
+        needEflags();
+        if (dst == 6) {
+          b(0xFE), mem8085(sub, RBX);
+          flagsSet(AC_EXACT);
+          writeCheck(RBX, 0, next, after);
+        } else {
+          b(0xFE), modrmReg(sub, reg8[dst]);
+          flagsSet(AC_EXACT);
+        }
+        return false;
+      }
+
+      if ((op & 7) == 6) {  // MVI
+        if (dst == 6) {
+          b(0xC6), mem8085(0, RBX), b(imm);
+          writeCheck(RBX, 0, next, after);
+        } else {
+          b(0xB0 + reg8[dst]), b(imm);
+        }
+        return false;
+      }
+
+      switch (op) {
+        case 0x00:  // NOP
+          return false;
+        case 0x02:  // STAX B
+        case 0x12:  // STAX D
+          b(0x88), mem8085(AL, pair[rp]);
+          writeCheck(pair[rp], 0, next, after);
+          return false;
+        case 0x0A:  // LDAX B
+        case 0x1A:  // LDAX D
+          b(0x8A), mem8085(AL, pair[rp]);
+          return false;
+        case 0x07:  // RLC
+        case 0x0F:  // RRC
+        case 0x17:  // RAL
+        case 0x1F:  // RAR
+          needEflags();
+          b(0xD0), modrmReg(op >> 3 & 3, AL);  // rol ror rcl rcr al, 1
+          flagsSet(acFix);
+          return false;
+        case 0x22:  // SHLD
+          b(0x88), memAbs(BL, imm);
+          b(0x88), memAbs(BH, imm + 1);
+          writeCheck(NO_INDEX, imm, next, after);
+          writeCheck(NO_INDEX, (uint16_t)(imm + 1), next, after);
+          return false;
+        case 0x2A:  // LHLD
+          b(0x8A), memAbs(BL, imm);
+          b(0x8A), memAbs(BH, imm + 1);
+          return false;
+        case 0x2F:  // CMA
+          b(0xF6), b(0xD0);
+          return false;
+        case 0x32:  // STA
+          b(0x88), memAbs(AL, imm);
+          writeCheck(NO_INDEX, imm, next, after);
+          return false;
+        case 0x3A:  // LDA
+          b(0x8A), memAbs(AL, imm);
+          return false;
+        case 0x37:  // STC
+        case 0x3F:  // CMC
+          needEflags();
+          b(op == 0x37 ? 0xF9 : 0xF5);
+          flagsSet(acFix);
+          return false;
+      }
+      return false;
+    }
+
+    // 0xC0..0xFF: stack and control transfer
+    int cond = op >> 3 & 7;
+    switch (op & 7) {
+      case 0:  // Rcc
+        materialize();
+        stubs.push_back(
+            {condJump(cond, true), JIT_EXIT_CHAIN, next, 0, false, AC_EXACT});
+        popPc();
+        exitIndirect();
+        return true;
+      case 2:  // Jcc
+        materialize();
+        stubs.push_back(
+            {condJump(cond, false), JIT_EXIT_CHAIN, imm, 0, false, AC_EXACT});
+        exitChain(next);
+        return true;
+      case 4:  // Ccc
+        materialize();
+        stubs.push_back(
+            {condJump(cond, true), JIT_EXIT_CHAIN, next, 0, false, AC_EXACT});
+        push16(-1, -1, next, imm, 0);
+        exitChain(imm);
+        return true;
+      case 7:  // RST
+        materialize();
+        push16(-1, -1, next, op & 0x38, 0);
+        exitChain(op & 0x38);
+        return true;
+    }
+
+    switch (op) {
+      case 0xC1:  // POP B
+      case 0xD1:  // POP D
+      case 0xE1:  // POP H
+        pop16(reg8[rp * 2], reg8[rp * 2 + 1]);
+        return false;
+      case 0xF1:  // POP PSW
+        b(0x8A), mem8085(AH, RDI);
+        b(0x80), b(0xE4), b(0xD5);  // and ah, S Z AC P CY
+        b(0x80), b(0xCC), b(FLAG_FIXED);
+        b(0x88), state(AH, ST_F);
+        spStep(1);
+        b(0x8A), mem8085(AL, RDI);
+        spStep(1);
+        loc = IN_F;
+        acFix = AC_EXACT;
+        return false;
+      case 0xC5:  // PUSH B
+      case 0xD5:  // PUSH D
+      case 0xE5:  // PUSH H
+        push16(reg8[rp * 2], reg8[rp * 2 + 1], 0, next, after);
+        return false;
+      case 0xF5:  // PUSH PSW
+        materialize();
+        b(0x8A), state(AH, ST_F);
+        push16(AL, AH, 0, next, after);
+        return false;
+      case 0xC3:  // JMP
+        materialize();
+        exitChain(imm);
+        return true;
+      case 0xCD:  // CALL
+        materialize();
+        push16(-1, -1, next, imm, 0);
+        exitChain(imm);
+        return true;
+      case 0xC9:  // RET
+        materialize();
+        popPc();
+        exitIndirect();
+        return true;
+      case 0xE9:  // PCHL
+        materialize();
+        b(0x66), b(0x89), state(BL, ST_PC);  // mov [pc], bx
+        exitIndirect();
+        return true;
+      case 0xEB:  // XCHG
+        b(0x87), modrmReg(RDX, RBX);
+        return false;
+      case 0xF9:  // SPHL
+        b(0x89), modrmReg(RBX, RDI);
+        return false;
+    }
+    return false;
+  }
+
+  // -------------------------------------------------------------------------
+
+  // one instruction on the interpreter. it may store into translated code
+  // (XTHL, or anything in a budget tail), so check what it wrote to
+  Stop8085 interpStep() {
+    const Regs8085 &r = js.r;
+    uint8_t op = cpu.mem[r.pc];
+    uint16_t imm = cpu.mem[(uint16_t)(r.pc + 1)] |
+                   cpu.mem[(uint16_t)(r.pc + 2)] << 8;
+    uint16_t at[2];
+    int n = 0;
+
+    if (op == 0x02) at[n++] = r.bc();  // STAX B
+    if (op == 0x12) at[n++] = r.de();  // STAX D
+    if (op == 0x22) at[n++] = imm, at[n++] = imm + 1;  // SHLD
+    if (op == 0x32) at[n++] = imm;                     // STA
+    if ((op >= 0x34 && op <= 0x36) || (op >= 0x70 && op <= 0x77 && op != 0x76))
+      at[n++] = r.hl();                           // INR/DCR/MVI/MOV M
+    if (op == 0xE3) at[n++] = r.sp, at[n++] = r.sp + 1;  // XTHL
+    if (op >= 0xC0 && ((op & 7) == 4 || (op & 7) == 7 || (op & 0xCF) == 0xC5 ||
+                       op == 0xCD))
+      at[n++] = r.sp - 1, at[n++] = r.sp - 2;  // Ccc, RST, PUSH, CALL
+
+    cpu.r = js.r;
+    Stop8085 why = cpu.runSwitch(1);
+    js.r = cpu.r;
+
+    for (int i = 0; i < n; i++) {
+      if (js.codeMap[at[i]]) {
+        flush();
+        break;
+      }
+    }
+    return why;
+  }
+};
+
+#endif
+#endif
@@ -0,0 +1,753 @@
+/*
+ * N independent 8085 machines stepped together, for running one routine
+ * over many inputs (verify8085.cpp).
+ *
+ * the registers are kept as structure of arrays, R[reg][lane], so every
+ * instruction is a short loop over the lanes that the compiler can turn
+ * into vector code (build with -O3; -march=native for AVX2). each step
+ * takes the lowest PC among the running lanes and executes the instruction
+ * there for every lane at that PC, under a mask. lanes that branch apart
+ * wait while the others catch up: a loop running longer in some lanes
+ * keeps the rest parked at its exit until they all get there. the smallest
+ * PC first order makes that the usual way they meet again.
+ *
+ * memory is the shared starting image plus, per address that some lane
+ * has written (or poke() set), a row of N private bytes. an access with
+ * the same address in every active lane is a row copy; other accesses
+ * fall back to a loop over the lanes. operand bytes are read through the
+ * same path, so lanes may differ in their immediates (inputs patched into
+ * MVI operands); they must agree on the opcode.
+ *
+ * semantics and flags are those of cpu8085.h, RST 1 and HLT stop a lane.
+ * IN, OUT, RIM, SIM, EI and DI (no ports or interrupt state here), lanes
+ * that disagree on the opcode, and more than MAX_ROWS private addresses
+ * make run() give up (bailed, with the reason); the caller reruns those
+ * inputs on Cpu8085.
+ *
+ * this is only faster than Cpu8085 where the lanes stay together. measured
+ * by verify8085 -j 1 (scalar time over lanes time), best to worst:
+ *
+ *                      add24      mul8imm    mul8   factorial
+ *   -O3 -march=native  2.4-2.8x   1.5-1.7x   1.3x   0.5-0.95x
+ *   -O3                2.6-2.8x   1.0-1.1x   0.8x   0.65-0.8x
+ *   -O2                1.5-1.7x   0.4x       0.3x   0.2x
+ *
+ * add24 is straight line code, so all 32 lanes run every step. the
+ * multiplies split on the JNC in their loop (75-90% of the lanes busy)
+ * and factorial's lanes stop at widely different counts (about half
+ * busy), and the per step overhead then outweighs the width. at -O2 gcc
+ * vectorizes few of the lane loops.
+ */
+
+#ifndef LANES8085_H
+#define LANES8085_H
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "cpu8085.h"
+
+template <int N = 32>
+class Lanes8085 {
+ public:
+  static constexpr int LANES = N;
+  static constexpr int MAX_ROWS = 4096;
+
+  // B C D E H L - A in the opcode register order; row 6 is where M
+  // operands are loaded to and stored from
+  alignas(64) uint8_t R[8][N];
+  alignas(64) uint8_t F[N];
+  alignas(64) uint16_t PC[N], SP[N];
+  alignas(64) uint8_t running[N];  // 0xFF while the lane runs
+  uint32_t count[N];               // instructions each lane ran
+  Stop8085 why[N];
+
+  uint64_t steps = 0;     // instructions issued, each for a set of lanes
+  uint64_t executed = 0;  // instructions summed over the lanes
+  bool bailed = false;
+  const char *bailReason = nullptr;
+  uint16_t bailPc = 0;
+
+  explicit Lanes8085(const uint8_t *image)
+      : image(image), slotOf(0x10000, -1) {
+    rows.reserve(MAX_ROWS * N);
+    reset();
+  }
+
+  // every lane as Cpu8085::reset leaves it, memory back to the image
+  void reset(uint16_t pc = 0x0000) {
+    memset(R, 0, sizeof(R));
+    for (int i = 0; i < N; i++) {
+      F[i] = FLAG_FIXED;
+      PC[i] = pc;
+      SP[i] = 0xFFFF;
+      running[i] = 0xFF;
+      count[i] = 0;
+      why[i] = STOP_BUDGET;
+    }
+    for (uint16_t a : rowAddr) slotOf[a] = -1;
+    rowAddr.clear();
+    rows.clear();
+    bailed = false;
+    bailReason = nullptr;
+  }
+
+  // lane i's memory, before or after a run
+  uint8_t peek(int i, uint16_t a) const {
+    int s = slotOf[a];
+    return s < 0 ? image[a] : rows[s * N + i];
+  }
+  void poke(int i, uint16_t a, uint8_t v) { rows[row(a) * N + i] = v; }
+
+  // lanes that shouldn't run at all (a partial batch)
+  void park(int i) { running[i] = 0; }
+
+  // lane i back to its state after reset() (registers, its column of the
+  // private memory), running again: how a lane that stopped takes the next
+  // input while the others carry on
+  void restart(int i, uint16_t pc = 0x0000) {
+    for (int r = 0; r < 8; r++) R[r][i] = 0;
+    F[i] = FLAG_FIXED;
+    PC[i] = pc;
+    SP[i] = 0xFFFF;
+    running[i] = 0xFF;
+    count[i] = 0;
+    why[i] = STOP_BUDGET;
+    for (size_t s = 0; s < rowAddr.size(); s++)
+      rows[s * N + i] = image[rowAddr[s]];
+  }
+
+  // until every lane has stopped or run maxInsns (or, with untilStopped,
+  // until that many of the lanes running on entry have); false if it
+  // bailed, and then the lanes are in no useful state
+  bool run(uint32_t maxInsns, int untilStopped = N) {
+    int live = 0;
+    uint32_t most = 0;
+    for (int i = 0; i < N; i++) {
+      live += running[i] & 1;
+      most = running[i] && count[i] > most ? count[i] : most;
+    }
+    // no lane can reach maxInsns before this many more steps
+    uint32_t budget = maxInsns > most ? maxInsns - most : 1;
+    int left = live;
+    while (!bailed) {
+      uint32_t lowest = 0x10000;
+      for (int i = 0; i < N; i++) {
+        uint32_t k = running[i] ? PC[i] : 0x10000;
+        lowest = k < lowest ? k : lowest;
+      }
+      if (lowest == 0x10000) return true;
+      uint16_t p = lowest;
+
+      lead = -1;
+      int active = 0;
+      for (int i = 0; i < N; i++) {
+        act[i] = running[i] && PC[i] == p ? 0xFF : 0;
+        active += act[i] & 1;
+      }
+      for (int i = 0; i < N && lead < 0; i++)
+        if (act[i]) lead = i;
+
+      uint8_t op;
+      if (!fetch(p, op)) return false;
+      steps++;
+      executed += active;
+      exec(op, p);
+
+      for (int i = 0; i < N; i++) count[i] += act[i] & 1;
+      if (--budget == 0 || stoppedSome) {
+        most = 0;
+        left = 0;
+        for (int i = 0; i < N; i++) {
+          uint8_t over = count[i] >= maxInsns ? 0xFF : 0;
+          running[i] &= ~over;
+          left += running[i] & 1;
+          most = running[i] && count[i] > most ? count[i] : most;
+        }
+        budget = maxInsns > most ? maxInsns - most : 1;
+        stoppedSome = false;
+        if (live - left >= untilStopped) return true;
+      }
+    }
+    return false;
+  }
+
+ private:
+  const uint8_t *image;
+  std::vector<int32_t> slotOf;  // address -> row, -1 if shared
+  std::vector<uint16_t> rowAddr;
+  std::vector<uint8_t> rows;  // MAX_ROWS x N at most
+
+  alignas(64) uint8_t act[N];  // lanes at this step's PC
+  int lead;                    // first of them
+  bool stoppedSome = false;    // exec() stopped a lane this step
+  alignas(64) uint8_t imm8[N];
+  alignas(64) uint16_t imm16[N], ad[N], t16[N];
+  alignas(64) uint8_t t8[N], t8b[N];
+
+  static uint8_t pick(uint8_t m, uint8_t v, uint8_t old) {
+    return (v & m) | (old & ~m);
+  }
+  static uint16_t pick16(uint8_t m, uint16_t v, uint16_t old) {
+    uint16_t m16 = (int16_t)(int8_t)m;
+    return (v & m16) | (old & ~m16);
+  }
+
+  // S Z P and the fixed bit, without the table so it vectorizes
+  static uint8_t szp(uint8_t v) {
+    uint8_t p = v ^ v >> 4;
+    p ^= p >> 2;
+    p ^= p >> 1;
+    return (v & FLAG_S) | (v ? 0 : FLAG_Z) | (p & 1 ? 0 : FLAG_P) | FLAG_FIXED;
+  }
+
+  void bail(const char *why, uint16_t at) {
+    bailed = true;
+    bailReason = why;
+    bailPc = at;
+  }
+
+  int row(uint16_t a) {
+    int s = slotOf[a];
+    if (s >= 0) return s;
+    if ((int)rowAddr.size() == MAX_ROWS) {
+      bail("too many private addresses", a);
+      return 0;  // somewhere harmless to put it
+    }
+    s = rowAddr.size();
+    slotOf[a] = s;
+    rowAddr.push_back(a);
+    rows.resize(rows.size() + N, image[a]);
+    return s;
+  }
+
+  // the address in ad[] is the same in every active lane
+  bool uniform() const {
+    uint16_t at = ad[lead], diff = 0;
+    for (int i = 0; i < N; i++)
+      diff |= (ad[i] ^ at) & (int16_t)(int8_t)act[i];
+    return !diff;
+  }
+
+  // out[i] = memory at ad[i], for the active lanes
+  void load(uint8_t *out) {
+    if (uniform()) {
+      int s = slotOf[ad[lead]];
+      if (s < 0)
+        memset(out, image[ad[lead]], N);
+      else
+        memcpy(out, &rows[s * N], N);
+      return;
+    }
+    for (int i = 0; i < N; i++)
+      if (act[i]) out[i] = peek(i, ad[i]);
+  }
+
+  // memory at ad[i] = v[i], for the active lanes
+  void store(const uint8_t *v) {
+    if (uniform()) {
+      uint8_t *r = &rows[row(ad[lead]) * N];
+      for (int i = 0; i < N; i++) r[i] = pick(act[i], v[i], r[i]);
+      return;
+    }
+    for (int i = 0; i < N; i++)
+      if (act[i]) rows[row(ad[i]) * N + i] = v[i];
+  }
+
+  // the opcode at p (shared by the active lanes) and its operands into
+  // imm8 / imm16
+  bool fetch(uint16_t p, uint8_t &op) {
+    int s = slotOf[p];
+    op = s < 0 ? image[p] : rows[s * N + lead];
+    if (s >= 0)
+      for (int i = 0; i < N; i++)
+        if (act[i] && rows[s * N + i] != op) {
+          bail("lanes run different code", p);
+          return false;
+        }
+    // every active lane is at p, so no need to check the address is the
+    // same everywhere
+    int len = opInfo8085.len[op];
+    auto operand = [&](uint16_t a, uint8_t *out) {
+      int s = slotOf[a];
+      if (s < 0)
+        memset(out, image[a], N);
+      else
+        memcpy(out, &rows[s * N], N);
+    };
+    if (len > 2 && slotOf[(uint16_t)(p + 1)] < 0 &&
+        slotOf[(uint16_t)(p + 2)] < 0) {
+      // the usual case, both bytes shared
+      uint16_t v = image[(uint16_t)(p + 1)] | image[(uint16_t)(p + 2)] << 8;
+      memset(imm8, v & 0xFF, N);
+      for (int i = 0; i < N; i++) imm16[i] = v;
+      return true;
+    }
+    if (len > 1) operand(p + 1, imm8);
+    if (len > 2) {
+      operand(p + 2, t8);
+      for (int i = 0; i < N; i++) imm16[i] = imm8[i] | t8[i] << 8;
+    }
+    return true;
+  }
+
+  void pair(int rp, uint16_t *out) const {
+    if (rp == 3) {
+      memcpy(out, SP, sizeof(SP));
+      return;
+    }
+    const uint8_t *hi = R[2 * rp], *lo = R[2 * rp + 1];
+    for (int i = 0; i < N; i++) out[i] = hi[i] << 8 | lo[i];
+  }
+  void setPair(int rp, const uint16_t *v) {
+    if (rp == 3) {
+      for (int i = 0; i < N; i++) SP[i] = pick16(act[i], v[i], SP[i]);
+      return;
+    }
+    uint8_t *hi = R[2 * rp], *lo = R[2 * rp + 1];
+    for (int i = 0; i < N; i++) {
+      hi[i] = pick(act[i], v[i] >> 8, hi[i]);
+      lo[i] = pick(act[i], v[i], lo[i]);
+    }
+  }
+
+  // the M operand into row 6
+  void loadM() {
+    pair(2, ad);
+    load(R[6]);
+  }
+
+  void setPC(const uint16_t *v, const uint8_t *m) {
+    for (int i = 0; i < N; i++) PC[i] = pick16(m[i], v[i], PC[i]);
+  }
+  void advance(int len) {
+    for (int i = 0; i < N; i++) PC[i] += act[i] & len;
+  }
+
+  // lanes in act whose condition cc (NZ Z NC C PO PE P M) holds, into t8b
+  void condition(int cc) {
+    static const uint8_t bit[4] = {FLAG_Z, FLAG_CY, FLAG_P, FLAG_S};
+    uint8_t b = bit[cc >> 1], want = cc & 1 ? b : 0;
+    for (int i = 0; i < N; i++)
+      t8b[i] = act[i] & ((F[i] & b) == want ? 0xFF : 0);
+  }
+
+  // narrows act to the lanes in m for a push or pop, putting it back when
+  // it goes out of scope
+  struct Narrow {
+    Lanes8085 &x;
+    uint8_t saved[N];
+    int savedLead;
+
+    Narrow(Lanes8085 &x, const uint8_t *m) : x(x), savedLead(x.lead) {
+      memcpy(saved, x.act, N);
+      memcpy(x.act, m, N);
+      x.lead = -1;
+      for (int i = 0; i < N && x.lead < 0; i++)
+        if (x.act[i]) x.lead = i;
+    }
+    ~Narrow() {
+      memcpy(x.act, saved, N);
+      x.lead = savedLead;
+    }
+  };
+
+  // push v for the lanes in m
+  void push(const uint16_t *v, const uint8_t *m) {
+    Narrow only(*this, m);
+    if (lead >= 0) {
+      for (int i = 0; i < N; i++) ad[i] = SP[i] - 1, t8[i] = v[i] >> 8;
+      store(t8);
+      for (int i = 0; i < N; i++) ad[i] = SP[i] - 2, t8[i] = v[i];
+      store(t8);
+      for (int i = 0; i < N; i++) SP[i] -= act[i] & 2;
+    }
+  }
+
+  // pop into out for the lanes in m (the others get garbage)
+  void pop(uint16_t *out, const uint8_t *m) {
+    Narrow only(*this, m);
+    if (lead >= 0) {
+      for (int i = 0; i < N; i++) ad[i] = SP[i];
+      load(t8);
+      for (int i = 0; i < N; i++) ad[i] = SP[i] + 1;
+      load(t8b);
+      for (int i = 0; i < N; i++) {
+        out[i] = t8[i] | t8b[i] << 8;
+        SP[i] += act[i] & 2;
+      }
+    }
+  }
+
+  void alu(int k, const uint8_t *v) {
+    uint8_t *A = R[7];
+    switch (k) {
+      case 0:  // ADD, ADC
+      case 1: {
+        uint8_t cyMask = k == 1 ? FLAG_CY : 0;
+        for (int i = 0; i < N; i++) {
+          unsigned a = A[i], x = v[i];
+          unsigned r = a + x + (F[i] & cyMask);
+          uint8_t f = szp(r) | ((a ^ x ^ r) & FLAG_AC) | (r >> 8 & FLAG_CY);
+          A[i] = pick(act[i], r, A[i]);
+          F[i] = pick(act[i], f, F[i]);
+        }
+        break;
+      }
+      case 2:  // SUB, SBB, CMP
+      case 3:
+      case 7: {
+        uint8_t cyMask = k == 3 ? FLAG_CY : 0;
+        uint8_t keep = k == 7 ? 0 : 0xFF;
+        for (int i = 0; i < N; i++) {
+          unsigned a = A[i], x = v[i];
+          unsigned r = (a - x - (F[i] & cyMask)) & 0x1FF;
+          uint8_t f = szp(r) | ((a ^ x ^ r) & FLAG_AC) | (r >> 8 & FLAG_CY);
+          A[i] = pick(act[i] & keep, r, A[i]);
+          F[i] = pick(act[i], f, F[i]);
+        }
+        break;
+      }
+      case 4:  // ANA sets AC
+      case 5:
+      case 6:
+        for (int i = 0; i < N; i++) {
+          uint8_t r = k == 4 ? A[i] & v[i] : k == 5 ? A[i] ^ v[i] : A[i] | v[i];
+          uint8_t f = szp(r) | (k == 4 ? FLAG_AC : 0);
+          A[i] = pick(act[i], r, A[i]);
+          F[i] = pick(act[i], f, F[i]);
+        }
+        break;
+    }
+  }
+
+  void exec(uint8_t op, uint16_t p) {
+    int lo = op & 7, mid = op >> 3 & 7, rp = op >> 4 & 3;
+    uint8_t *A = R[7];
+
+    if (op == 0x76 || op == 0xCF) {  // HLT, RST 1: stop there
+      for (int i = 0; i < N; i++) {
+        if (!act[i]) continue;
+        running[i] = 0;
+        stoppedSome = true;
+        why[i] = op == 0x76 ? STOP_HALT : STOP_RST1;
+        PC[i] = p + 1;
+      }
+      return;
+    }
+    if (opInfo8085.cls[op] & OPC_ENDS_BLOCK && opInfo8085.len[op] == 1 &&
+        op < 0xC0) {  // the undocumented ones below C0
+      illegal(p);
+      return;
+    }
+
+    if (op >= 0x40 && op < 0x80) {  // MOV
+      if (lo == 6) loadM();
+      if (mid == 6) {
+        pair(2, ad);
+        store(R[lo]);
+      } else {
+        uint8_t *d = R[mid], *s = R[lo];
+        for (int i = 0; i < N; i++) d[i] = pick(act[i], s[i], d[i]);
+      }
+      advance(1);
+      return;
+    }
+    if (op >= 0x80 && op < 0xC0) {  // ALU r
+      if (lo == 6) loadM();
+      alu(mid, R[lo]);
+      advance(1);
+      return;
+    }
+
+    if (op < 0x40) {
+      switch (lo) {
+        case 0:  // NOP, RIM, SIM
+          if (op == 0x00) break;
+          bail("RIM/SIM", p);
+          return;
+        case 1:
+          if (mid & 1) {  // DAD
+            pair(rp, t16);
+            pair(2, ad);
+            for (int i = 0; i < N; i++) {
+              uint32_t r = ad[i] + t16[i];
+              imm16[i] = r;
+              F[i] = pick(act[i], (F[i] & ~FLAG_CY) | (r >> 16), F[i]);
+            }
+            setPair(2, imm16);
+          } else {  // LXI
+            setPair(rp, imm16);
+          }
+          break;
+        case 2:
+          switch (mid) {
+            case 0:  // STAX B, D
+            case 2:
+              pair(rp, ad);
+              store(A);
+              break;
+            case 1:  // LDAX B, D
+            case 3:
+              pair(rp, ad);
+              load(t8);
+              for (int i = 0; i < N; i++) A[i] = pick(act[i], t8[i], A[i]);
+              break;
+            case 4:  // SHLD
+              memcpy(ad, imm16, sizeof(ad));
+              store(R[5]);
+              for (int i = 0; i < N; i++) ad[i] = imm16[i] + 1;
+              store(R[4]);
+              break;
+            case 5:  // LHLD
+              memcpy(ad, imm16, sizeof(ad));
+              load(t8);
+              for (int i = 0; i < N; i++) ad[i] = imm16[i] + 1;
+              load(t8b);
+              for (int i = 0; i < N; i++) {
+                R[5][i] = pick(act[i], t8[i], R[5][i]);
+                R[4][i] = pick(act[i], t8b[i], R[4][i]);
+              }
+              break;
+            case 6:  // STA
+              memcpy(ad, imm16, sizeof(ad));
+              store(A);
+              break;
+            case 7:  // LDA
+              memcpy(ad, imm16, sizeof(ad));
+              load(t8);
+              for (int i = 0; i < N; i++) A[i] = pick(act[i], t8[i], A[i]);
+              break;
+          }
+          break;
+        case 3: {  // INX, DCX
+          pair(rp, t16);
+          uint16_t delta = mid & 1 ? 0xFFFF : 1;
+          for (int i = 0; i < N; i++) t16[i] += delta;
+          setPair(rp, t16);
+          break;
+        }
+        case 4:  // INR
+        case 5: {  // DCR
+          if (mid == 6) loadM();
+          uint8_t *x = R[mid];
+          uint8_t delta = lo == 4 ? 1 : 0xFF, half = lo == 4 ? 0x00 : 0x0F;
+          for (int i = 0; i < N; i++) {
+            uint8_t r = x[i] + delta;
+            uint8_t f = (F[i] & FLAG_CY) | szp(r) |
+                        ((r & 0x0F) == half ? FLAG_AC : 0);
+            x[i] = pick(act[i], r, x[i]);
+            F[i] = pick(act[i], f, F[i]);
+          }
+          if (mid == 6) {
+            pair(2, ad);
+            store(R[6]);
+          }
+          break;
+        }
+        case 6:  // MVI
+          if (mid == 6) {
+            pair(2, ad);
+            store(imm8);
+          } else {
+            uint8_t *d = R[mid];
+            for (int i = 0; i < N; i++) d[i] = pick(act[i], imm8[i], d[i]);
+          }
+          break;
+        case 7:
+          misc(mid);
+          break;
+      }
+      advance(opInfo8085.len[op]);
+      return;
+    }
+
+    // C0-FF
+    switch (lo) {
+      case 0: {  // Rcc
+        uint8_t taken[N];
+        condition(mid);
+        memcpy(taken, t8b, N);
+        pop(t16, taken);
+        for (int i = 0; i < N; i++) t16[i] = pick16(taken[i], t16[i], p + 1);
+        setPC(t16, act);
+        return;
+      }
+      case 1:
+        if (mid & 1) {
+          if (rp == 0) {  // RET
+            pop(t16, act);
+            setPC(t16, act);
+            return;
+          }
+          if (rp == 2) {  // PCHL
+            pair(2, t16);
+            setPC(t16, act);
+            return;
+          }
+          if (rp == 1) {
+            illegal(p);
+            return;
+          }
+          pair(2, t16);  // SPHL
+          setPair(3, t16);
+        } else {  // POP
+          pop(t16, act);
+          if (rp == 3) {
+            for (int i = 0; i < N; i++) {
+              A[i] = pick(act[i], t16[i] >> 8, A[i]);
+              F[i] = pick(act[i], (t16[i] & 0xD5) | FLAG_FIXED, F[i]);
+            }
+          } else {
+            setPair(rp, t16);
+          }
+        }
+        advance(1);
+        return;
+      case 2:  // Jcc
+        condition(mid);
+        for (int i = 0; i < N; i++) t16[i] = pick16(t8b[i], imm16[i], p + 3);
+        setPC(t16, act);
+        return;
+      case 3:
+        switch (mid) {
+          case 0:  // JMP
+            setPC(imm16, act);
+            return;
+          case 4: {  // XTHL
+            for (int i = 0; i < N; i++) ad[i] = SP[i];
+            load(t8);
+            store(R[5]);
+            for (int i = 0; i < N; i++) ad[i] = SP[i] + 1;
+            load(t8b);
+            store(R[4]);
+            for (int i = 0; i < N; i++) {
+              R[5][i] = pick(act[i], t8[i], R[5][i]);
+              R[4][i] = pick(act[i], t8b[i], R[4][i]);
+            }
+            break;
+          }
+          case 5:  // XCHG
+            for (int i = 0; i < N; i++) {
+              uint8_t h = R[4][i], l = R[5][i];
+              R[4][i] = pick(act[i], R[2][i], h);
+              R[5][i] = pick(act[i], R[3][i], l);
+              R[2][i] = pick(act[i], h, R[2][i]);
+              R[3][i] = pick(act[i], l, R[3][i]);
+            }
+            break;
+          case 1:  // undocumented
+            illegal(p);
+            return;
+          default:  // OUT, IN, DI, EI
+            bail("IN/OUT/EI/DI", p);
+            return;
+        }
+        advance(opInfo8085.len[op]);
+        return;
+      case 4:  // Ccc
+        condition(mid);
+        call(p, t8b);
+        return;
+      case 5:
+        if (mid & 1) {
+          if (rp != 0) {
+            illegal(p);
+            return;
+          }
+          call(p, act);  // CALL
+          return;
+        }
+        if (rp == 3) {  // PUSH PSW
+          for (int i = 0; i < N; i++) t16[i] = A[i] << 8 | F[i];
+        } else {
+          pair(rp, t16);
+        }
+        push(t16, act);
+        advance(1);
+        return;
+      case 6:  // ADI ... CPI
+        alu(mid, imm8);
+        advance(2);
+        return;
+      case 7: {  // RST n
+        for (int i = 0; i < N; i++) t16[i] = p + 1;
+        push(t16, act);
+        for (int i = 0; i < N; i++) t16[i] = mid * 8;
+        setPC(t16, act);
+        return;
+      }
+    }
+  }
+
+  // CALL for the lanes in m, the other active lanes go past it
+  void call(uint16_t p, const uint8_t *m) {
+    uint8_t taken[N];
+    memcpy(taken, m, N);
+    for (int i = 0; i < N; i++) t16[i] = p + 3;
+    push(t16, taken);
+    for (int i = 0; i < N; i++) t16[i] = pick16(taken[i], imm16[i], p + 3);
+    setPC(t16, act);
+  }
+
+  // 07 0F 17 1F 27 2F 37 3F
+  void misc(int mid) {
+    uint8_t *A = R[7];
+    for (int i = 0; i < N; i++) {
+      uint8_t a = A[i], f = F[i], cy = f & FLAG_CY, r = a, nf = f;
+      switch (mid) {
+        case 0:  // RLC
+          r = a << 1 | a >> 7;
+          nf = (f & ~FLAG_CY) | (r & 1);
+          break;
+        case 1:  // RRC
+          r = a >> 1 | a << 7;
+          nf = (f & ~FLAG_CY) | (a & 1);
+          break;
+        case 2:  // RAL
+          r = a << 1 | cy;
+          nf = (f & ~FLAG_CY) | a >> 7;
+          break;
+        case 3:  // RAR
+          r = a >> 1 | cy << 7;
+          nf = (f & ~FLAG_CY) | (a & 1);
+          break;
+        case 4: {  // DAA
+          uint8_t cor = 0, c = cy;
+          if ((a & 0x0F) > 9 || (f & FLAG_AC)) cor |= 0x06;
+          if (a > 0x99 || c) cor |= 0x60, c = 1;
+          r = a + cor;
+          nf = szp(r) | ((a ^ cor ^ r) & FLAG_AC) | c;
+          break;
+        }
+        case 5:  // CMA
+          r = ~a;
+          break;
+        case 6:  // STC
+          nf = f | FLAG_CY;
+          break;
+        case 7:  // CMC
+          nf = f ^ FLAG_CY;
+          break;
+      }
+      A[i] = pick(act[i], r, a);
+      F[i] = pick(act[i], nf, f);
+    }
+  }
+
+  // stops the lanes without counting the instruction in executed, as
+  // Cpu8085 does
+  void illegal(uint16_t p) {
+    for (int i = 0; i < N; i++) {
+      if (!act[i]) continue;
+      running[i] = 0;
+      stoppedSome = true;
+      why[i] = STOP_ILLEGAL;
+      PC[i] = p;
+      executed--;
+    }
+  }
+};
+
+#endif
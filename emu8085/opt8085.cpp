@@ -0,0 +1,1102 @@
+/*
+ * peephole optimizer and superoptimizer for 8085 sources
+ *
+ *   ./opt8085.out [--search N] [--inputs N] [-o DIR] FILE.asm|DIR ...
+ *
+ * works on the source: lines that aren't rewritten are copied as they are,
+ * and the result assembles with asm8085.h. rewrites, in this order:
+ *
+ *   - idioms: MOV r,r is dropped, so is MOV y,x right after MOV x,y, and
+ *     MVI A,00 becomes XRA A where no flag it sets is read before being
+ *     set again
+ *   - the repeated add multiply loop
+ *         L1: ADD r / JNC L2 / INR d / L2: DCR c / JNZ L1
+ *     (d:A += r * c, c = 0 counting 256) becomes a shift-and-add over the
+ *     bits of c. it leaves every register and flag as the loop did and
+ *     doesn't touch the stack: the registers are saved in seven bytes it
+ *     carries with it, so the only memory it writes is its own
+ *   - superoptimization: every run of up to 4 straight-line register-only
+ *     instructions (no memory, stack or branches) is replaced by the
+ *     cheapest sequence of up to N (--search, default 2, at most 3) such
+ *     instructions that leaves the same values in every register and flag
+ *     still live afterwards, if that takes fewer T-states
+ *
+ * a rewrite is only made once it has been checked by emulation over its
+ * whole input space. for a superoptimized window that is every value of
+ * the registers either sequence reads (windows reading more than two are
+ * skipped) and of CY; for the multiply it is every multiplicand and count,
+ * with three starting values of d:A. liveness comes from the assembled
+ * program: a stop (RST 1, HLT, running off the end), RET or CALL counts as
+ * reading everything.
+ *
+ * at the end the old and the new program are both run on --inputs random
+ * memory images (default 16) and must stop the same way with the same
+ * registers, flags and memory (all of it bar the program bytes). the
+ * shift-and-add is slower than the loop for counts below about 20, so the
+ * file is also tried without it and the faster of the two on those images
+ * is kept. the report gives the T-states saved by
+ * each rewrite and by the whole file; -o writes the new sources to DIR.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <set>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "asm8085.h"
+#include "cpu8085.h"
+
+namespace fs = std::filesystem;
+
+// ---------------------------------------------------------------------------
+// what each opcode reads and writes
+
+// registers by 8085 number (bit 6, M, unused), then CY, the other flags, SP
+const uint16_t L_CY = 1 << 8, L_FL = 1 << 9, L_SP = 1 << 10;
+const uint16_t L_ALL = 0x7BF;
+const uint8_t OTHER_FLAGS = FLAG_S | FLAG_Z | FLAG_AC | FLAG_P;
+const uint8_t ALL_FLAGS = OTHER_FLAGS | FLAG_CY;
+
+const char regName[] = "BCDEHLMA";
+const char *const pairName[] = {"B", "D", "H", "SP"};
+
+struct Effect {
+  int use, def;
+};
+
+uint16_t pairBits(int rp) { return rp == 3 ? L_SP : 3 << (rp * 2); }
+
+bool isJump(uint8_t op) { return op == 0xC3 || (op >= 0xC0 && (op & 7) == 2); }
+bool isCall(uint8_t op) { return op == 0xCD || (op >= 0xC0 && (op & 7) == 4); }
+bool isCond(uint8_t op) {
+  return op >= 0xC0 && ((op & 7) == 0 || (op & 7) == 2 || (op & 7) == 4);
+}
+
+// memory isn't tracked: nothing here is moved across a load or store
+Effect effect(uint8_t op) {
+  Effect e{0, 0};
+  int lo = op & 7, mid = op >> 3 & 7, rp = op >> 4 & 3;
+  auto src = [&](int r) { e.use |= r == 6 ? 0x30 : 1 << r; };
+  auto dst = [&](int r) {
+    if (r == 6)
+      e.use |= 0x30;
+    else
+      e.def |= 1 << r;
+  };
+
+  if (op == 0x76) return {L_ALL, 0};  // HLT
+  if (op >= 0x40 && op < 0x80) {      // MOV
+    src(lo);
+    dst(mid);
+    return e;
+  }
+  if (op >= 0x80 && op < 0xC0) {  // ALU r
+    src(lo);
+    src(7);
+    if (mid == 1 || mid == 3) e.use |= L_CY;
+    if (mid != 7) e.def |= 1 << 7;
+    e.def |= L_CY | L_FL;
+    return e;
+  }
+  if (op < 0x40) {
+    switch (lo) {
+      case 0:
+        if (op == 0x20) e.def |= 1 << 7;  // RIM
+        if (op == 0x30) e.use |= 1 << 7;  // SIM
+        return e;
+      case 1:
+        if (op & 8) {  // DAD
+          e.use = pairBits(2) | pairBits(rp);
+          e.def = pairBits(2) | L_CY;
+        } else {  // LXI
+          e.def = pairBits(rp);
+        }
+        return e;
+      case 2:
+        if (op == 0x22) e.use = pairBits(2);        // SHLD
+        if (op == 0x2A) e.def = pairBits(2);        // LHLD
+        if (op == 0x32) e.use = 1 << 7;             // STA
+        if (op == 0x3A) e.def = 1 << 7;             // LDA
+        if (op < 0x20 && !(op & 8)) e.use = pairBits(rp) | 1 << 7;  // STAX
+        if (op < 0x20 && (op & 8)) {                                // LDAX
+          e.use = pairBits(rp);
+          e.def = 1 << 7;
+        }
+        return e;
+      case 3:  // INX, DCX
+        e.use = e.def = pairBits(rp);
+        return e;
+      case 4:
+      case 5:  // INR, DCR
+        src(mid);
+        dst(mid);
+        e.def |= L_FL;
+        return e;
+      case 6:  // MVI
+        dst(mid);
+        return e;
+      case 7:
+        switch (op) {
+          case 0x07:
+          case 0x0F:  // RLC, RRC
+            return {1 << 7, 1 << 7 | L_CY};
+          case 0x17:
+          case 0x1F:  // RAL, RAR
+            return {1 << 7 | L_CY, 1 << 7 | L_CY};
+          case 0x27:  // DAA
+            return {1 << 7 | L_CY | L_FL, 1 << 7 | L_CY | L_FL};
+          case 0x2F:  // CMA
+            return {1 << 7, 1 << 7};
+          case 0x37:  // STC
+            return {0, L_CY};
+          case 0x3F:  // CMC
+            return {L_CY, L_CY};
+        }
+    }
+  }
+
+  // 0xC0 and up
+  if (lo == 6) {  // ALU immediate
+    e.use = 1 << 7;
+    if (mid == 1 || mid == 3) e.use |= L_CY;
+    e.def = L_CY | L_FL;
+    if (mid != 7) e.def |= 1 << 7;
+    return e;
+  }
+  if (lo == 2 && op != 0xC3 && op != 0xCB) {  // Jcc
+    e.use = (op >> 4 & 3) == 1 ? L_CY : L_FL;
+    return e;
+  }
+  switch (op) {
+    case 0xC3:  // JMP
+    case 0xF3:  // DI
+    case 0xFB:  // EI
+      return e;
+    case 0xD3:  // OUT
+      return {1 << 7, 0};
+    case 0xDB:  // IN
+      return {0, 1 << 7};
+    case 0xEB:  // XCHG
+      return {pairBits(1) | pairBits(2), pairBits(1) | pairBits(2)};
+    case 0xE3:  // XTHL
+      return {pairBits(2) | L_SP, pairBits(2)};
+    case 0xF9:  // SPHL
+      return {pairBits(2), L_SP};
+    case 0xF5:  // PUSH PSW
+      return {1 << 7 | L_CY | L_FL | L_SP, L_SP};
+    case 0xF1:  // POP PSW
+      return {L_SP, 1 << 7 | L_CY | L_FL | L_SP};
+  }
+  if (lo == 5 && !(op & 8)) return {pairBits(rp) | L_SP, L_SP};  // PUSH
+  if (lo == 1 && !(op & 8)) return {L_SP, pairBits(rp) | L_SP};  // POP
+
+  // returns, calls, RST, PCHL and the undocumented opcodes
+  return {L_ALL, 0};
+}
+
+// ---------------------------------------------------------------------------
+// running code
+
+// T-states of one instruction that went from pc to next
+int tstatesOf(uint8_t op, uint16_t pc, uint16_t next) {
+  bool taken = isCond(op) && next != (uint16_t)(pc + opInfo8085.len[op]);
+  return taken ? opInfo8085.tstatesTaken[op] : opInfo8085.tstates[op];
+}
+
+// cpu.run with T-states counted
+Stop8085 timedRun(Cpu8085 &cpu, uint64_t limit, uint64_t &t) {
+  t = 0;
+  while (limit--) {
+    uint16_t pc = cpu.r.pc;
+    uint8_t op = cpu.mem[pc];
+    Stop8085 why = cpu.step();
+    t += tstatesOf(op, pc, cpu.r.pc);
+    if (why != STOP_BUDGET) return why;
+  }
+  return STOP_BUDGET;
+}
+
+bool sameLive(const Regs8085 &a, const Regs8085 &b, uint16_t live) {
+  const uint8_t ra[8] = {a.b, a.c, a.d, a.e, a.h, a.l, 0, a.a};
+  const uint8_t rb[8] = {b.b, b.c, b.d, b.e, b.h, b.l, 0, b.a};
+  for (int r = 0; r < 8; r++)
+    if (live >> r & 1 && ra[r] != rb[r]) return false;
+  if (live & L_CY && (a.f ^ b.f) & FLAG_CY) return false;
+  if (live & L_FL && (a.f ^ b.f) & OTHER_FLAGS) return false;
+  if (live & L_SP && a.sp != b.sp) return false;
+  return true;
+}
+
+// ---------------------------------------------------------------------------
+// the source
+
+struct Line {
+  std::string text;
+  int addr = -1;  // -1 if not an instruction
+  uint8_t bytes[3] = {0, 0, 0};
+  uint8_t len = 0;
+  std::string label;
+  uint16_t liveOut = 0;
+};
+
+bool readFile(const fs::path &path, std::string &out) {
+  std::ifstream in(path, std::ios::binary);
+  if (!in) return false;
+  std::ostringstream ss;
+  ss << in.rdbuf();
+  out = ss.str();
+  return true;
+}
+
+// the label a source line starts with, if any
+std::string labelOf(const std::string &line) {
+  size_t colon = line.find(':');
+  if (colon == std::string::npos) return "";
+  size_t b = line.find_first_not_of(" \t");
+  std::string s = b < colon ? line.substr(b, colon - b) : "";
+  return s.find_first_of(" \t;") == std::string::npos ? s : "";
+}
+
+std::string hex2(int v) {
+  char buf[8];
+  snprintf(buf, sizeof(buf), "%02X", v & 0xFF);
+  return buf;
+}
+
+std::string hex4(int v) {
+  char buf[8];
+  snprintf(buf, sizeof(buf), "%04X", v & 0xFFFF);
+  return buf;
+}
+
+class Program {
+ public:
+  std::vector<Line> lines;  // lines[0] is empty so indexes are line numbers
+  std::unordered_map<uint16_t, int> lineAt;
+  std::unique_ptr<Assembler8085> as = std::make_unique<Assembler8085>();
+
+  bool load(const std::string &src, const std::string &name) {
+    if (!as->assemble(src, name)) return false;
+    lines.assign(1, Line());
+    std::istringstream in(src);
+    for (std::string l; std::getline(in, l);) {
+      if (!l.empty() && l.back() == '\r') l.pop_back();
+      lines.emplace_back();
+      lines.back().text = l;
+      lines.back().label = labelOf(l);
+    }
+    for (auto &[n, addr] : as->insnLines()) {
+      Line &l = lines[n];
+      l.addr = addr;
+      l.len = opInfo8085.len[as->image[addr]];
+      for (int i = 0; i < l.len; i++)
+        l.bytes[i] = as->image[(uint16_t)(addr + i)];
+      lineAt[addr] = n;
+    }
+    liveness();
+    return true;
+  }
+
+  // the next instruction line after n, 0 if none
+  int nextInsn(int n) const {
+    for (n++; n < (int)lines.size(); n++)
+      if (lines[n].addr >= 0) return n;
+    return 0;
+  }
+
+  uint16_t target(const Line &l) const { return l.bytes[1] | l.bytes[2] << 8; }
+
+  // true if some branch or call other than those on lines `except` goes to
+  // an address in [lo, hi]
+  bool targeted(uint16_t lo, uint16_t hi, const std::set<int> &except) const {
+    for (size_t n = 1; n < lines.size(); n++) {
+      const Line &l = lines[n];
+      if (l.addr < 0 || except.count(n)) continue;
+      uint8_t op = l.bytes[0];
+      if ((isJump(op) || isCall(op)) && target(l) >= lo && target(l) <= hi)
+        return true;
+    }
+    return false;
+  }
+
+ private:
+  void liveness() {
+    std::vector<uint16_t> liveIn(lines.size());
+    auto in = [&](uint16_t addr) -> uint16_t {
+      auto it = lineAt.find(addr);
+      return it == lineAt.end() ? L_ALL : liveIn[it->second];
+    };
+    for (bool changed = true; changed;) {
+      changed = false;
+      for (size_t n = lines.size(); n-- > 1;) {
+        Line &l = lines[n];
+        if (l.addr < 0) continue;
+        uint8_t op = l.bytes[0];
+        Effect e = effect(op);
+        uint16_t next = l.addr + l.len, out = 0;
+        if (e.use != L_ALL || isCall(op)) {
+          if (op != 0xC3) out |= in(next);
+          if (isJump(op)) out |= in(target(l));
+        }
+        uint16_t li = e.use | (out & ~e.def);
+        if (li != liveIn[n] || out != l.liveOut) changed = true;
+        liveIn[n] = li;
+        l.liveOut = out;
+      }
+    }
+  }
+};
+
+// ---------------------------------------------------------------------------
+// rewrites
+
+struct Rewrite {
+  int first, last;  // lines, inclusive
+  std::vector<std::string> code;
+  std::string what;
+  std::string saving;
+};
+
+std::string insnText(const Line &l) {
+  size_t start = 0;
+  if (!l.label.empty()) start = l.text.find(':') + 1;
+  std::string s = l.text.substr(start);
+  size_t cut = std::min(s.find(';'), s.find("//"));
+  if (cut != std::string::npos) s = s.substr(0, cut);
+  size_t b = s.find_first_not_of(" \t"), e = s.find_last_not_of(" \t");
+  return b == std::string::npos ? "" : s.substr(b, e - b + 1);
+}
+
+void idioms(const Program &p, std::vector<Rewrite> &out) {
+  for (size_t n = 1; n < p.lines.size(); n++) {
+    const Line &l = p.lines[n];
+    if (l.addr < 0) continue;
+    uint8_t op = l.bytes[0];
+    int lo = op & 7, mid = op >> 3 & 7;
+
+    if (op >= 0x40 && op < 0x80 && op != 0x76 && lo == mid) {
+      out.push_back({(int)n, (int)n, {}, "MOV r,r dropped", "4 T"});
+      continue;
+    }
+    int prev = 0;
+    for (int k = n - 1; k > 0; k--)
+      if (p.lines[k].addr >= 0) {
+        prev = k;
+        break;
+      }
+    if (prev && l.label.empty() && op >= 0x40 && op < 0x80 && op != 0x76) {
+      uint8_t pop = p.lines[prev].bytes[0];
+      bool movedBack = pop >= 0x40 && pop < 0x80 && pop != 0x76 &&
+                       (pop & 7) == mid && (pop >> 3 & 7) == lo;
+      bool between = false;  // another rewrite already touches prev
+      for (auto &r : out) between |= r.last == prev;
+      if (movedBack && !between) {
+        out.push_back({(int)n, (int)n, {},
+                       "MOV back after line " + std::to_string(prev) +
+                           " dropped",
+                       std::to_string(opInfo8085.tstates[op]) + " T"});
+        continue;
+      }
+    }
+    if (op == 0x3E && l.bytes[1] == 0 && !(l.liveOut & (L_CY | L_FL)))
+      out.push_back({(int)n, (int)n, {"XRA A"}, "MVI A,00 -> XRA A", "3 T"});
+  }
+}
+
+// d:A += r * c by shift-and-add, without the stack: A and B..L are saved
+// in seven bytes of its own (TAG_S, jumped over) and read back from there;
+// HL accumulates d:A, DE holds r shifted left and A the bits of c left to
+// go. the results go into the saved copies, which are loaded back, and a
+// DCR of c from 1 leaves the flags the loop's last DCR did, with CY from a
+// compare standing in for the last ADD. the only memory written is TAG_S,
+// which is part of the program
+std::vector<std::string> mulCode(int r, int d, int c, const std::string &tag) {
+  // SHLD stores L then H: the slots are C B E D L H A
+  static const int off[8] = {1, 0, 3, 2, 5, 4, -1, 6};
+  std::string S = tag + "_S", B = tag + "_B", L = tag + "_L",
+              N = tag + "_N", D = tag + "_D";
+  auto slot = [&](int reg) { return S + "+" + std::to_string(off[reg]); };
+  return {"JMP " + B, S + ":DB 00,00,00,00,00,00,00",
+          B + ":STA " + slot(7), "SHLD " + slot(5), "XCHG",
+          "SHLD " + slot(3), "MOV H,B", "MOV L,C", "SHLD " + slot(1),
+          // r -> E, d:A -> HL, c -> A
+          "LDA " + slot(r), "MOV E,A", "MVI D,00", "LDA " + slot(d),
+          "MOV H,A", "LDA " + slot(7), "MOV L,A", "LDA " + slot(c),
+          "ORA A", "JNZ " + L,
+          // c = 0 counts 256: d:A += r << 8
+          "MOV A,H", "ADD E", "MOV H,A", "JMP " + D,
+          L + ":RAR", "JNC " + N, "DAD D",
+          N + ":XCHG", "DAD H", "XCHG", "ORA A", "JNZ " + L,
+          D + ":MOV A,H", "STA " + slot(d), "MOV A,L", "STA " + slot(7),
+          "MVI A,01", "STA " + slot(c),
+          // the last ADD carried iff the low byte came out below r
+          "LDA " + slot(r), "MOV E,A", "MOV A,L", "CMP E",
+          // none of these touch the flags
+          "LHLD " + slot(1), "MOV B,H", "MOV C,L", "LHLD " + slot(3),
+          "XCHG", "LHLD " + slot(5), "LDA " + slot(7),
+          std::string("DCR ") + regName[c]};
+}
+
+// assembles `code` (one statement per entry, "LABEL:" glued on) followed
+// by RST 1
+bool assembleSnippet(Assembler8085 &as, const std::vector<std::string> &code) {
+  std::string src;
+  for (auto &c : code) {
+    size_t colon = c.find(':');
+    if (colon == std::string::npos)
+      src += "\t" + c;
+    else
+      src += c.substr(0, colon + 1) + "\t" + c.substr(colon + 1);
+    src += "\n";
+  }
+  src += "\tRST 1\n";
+  return as.assemble(src, "snippet");
+}
+
+// every r and count, three starting d:A. before/after get the worst
+// T-states per count over 16 values of r
+bool checkMul(const std::vector<std::string> &oldCode,
+              const std::vector<std::string> &newCode, int r, int d, int c,
+              std::vector<uint64_t> &before, std::vector<uint64_t> &after) {
+  auto as = std::make_unique<Assembler8085>();
+  auto a = std::make_unique<Cpu8085>(), b = std::make_unique<Cpu8085>();
+  if (!assembleSnippet(*as, oldCode)) return false;
+  memcpy(a->mem, as->image, 0x10000);
+  if (!assembleSnippet(*as, newCode)) return false;
+  memcpy(b->mem, as->image, 0x10000);
+
+  before.assign(256, 0);
+  after.assign(256, 0);
+  std::mt19937 rng(8085);
+  static const uint8_t start[3][2] = {{0x00, 0x00}, {0x7F, 0x80}, {0xFF, 0xFF}};
+  for (int n = 0; n < 256; n++)
+    for (int m = 0; m < 256; m++)
+      for (auto &st : start) {
+        Regs8085 in;
+        uint8_t regs[8];
+        for (auto &v : regs) v = rng();
+        regs[r] = m;
+        regs[c] = n;
+        regs[d] = st[1];
+        regs[7] = st[0];
+        in.b = regs[0], in.c = regs[1], in.d = regs[2], in.e = regs[3];
+        in.h = regs[4], in.l = regs[5], in.a = regs[7];
+        in.f = (rng() & (ALL_FLAGS)) | FLAG_FIXED;
+        in.sp = 0xF000;
+        in.pc = 0;
+        a->r = in;
+        b->r = in;
+        if (a->run(10000) != STOP_RST1 || b->run(10000) != STOP_RST1 ||
+            !sameLive(a->r, b->r, L_ALL) || a->r.f != b->r.f)
+          return false;
+        if (m % 17 || &st != start) continue;
+
+        // timed again on 16 of the multiplicands, stepping is slow
+        uint64_t ta, tb;
+        a->r = in;
+        b->r = in;
+        timedRun(*a, 10000, ta);
+        timedRun(*b, 10000, tb);
+        before[n] = std::max(before[n], ta);
+        after[n] = std::max(after[n], tb);
+      }
+  return true;
+}
+
+void multiplies(const Program &p, std::vector<Rewrite> &out) {
+  int tags = 0;
+  for (size_t n = 1; n < p.lines.size(); n++) {
+    int ln[5] = {(int)n};
+    for (int i = 1; i < 5; i++) ln[i] = ln[i - 1] ? p.nextInsn(ln[i - 1]) : 0;
+    if (p.lines[n].addr < 0 || !ln[4]) continue;
+    const Line *l[5];
+    for (int i = 0; i < 5; i++) l[i] = &p.lines[ln[i]];
+
+    uint8_t add = l[0]->bytes[0], inr = l[2]->bytes[0], dcr = l[3]->bytes[0];
+    int r = add & 7, d = inr >> 3 & 7, c = dcr >> 3 & 7;
+    bool shape = (add & 0xF8) == 0x80 && l[1]->bytes[0] == 0xD2 &&
+                 p.target(*l[1]) == l[3]->addr && (inr & 0xC7) == 0x04 &&
+                 (dcr & 0xC7) == 0x05 && l[4]->bytes[0] == 0xC2 &&
+                 p.target(*l[4]) == l[0]->addr;
+    if (!shape || r >= 6 || d >= 6 || c >= 6 || r == d || r == c || d == c)
+      continue;
+    // the first line keeps its label, so only jumps into the middle matter
+    if (p.targeted(l[0]->addr + 1, l[4]->addr, {ln[1]})) continue;
+    bool labelsInside = false;
+    for (int k = ln[0] + 1; k <= ln[4]; k++)
+      if (!p.lines[k].label.empty() && k != ln[3]) labelsInside = true;
+    if (labelsInside) continue;
+
+    // labels of the new code are TAG_L, TAG_N, TAG_D
+    std::string tag;
+    for (bool clash = true; clash;) {
+      tag = "MUL" + std::to_string(++tags);
+      clash = false;
+      for (auto &x : p.lines) clash |= x.label.rfind(tag + "_", 0) == 0;
+    }
+
+    std::vector<std::string> oldCode;
+    for (int i = 0; i < 5; i++) {
+      std::string t = insnText(*l[i]);
+      if (i == 1) t = "JNC X_C";
+      if (i == 4) t = "JNZ X_L";
+      if (i == 0) t = "X_L:" + t;
+      if (i == 3) t = "X_C:" + t;
+      oldCode.push_back(t);
+    }
+    std::vector<std::string> code = mulCode(r, d, c, tag);
+    std::vector<uint64_t> before, after;
+    if (!checkMul(oldCode, code, r, d, c, before, after)) {
+      printf("  lines %d-%d: shift-and-add doesn't match the loop, kept\n",
+             ln[0], ln[4]);
+      continue;
+    }
+    // worst T-states at a few counts, and the count it starts to pay from
+    std::string saving;
+    for (int k : {1, 16, 255}) {
+      saving += std::to_string(k) + " times " + std::to_string(before[k]) +
+                " -> " + std::to_string(after[k]) + " T, ";
+    }
+    int from = 1;
+    while (from < 255 && after[from] >= before[from]) from++;
+    saving += "less from " + std::to_string(from) + " times on";
+    out.push_back({ln[0], ln[4], code,
+                   std::string("multiply loop (ADD ") + regName[r] +
+                       ", INR " + regName[d] + ", DCR " + regName[c] +
+                       ") -> shift-and-add",
+                   saving});
+    n = ln[4];
+  }
+}
+
+// ---------------------------------------------------------------------------
+// superoptimizer
+
+struct Seq {
+  uint8_t code[12];
+  uint8_t bytes, insns;
+  uint16_t t;
+};
+
+bool registerOnly(uint8_t op) {
+  int lo = op & 7, mid = op >> 3 & 7, rp = op >> 4 & 3;
+  if (op >= 0x40 && op < 0x80) return lo != 6 && mid != 6;
+  if (op >= 0x80 && op < 0xC0) return lo != 6;
+  if (op >= 0xC0) return lo == 6 || op == 0xEB;
+  switch (lo) {
+    case 0:
+      return op == 0x00;
+    case 1:
+    case 3:
+      return rp != 3;
+    case 4:
+    case 5:
+    case 6:
+      return mid != 6;
+    case 7:
+      return op != 0x27;
+  }
+  return false;
+}
+
+std::string seqText(const uint8_t *c, int insns,
+                    std::vector<std::string> *out) {
+  static const char *const alu[8] = {"ADD", "ADC", "SUB", "SBB",
+                                     "ANA", "XRA", "ORA", "CMP"};
+  static const char *const alui[8] = {"ADI", "ACI", "SUI", "SBI",
+                                      "ANI", "XRI", "ORI", "CPI"};
+  std::string all;
+  for (int i = 0; i < insns; i++) {
+    uint8_t op = *c;
+    int lo = op & 7, mid = op >> 3 & 7, rp = op >> 4 & 3;
+    std::string s;
+    if (op >= 0x40 && op < 0x80)
+      s = std::string("MOV ") + regName[mid] + "," + regName[lo];
+    else if (op >= 0x80 && op < 0xC0)
+      s = std::string(alu[mid]) + " " + regName[lo];
+    else if (op >= 0xC0 && lo == 6)
+      s = std::string(alui[mid]) + " " + hex2(c[1]);
+    else if (op == 0xEB)
+      s = "XCHG";
+    else if (op == 0x00)
+      s = "NOP";
+    else if (lo == 1)
+      s = (op & 8) ? std::string("DAD ") + pairName[rp]
+                   : std::string("LXI ") + pairName[rp] + "," +
+                         hex4(c[1] | c[2] << 8);
+    else if (lo == 3)
+      s = std::string(op & 8 ? "DCX " : "INX ") + pairName[rp];
+    else if (lo == 4 || lo == 5)
+      s = std::string(lo == 4 ? "INR " : "DCR ") + regName[mid];
+    else if (lo == 6)
+      s = std::string("MVI ") + regName[mid] + "," + hex2(c[1]);
+    else {
+      static const char *const rot[8] = {"RLC", "RRC", "RAL", "RAR",
+                                         "DAA", "CMA", "STC", "CMC"};
+      s = rot[mid];
+    }
+    if (out) out->push_back(s);
+    all += (i ? " / " : "") + s;
+    c += opInfo8085.len[op];
+  }
+  return all.empty() ? "nothing" : all;
+}
+
+class Superopt {
+ public:
+  int maxLen;
+
+  explicit Superopt(int maxLen) : maxLen(maxLen) {}
+
+  // the cheapest replacement of `win` (register-only), or false
+  bool best(const Seq &win, uint16_t liveOut, Seq &found) {
+    std::vector<uint8_t> consts = {0x00, 0x01, 0xFF};
+    std::vector<uint16_t> words;
+    for (const uint8_t *c = win.code; c < win.code + win.bytes;
+         c += opInfo8085.len[*c]) {
+      if (opInfo8085.len[*c] == 2) consts.push_back(c[1]);
+      if (opInfo8085.len[*c] == 3) {
+        consts.push_back(c[1]);
+        consts.push_back(c[2]);
+        words.push_back(c[1] | c[2] << 8);
+      }
+    }
+    std::sort(consts.begin(), consts.end());
+    consts.erase(std::unique(consts.begin(), consts.end()), consts.end());
+    for (uint8_t h : consts)
+      for (uint8_t l : consts) words.push_back(h << 8 | l);
+    std::sort(words.begin(), words.end());
+    words.erase(std::unique(words.begin(), words.end()), words.end());
+
+    std::vector<Seq> alphabet;
+    for (int op = 0; op < 256; op++) {
+      if (!registerOnly(op)) continue;
+      int len = opInfo8085.len[op];
+      if (len == 1) {
+        if (op != 0x00) alphabet.push_back({{(uint8_t)op}, 1, 1, 0});
+      } else if (len == 2) {
+        for (uint8_t k : consts)
+          alphabet.push_back({{(uint8_t)op, k}, 2, 1, 0});
+      } else {
+        for (uint16_t w : words)
+          alphabet.push_back(
+              {{(uint8_t)op, (uint8_t)w, (uint8_t)(w >> 8)}, 3, 1, 0});
+      }
+    }
+    for (auto &s : alphabet) s.t = opInfo8085.tstates[s.code[0]];
+
+    // everything cheaper than the window, cheapest first
+    std::vector<Seq> cands{{{0}, 0, 0, 0}};
+    std::vector<Seq> frontier = cands;
+    for (int len = 1; len <= maxLen; len++) {
+      std::vector<Seq> next;
+      for (auto &f : frontier)
+        for (auto &a : alphabet) {
+          Seq s = f;
+          if (s.t + a.t >= win.t) continue;
+          memcpy(s.code + s.bytes, a.code, a.bytes);
+          s.bytes += a.bytes;
+          s.insns++;
+          s.t += a.t;
+          next.push_back(s);
+        }
+      cands.insert(cands.end(), next.begin(), next.end());
+      frontier.swap(next);
+    }
+    std::stable_sort(cands.begin(), cands.end(), [](const Seq &a,
+                                                    const Seq &b) {
+      return a.t != b.t ? a.t < b.t : a.bytes < b.bytes;
+    });
+
+    // random states to throw most candidates out quickly
+    std::mt19937 rng(win.t * 131 + win.bytes);
+    Regs8085 tests[16], want[16];
+    for (int i = 0; i < 16; i++) {
+      tests[i] = randomRegs(rng);
+      want[i] = exec(win, tests[i]);
+    }
+    uint16_t winUse = exposed(win);
+    for (auto &c : cands) {
+      bool ok = true;
+      for (int i = 0; i < 16 && ok; i++)
+        ok = sameLive(exec(c, tests[i]), want[i], liveOut);
+      if (!ok) continue;
+      if (exhaustive(win, c, winUse | exposed(c), liveOut)) {
+        found = c;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // registers and flags the sequence reads before writing
+  static uint16_t exposed(const Seq &s) {
+    uint16_t use = 0, def = 0;
+    for (const uint8_t *c = s.code; c < s.code + s.bytes;
+         c += opInfo8085.len[*c]) {
+      Effect e = effect(*c);
+      use |= e.use & ~def;
+      def |= e.def;
+    }
+    return use;
+  }
+
+ private:
+  std::unique_ptr<Cpu8085> cpu = std::make_unique<Cpu8085>();
+
+  static Regs8085 randomRegs(std::mt19937 &rng) {
+    Regs8085 r;
+    r.b = rng(), r.c = rng(), r.d = rng(), r.e = rng();
+    r.h = rng(), r.l = rng(), r.a = rng();
+    r.f = (rng() & ALL_FLAGS) | FLAG_FIXED;
+    r.sp = rng();
+    r.pc = 0;
+    return r;
+  }
+
+  Regs8085 exec(const Seq &s, Regs8085 r) {
+    memcpy(cpu->mem, s.code, s.bytes);
+    cpu->r = r;
+    cpu->runSwitch(s.insns);
+    return cpu->r;
+  }
+
+  // every value of the inputs, up to two registers and CY; the registers
+  // neither reads get two different fills
+  bool exhaustive(const Seq &a, const Seq &b, uint16_t in, uint16_t live) {
+    std::vector<int> regs;
+    for (int r = 0; r < 8; r++)
+      if (in >> r & 1) regs.push_back(r);
+    if (regs.size() > 2) return false;
+    uint32_t n = 1u << (8 * regs.size() + (in & L_CY ? 1 : 0));
+    std::mt19937 rng(1);
+    for (int fill = 0; fill < 2; fill++) {
+      Regs8085 base = randomRegs(rng);
+      for (uint32_t v = 0; v < n; v++) {
+        Regs8085 r = base;
+        uint8_t *p[8] = {&r.b, &r.c, &r.d, &r.e, &r.h, &r.l, nullptr, &r.a};
+        uint32_t x = v;
+        for (int reg : regs) {
+          *p[reg] = x;
+          x >>= 8;
+        }
+        if (in & L_CY) r.f = (r.f & ~FLAG_CY) | (x & 1 ? FLAG_CY : 0);
+        if (!sameLive(exec(a, r), exec(b, r), live)) return false;
+      }
+    }
+    return true;
+  }
+};
+
+void superoptimize(const Program &p, Superopt &so,
+                   std::vector<Rewrite> &out) {
+  std::vector<bool> taken(p.lines.size());
+  for (auto &r : out)
+    for (int k = r.first; k <= r.last; k++) taken[k] = true;
+
+  std::vector<Rewrite> found;
+  for (int n = p.nextInsn(0); n;) {
+    // the longest window from n that pays, up to 4 instructions
+    Rewrite best{0, 0, {}, "", ""};
+    int bestSaved = 0, bestEnd = n;
+    Seq win{{0}, 0, 0, 0};
+    for (int k = n, len = 0; k && len < 4; k = p.nextInsn(k), len++) {
+      const Line &l = p.lines[k];
+      if (taken[k] || !registerOnly(l.bytes[0]) ||
+          (k != n && !l.label.empty()))
+        break;
+      memcpy(win.code + win.bytes, l.bytes, l.len);
+      win.bytes += l.len;
+      win.insns++;
+      win.t += opInfo8085.tstates[l.bytes[0]];
+
+      uint16_t in = Superopt::exposed(win);
+      int regs = 0;
+      for (int r = 0; r < 8; r++) regs += in >> r & 1;
+      if (regs > 2) break;
+
+      Seq s;
+      if (!so.best(win, l.liveOut, s) || win.t - s.t <= bestSaved) continue;
+      bestSaved = win.t - s.t;
+      bestEnd = k;
+      best = {n, k, {}, "", ""};
+      std::string from = seqText(win.code, win.insns, nullptr);
+      std::string to = seqText(s.code, s.insns, &best.code);
+      best.what = from + " -> " + to;
+      best.saving = std::to_string(bestSaved) + " T";
+    }
+    if (bestSaved) {
+      found.push_back(best);
+      n = p.nextInsn(bestEnd);
+    } else {
+      n = p.nextInsn(n);
+    }
+  }
+  out.insert(out.end(), found.begin(), found.end());
+}
+
+// ---------------------------------------------------------------------------
+// putting it together
+
+// the whitespace before the instruction on l (after its label, if any),
+// so new code is indented like the line it replaces
+std::string indentOf(const Line &l) {
+  size_t at = l.label.empty() ? 0 : l.text.find(':') + 1;
+  size_t end = l.text.find_first_not_of(" \t", at);
+  return l.text.substr(at, end == std::string::npos ? end : end - at);
+}
+
+std::string rewritten(const Program &p, std::vector<Rewrite> rw) {
+  std::sort(rw.begin(), rw.end(), [](const Rewrite &a, const Rewrite &b) {
+    return a.first < b.first;
+  });
+  std::string out;
+  size_t next = 0;
+  for (size_t n = 1; n < p.lines.size(); n++) {
+    if (next < rw.size() && rw[next].first == (int)n) {
+      const Rewrite &r = rw[next++];
+      const Line &l = p.lines[n];
+      std::string label = l.label.empty() ? "" : l.label + ":";
+      std::string indent = indentOf(l);
+      if (r.code.empty() && !label.empty()) out += label + "\n";
+      for (size_t i = 0; i < r.code.size(); i++) {
+        std::string c = r.code[i], lab = i ? "" : label;
+        size_t colon = c.find(':');
+        if (colon != std::string::npos) {
+          if (i == 0 && !label.empty()) out += label + "\n";
+          lab = c.substr(0, colon + 1);
+          c = c.substr(colon + 1);
+        }
+        // a label still needs something between it and the instruction
+        out += lab + (lab.empty() || !indent.empty() ? indent : " ") + c +
+               "\n";
+      }
+      n = r.last;
+      continue;
+    }
+    out += p.lines[n].text + "\n";
+  }
+  return out;
+}
+
+// runs the program on a random image; false if it didn't stop
+struct Outcome {
+  Stop8085 why;
+  Regs8085 r;
+  uint64_t t;
+};
+
+Outcome runOn(const Assembler8085 &as, Cpu8085 &cpu, unsigned seed) {
+  std::mt19937 rng(seed);
+  for (auto &b : cpu.mem) b = rng();
+  for (uint32_t a = 0; a < 0x10000; a++)
+    if (as.isUsed(a)) cpu.mem[a] = as.image[a];
+  uint32_t lo, hi;
+  as.extent(lo, hi);
+  cpu.mem[(uint16_t)hi] = 0xCF;  // running off the end stops
+  cpu.reset();
+  Outcome o;
+  o.why = timedRun(cpu, 20000000, o.t);
+  o.r = cpu.r;
+  return o;
+}
+
+// old and new program on the same random images: T-states summed over
+// the runs that stopped, and how many of those ended differently
+struct Comparison {
+  int stopped = 0, differ = 0;
+  uint64_t before = 0, after = 0;
+};
+
+Comparison compare(const Program &p, const Program &q, int inputs) {
+  // where runOn plants the RST 1s
+  uint32_t lo, endP, endQ;
+  p.as->extent(lo, endP);
+  q.as->extent(lo, endQ);
+  endP &= 0xFFFF;
+  endQ &= 0xFFFF;
+
+  auto a = std::make_unique<Cpu8085>(), b = std::make_unique<Cpu8085>();
+  Comparison c;
+  for (int i = 0; i < inputs; i++) {
+    Outcome x = runOn(*p.as, *a, 8085 + i), y = runOn(*q.as, *b, 8085 + i);
+    if (x.why == STOP_BUDGET) continue;
+    c.stopped++;
+    bool eq = x.why == y.why && sameLive(x.r, y.r, L_ALL) && x.r.f == y.r.f;
+    for (uint32_t m = 0; m < 0x10000 && eq; m++) {
+      if (p.as->isUsed(m) || q.as->isUsed(m) || m == endP || m == endQ)
+        continue;
+      eq = a->mem[m] == b->mem[m];
+    }
+    c.differ += !eq;
+    c.before += x.t;
+    c.after += y.t;
+  }
+  return c;
+}
+
+void report(const std::vector<Rewrite> &rw) {
+  for (auto &r : rw) {
+    if (r.first == r.last)
+      printf("  line %d: %s (%s)\n", r.first, r.what.c_str(), r.saving.c_str());
+    else
+      printf("  lines %d-%d: %s (%s)\n", r.first, r.last, r.what.c_str(),
+             r.saving.c_str());
+  }
+}
+
+int optimize(const fs::path &path, Superopt &so, int inputs,
+             const std::string &outDir, uint64_t &saved, uint64_t &total) {
+  std::string src;
+  if (!readFile(path, src)) {
+    std::cerr << "opt8085: cannot read " << path << "\n";
+    return 1;
+  }
+  std::string name = path.filename().string();
+  Program p;
+  if (!p.load(src, name)) {
+    printf("== %s: doesn't assemble (%s)\n", name.c_str(),
+           p.as->errors.empty() ? "" : p.as->errors[0].c_str());
+    return 1;
+  }
+  printf("== %s\n", name.c_str());
+
+  // the shift-and-add loses to the loop on small counts, so the program
+  // is tried with and without it
+  std::vector<Rewrite> rw, muls;
+  idioms(p, rw);
+  multiplies(p, muls);
+  std::vector<Rewrite> all = rw;
+  all.insert(all.end(), muls.begin(), muls.end());
+  superoptimize(p, so, all);
+  rw.assign(all.begin(), all.end());
+  rw.erase(std::remove_if(rw.begin(), rw.end(),
+                          [](const Rewrite &r) {
+                            return r.what.rfind("multiply", 0) == 0;
+                          }),
+           rw.end());
+
+  auto byLine = [](const Rewrite &a, const Rewrite &b) {
+    return a.first < b.first;
+  };
+  std::sort(rw.begin(), rw.end(), byLine);
+  std::sort(all.begin(), all.end(), byLine);
+
+  std::string text;
+  Comparison c;
+  bool withMuls = false;
+  for (auto *set : {&all, &rw}) {
+    std::string t = rewritten(p, *set);
+    Program q;
+    if (!q.load(t, name)) {
+      printf("  the rewritten source doesn't assemble: %s\n",
+             q.as->errors.empty() ? "" : q.as->errors[0].c_str());
+      return 1;
+    }
+    Comparison k = compare(p, q, inputs);
+    if (!k.stopped) {
+      printf("  doesn't stop within 2e7 instructions, not checked\n");
+      return 1;
+    }
+    if (k.differ) {
+      printf("  DIFFERS from the original on %d of %d inputs, not written\n",
+             k.differ, k.stopped);
+      return 1;
+    }
+    if (text.empty() || k.after < c.after) {
+      text = t;
+      c = k;
+      withMuls = set == &all;
+    }
+    if (muls.empty()) break;
+  }
+
+  if (!withMuls) {
+    for (auto &m : muls)
+      printf("  lines %d-%d: %s not taken, slower on these inputs\n", m.first,
+             m.last, m.what.c_str());
+    all = rw;
+  }
+  report(all);
+  if (all.empty()) printf("  nothing to rewrite\n");
+
+  printf("  %d random inputs, same results: %llu -> %llu T-states on "
+         "average (%.1f%% saved)\n",
+         c.stopped, (unsigned long long)(c.before / c.stopped),
+         (unsigned long long)(c.after / c.stopped),
+         c.before ? 100.0 * (c.before - c.after) / c.before : 0.0);
+  saved += (c.before - c.after) / c.stopped;
+  total += c.before / c.stopped;
+
+  if (!outDir.empty() && !all.empty()) {
+    fs::path to = fs::path(outDir) / name;
+    std::ofstream o(to, std::ios::binary);
+    o << text;
+    if (!o) {
+      std::cerr << "opt8085: cannot write " << to << "\n";
+      return 1;
+    }
+  }
+  return 0;
+}
+
+int main(int argc, char *argv[]) {
+  int search = 2, inputs = 16;
+  std::string outDir;
+  std::vector<fs::path> args;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--search" && i + 1 < argc)
+      search = std::min(3, std::max(0, atoi(argv[++i])));
+    else if (arg == "--inputs" && i + 1 < argc)
+      inputs = std::max(1, atoi(argv[++i]));
+    else if (arg == "-o" && i + 1 < argc)
+      outDir = argv[++i];
+    else
+      args.push_back(arg);
+  }
+  if (args.empty()) {
+    std::cerr << "usage: " << argv[0]
+              << " [--search N] [--inputs N] [-o DIR] FILE.asm|DIR ...\n";
+    return 1;
+  }
+  if (!outDir.empty()) fs::create_directories(outDir);
+
+  std::vector<fs::path> files;
+  for (auto &in : args) {
+    if (fs::is_directory(in)) {
+      std::vector<fs::path> dir;
+      for (auto &e : fs::directory_iterator(in))
+        if (e.is_regular_file() && e.path().extension() == ".asm")
+          dir.push_back(e.path());
+      std::sort(dir.begin(), dir.end());
+      files.insert(files.end(), dir.begin(), dir.end());
+    } else {
+      files.push_back(in);
+    }
+  }
+
+  Superopt so(search);
+  int bad = 0;
+  uint64_t saved = 0, total = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (auto &f : files) bad += optimize(f, so, inputs, outDir, saved, total);
+  double sec =
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - start)
+          .count();
+  printf("%zu file(s) in %.2f s: %llu of %llu T-states saved per run "
+         "(%.1f%%)%s\n",
+         files.size(), sec, (unsigned long long)saved,
+         (unsigned long long)total, total ? 100.0 * saved / total : 0.0,
+         bad ? ", some files skipped" : "");
+  return bad ? 1 : 0;
+}
@@ -0,0 +1,183 @@
+/*
+ * snapshots and replay for the 8085 core in cpu8085.h.
+ *
+ * Recorder8085 runs a Cpu8085 and every `interval` instructions keeps a
+ * snapshot in a ring of `slots`: the registers, ports and instruction count
+ * plus only the 256 byte pages stored to since the previous snapshot (from
+ * Cpu8085::dirtyPages()). the oldest snapshot's memory is kept whole; when
+ * the ring is full the oldest one is dropped and the next one's pages are
+ * folded into that copy.
+ *
+ * the 8085 here has no outside input (ports only change through OUT), so a
+ * run is a function of its starting state. seek(n) goes back to the newest
+ * snapshot at or before instruction n and runs forward from there, which
+ * makes stepBack() and seeking anywhere in the ring cost at most one
+ * interval of emulation. positions are instruction counts (cpu.executed).
+ *
+ * everything that changes the machine has to go through the recorder once
+ * it is constructed: stores through mem[] from outside, load() and the JIT
+ * don't mark pages dirty, so a snapshot would miss them.
+ */
+
+#ifndef REPLAY8085_H
+#define REPLAY8085_H
+
+#include <vector>
+
+#include "cpu8085.h"
+
+struct Snapshot8085 {
+  Regs8085 r;
+  bool ie;
+  uint8_t ports[256];
+  uint64_t executed;
+
+  // the pages stored to since the snapshot before, as they were at this one
+  std::vector<uint8_t> pageNums;
+  std::vector<uint8_t> pages;
+};
+
+class Recorder8085 {
+ public:
+  uint64_t snapshotsTaken = 0;
+
+  Recorder8085(Cpu8085 &cpu, uint64_t interval = 100000, size_t slots = 64)
+      : cpu(cpu),
+        interval(interval ? interval : 1),
+        ring(slots > 1 ? slots : 2),
+        base(cpu.mem, cpu.mem + 0x10000) {
+    cpu.clearDirty();
+    save(ring[0]);
+    oldest = 0;
+    count = 1;
+  }
+
+  Recorder8085(const Recorder8085 &) = delete;
+  Recorder8085 &operator=(const Recorder8085 &) = delete;
+
+  // Cpu8085::run, stopping at each multiple of interval for a snapshot
+  Stop8085 run(uint64_t maxInsns = UINT64_MAX) {
+    Stop8085 why = STOP_BUDGET;
+    while (maxInsns) {
+      uint64_t next = newest().executed + interval;
+      uint64_t chunk = next - cpu.executed;
+      if (chunk > maxInsns) chunk = maxInsns;
+
+      uint64_t before = cpu.executed;
+      why = cpu.run(chunk);
+      maxInsns -= cpu.executed - before;
+      if (cpu.executed == next) snapshot();
+      if (why != STOP_BUDGET) break;
+    }
+    return why;
+  }
+
+  // puts the machine back to where it was after `insn` instructions (or
+  // forward to there); false if that is older than the oldest snapshot
+  bool seek(uint64_t insn) {
+    if (insn < ring[oldest].executed) return false;
+    if (insn >= cpu.executed) {
+      run(insn - cpu.executed);
+      return cpu.executed == insn;
+    }
+
+    size_t k = count - 1;
+    while (at(k).executed > insn) k--;
+    restore(k);
+    run(insn - cpu.executed);
+    return cpu.executed == insn;
+  }
+
+  bool stepBack(uint64_t n = 1) {
+    return n <= cpu.executed && seek(cpu.executed - n);
+  }
+
+  // the range seek() can reach without running forward
+  uint64_t oldestPosition() const { return ring[oldest].executed; }
+
+  // bytes held by the snapshots, the whole oldest image included
+  size_t bytes() const {
+    size_t n = base.size();
+    for (size_t i = 0; i < count; i++)
+      n += sizeof(Snapshot8085) + at(i).pages.size();
+    return n;
+  }
+
+ private:
+  Cpu8085 &cpu;
+  uint64_t interval;
+  std::vector<Snapshot8085> ring;
+  size_t oldest, count;
+  std::vector<uint8_t> base;  // memory at ring[oldest]
+
+  Snapshot8085 &at(size_t i) { return ring[(oldest + i) % ring.size()]; }
+  const Snapshot8085 &at(size_t i) const {
+    return ring[(oldest + i) % ring.size()];
+  }
+  Snapshot8085 &newest() { return at(count - 1); }
+
+  // registers and the dirty pages into s; the vectors keep their capacity
+  // so a full ring takes snapshots without allocating
+  void save(Snapshot8085 &s) {
+    s.r = cpu.r;
+    s.ie = cpu.ie;
+    memcpy(s.ports, cpu.ports, sizeof(s.ports));
+    s.executed = cpu.executed;
+    s.pageNums.clear();
+    s.pages.clear();
+    cpu.dirtyPages().each([&](int p) {
+      s.pageNums.push_back(p);
+      const uint8_t *page = cpu.mem + p * 256;
+      s.pages.insert(s.pages.end(), page, page + 256);
+    });
+    cpu.clearDirty();
+  }
+
+  void snapshot() {
+    if (count == ring.size()) {
+      // fold the second oldest into the base image and let it be the oldest
+      Snapshot8085 &next = at(1);
+      for (size_t i = 0; i < next.pageNums.size(); i++)
+        memcpy(&base[next.pageNums[i] * 256], &next.pages[i * 256], 256);
+      next.pageNums.clear();
+      next.pages.clear();
+      oldest = (oldest + 1) % ring.size();
+      count--;
+    }
+    count++;
+    save(newest());
+    snapshotsTaken++;
+  }
+
+  // back to snapshot k, dropping the ones after it. only the pages that
+  // changed since k are copied: each from the newest snapshot at or before
+  // k that has it, or from the base image
+  void restore(size_t k) {
+    Pages8085 need = cpu.dirtyPages(), done;
+    for (size_t i = k + 1; i < count; i++)
+      for (uint8_t p : at(i).pageNums) need.set(p);
+
+    for (size_t i = k; i > 0; i--) {
+      const Snapshot8085 &s = at(i);
+      for (size_t j = 0; j < s.pageNums.size(); j++) {
+        uint8_t p = s.pageNums[j];
+        if (!need.has(p) || done.has(p)) continue;
+        memcpy(cpu.mem + p * 256, &s.pages[j * 256], 256);
+        done.set(p);
+      }
+    }
+    need.each([&](int p) {
+      if (!done.has(p)) memcpy(cpu.mem + p * 256, &base[p * 256], 256);
+    });
+
+    const Snapshot8085 &s = at(k);
+    cpu.r = s.r;
+    cpu.ie = s.ie;
+    memcpy(cpu.ports, s.ports, sizeof(cpu.ports));
+    cpu.executed = s.executed;
+    cpu.clearDirty();
+    count = k + 1;
+  }
+};
+
+#endif
@@ -0,0 +1,538 @@
+/*
+ * runs the arithmetic routines in `Microprocessor 8085/` over their whole
+ * input space and checks every result against a C++ reference
+ *
+ *   ./verify8085.out [--dir DIR] [--engine scalar|lanes|both] [-j N]
+ *                    [--max-bits B] [--samples N] [--seed S]
+ *                    [--limit INSNS] [ROUTINE ...]
+ *
+ * DIR defaults to `Microprocessor 8085/` beside the emu8085/ the binary
+ * (or, built from an absolute path, this file) is in.
+ *
+ * each routine in the table below names its source file, where its input
+ * bytes go (a memory address, the operand of the MVI on a source line, or
+ * a register) and where its output bytes are read from after it stops on
+ * RST 1 or HLT. inputs of up to --max-bits bits (default 24) are
+ * enumerated exhaustively; bigger spaces get every mix of the bytes
+ * 00 01 7F 80 FE FF plus --samples random inputs.
+ *
+ * engines: scalar runs one Cpu8085 per thread, putting back only the
+ * pages the last input dirtied. lanes runs Lanes8085 (lanes8085.h), 32
+ * inputs in lockstep, refilling the lanes that have stopped once REFILL
+ * of them have and falling back to Cpu8085 for the inputs of a run it
+ * bails on. both (the default) runs each and checks they agree on every
+ * input. lanes is not a speedup everywhere: only add24 gains at every
+ * optimization level, the multiplies need -O3 -march=native and factorial
+ * is slower than scalar (numbers in lanes8085.h).
+ * throughput is reported as routine executions per second.
+ *
+ * the references are what the routines are meant to compute, so quirks
+ * (a zero count running a DCR loop 256 times) show up as failures, with
+ * the lowest few inputs that fail.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "asm8085.h"
+#include "cpu8085.h"
+#include "lanes8085.h"
+
+struct Loc {
+  enum Kind : uint8_t { MEM, IMM, REG } kind;
+  uint16_t at;  // address, source line, or register (B C D E H L - A)
+};
+
+static Loc mem(uint16_t a) { return {Loc::MEM, a}; }
+static Loc imm(int line) { return {Loc::IMM, (uint16_t)line}; }
+static Loc reg(int r) { return {Loc::REG, (uint16_t)r}; }
+enum { RB, RC, RD, RE, RH, RL, RM, RA };
+
+struct Routine {
+  const char *name, *file;
+  std::vector<Loc> in, out;
+  void (*ref)(const uint8_t *in, uint8_t *out);
+};
+
+static void put(uint8_t *out, uint64_t v, int n) {
+  for (int i = 0; i < n; i++) out[i] = v >> (8 * i);
+}
+
+static const std::vector<Routine> &routines() {
+  static const std::vector<Routine> table = {
+      {"square", "19 SEPt 24-1.asm", {mem(0x2000)},
+       {mem(0x2001), mem(0x2002)},
+       [](const uint8_t *in, uint8_t *out) { put(out, in[0] * in[0], 2); }},
+      {"mul8", "5SEPT24-2.asm", {mem(0x3000), mem(0x3001)},
+       {mem(0x4000), mem(0x4001)},
+       [](const uint8_t *in, uint8_t *out) { put(out, in[0] * in[1], 2); }},
+      {"mul8imm", "5SEPT24.asm", {imm(1), imm(2)}, {reg(RE), reg(RD)},
+       [](const uint8_t *in, uint8_t *out) { put(out, in[0] * in[1], 2); }},
+      {"factorial", "19 SEPt 24-1B.asm", {mem(0x2000)},
+       {mem(0x2001), mem(0x2002)},
+       [](const uint8_t *in, uint8_t *out) {
+         uint32_t f = 1;
+         for (int k = 2; k <= in[0]; k++) f = f * k & 0xFFFF;
+         put(out, f, 2);
+       }},
+      // x = H:L:E, y = B:C:D as the MVIs load them
+      {"add24", "24bitsAddition.asm",
+       {imm(1), imm(2), imm(3), imm(5), imm(6), imm(7)},
+       {mem(0x9000), mem(0x9001), mem(0x9002), mem(0x9003)},
+       [](const uint8_t *in, uint8_t *out) {
+         uint32_t y = in[0] << 16 | in[1] << 8 | in[2];
+         uint32_t x = in[3] << 16 | in[4] << 8 | in[5];
+         put(out, x + y, 4);
+       }},
+  };
+  return table;
+}
+
+// a routine bound to its assembled image: where each input and output is
+struct Bound {
+  const Routine *r;
+  const uint8_t *image;
+  std::vector<uint16_t> inAddr;  // memory address, or register for REG
+  bool found = true;
+};
+
+static bool bind(const Routine &r, const Assembler8085 &as, Bound &b) {
+  b.r = &r;
+  b.image = as.image;
+  auto lines = as.insnLines();
+  for (const Loc &l : r.in) {
+    if (l.kind != Loc::IMM) {
+      b.inAddr.push_back(l.at);
+      continue;
+    }
+    auto it = std::find_if(lines.begin(), lines.end(),
+                           [&](auto &p) { return p.first == l.at; });
+    if (it == lines.end() || opInfo8085.len[as.image[it->second]] != 2) {
+      std::cerr << "verify8085: " << r.file << ":" << l.at
+                << ": no two byte instruction to put an input in\n";
+      return false;
+    }
+    b.inAddr.push_back(it->second + 1);
+  }
+  return true;
+}
+
+static uint8_t &regOf(Regs8085 &r, int i) {
+  uint8_t *regs[8] = {&r.b, &r.c, &r.d, &r.e, &r.h, &r.l, &r.f, &r.a};
+  return *regs[i];
+}
+
+// what one execution gave: its stop and output bytes, folded so the two
+// engines can be compared without keeping every output
+static uint64_t digest(Stop8085 why, const uint8_t *out, size_t n) {
+  uint64_t h = 0xcbf29ce484222325ull ^ why;
+  for (size_t i = 0; i < n; i++) h = (h ^ out[i]) * 0x100000001b3ull;
+  return h;
+}
+
+struct Space {
+  uint64_t size;
+  bool exhaustive;
+  std::vector<uint8_t> sampled;  // size x inputs bytes when not exhaustive
+
+  void input(uint64_t k, size_t n, uint8_t *in) const {
+    if (exhaustive)
+      for (size_t i = 0; i < n && i < 8; i++) in[i] = k >> (8 * i);
+    else
+      memcpy(in, &sampled[k * n], n);
+  }
+};
+
+static Space makeSpace(size_t n, int maxBits, uint64_t samples,
+                       unsigned seed) {
+  Space s;
+  s.exhaustive = (int)(8 * n) <= maxBits;
+  if (s.exhaustive) {
+    s.size = 1ull << (8 * n);
+    return s;
+  }
+  static const uint8_t edges[] = {0x00, 0x01, 0x7F, 0x80, 0xFE, 0xFF};
+  uint64_t combos = 1;
+  for (size_t i = 0; i < n && combos < (1u << 20); i++) combos *= 6;
+  std::mt19937_64 rng(seed);
+  s.size = std::min<uint64_t>(combos, 1u << 20) + samples;
+  s.sampled.resize(s.size * n);
+  for (uint64_t k = 0; k < s.size; k++) {
+    uint8_t *in = &s.sampled[k * n];
+    if (k < combos && combos <= (1u << 20)) {
+      uint64_t c = k;
+      for (size_t i = 0; i < n; i++, c /= 6) in[i] = edges[c % 6];
+    } else {
+      for (size_t i = 0; i < n; i++) in[i] = rng();
+    }
+  }
+  return s;
+}
+
+struct Outcome {
+  uint64_t pass = 0, fail = 0, insns = 0, bailedBatches = 0;
+  uint64_t laneSteps = 0, laneInsns = 0;
+  std::vector<uint64_t> failures;  // the lowest few failing inputs
+  double sec = 0;
+  std::mutex lock;
+
+  // lanes finish out of order, so keep the lowest rather than the first
+  void failed(uint64_t k) {
+    std::lock_guard<std::mutex> g(lock);
+    if (failures.size() == 8 && k > failures.back()) return;
+    failures.insert(
+        std::upper_bound(failures.begin(), failures.end(), k), k);
+    if (failures.size() > 8) failures.pop_back();
+  }
+};
+
+// checks one execution, true if it passed
+static bool check(const Bound &b, const uint8_t *in, Stop8085 why,
+                  const uint8_t *out) {
+  uint8_t want[16];
+  b.r->ref(in, want);
+  return (why == STOP_RST1 || why == STOP_HALT) &&
+         !memcmp(out, want, b.r->out.size());
+}
+
+struct Scalar {
+  const Bound &b;
+  Cpu8085 cpu;
+
+  explicit Scalar(const Bound &b) : b(b) {
+    memcpy(cpu.mem, b.image, sizeof(cpu.mem));
+  }
+
+  Stop8085 run(const uint8_t *in, uint8_t *out, uint64_t limit,
+               uint64_t &insns) {
+    const Routine &r = *b.r;
+    cpu.reset();
+    for (size_t i = 0; i < r.in.size(); i++) {
+      if (r.in[i].kind == Loc::REG)
+        regOf(cpu.r, b.inAddr[i]) = in[i];
+      else
+        cpu.mem[b.inAddr[i]] = in[i];
+    }
+    Stop8085 why = cpu.run(limit);
+    insns += cpu.executed;
+    for (size_t i = 0; i < r.out.size(); i++)
+      out[i] = r.out[i].kind == Loc::REG ? regOf(cpu.r, r.out[i].at)
+                                         : cpu.mem[r.out[i].at];
+
+    // back to the image: the pages it stored to and the inputs
+    for (int p = 0; p < 256; p++)
+      if (cpu.dirty[p]) memcpy(cpu.mem + p * 256, b.image + p * 256, 256);
+    cpu.clearDirty();
+    for (size_t i = 0; i < r.in.size(); i++)
+      if (r.in[i].kind != Loc::REG)
+        cpu.mem[b.inAddr[i]] = b.image[b.inAddr[i]];
+    return why;
+  }
+};
+
+static const uint64_t CHUNK = 4096;
+
+// lanes are refilled once this many have stopped. refilling after every
+// stop keeps the group full but pays for a run() exit and re-entry each
+// time; on routines whose lanes stop at scattered counts (factorial) that
+// costs more than the few idle lanes do
+static const int REFILL = 16;
+
+static void runEngine(const Bound &b, const Space &space, bool lanes,
+                      unsigned threads, uint64_t limit,
+                      std::vector<uint64_t> *digests, Outcome &o) {
+  const Routine &r = *b.r;
+  const size_t nIn = r.in.size(), nOut = r.out.size();
+  std::atomic<uint64_t> next{0};
+
+  auto record = [&](uint64_t k, const uint8_t *in, Stop8085 why,
+                    const uint8_t *out, uint64_t &pass, uint64_t &fail) {
+    if (check(b, in, why, out)) {
+      pass++;
+    } else {
+      fail++;
+      o.failed(k);
+    }
+    if (digests) (*digests)[k] = digest(why, out, nOut);
+  };
+
+  auto worker = [&]() {
+    Scalar scalar(b);
+    Lanes8085<32> group(b.image);
+    const int N = Lanes8085<32>::LANES;
+    const uint64_t NONE = UINT64_MAX;
+    uint64_t pass = 0, fail = 0, insns = 0, bailed = 0;
+    uint8_t in[N][16], out[16];
+
+    uint64_t cur = 0, end = 0;
+    auto take = [&](uint64_t &k) {
+      if (cur == end) {
+        cur = next.fetch_add(CHUNK);
+        if (cur >= space.size) {
+          cur = end;
+          return false;
+        }
+        end = std::min(space.size, cur + CHUNK);
+      }
+      k = cur++;
+      return true;
+    };
+
+    if (!lanes) {
+      for (uint64_t k; take(k);) {
+        space.input(k, nIn, in[0]);
+        Stop8085 why = scalar.run(in[0], out, limit, insns);
+        record(k, in[0], why, out, pass, fail);
+      }
+    } else {
+      // lanes take the next input as soon as they stop, so a long run in
+      // one lane doesn't leave the others idle until it's done
+      uint64_t held[N];
+      int holding = 0;
+      auto give = [&](int i, bool fresh) {
+        if (!take(held[i])) {
+          held[i] = NONE;
+          group.park(i);
+          return;
+        }
+        holding++;
+        if (!fresh) group.restart(i);
+        space.input(held[i], nIn, in[i]);
+        for (size_t j = 0; j < nIn; j++) {
+          if (r.in[j].kind == Loc::REG)
+            group.R[b.inAddr[j]][i] = in[i][j];
+          else
+            group.poke(i, b.inAddr[j], in[i][j]);
+        }
+      };
+      group.reset();
+      for (int i = 0; i < N; i++) give(i, true);
+
+      while (holding) {
+        if (!group.run(limit, REFILL)) {
+          // what the lanes held, again one at a time
+          bailed++;
+          for (int i = 0; i < N; i++) {
+            if (held[i] == NONE) continue;
+            Stop8085 why = scalar.run(in[i], out, limit, insns);
+            record(held[i], in[i], why, out, pass, fail);
+          }
+          holding = 0;
+          group.reset();
+          for (int i = 0; i < N; i++) give(i, true);
+          continue;
+        }
+        for (int i = 0; i < N; i++) {
+          if (held[i] == NONE || group.running[i]) continue;
+          for (size_t j = 0; j < nOut; j++)
+            out[j] = r.out[j].kind == Loc::REG ? group.R[r.out[j].at][i]
+                                               : group.peek(i, r.out[j].at);
+          insns += group.count[i];
+          record(held[i], in[i], group.why[i], out, pass, fail);
+          holding--;
+          give(i, false);
+        }
+      }
+    }
+
+    std::lock_guard<std::mutex> g(o.lock);
+    o.pass += pass;
+    o.fail += fail;
+    o.insns += insns;
+    o.bailedBatches += bailed;
+    o.laneSteps += group.steps;
+    o.laneInsns += group.executed;
+  };
+
+  auto start = std::chrono::steady_clock::now();
+  std::vector<std::thread> pool;
+  for (unsigned t = 0; t < threads; t++) pool.emplace_back(worker);
+  for (auto &t : pool) t.join();
+  o.sec =
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - start)
+          .count();
+}
+
+static std::string where(const Loc &l, const Bound &b, size_t i) {
+  static const char names[] = "BCDEHLMA";
+  char buf[16];
+  if (l.kind == Loc::REG)
+    snprintf(buf, sizeof(buf), "%c", names[l.at]);
+  else
+    snprintf(buf, sizeof(buf), "%04X", l.kind == Loc::MEM ? l.at
+                                                          : b.inAddr[i]);
+  return buf;
+}
+
+static void report(const char *engine, const Bound &b, const Space &space,
+                   const Outcome &o, uint64_t limit, unsigned threads) {
+  const Routine &r = *b.r;
+  printf("  %-7s %llu/%llu pass, %.3f s, %.2fM executions/s, "
+         "%.1fM insns/s",
+         engine, (unsigned long long)o.pass, (unsigned long long)space.size,
+         o.sec, o.sec > 0 ? space.size / o.sec / 1e6 : 0.0,
+         o.sec > 0 ? o.insns / o.sec / 1e6 : 0.0);
+  if (o.laneSteps)
+    printf(", %.0f%% lane use",
+           100.0 * o.laneInsns / (o.laneSteps * Lanes8085<32>::LANES));
+  if (o.bailedBatches)
+    printf(", %llu batches on Cpu8085", (unsigned long long)o.bailedBatches);
+  printf(" (%u thread%s)\n", threads, threads == 1 ? "" : "s");
+
+  Scalar scalar(b);
+  for (size_t f = 0; f < o.failures.size() && f < 4; f++) {
+    uint8_t in[16], out[16], want[16];
+    uint64_t insns = 0;
+    space.input(o.failures[f], r.in.size(), in);
+    Stop8085 why = scalar.run(in, out, limit, insns);
+    r.ref(in, want);
+    printf("    ");
+    for (size_t i = 0; i < r.in.size(); i++)
+      printf("%s=%02X ", where(r.in[i], b, i).c_str(), in[i]);
+    printf("->");
+    if (why != STOP_RST1 && why != STOP_HALT)
+      printf(" did not stop (%llu insns)", (unsigned long long)insns);
+    for (size_t i = 0; i < r.out.size(); i++)
+      printf(" %s=%02X", where(r.out[i], b, i).c_str(), out[i]);
+    printf(", expected");
+    for (size_t i = 0; i < r.out.size(); i++) printf(" %02X", want[i]);
+    printf("\n");
+  }
+}
+
+// `Microprocessor 8085/` found from this file's directory when the build
+// named it by an absolute path, otherwise from the binary's (the usual
+// build leaves it in emu8085/); "" when neither says where that is
+static std::string defaultDir(const char *argv0) {
+  std::string from = __FILE__[0] == '/' ? __FILE__ : argv0;
+  size_t slash = from.rfind('/');
+  if (slash == std::string::npos) return "";
+  return from.substr(0, slash + 1) + "../Microprocessor 8085";
+}
+
+int main(int argc, char *argv[]) {
+  std::string dir = defaultDir(argv[0]);
+  std::string engine = "both";
+  unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+  int maxBits = 24;
+  uint64_t samples = 1 << 22, limit = 1000000;
+  unsigned seed = 8085;
+  std::vector<std::string> only;
+
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--dir" && i + 1 < argc) {
+      dir = argv[++i];
+    } else if (arg == "--engine" && i + 1 < argc) {
+      engine = argv[++i];
+    } else if (arg == "-j" && i + 1 < argc) {
+      threads = std::max(1, atoi(argv[++i]));
+    } else if (arg == "--max-bits" && i + 1 < argc) {
+      maxBits = std::min(32, atoi(argv[++i]));
+    } else if (arg == "--samples" && i + 1 < argc) {
+      samples = strtoull(argv[++i], nullptr, 0);
+    } else if (arg == "--seed" && i + 1 < argc) {
+      seed = strtoul(argv[++i], nullptr, 0);
+    } else if (arg == "--limit" && i + 1 < argc) {
+      limit = std::max(1LL, atoll(argv[++i]));
+    } else if (arg[0] == '-') {
+      std::cerr << "usage: " << argv[0]
+                << " [--dir DIR] [--engine scalar|lanes|both] [-j N]"
+                << " [--max-bits B] [--samples N] [--seed S]"
+                << " [--limit INSNS] [ROUTINE ...]\n";
+      return 1;
+    } else {
+      only.push_back(arg);
+    }
+  }
+  if (dir.empty()) {
+    std::cerr << "verify8085: can't tell where `Microprocessor 8085` is"
+              << " from " << argv[0] << ", give --dir\n";
+    return 1;
+  }
+  if (engine != "scalar" && engine != "lanes" && engine != "both") {
+    std::cerr << "verify8085: --engine takes scalar, lanes or both\n";
+    return 1;
+  }
+  limit = std::min<uint64_t>(limit, UINT32_MAX);
+
+  int status = 0;
+  for (const Routine &r : routines()) {
+    if (!only.empty() &&
+        std::find(only.begin(), only.end(), r.name) == only.end())
+      continue;
+
+    std::string path = dir + "/" + r.file;
+    std::ifstream f(path, std::ios::binary);
+    if (!f) {
+      std::cerr << "verify8085: can't read " << path << "\n";
+      status = 1;
+      continue;
+    }
+    std::stringstream ss;
+    ss << f.rdbuf();
+    std::string src = ss.str();
+    auto as = std::make_unique<Assembler8085>();
+    if (!as->assemble(src, r.file)) {
+      for (auto &e : as->errors) std::cerr << e << "\n";
+      status = 1;
+      continue;
+    }
+    Bound b;
+    if (!bind(r, *as, b)) {
+      status = 1;
+      continue;
+    }
+
+    Space space = makeSpace(r.in.size(), maxBits, samples, seed);
+    printf("%s (%s): %llu inputs, %s\n", r.name, r.file,
+           (unsigned long long)space.size,
+           space.exhaustive ? "exhaustive" : "edges + random");
+
+    std::vector<uint64_t> scalarDigests, laneDigests;
+    bool both = engine == "both";
+    if (both) {
+      scalarDigests.resize(space.size);
+      laneDigests.resize(space.size);
+    }
+    Outcome scalar, lanes;
+    if (engine != "lanes") {
+      runEngine(b, space, false, threads, limit,
+                both ? &scalarDigests : nullptr, scalar);
+      report("scalar", b, space, scalar, limit, threads);
+    }
+    if (engine != "scalar") {
+      runEngine(b, space, true, threads, limit,
+                both ? &laneDigests : nullptr, lanes);
+      report("lanes", b, space, lanes, limit, threads);
+    }
+    if (both) {
+      uint64_t differ = 0, firstDiffer = 0;
+      for (uint64_t k = space.size; k-- > 0;)
+        if (scalarDigests[k] != laneDigests[k]) differ++, firstDiffer = k;
+      if (differ) {
+        printf("  engines disagree on %llu inputs, first #%llu\n",
+               (unsigned long long)differ, (unsigned long long)firstDiffer);
+        status = 1;
+      } else {
+        printf("  engines agree\n");
+      }
+      if (scalar.sec > 0 && lanes.sec > 0)
+        printf("  lanes/scalar: %.2fx\n", scalar.sec / lanes.sec);
+    }
+    if ((engine == "lanes" ? lanes : scalar).fail) status = 1;
+  }
+  return status;
+}
@@ -0,0 +1,1143 @@
+/*
+ * static worst case T-states of 8085 programs
+ *
+ *   ./wcet8085.out [--samples N] [--all] FILE.asm|DIR ...
+ *
+ * the assembled program is decoded from 0000 into a control flow graph,
+ * one per function (0000 and every CALL target), with the immediate
+ * postdominator of each instruction. back edges give the loops; a DCR r in
+ * front of the branch that closes one makes r its counter.
+ *
+ * the program is then executed abstractly. registers and memory hold known
+ * bytes, input bytes ([addr] + k: anything outside the program that is read
+ * before it is written) or unknown bytes, and an instruction with known
+ * operands is run on a real Cpu8085. a branch on a flag that isn't known
+ * runs both ways and joins them again at its immediate postdominator,
+ * keeping the larger T-state count, so the count at the end is the worst
+ * case over all data. the program must not modify itself; a store through
+ * an unknown pointer is taken to miss the program and the stack and makes
+ * the rest of memory unknown.
+ *
+ * a loop closed by a branch on an input byte (MOV C,M ... DCR C / JNZ) has
+ * no fixed bound. that byte becomes an input size and the analysis is run
+ * for sampled values of it (every value with --all); with one size the
+ * worst case is also fitted to a polynomial in it. every sampled size is
+ * checked against runProfiled on N random memory images (default 20): no
+ * run may take longer than the bound.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <numeric>
+#include <random>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "asm8085.h"
+#include "cpu8085.h"
+
+namespace fs = std::filesystem;
+
+// ---------------------------------------------------------------------------
+// control flow graph
+
+const int32_t EXIT = -1;  // the node every return, HLT and RST 1 leads to
+
+struct Func {
+  uint16_t entry;
+  std::vector<uint16_t> insns;
+  std::unordered_map<uint16_t, int32_t> ipdom;
+};
+
+struct Loop {
+  uint16_t header, latch;  // latch: the branch back to the header
+  uint16_t lo, hi;         // address range of the body
+  int counter;             // register number, -1 if none found
+};
+
+const char regName[] = "BCDEHLMA";
+
+bool isJump(uint8_t op) { return op == 0xC3 || (op >= 0xC0 && (op & 7) == 2); }
+bool isCall(uint8_t op) { return op == 0xCD || (op >= 0xC0 && (op & 7) == 4); }
+bool isRet(uint8_t op) { return op == 0xC9 || (op >= 0xC0 && (op & 7) == 0); }
+bool isHalt(uint8_t op) { return op == 0x76 || op == 0xCF; }
+
+class Cfg {
+ public:
+  std::vector<Func> funcs;
+  std::vector<Loop> loops;
+  std::unordered_map<uint16_t, int> funcAt;  // entry -> funcs index
+  std::unordered_map<uint16_t, int> loopAt;  // latch -> loops index
+  std::vector<uint16_t> offEnd;  // where the program runs off its end
+  std::string error;
+
+  // running off the end counts as an RST 1 there
+  uint8_t opAt(uint16_t pc) const {
+    return used->isUsed(pc) ? img[pc] : 0xCF;
+  }
+
+  bool build(const Assembler8085 &as) {
+    img = as.image;
+    used = &as;
+    std::vector<uint16_t> todo{0};
+    while (!todo.empty()) {
+      uint16_t entry = todo.back();
+      todo.pop_back();
+      if (funcAt.count(entry)) continue;
+      funcAt[entry] = funcs.size();
+      funcs.push_back({entry, {}, {}});
+      if (!walk(funcs.back(), todo)) return false;
+    }
+    for (auto &f : funcs) {
+      postdominators(f);
+      for (uint16_t pc : f.insns)
+        if (!f.ipdom.count(pc)) {
+          char msg[80];
+          snprintf(msg, sizeof(msg), "no way out of %04X", pc);
+          error = msg;
+          return false;
+        }
+      findLoops(f);
+    }
+    return true;
+  }
+
+  size_t instructions() const {
+    size_t n = 0;
+    for (auto &f : funcs) n += f.insns.size();
+    return n;
+  }
+
+  // successors inside the function: calls fall through, returns and stops
+  // go to EXIT
+  void succs(uint16_t pc, std::vector<int32_t> &out) const {
+    uint8_t op = opAt(pc);
+    uint16_t next = pc + opInfo8085.len[op];
+    uint16_t target = img[(uint16_t)(pc + 1)] | img[(uint16_t)(pc + 2)] << 8;
+    out.clear();
+    if (isHalt(op) || op == 0xC9) {
+      out.push_back(EXIT);
+    } else if (isRet(op)) {
+      out.push_back(EXIT);
+      out.push_back(next);
+    } else if (op == 0xC3) {
+      out.push_back(target);
+    } else if (isJump(op)) {
+      out.push_back(target);
+      if (next != target) out.push_back(next);
+    } else {
+      out.push_back(next);
+    }
+  }
+
+ private:
+  const uint8_t *img;
+  const Assembler8085 *used;
+
+  bool walk(Func &f, std::vector<uint16_t> &calls) {
+    std::vector<bool> seen(0x10000);
+    std::vector<uint16_t> todo{f.entry};
+    std::vector<int32_t> out;
+    char msg[80];
+    while (!todo.empty()) {
+      uint16_t pc = todo.back();
+      todo.pop_back();
+      if (seen[pc]) continue;
+      seen[pc] = true;
+      f.insns.push_back(pc);
+
+      uint8_t op = opAt(pc);
+      const char *bad = nullptr;
+      if (!used->isUsed(pc))
+        offEnd.push_back(pc);
+      if (opInfo8085.cls[op] & OPC_ENDS_BLOCK && opInfo8085.len[op] == 1 &&
+          !isHalt(op) && !isRet(op) && op != 0xE9 && (op & 0xC7) != 0xC7)
+        bad = "undocumented opcode";
+      else if (op == 0xE9)
+        bad = "PCHL (jump through HL)";
+      else if ((op & 0xC7) == 0xC7 && op != 0xCF)
+        bad = "RST other than RST 1";
+      if (bad) {
+        snprintf(msg, sizeof(msg), "%s at %04X", bad, pc);
+        error = msg;
+        return false;
+      }
+
+      if (isCall(op))
+        calls.push_back(img[(uint16_t)(pc + 1)] | img[(uint16_t)(pc + 2)] << 8);
+      succs(pc, out);
+      for (int32_t s : out)
+        if (s != EXIT) todo.push_back(s);
+    }
+    std::sort(f.insns.begin(), f.insns.end());
+    return true;
+  }
+
+  // immediate postdominators: Cooper, Harvey and Kennedy's dominator
+  // algorithm on the reversed graph, EXIT being its entry
+  void postdominators(Func &f) {
+    std::unordered_map<int32_t, std::vector<int32_t>> rpreds;  // = succs
+    std::unordered_map<int32_t, std::vector<int32_t>> rsuccs;  // = preds
+    std::vector<int32_t> out;
+    for (uint16_t pc : f.insns) {
+      succs(pc, out);
+      rpreds[pc] = out;
+      for (int32_t s : out) rsuccs[s].push_back(pc);
+    }
+
+    std::unordered_map<int32_t, int> po;  // postorder number
+    std::vector<int32_t> order;
+    std::vector<std::pair<int32_t, size_t>> stack{{EXIT, 0}};
+    po[EXIT] = -2;
+    while (!stack.empty()) {
+      auto &[n, i] = stack.back();
+      auto &next = rsuccs[n];
+      if (i < next.size()) {
+        int32_t m = next[i++];
+        if (!po.count(m)) {
+          po[m] = -2;
+          stack.push_back({m, 0});
+        }
+        continue;
+      }
+      po[n] = order.size();
+      order.push_back(n);
+      stack.pop_back();
+    }
+
+    std::unordered_map<int32_t, int32_t> idom{{EXIT, EXIT}};
+    auto intersect = [&](int32_t a, int32_t b) {
+      while (a != b) {
+        while (po[a] < po[b]) a = idom[a];
+        while (po[b] < po[a]) b = idom[b];
+      }
+      return a;
+    };
+    for (bool changed = true; changed;) {
+      changed = false;
+      for (size_t i = order.size() - 1; i-- > 0;) {
+        int32_t n = order[i];
+        int32_t d = INT32_MIN;
+        for (int32_t p : rpreds[n]) {
+          if (!idom.count(p)) continue;
+          d = d == INT32_MIN ? p : intersect(p, d);
+        }
+        if (d != INT32_MIN && (!idom.count(n) || idom[n] != d)) {
+          idom[n] = d;
+          changed = true;
+        }
+      }
+    }
+    for (uint16_t pc : f.insns)
+      if (idom.count(pc)) f.ipdom[pc] = idom[pc];
+  }
+
+  // a back edge is a branch to an instruction still on the DFS stack
+  void findLoops(Func &f) {
+    std::unordered_map<int32_t, int> state;  // 1 on the stack, 2 done
+    std::vector<std::pair<uint16_t, size_t>> stack{{f.entry, 0}};
+    std::vector<std::vector<int32_t>> outs{{}};
+    succs(f.entry, outs.back());
+    state[f.entry] = 1;
+    while (!stack.empty()) {
+      auto [pc, i] = stack.back();
+      if (i < outs.back().size()) {
+        stack.back().second++;
+        int32_t s = outs.back()[i];
+        if (s == EXIT) continue;
+        if (state[s] == 1) {
+          addLoop(f, s, pc);
+        } else if (state[s] == 0) {
+          state[s] = 1;
+          stack.push_back({(uint16_t)s, 0});
+          outs.emplace_back();
+          succs(s, outs.back());
+        }
+        continue;
+      }
+      state[pc] = 2;
+      stack.pop_back();
+      outs.pop_back();
+    }
+  }
+
+  void addLoop(Func &f, uint16_t header, uint16_t latch) {
+    // the body: everything reaching the latch without passing the header
+    std::unordered_map<uint16_t, std::vector<uint16_t>> preds;
+    std::vector<int32_t> out;
+    for (uint16_t pc : f.insns) {
+      succs(pc, out);
+      for (int32_t s : out)
+        if (s != EXIT) preds[s].push_back(pc);
+    }
+    Loop l{header, latch, header, latch, -1};
+    std::vector<bool> in(0x10000);
+    in[header] = true;
+    std::vector<uint16_t> todo{latch};
+    while (!todo.empty()) {
+      uint16_t pc = todo.back();
+      todo.pop_back();
+      if (in[pc]) continue;
+      in[pc] = true;
+      l.lo = std::min(l.lo, pc);
+      l.hi = std::max(l.hi, pc);
+      for (uint16_t p : preds[pc]) todo.push_back(p);
+    }
+
+    // DCR r / Jcc closing the loop
+    for (uint16_t pc : f.insns)
+      if ((uint16_t)(pc + 1) == latch && (opAt(pc) & 0xC7) == 0x05 &&
+          (opAt(pc) >> 3 & 7) != 6)
+        l.counter = opAt(pc) >> 3 & 7;
+    loopAt[latch] = loops.size();
+    loops.push_back(l);
+  }
+};
+
+// ---------------------------------------------------------------------------
+// abstract execution
+
+enum ValKind : uint8_t { V_KNOWN, V_INPUT, V_UNKNOWN };
+
+// a byte: known, the input byte at addr plus v, or unknown
+struct Val {
+  uint8_t kind, v;
+  uint16_t addr;
+
+  bool operator==(const Val &o) const {
+    return kind == o.kind && (kind == V_UNKNOWN || v == o.v) &&
+           (kind != V_INPUT || addr == o.addr);
+  }
+  bool known() const { return kind == V_KNOWN; }
+};
+
+Val knownVal(uint8_t v) { return {V_KNOWN, v, 0}; }
+const Val unknownVal{V_UNKNOWN, 0, 0};
+
+const uint8_t ALL_FLAGS = FLAG_S | FLAG_Z | FLAG_AC | FLAG_P | FLAG_CY;
+const int MAX_LOOPS = 32;
+
+enum End : uint8_t { END_NONE, END_RET, END_HALT };
+
+struct State {
+  Val r[8];  // by register number, [6] unused
+  uint16_t pc, sp;
+  uint8_t fknown, f;  // which flags are known, and their values
+  Val zsrc;           // the byte whose zero-ness Z holds, when Z isn't known
+  uint64_t t;
+  End end;
+  uint32_t iters[MAX_LOOPS];  // times each loop's back edge was taken
+};
+
+class Analyzer {
+ public:
+  std::vector<std::pair<uint16_t, uint8_t>> sizes;  // input size bytes
+  int32_t wantSize;  // set with error: this input byte bounds a loop
+  std::string error;
+
+  Analyzer(const Assembler8085 &as, const Cfg &cfg)
+      : as(as), cfg(cfg), mem(0x10000) {}
+
+  // worst case of the whole program; false with error set if it can't
+  bool run(State &s) {
+    for (uint32_t a = 0; a < 0x10000; a++)
+      mem[a] = as.isUsed(a) ? knownVal(as.image[a]) : Val{V_INPUT, 0,
+                                                           (uint16_t)a};
+    for (auto &[addr, v] : sizes) mem[addr] = knownVal(v);
+    journal.clear();
+    forkDepth = 0;
+    clobbered = false;
+    stackLo = 0xFFFF;
+    stackHi = 0;
+    steps = 0;
+    error.clear();
+    wantSize = -1;
+
+    memset(&s, 0, sizeof(s));
+    for (auto &v : s.r) v = knownVal(0);
+    s.sp = 0xFFFF;
+    s.fknown = ALL_FLAGS;
+    s.f = FLAG_FIXED;
+    s.zsrc = unknownVal;
+    exec(s, EXIT, cfg.funcs[0]);
+    if (error.empty() && s.end != END_HALT) error = "returned from 0000";
+    return error.empty();
+  }
+
+ private:
+  const Assembler8085 &as;
+  const Cfg &cfg;
+  std::vector<Val> mem;
+  // (address, value before) of every store made inside a fork
+  std::vector<std::pair<uint16_t, Val>> journal;
+  int forkDepth;
+  uint64_t steps;
+  bool clobbered;  // something was stored through an unknown pointer
+  uint16_t stackLo, stackHi;
+
+  static constexpr uint64_t MAX_STEPS = 2000000000;
+  static constexpr int MAX_DEPTH = 4000;
+
+  void fail(const char *what, uint16_t pc) {
+    if (!error.empty()) return;
+    char msg[120];
+    snprintf(msg, sizeof(msg), "%s at %04X", what, pc);
+    error = msg;
+  }
+
+  // after a store through an unknown pointer only the program and the
+  // stack are still known
+  Val load(uint16_t a) const {
+    if (clobbered && !as.isUsed(a) && (a < stackLo || a > stackHi))
+      return unknownVal;
+    return mem[a];
+  }
+
+  // a store to the stack, which a store through an unknown pointer is
+  // taken not to hit
+  void push(uint16_t a, Val v, uint16_t pc) {
+    stackLo = std::min(stackLo, a);
+    stackHi = std::max(stackHi, a);
+    store(a, v, pc);
+  }
+
+  void store(uint16_t a, Val v, uint16_t pc) {
+    if (as.isUsed(a)) fail("store into the program", pc);
+    if (forkDepth) journal.push_back({a, mem[a]});
+    mem[a] = v;
+  }
+
+  bool pairKnown(const State &s, int hi) const {
+    return s.r[hi].known() && s.r[hi + 1].known();
+  }
+  uint16_t pair(const State &s, int hi) const {
+    return s.r[hi].v << 8 | s.r[hi + 1].v;
+  }
+
+  Val get(const State &s, int r) const {
+    if (r != 6) return s.r[r];
+    return pairKnown(s, 4) ? load(pair(s, 4)) : unknownVal;
+  }
+
+  void put(State &s, int r, Val v) {
+    if (r != 6) {
+      s.r[r] = v;
+    } else if (pairKnown(s, 4)) {
+      store(pair(s, 4), v, s.pc);
+    } else {
+      clobbered = true;
+    }
+  }
+
+  // one instruction on known values, on a real CPU
+  static Regs8085 concrete(Regs8085 r, uint8_t op, uint16_t imm) {
+    static auto cpu = std::make_unique<Cpu8085>();
+    r.pc = 0;
+    cpu->r = r;
+    cpu->mem[0] = op;
+    cpu->mem[1] = imm;
+    cpu->mem[2] = imm >> 8;
+    cpu->step();
+    return cpu->r;
+  }
+
+  Regs8085 known(const State &s) const {
+    Regs8085 r;
+    memset(&r, 0, sizeof(r));
+    r.b = s.r[0].v, r.c = s.r[1].v, r.d = s.r[2].v, r.e = s.r[3].v;
+    r.h = s.r[4].v, r.l = s.r[5].v, r.a = s.r[7].v;
+    r.f = (s.f & s.fknown) | FLAG_FIXED;
+    r.sp = s.sp;
+    return r;
+  }
+
+  void setFlags(State &s, uint8_t which, uint8_t f) {
+    s.fknown |= which;
+    s.f = (s.f & ~which) | (f & which);
+  }
+
+  void loseFlags(State &s, uint8_t which) {
+    s.fknown &= ~which;
+    s.f &= ~which;
+    if (which & FLAG_Z) s.zsrc = unknownVal;
+  }
+
+  // everything but control flow
+  void step(State &s, uint8_t op, uint16_t imm) {
+    int lo = op & 7, mid = op >> 3 & 7, rp = op >> 4 & 3;
+
+    if (op >= 0x40 && op < 0x80) {  // MOV
+      put(s, mid, get(s, lo));
+      return;
+    }
+    if (op >= 0x80 || (op >= 0xC0 && lo == 6)) {  // ALU r / M / immediate
+      Val v = op < 0xC0 ? get(s, lo) : knownVal(imm);
+      bool cy = mid == 1 || mid == 3;  // ADC, SBB
+      Val a = s.r[7];
+      if (op < 0xC0 && lo == 7 && (mid == 2 || mid == 5)) {
+        a = v = knownVal(0);  // SUB A, XRA A: 0 whatever A was
+      }
+      if (a.known() && v.known() && (!cy || s.fknown & FLAG_CY)) {
+        Regs8085 r = known(s);
+        r.a = a.v;
+        r.b = v.v;
+        r = concrete(r, 0x80 | mid << 3, 0);
+        s.r[7] = knownVal(r.a);
+        setFlags(s, ALL_FLAGS, r.f);
+      } else {
+        if (mid != 7) s.r[7] = unknownVal;
+        loseFlags(s, ALL_FLAGS);
+      }
+      return;
+    }
+
+    switch (op) {
+      case 0x00:  // NOP
+      case 0x30:  // SIM
+      case 0xD3:  // OUT
+      case 0xF3:  // DI
+      case 0xFB:  // EI
+        return;
+      case 0x20:  // RIM
+      case 0xDB:  // IN
+        s.r[7] = unknownVal;
+        return;
+      case 0x22:  // SHLD
+        store(imm, s.r[5], s.pc);
+        store(imm + 1, s.r[4], s.pc);
+        return;
+      case 0x2A:  // LHLD
+        s.r[5] = load(imm);
+        s.r[4] = load(imm + 1);
+        return;
+      case 0x32:  // STA
+        store(imm, s.r[7], s.pc);
+        return;
+      case 0x3A:  // LDA
+        s.r[7] = load(imm);
+        return;
+      case 0x2F:  // CMA
+        s.r[7] = s.r[7].known() ? knownVal(~s.r[7].v) : unknownVal;
+        return;
+      case 0x37:  // STC
+        setFlags(s, FLAG_CY, FLAG_CY);
+        return;
+      case 0x3F:  // CMC
+        s.f ^= FLAG_CY & s.fknown;
+        return;
+      case 0xEB:  // XCHG
+        std::swap(s.r[2], s.r[4]);
+        std::swap(s.r[3], s.r[5]);
+        return;
+      case 0xE3: {  // XTHL
+        Val l = load(s.sp), h = load(s.sp + 1);
+        push(s.sp, s.r[5], s.pc);
+        push(s.sp + 1, s.r[4], s.pc);
+        s.r[5] = l;
+        s.r[4] = h;
+        return;
+      }
+      case 0xF9:  // SPHL
+        if (!pairKnown(s, 4)) return fail("SPHL with an unknown HL", s.pc);
+        s.sp = pair(s, 4);
+        return;
+      case 0xF5:  // PUSH PSW
+        push(s.sp - 1, s.r[7], s.pc);
+        push(s.sp - 2,
+              s.fknown == ALL_FLAGS ? knownVal(s.f | FLAG_FIXED) : unknownVal,
+              s.pc);
+        s.sp -= 2;
+        return;
+      case 0xF1: {  // POP PSW
+        Val f = load(s.sp);
+        s.r[7] = load(s.sp + 1);
+        s.sp += 2;
+        if (f.known())
+          setFlags(s, ALL_FLAGS, f.v);
+        else
+          loseFlags(s, ALL_FLAGS);
+        return;
+      }
+    }
+
+    if (op < 0x40) {
+      switch (lo) {
+        case 1:
+          if (op & 8) {  // DAD
+            bool k = rp == 3 ? pairKnown(s, 4) : pairKnown(s, 4) &&
+                                                     pairKnown(s, rp * 2);
+            if (k) {
+              Regs8085 r = concrete(known(s), op, 0);
+              s.r[4] = knownVal(r.h);
+              s.r[5] = knownVal(r.l);
+              setFlags(s, FLAG_CY, r.f);
+            } else {
+              s.r[4] = s.r[5] = unknownVal;
+              loseFlags(s, FLAG_CY);
+            }
+          } else if (rp == 3) {  // LXI
+            s.sp = imm;
+          } else {
+            s.r[rp * 2] = knownVal(imm >> 8);
+            s.r[rp * 2 + 1] = knownVal(imm);
+          }
+          return;
+        case 2:  // STAX, LDAX
+          if (!pairKnown(s, rp * 2)) {
+            if (op & 8)
+              s.r[7] = unknownVal;
+            else
+              clobbered = true;
+          } else if (op & 8) {
+            s.r[7] = load(pair(s, rp * 2));
+          } else {
+            store(pair(s, rp * 2), s.r[7], s.pc);
+          }
+          return;
+        case 3: {  // INX, DCX
+          int d = op & 8 ? -1 : 1;
+          if (rp == 3) {
+            s.sp += d;
+          } else if (pairKnown(s, rp * 2)) {
+            uint16_t v = pair(s, rp * 2) + d;
+            s.r[rp * 2] = knownVal(v >> 8);
+            s.r[rp * 2 + 1] = knownVal(v);
+          } else {
+            // the high byte only survives if the low one can't carry
+            Val &l = s.r[rp * 2 + 1];
+            bool carry = !l.known() || l.v == (d > 0 ? 0xFF : 0x00);
+            if (carry) s.r[rp * 2] = unknownVal;
+            if (l.kind != V_UNKNOWN) l.v += d;
+          }
+          return;
+        }
+        case 4:
+        case 5: {  // INR, DCR
+          Val v = get(s, mid);
+          int d = lo == 4 ? 1 : -1;
+          uint8_t keep = s.fknown & FLAG_CY, cy = s.f & FLAG_CY;
+          if (v.known()) {
+            v.v += d;
+            uint8_t f =
+                (lo == 4 ? flagTables8085.inr : flagTables8085.dcr)[v.v];
+            s.fknown = keep | (ALL_FLAGS & ~FLAG_CY);
+            s.f = (f & ~FLAG_CY) | cy;
+          } else {
+            if (v.kind == V_INPUT) v.v += d;
+            loseFlags(s, ALL_FLAGS & ~FLAG_CY);
+            s.zsrc = v;
+          }
+          put(s, mid, v);
+          return;
+        }
+        case 6:  // MVI
+          put(s, mid, knownVal(imm));
+          return;
+        case 7: {  // rotates, DAA; CMA, STC, CMC are done above
+          bool needCy = op == 0x17 || op == 0x1F;
+          bool k = s.r[7].known();
+          if (needCy) k = k && s.fknown & FLAG_CY;
+          if (op == 0x27)
+            k = k && (s.fknown & (FLAG_CY | FLAG_AC)) == (FLAG_CY | FLAG_AC);
+          uint8_t which = op == 0x27 ? ALL_FLAGS : (uint8_t)FLAG_CY;
+          if (k) {
+            Regs8085 r = concrete(known(s), op, 0);
+            s.r[7] = knownVal(r.a);
+            setFlags(s, which, r.f);
+          } else {
+            s.r[7] = unknownVal;
+            loseFlags(s, which);
+          }
+          return;
+        }
+      }
+    }
+
+    if (op >= 0xC0 && (lo == 1 || lo == 5)) {  // POP, PUSH
+      int hi = rp * 2;
+      if (lo == 5) {
+        push(s.sp - 1, s.r[hi], s.pc);
+        push(s.sp - 2, s.r[hi + 1], s.pc);
+        s.sp -= 2;
+      } else {
+        s.r[hi + 1] = load(s.sp);
+        s.r[hi] = load(s.sp + 1);
+        s.sp += 2;
+      }
+      return;
+    }
+    fail("can't analyze opcode", s.pc);
+  }
+
+  // 1 or 0 when the condition of Jcc / Ccc / Rcc `op` is known, else -1
+  int cond(const State &s, uint8_t op) const {
+    static const uint8_t flag[4] = {FLAG_Z, FLAG_CY, FLAG_P, FLAG_S};
+    uint8_t fl = flag[op >> 4 & 3];
+    if (!(s.fknown & fl)) return -1;
+    bool set = s.f & fl;
+    return (op & 8) ? set : !set;
+  }
+
+  State join(const State &a, const State &b, uint16_t pc) {
+    if (a.end != b.end || (!a.end && a.pc != b.pc) || a.sp != b.sp)
+      fail("paths that can't be joined", pc);
+    State s = a;
+    for (int i = 0; i < 8; i++)
+      if (!(a.r[i] == b.r[i])) s.r[i] = unknownVal;
+    s.fknown = a.fknown & b.fknown & ~(a.f ^ b.f);
+    s.f = a.f & s.fknown;
+    if (!(a.zsrc == b.zsrc)) s.zsrc = unknownVal;
+    s.t = std::max(a.t, b.t);
+    for (int i = 0; i < MAX_LOOPS; i++)
+      s.iters[i] = std::max(a.iters[i], b.iters[i]);
+    return s;
+  }
+
+  // runs s both ways from a branch (arm() sets up each way) to `until`,
+  // then joins the two states and their stores
+  void fork(State &s, int32_t until, const Func &fn,
+            const std::function<void(State &, bool)> &arm) {
+    if (forkDepth >= MAX_DEPTH) return fail("paths nested too deep", s.pc);
+    size_t mark = journal.size();
+    forkDepth++;
+
+    State a = s;
+    arm(a, true);
+    if (!a.end && a.pc != until) exec(a, until, fn);
+    std::unordered_map<uint16_t, Val> storedA;
+    for (size_t i = mark; i < journal.size(); i++)
+      storedA[journal[i].first] = mem[journal[i].first];
+    for (size_t i = journal.size(); i-- > mark;)
+      mem[journal[i].first] = journal[i].second;
+    journal.resize(mark);
+
+    State b = s;
+    arm(b, false);
+    if (!b.end && b.pc != until) exec(b, until, fn);
+
+    // a byte either way stored to keeps its value only if both agree
+    std::vector<uint16_t> differ;
+    std::unordered_map<uint16_t, Val> before;
+    for (size_t i = mark; i < journal.size(); i++)
+      before.insert(journal[i]);
+    for (auto &[addr, va] : storedA)
+      if (!(va == mem[addr])) differ.push_back(addr);
+    for (auto &[addr, old] : before)
+      if (!storedA.count(addr) && !(old == mem[addr])) differ.push_back(addr);
+
+    forkDepth--;
+    s = join(a, b, s.pc);
+    for (uint16_t addr : differ) store(addr, unknownVal, s.pc);
+    if (!forkDepth) journal.clear();
+  }
+
+  // until pc reaches `until`, or the function returns or the program stops
+  void exec(State &s, int32_t until, const Func &fn) {
+    while (error.empty() && s.pc != until) {
+      if (++steps > MAX_STEPS) return fail("gave up after 2e9 steps", s.pc);
+      uint8_t op = cfg.opAt(s.pc);
+      uint16_t imm = as.image[(uint16_t)(s.pc + 1)] |
+                     as.image[(uint16_t)(s.pc + 2)] << 8;
+      uint16_t next = s.pc + opInfo8085.len[op];
+      uint8_t t = opInfo8085.tstates[op], taken = opInfo8085.tstatesTaken[op];
+      int c = (op >= 0xC0 && (lo(op) == 0 || lo(op) == 2 || lo(op) == 4))
+                  ? cond(s, op)
+                  : 1;
+
+      if (isHalt(op)) {
+        s.t += t;
+        s.end = END_HALT;
+        return;
+      }
+
+      if (isJump(op)) {
+        auto loop = cfg.loopAt.find(s.pc);
+        if (c >= 0) {
+          s.t += c ? taken : t;
+          if (c && loop != cfg.loopAt.end() && loop->second < MAX_LOOPS)
+            s.iters[loop->second]++;
+          s.pc = c ? imm : next;
+          continue;
+        }
+        if (loop != cfg.loopAt.end() && cfg.loops[loop->second].latch == s.pc) {
+          if ((op >> 4 & 3) == 0 && s.zsrc.kind == V_INPUT)
+            wantSize = s.zsrc.addr;
+          return fail("loop bound depends on data", s.pc);
+        }
+        fork(s, fn.ipdom.find(s.pc)->second, fn, [&](State &x, bool yes) {
+          x.t += yes ? taken : t;
+          x.pc = yes ? imm : next;
+        });
+        continue;
+      }
+
+      if (isCall(op)) {
+        auto call = [&](State &x, bool yes) {
+          if (!yes) {
+            x.t += t;
+            x.pc = next;
+            return;
+          }
+          x.t += taken;
+          push(x.sp - 1, knownVal(next >> 8), x.pc);
+          push(x.sp - 2, knownVal(next), x.pc);
+          x.sp -= 2;
+          x.pc = imm;
+          exec(x, EXIT, cfg.funcs[cfg.funcAt.at(imm)]);
+          if (x.end == END_RET) x.end = END_NONE;
+        };
+        if (c >= 0)
+          call(s, c);
+        else
+          fork(s, next, fn, call);
+        if (s.end) return;
+        continue;
+      }
+
+      if (isRet(op)) {
+        auto ret = [&](State &x, bool yes) {
+          if (!yes) {
+            x.t += t;
+            x.pc = next;
+            return;
+          }
+          x.t += op == 0xC9 ? t : taken;
+          Val l = load(x.sp), h = load(x.sp + 1);
+          if (!l.known() || !h.known())
+            return fail("return to an unknown address", x.pc);
+          x.sp += 2;
+          x.pc = h.v << 8 | l.v;
+          x.end = END_RET;
+        };
+        if (c >= 0) {
+          ret(s, c);
+        } else {
+          fork(s, fn.ipdom.find(s.pc)->second, fn, ret);
+        }
+        if (s.end) return;
+        continue;
+      }
+
+      s.t += t;
+      step(s, op, imm);
+      s.pc = next;
+    }
+  }
+
+  static int lo(uint8_t op) { return op & 7; }
+};
+
+// ---------------------------------------------------------------------------
+// reporting
+
+struct Rational {
+  long long n, d;
+
+  Rational(long long n = 0, long long d = 1) : n(n), d(d) { norm(); }
+  void norm() {
+    if (d < 0) n = -n, d = -d;
+    long long g = std::gcd(n < 0 ? -n : n, d);
+    if (g > 1) n /= g, d /= g;
+  }
+  Rational operator+(Rational o) const { return {n * o.d + o.n * d, d * o.d}; }
+  Rational operator-(Rational o) const { return {n * o.d - o.n * d, d * o.d}; }
+  Rational operator*(Rational o) const { return {n * o.n, d * o.d}; }
+  Rational operator/(Rational o) const { return {n * o.d, d * o.n}; }
+  bool zero() const { return n == 0; }
+};
+
+// coefficients (constant first) of the polynomial through the points
+std::vector<Rational> fit(const std::vector<std::pair<int, uint64_t>> &pts) {
+  size_t k = pts.size();
+  std::vector<std::vector<Rational>> m(k, std::vector<Rational>(k + 1));
+  for (size_t i = 0; i < k; i++) {
+    Rational x = 1;
+    for (size_t j = 0; j < k; j++, x = x * Rational(pts[i].first)) m[i][j] = x;
+    m[i][k] = Rational((long long)pts[i].second);
+  }
+  for (size_t c = 0; c < k; c++) {
+    size_t p = c;
+    while (m[p][c].zero()) p++;
+    std::swap(m[p], m[c]);
+    for (size_t i = 0; i < k; i++) {
+      if (i == c || m[i][c].zero()) continue;
+      Rational f = m[i][c] / m[c][c];
+      for (size_t j = c; j <= k; j++) m[i][j] = m[i][j] - f * m[c][j];
+    }
+  }
+  std::vector<Rational> coef(k);
+  for (size_t i = 0; i < k; i++) coef[i] = m[i][k] / m[i][i];
+  return coef;
+}
+
+bool fits(const std::vector<Rational> &coef, int x, uint64_t y) {
+  Rational v, p = 1;
+  for (auto &c : coef) v = v + c * p, p = p * Rational(x);
+  return v.d == 1 && v.n == (long long)y;
+}
+
+std::string polyText(const std::vector<Rational> &coef, const char *x) {
+  std::string s;
+  for (size_t i = coef.size(); i-- > 0;) {
+    Rational c = coef[i];
+    if (c.zero()) continue;
+    bool neg = c.n < 0;
+    if (neg) c.n = -c.n;
+    s += s.empty() ? (neg ? "-" : "") : (neg ? " - " : " + ");
+    if (i == 0 || c.n != 1 || c.d != 1) {
+      s += std::to_string(c.n);
+      if (c.d != 1) s += "/" + std::to_string(c.d);
+      if (i) s += " ";
+    }
+    if (i) s += x;
+    if (i > 1) s += "^" + std::to_string(i);
+  }
+  return s.empty() ? "0" : s;
+}
+
+bool readFile(const fs::path &path, std::string &out) {
+  std::ifstream in(path, std::ios::binary);
+  if (!in) return false;
+  std::ostringstream ss;
+  ss << in.rdbuf();
+  out = ss.str();
+  return true;
+}
+
+// the label a source line starts with, if any
+std::string labelOf(const std::string &line) {
+  size_t colon = line.find(':');
+  if (colon == std::string::npos) return "";
+  size_t b = line.find_first_not_of(" \t");
+  return b < colon ? line.substr(b, colon - b) : "";
+}
+
+// one sampled set of input sizes
+struct Sample {
+  std::vector<uint8_t> size;
+  bool ok;
+  std::string error;
+  uint64_t bound;
+  std::vector<uint32_t> iters;
+  uint64_t worstRun;  // most T-states runProfiled measured
+};
+
+int analyze(const fs::path &path, int samples, bool all) {
+  std::string src;
+  if (!readFile(path, src)) {
+    std::cerr << "wcet8085: cannot read " << path << "\n";
+    return 1;
+  }
+  std::string name = path.filename().string();
+  auto as = std::make_unique<Assembler8085>();
+  if (!as->assemble(src, name)) {
+    printf("== %s: doesn't assemble (%s)\n", name.c_str(),
+           as->errors.empty() ? "" : as->errors[0].c_str());
+    return 1;
+  }
+
+  std::vector<std::string> lines{""};
+  std::istringstream in(src);
+  for (std::string l; std::getline(in, l);) lines.push_back(l);
+  std::unordered_map<uint16_t, std::string> label;
+  for (auto &[line, addr] : as->insnLines())
+    if (!label.count(addr)) label[addr] = labelOf(lines[line]);
+
+  Cfg cfg;
+  if (!cfg.build(*as)) {
+    printf("== %s: %s\n", name.c_str(), cfg.error.c_str());
+    return 1;
+  }
+  printf("== %s: %zu instructions, %zu function(s), %zu loop(s)\n",
+         name.c_str(), cfg.instructions(), cfg.funcs.size(), cfg.loops.size());
+  for (uint16_t a : cfg.offEnd)
+    printf("  runs off the end at %04X, taken as RST 1 there\n", a);
+  for (auto &l : cfg.loops) {
+    printf("  loop %04X-%04X %-10s", l.lo, l.hi, label[l.header].c_str());
+    if (l.counter >= 0)
+      printf(" counter %c (DCR %c / branch at %04X)\n", regName[l.counter],
+             regName[l.counter], l.latch);
+    else
+      printf(" no DCR counter (branch at %04X)\n", l.latch);
+  }
+
+  // find the input bytes that bound loops
+  Analyzer an(*as, cfg);
+  State st;
+  while (!an.run(st)) {
+    if (an.wantSize < 0 || an.sizes.size() == 3) {
+      printf("  can't bound: %s\n", an.error.c_str());
+      return 1;
+    }
+    an.sizes.push_back({(uint16_t)an.wantSize, 0});
+  }
+
+  std::vector<std::vector<uint8_t>> grid{{}};
+  std::vector<int> values;
+  if (an.sizes.size() == 1)
+    values = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 24,
+              32, 48, 64, 96, 128, 160, 192, 224, 254, 255};
+  else
+    values = {0, 1, 2, 5, 16, 64, 255};
+  if (all) {
+    values.clear();
+    for (int v = 0; v < 256; v++) values.push_back(v);
+  }
+  for (size_t i = 0; i < an.sizes.size(); i++) {
+    std::vector<std::vector<uint8_t>> g;
+    for (auto &prev : grid)
+      for (int v : values) {
+        g.push_back(prev);
+        g.back().push_back(v);
+      }
+    grid = g;
+  }
+
+  if (an.sizes.empty()) {
+    printf("  no input sizes: the bound is one number\n");
+  } else {
+    printf("  input size(s):");
+    for (auto &sz : an.sizes) printf(" [%04X]", sz.first);
+    printf("\n");
+  }
+
+  auto cpu = std::make_unique<Cpu8085>();
+  auto prof = std::make_unique<Profile8085>();
+  std::mt19937 rng(8085);
+  std::vector<Sample> results;
+  for (auto &g : grid) {
+    Sample sm{g, false, "", 0, {}, 0};
+    for (size_t i = 0; i < g.size(); i++) an.sizes[i].second = g[i];
+    sm.ok = an.run(st);
+    sm.error = an.error;
+    sm.bound = st.t;
+    sm.iters.assign(st.iters, st.iters + std::min<size_t>(MAX_LOOPS,
+                                                          cfg.loops.size()));
+
+    for (int k = 0; k < samples && sm.ok; k++) {
+      for (auto &b : cpu->mem) b = rng();
+      for (uint32_t a = 0; a < 0x10000; a++)
+        if (as->isUsed(a)) cpu->mem[a] = as->image[a];
+      for (auto &sz : an.sizes) cpu->mem[sz.first] = sz.second;
+      for (uint16_t a : cfg.offEnd) cpu->mem[a] = 0xCF;
+      cpu->reset();
+      prof->clear();
+      cpu->runProfiled(sm.bound + 1, *prof);
+      sm.worstRun = std::max(sm.worstRun, prof->total);
+    }
+    results.push_back(sm);
+  }
+
+  // table
+  printf("  ");
+  for (auto &sz : an.sizes) printf("[%04X] ", sz.first);
+  printf("%12s %12s", "worst T", "random max");
+  for (auto &l : cfg.loops)
+    printf(" %10.10s", label[l.header].empty() ? "loop" :
+                                                 label[l.header].c_str());
+  printf("\n");
+  int over = 0, failed = 0;
+  double tight = 0;
+  for (auto &sm : results) {
+    printf("  ");
+    for (uint8_t v : sm.size) printf("    %02X ", v);
+    if (!sm.ok) {
+      printf("%s\n", sm.error.c_str());
+      failed++;
+      continue;
+    }
+    printf("%12llu %12llu", (unsigned long long)sm.bound,
+           (unsigned long long)sm.worstRun);
+    for (uint32_t it : sm.iters) printf(" %10u", it);
+    printf("%s\n", sm.worstRun > sm.bound ? "  OVER THE BOUND" : "");
+    if (sm.worstRun > sm.bound) over++;
+    if (sm.bound) tight = std::max(tight, (double)sm.worstRun / sm.bound);
+  }
+
+  // one size: the worst case as a polynomial, fitted on the largest sizes
+  // and extended down as far as it keeps matching
+  if (an.sizes.size() == 1) {
+    std::vector<std::pair<int, uint64_t>> pts;
+    for (auto &sm : results)
+      if (sm.ok) pts.push_back({sm.size[0], sm.bound});
+    size_t bestFrom = pts.size();
+    std::vector<Rational> best;
+    for (size_t deg = 0; deg < 4 && deg < pts.size(); deg++) {
+      std::vector<std::pair<int, uint64_t>> top(pts.end() - deg - 1,
+                                                pts.end());
+      std::vector<Rational> coef = fit(top);
+      size_t from = pts.size();
+      while (from > 0 && fits(coef, pts[from - 1].first, pts[from - 1].second))
+        from--;
+      if (from < bestFrom && pts.size() - from > deg + 1) {
+        bestFrom = from;
+        best = coef;
+      }
+    }
+    if (!best.empty())
+      printf("  worst case = %s T-states for n = [%04X] = %d..%d (%zu sizes)\n",
+             polyText(best, "n").c_str(), an.sizes[0].first,
+             pts[bestFrom].first, pts.back().first, pts.size() - bestFrom);
+    else
+      printf("  worst case: no polynomial of degree 3 or less in [%04X]\n",
+             an.sizes[0].first);
+  }
+
+  printf("  runProfiled, %d random images per size: %s, at most %.1f%% of "
+         "the bound\n",
+         samples, over ? "SOME RUNS OVER THE BOUND" : "none over the bound",
+         tight * 100);
+  return over || failed ? 1 : 0;
+}
+
+int main(int argc, char *argv[]) {
+  int samples = 20;
+  bool all = false;
+  std::vector<fs::path> inputs;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--samples" && i + 1 < argc)
+      samples = std::max(0, atoi(argv[++i]));
+    else if (arg == "--all")
+      all = true;
+    else
+      inputs.push_back(arg);
+  }
+  if (inputs.empty()) {
+    std::cerr << "usage: " << argv[0]
+              << " [--samples N] [--all] FILE.asm|DIR ...\n";
+    return 1;
+  }
+
+  std::vector<fs::path> files;
+  for (auto &in : inputs) {
+    if (fs::is_directory(in)) {
+      std::vector<fs::path> dir;
+      for (auto &e : fs::directory_iterator(in))
+        if (e.is_regular_file() && e.path().extension() == ".asm")
+          dir.push_back(e.path());
+      std::sort(dir.begin(), dir.end());
+      files.insert(files.end(), dir.begin(), dir.end());
+    } else {
+      files.push_back(in);
+    }
+  }
+
+  int bad = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (auto &f : files) bad += analyze(f, samples, all);
+  double sec =
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - start)
+          .count();
+  printf("%zu file(s) in %.2f s, %d not bounded or over the bound\n",
+         files.size(), sec, bad);
+  return bad ? 1 : 0;
+}
@@ -0,0 +1,204 @@
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <string>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "fastIO.h"
+
+using namespace std;
+
+// fastIO.h against the usual ways of reading a judge's input: cin as the
+// codeChef solutions had it (synced with stdio), cin with
+// sync_with_stdio(false) and an untied cout, and scanf. N integers (default
+// 10M, one to a few per line like a test file) are written to a temp file,
+// once a mix of small counts and values up to 1e9 with some negatives and
+// once all of 9 or 10 digits. each reader runs in a forked child with that
+// file as its stdin: sync_with_stdio only means anything before the first
+// read, so every reader starts from a fresh process. the children send back
+// the time and a checksum of what they read. the writers read the mixed
+// file with FastInput and print it to /dev/null one number a line.
+//
+// build: g++ -O2 -march=native fastIOBench.cpp
+// run:   ./fastIOBench.out [N]
+
+struct Result {
+  double sec;
+  long long sum;
+};
+
+static double secondsSince(chrono::steady_clock::time_point t) {
+  return chrono::duration<double>(chrono::steady_clock::now() - t).count();
+}
+
+// f() in a child with path as stdin and /dev/null as stdout
+template <class F>
+static Result inChild(const char *path, F f) {
+  int fds[2];
+  Result r{-1, 0};
+  if (pipe(fds) != 0)
+    return r;
+  fflush(stdout);  // or the child writes out what is buffered as well
+  pid_t pid = fork();
+  if (pid == 0) {
+    close(fds[0]);
+    if (!freopen(path, "r", stdin) || !freopen("/dev/null", "w", stdout))
+      _exit(1);
+    auto t = chrono::steady_clock::now();
+    long long sum = f();
+    fflush(stdout);
+    cout.flush();
+    Result out{secondsSince(t), sum};
+    ssize_t put = write(fds[1], &out, sizeof(out));
+    _exit(put == sizeof(out) ? 0 : 1);
+  }
+  close(fds[1]);
+  if (pid > 0) {
+    if (read(fds[0], &r, sizeof(r)) != sizeof(r))
+      r.sec = -1;
+    waitpid(pid, nullptr, 0);
+  }
+  close(fds[0]);
+  return r;
+}
+
+int main(int argc, char *argv[]) {
+  long long n = argc > 1 ? atoll(argv[1]) : 10000000;
+  if (n < 1)
+    n = 1;
+
+  // mixed: small counts and values up to 1e9, some negative. wide: every
+  // value 9 or 10 digits, where taking 8 at a time should pay most
+  char path[] = "/tmp/fastIOBenchXXXXXX";
+  long long want = 0;
+  auto makeFile = [&](bool wide) {
+    int fd = mkstemp(path);
+    if (fd < 0)
+      return false;
+    FILE *f = fdopen(fd, "w");
+    mt19937_64 rng(148);
+    want = 0;
+    for (long long i = 0; i < n; i++) {
+      uint64_t r = rng();
+      long long v = wide          ? 100000000 + (long long)(r >> 8) % 2000000000
+                    : r % 4 == 0 ? (long long)(r >> 8) % 1000000001
+                    : r % 4 == 1 ? -(long long)((r >> 8) % 100000)
+                                 : (long long)(r >> 8) % 1000;
+      want += v;
+      fprintf(f, "%lld%c", v, r % 3 == 0 ? '\n' : ' ');
+    }
+    fclose(f);
+    return true;
+  };
+  auto report = [&](const char *what, Result r) {
+    if (r.sec < 0) {
+      printf("  %-28s failed\n", what);
+      return;
+    }
+    printf("  %-28s %8.1f M ints/s%s\n", what, n / r.sec / 1e6,
+           r.sum == want ? "" : "  WRONG");
+  };
+
+  auto readers = [&](bool wide) {
+    printf("%lld integers, %s\n", n, wide ? "9 and 10 digits" : "mixed");
+    report("cin", inChild(path, [&] {
+             long long s = 0, v;
+             for (long long i = 0; i < n && cin >> v; i++)
+               s += v;
+             return s;
+           }));
+    report("cin, sync_with_stdio(false)", inChild(path, [&] {
+             ios::sync_with_stdio(false);
+             cin.tie(nullptr);
+             long long s = 0, v;
+             for (long long i = 0; i < n && cin >> v; i++)
+               s += v;
+             return s;
+           }));
+    report("scanf", inChild(path, [&] {
+             long long s = 0, v;
+             for (long long i = 0; i < n && scanf("%lld", &v) == 1; i++)
+               s += v;
+             return s;
+           }));
+    report("FastInput, a digit at a time", inChild(path, [&] {
+             FastInput in;
+             long long s = 0;
+             for (long long i = 0; i < n; i++)
+               s += in.readIntBytewise<long long>();
+             return s;
+           }));
+    report("FastInput", inChild(path, [&] {
+             FastInput in;
+             long long s = 0;
+             for (long long i = 0; i < n; i++)
+               s += in.readInt<long long>();
+             return s;
+           }));
+  };
+
+  if (!makeFile(false)) {
+    cerr << "fastIOBench: cannot make a temp file" << endl;
+    return 1;
+  }
+  readers(false);
+  // the same numbers back out, one per line
+  printf("writing them\n");
+  report("cout << endl", inChild(path, [&] {
+           FastInput in;
+           long long s = 0;
+           for (long long i = 0; i < n; i++) {
+             long long v = in.readInt<long long>();
+             cout << v << endl;
+             s += v;
+           }
+           return s;
+         }));
+  report("cout << '\\n', unsynced", inChild(path, [&] {
+           ios::sync_with_stdio(false);
+           FastInput in;
+           long long s = 0;
+           for (long long i = 0; i < n; i++) {
+             long long v = in.readInt<long long>();
+             cout << v << '\n';
+             s += v;
+           }
+           return s;
+         }));
+  report("printf", inChild(path, [&] {
+           FastInput in;
+           long long s = 0;
+           for (long long i = 0; i < n; i++) {
+             long long v = in.readInt<long long>();
+             printf("%lld\n", v);
+             s += v;
+           }
+           return s;
+         }));
+  report("FastOutput", inChild(path, [&] {
+           FastInput in;
+           FastOutput out;
+           long long s = 0;
+           for (long long i = 0; i < n; i++) {
+             long long v = in.readInt<long long>();
+             out << v << '\n';
+             s += v;
+           }
+           return s;
+         }));
+  unlink(path);
+
+  strcpy(path, "/tmp/fastIOBenchXXXXXX");
+  if (!makeFile(true)) {
+    cerr << "fastIOBench: cannot make a temp file" << endl;
+    return 1;
+  }
+  readers(true);
+  unlink(path);
+  return 0;
+}
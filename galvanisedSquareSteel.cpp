@@ -1,27 +1,29 @@
 #include <iostream>
 #include <string>
 
+#include "stringInterner.h"
+
 using namespace std;
 
+// categorical fields (author, file format, gender, subject) repeat across
+// records, so they are interned: one copy in the pool, 4 bytes per record.
+// the unique ones stay strings. every constructor takes its strings by
+// const reference, so each field is copied once, into the record.
+
 class Book {
 private:
   string title;
-  string author;
+  InternedStr author;
   string isbn;
   int price;
   int year;
   int pages;
 
 public:
-  Book(string title, string author, string isbn, int price, int year,
-       int pages) {
-    this->title = title;
-    this->author = author;
-    this->price = price;
-    this->isbn = isbn;
-    this->year = year;
-    this->pages = pages;
-  }
+  Book(const string &title, const string &author, const string &isbn,
+       int price, int year, int pages)
+      : title(title), author(author), isbn(isbn), price(price), year(year),
+        pages(pages) {}
 
   void display() {
     cout << "Title: " << title << endl;
@@ -36,15 +38,12 @@ public:
 class EBook : public Book {
 private:
   double fileSize;
-  string fileFormat;
+  InternedStr fileFormat;
 
 public:
-  EBook(string t, string a, string i, int p, int y, int pg, double fs,
-        string ff)
-      : Book(t, a, i, p, y, pg) {
-    this->fileSize = fs;
-    this->fileFormat = ff;
-  }
+  EBook(const string &t, const string &a, const string &i, int p, int y,
+        int pg, double fs, const string &ff)
+      : Book(t, a, i, p, y, pg), fileSize(fs), fileFormat(ff) {}
 
   void display() {
     Book::display();
@@ -58,9 +57,7 @@ protected:
   double audio_len;
 
 public:
-  AudioBook(Book &book, double audio_len) : Book(book) {
-    this->audio_len = audio_len;
-  }
+  AudioBook(Book &book, double audio_len) : Book(book), audio_len(audio_len) {}
 
   void display() {
     Book::display();
@@ -73,14 +70,11 @@ class Person {
 protected:
   string name;
   string dob;
-  string gender;
+  InternedStr gender;
 
 public:
-  Person(string name, string dob, string gender) {
-    this->name = name;
-    this->dob = dob;
-    this->gender = gender;
-  }
+  Person(const string &name, const string &dob, const string &gender)
+      : name(name), dob(dob), gender(gender) {}
 
   int calcAge(int yr) {
     int birthYr = stoi(this->dob) % 10000;
@@ -101,16 +95,12 @@ protected:
   double salary;
 
 public:
-  Employee(string name, string dob, string gender, int empId, double salary)
-      : Person(name, dob, gender) {
-    this->empId = empId;
-    this->salary = salary;
-  }
+  Employee(const string &name, const string &dob, const string &gender,
+           int empId, double salary)
+      : Person(name, dob, gender), empId(empId), salary(salary) {}
 
-  Employee(Person &p, int empId, int salary) : Person(p) {
-    this->empId = empId;
-    this->salary = salary;
-  }
+  Employee(Person &p, int empId, int salary)
+      : Person(p), empId(empId), salary(salary) {}
 
   void display() {
     Person::display();
@@ -122,20 +112,15 @@ public:
 
 class Teacher : public Employee {
 protected:
-  string subject;
+  InternedStr subject;
   int semester;
 
 public:
-  Teacher(Employee &e, string subject, int sem) : Employee(e) {
-    this->subject = subject;
-    this->semester = sem;
-  }
+  Teacher(Employee &e, const string &subject, int sem)
+      : Employee(e), subject(subject), semester(sem) {}
 
-  Teacher(Person &p, int empId, double salary, string subject, int sem)
-      : Employee(p, empId, salary) {
-    this->subject = subject;
-    this->semester = sem;
-  }
+  Teacher(Person &p, int empId, double salary, const string &subject, int sem)
+      : Employee(p, empId, salary), subject(subject), semester(sem) {}
 
   void display() {
     Employee::display();
@@ -150,10 +135,8 @@ protected:
   float cgpa;
 
 public:
-  Student(Person &p, int roll, float cgpa) : Person(p) {
-    this->roll = roll;
-    this->cgpa = cgpa;
-  }
+  Student(Person &p, int roll, float cgpa)
+      : Person(p), roll(roll), cgpa(cgpa) {}
 
   void display() {
     Person::display();
@@ -166,7 +149,7 @@ class TeachingAssistant : public Student, public Teacher {
 
 public:
   TeachingAssistant(Person &p, int eID, double sal, int roll, float cgpa,
-                    string subject, int sem)
+                    const string &subject, int sem)
       : Student(p, roll, cgpa), Teacher(p, eID, sal, subject, sem) {}
 
   void display() {
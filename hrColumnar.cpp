@@ -0,0 +1,385 @@
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+
+// columnar version of the Person/Employee/Teacher/Student records from
+// galvanisedSquareSteel.cpp. one row per person, one vector per field, so
+// an age filter only touches the dob column and a salary sum only touches
+// the salary column.
+//
+// build: g++ -O2 -march=native hrColumnar.cpp
+// run:   ./hrColumnar.out [rows]
+
+// ---------------------------------------------------------------------------
+// object form (same layout as galvanisedSquareSteel.cpp), kept for the bench
+
+class Person {
+protected:
+  string name;
+  string dob;
+  string gender;
+
+public:
+  Person(string name, string dob, string gender) {
+    this->name = name;
+    this->dob = dob;
+    this->gender = gender;
+  }
+
+  int calcAge(int yr) {
+    int birthYr = stoi(this->dob) % 10000;
+    return yr - birthYr;
+  }
+};
+
+class Employee : public Person {
+protected:
+  int empId;
+  double salary;
+
+public:
+  Employee(Person &p, int empId, double salary) : Person(p) {
+    this->empId = empId;
+    this->salary = salary;
+  }
+
+  double getSalary() { return salary; }
+};
+
+// ---------------------------------------------------------------------------
+// dictionary for the string columns: every distinct string is stored once and
+// the column holds its 32 bit code
+
+class StringDict {
+private:
+  unordered_map<string, uint32_t> codes;
+  vector<string> strs;
+
+public:
+  uint32_t encode(const string &s) {
+    auto it = codes.find(s);
+    if (it != codes.end())
+      return it->second;
+
+    uint32_t code = strs.size();
+    codes.emplace(s, code);
+    strs.push_back(s);
+    return code;
+  }
+
+  // -1 if the string never made it into the column (matches no code)
+  int64_t lookup(const string &s) const {
+    auto it = codes.find(s);
+    return (it == codes.end()) ? -1 : it->second;
+  }
+
+  const string &decode(uint32_t code) const { return strs[code]; }
+  size_t size() const { return strs.size(); }
+};
+
+// dob is packed as yyyy << 9 | mm << 5 | dd so the year is a single shift
+// (no stoi, no division) and packed dates still compare in date order
+static inline uint32_t packDate(int dd, int mm, int yyyy) {
+  return (uint32_t)yyyy << 9 | (uint32_t)mm << 5 | (uint32_t)dd;
+}
+
+// "ddmmyyyy" as used by Person in galvanisedSquareSteel.cpp
+static inline uint32_t packDob(const string &ddmmyyyy) {
+  int v = stoi(ddmmyyyy);
+  return packDate(v / 1000000, (v / 10000) % 100, v % 10000);
+}
+
+static inline int dobDay(uint32_t d) { return d & 31; }
+static inline int dobMonth(uint32_t d) { return (d >> 5) & 15; }
+static inline int dobYear(uint32_t d) { return d >> 9; }
+
+// a TeachingAssistant is both a Student and a Teacher; in the object form it
+// carries two copies of Person, here it is one row with two role bits
+enum Role : uint8_t {
+  ROLE_EMPLOYEE = 1,
+  ROLE_TEACHER = 2,
+  ROLE_STUDENT = 4,
+};
+
+class PersonStore {
+public:
+  // Person
+  vector<uint32_t> name;
+  vector<uint32_t> dob;
+  vector<uint32_t> gender;
+  vector<uint8_t> role;
+
+  // Employee / Teacher (0 when the role bit is not set)
+  vector<int32_t> empId;
+  vector<double> salary;
+  vector<uint32_t> subject;
+  vector<uint8_t> semester;
+
+  // Student
+  vector<int32_t> roll;
+  vector<float> cgpa;
+
+  StringDict names;
+  StringDict genders;
+  StringDict subjects;
+
+  size_t size() const { return dob.size(); }
+
+  void reserve(size_t n) {
+    name.reserve(n);
+    dob.reserve(n);
+    gender.reserve(n);
+    role.reserve(n);
+    empId.reserve(n);
+    salary.reserve(n);
+    subject.reserve(n);
+    semester.reserve(n);
+    roll.reserve(n);
+    cgpa.reserve(n);
+  }
+
+  size_t addPerson(const string &n, const string &ddmmyyyy, const string &g) {
+    name.push_back(names.encode(n));
+    dob.push_back(packDob(ddmmyyyy));
+    gender.push_back(genders.encode(g));
+    role.push_back(0);
+    empId.push_back(0);
+    salary.push_back(0);
+    subject.push_back(0);
+    semester.push_back(0);
+    roll.push_back(0);
+    cgpa.push_back(0);
+    return size() - 1;
+  }
+
+  void makeEmployee(size_t row, int id, double sal) {
+    role[row] |= ROLE_EMPLOYEE;
+    empId[row] = id;
+    salary[row] = sal;
+  }
+
+  void makeTeacher(size_t row, const string &sub, int sem) {
+    role[row] |= ROLE_TEACHER;
+    subject[row] = subjects.encode(sub);
+    semester[row] = sem;
+  }
+
+  void makeStudent(size_t row, int r, float gpa) {
+    role[row] |= ROLE_STUDENT;
+    roll[row] = r;
+    cgpa[row] = gpa;
+  }
+
+  // age of every row as of year yr, in one pass over the dob column. no
+  // branches and no calls in the body, so the compiler turns it into a
+  // plain SIMD shift + subtract
+  void ages(int yr, int16_t *out) const {
+    const uint32_t *d = dob.data();
+    size_t n = dob.size();
+    for (size_t i = 0; i < n; i++)
+      out[i] = (int16_t)(yr - (int)(d[i] >> 9));
+  }
+
+  // age filter -> selection bytes (1 = row passes). an age range is a birth
+  // year range, which is a packed dob range, so this is two compares per row
+  // against the raw column
+  size_t selectAge(int yr, int lo, int hi, uint8_t *sel) const {
+    uint32_t minDob = packDate(0, 0, yr - hi);
+    uint32_t maxDob = packDate(31, 15, yr - lo);
+    const uint32_t *d = dob.data();
+    size_t n = dob.size();
+    size_t count = 0;
+
+    for (size_t i = 0; i < n; i++) {
+      uint8_t pass = (d[i] >= minDob) & (d[i] <= maxDob);
+      sel[i] = pass;
+      count += pass;
+    }
+    return count;
+  }
+
+  // narrows sel to the rows having every bit in mask
+  size_t selectRole(uint8_t mask, uint8_t *sel) const {
+    const uint8_t *r = role.data();
+    size_t n = role.size();
+    size_t count = 0;
+
+    for (size_t i = 0; i < n; i++) {
+      uint8_t pass = sel[i] & ((r[i] & mask) == mask);
+      sel[i] = pass;
+      count += pass;
+    }
+    return count;
+  }
+
+  // narrows sel to one gender; an unknown gender empties it
+  size_t selectGender(const string &g, uint8_t *sel) const {
+    int64_t code = genders.lookup(g);
+    const uint32_t *gd = gender.data();
+    size_t n = gender.size();
+    size_t count = 0;
+
+    for (size_t i = 0; i < n; i++) {
+      uint8_t pass = sel[i] & (gd[i] == code);
+      sel[i] = pass;
+      count += pass;
+    }
+    return count;
+  }
+
+  // salary of unselected rows is multiplied by 0 instead of branched on
+  double sumSalary(const uint8_t *sel) const {
+    const double *s = salary.data();
+    size_t n = salary.size();
+    double sum = 0;
+
+    for (size_t i = 0; i < n; i++)
+      sum += s[i] * sel[i];
+    return sum;
+  }
+
+  void display(size_t row) const {
+    uint32_t d = dob[row];
+    cout << "Name: " << names.decode(name[row]) << endl;
+    cout << "DOB: " << dobDay(d) << "/" << dobMonth(d) << "/" << dobYear(d)
+         << endl;
+    cout << "Gender: " << genders.decode(gender[row]) << endl;
+
+    if (role[row] & ROLE_EMPLOYEE) {
+      cout << "Emp Id: " << empId[row] << endl;
+      cout << "Salary: " << salary[row] << endl;
+    }
+    if (role[row] & ROLE_STUDENT) {
+      cout << "Roll No: " << roll[row] << endl;
+      cout << "CGPA: " << cgpa[row] << endl;
+    }
+    if (role[row] & ROLE_TEACHER) {
+      cout << "Subject: " << subjects.decode(subject[row]) << endl;
+      cout << "Semester: " << (int)semester[row] << endl;
+    }
+  }
+};
+
+// ---------------------------------------------------------------------------
+// bench
+
+static double msSince(chrono::steady_clock::time_point t) {
+  return chrono::duration<double, milli>(chrono::steady_clock::now() - t)
+      .count();
+}
+
+// deterministic fake people: ~1000 distinct first names, 2 genders
+static string fakeDob(uint32_t &seed) {
+  seed = seed * 1103515245 + 12345;
+  int dd = 1 + (seed >> 8) % 28;
+  int mm = 1 + (seed >> 16) % 12;
+  int yy = 1950 + (seed >> 4) % 55;
+
+  char buf[16];
+  snprintf(buf, sizeof(buf), "%02d%02d%04d", dd, mm, yy);
+  return buf;
+}
+
+int main(int argc, char *argv[]) {
+  size_t n = (argc > 1) ? strtoull(argv[1], nullptr, 10) : 2000000;
+  const int year = 2024;
+  const int lo = 25, hi = 40;
+
+  cout << "rows: " << n << endl;
+
+  // same input for both forms
+  vector<string> dobs(n);
+  uint32_t seed = 42;
+  for (size_t i = 0; i < n; i++)
+    dobs[i] = fakeDob(seed);
+
+  // object form
+  auto t = chrono::steady_clock::now();
+  vector<Employee> emps;
+  emps.reserve(n);
+  for (size_t i = 0; i < n; i++) {
+    Person p("Person" + to_string(i % 1000), dobs[i],
+             (i & 1) ? "male" : "female");
+    emps.emplace_back(p, (int)i, 20000 + (i % 50000));
+  }
+  double objBuild = msSince(t);
+
+  t = chrono::steady_clock::now();
+  size_t objCount = 0;
+  double objSum = 0;
+  for (auto &e : emps) {
+    int age = e.calcAge(year);
+    if (age >= lo && age <= hi) {
+      objCount++;
+      objSum += e.getSalary();
+    }
+  }
+  double objQuery = msSince(t);
+
+  // columnar form
+  t = chrono::steady_clock::now();
+  PersonStore store;
+  store.reserve(n);
+  for (size_t i = 0; i < n; i++) {
+    size_t row = store.addPerson("Person" + to_string(i % 1000), dobs[i],
+                                 (i & 1) ? "male" : "female");
+    store.makeEmployee(row, (int)i, 20000 + (i % 50000));
+  }
+  double colBuild = msSince(t);
+
+  vector<uint8_t> sel(n);
+  t = chrono::steady_clock::now();
+  store.selectAge(year, lo, hi, sel.data());
+  size_t colCount = store.selectRole(ROLE_EMPLOYEE, sel.data());
+  double colSum = store.sumSalary(sel.data());
+  double colQuery = msSince(t);
+
+  vector<int16_t> age(n);
+  t = chrono::steady_clock::now();
+  store.ages(year, age.data());
+  double colAges = msSince(t);
+
+  cout << "object   build " << objBuild << " ms, age " << lo << "-" << hi
+       << " + salary sum " << objQuery << " ms (" << objCount << ", "
+       << objSum << ")" << endl;
+  cout << "columnar build " << colBuild << " ms, age " << lo << "-" << hi
+       << " + salary sum " << colQuery << " ms (" << colCount << ", "
+       << colSum << ")" << endl;
+  cout << "columnar age of every row: " << colAges << " ms" << endl;
+  cout << "query speedup: " << objQuery / colQuery << "x" << endl;
+
+  if (objCount != colCount || objSum != colSum) {
+    cout << "MISMATCH between object and columnar results" << endl;
+    return 1;
+  }
+
+  // the people from galvanisedSquareSteel.cpp
+  PersonStore demo;
+  size_t adrien = demo.addPerson("Adrien", "09092005", "male");
+  demo.makeEmployee(adrien, 123, 50000);
+  demo.makeTeacher(adrien, "Geography", 4);
+
+  size_t louis = demo.addPerson("Louis", "14071789", "male");
+  demo.makeEmployee(louis, 124, 12000);
+  demo.makeTeacher(louis, "EVS", 4);
+  demo.makeStudent(louis, 15, 7.9);
+
+  vector<int16_t> demoAge(demo.size());
+  demo.ages(year, demoAge.data());
+
+  cout << endl;
+  demo.display(adrien);
+  cout << "Age of this person is " << demoAge[adrien] << " yrs" << endl;
+  cout << endl;
+  cout << "Teaching Assistant Details:" << endl;
+  demo.display(louis);
+
+  return 0;
+}
@@ -0,0 +1,145 @@
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <malloc.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "stringInterner.h"
+
+using namespace std;
+
+// memory + construction rate of the Employee record from
+// whatIsInheritanceAnyways.cpp, with plain strings copied in (the old
+// constructors) vs interned categorical fields and moved unique fields.
+//
+// build: g++ -O2 internBench.cpp
+// run:   ./internBench.out [records]   (default 10M)
+
+// ---------------------------------------------------------------------------
+// heap in use as glibc sees it: small chunks + mmap'd big ones (the record
+// vectors themselves end up there)
+static size_t heapBytes() {
+  struct mallinfo2 mi = mallinfo2();
+  return mi.uordblks + mi.hblkhd;
+}
+
+// ---------------------------------------------------------------------------
+
+class CopiedEmployee {
+protected:
+  string name;
+  string empId;
+  string gender;
+  string department;
+  string designation;
+
+  int age;
+  int salary;
+
+public:
+  CopiedEmployee(string n, string eId, int age, string g, string dept,
+                 int s) {
+    this->name = n;
+    this->empId = eId;
+    this->age = age;
+    this->gender = g;
+    this->department = dept;
+    this->salary = s;
+    this->designation = "Employee";
+  }
+
+  int getSalary() { return salary; }
+};
+
+class InternedEmployee {
+protected:
+  string name;
+  string empId;
+  InternedStr gender;
+  InternedStr department;
+  InternedStr designation;
+
+  int age;
+  int salary;
+
+public:
+  InternedEmployee(string n, string eId, int age, const string &g,
+                   const string &dept, int s)
+      : name(move(n)), empId(move(eId)), gender(g), department(dept),
+        designation("Employee"), age(age), salary(s) {}
+
+  int getSalary() { return salary; }
+};
+
+static const string genders[] = {"Male", "Female"};
+static const string departments[] = {
+    "Intern Management", "Human Resources Department",
+    "Software Engineering", "Accounts and Payroll",
+    "Research and Development", "Customer Success Operations",
+    "Facilities Management", "Legal and Compliance"};
+
+// names and ids are long enough to spill out of the small string buffer, so
+// both forms pay for them; only the categorical fields differ
+static string nameOf(size_t i) {
+  return "Employee Number " + to_string(i);
+}
+
+static string idOf(size_t i) { return "D-24601-" + to_string(i); }
+
+template <class E>
+static void bench(const char *label, size_t n) {
+  size_t bytesBefore = heapBytes();
+  size_t poolBefore = Interner::global().bytes();
+
+  auto t = chrono::steady_clock::now();
+  vector<E> emps;
+  emps.reserve(n);
+  for (size_t i = 0; i < n; i++) {
+    emps.emplace_back(nameOf(i), idOf(i), 20 + i % 40, genders[i & 1],
+                      departments[i % 8], 15000 + i % 1000);
+  }
+  double sec =
+      chrono::duration<double>(chrono::steady_clock::now() - t).count();
+
+  // the pool is shared, count only what this run added
+  size_t heap = heapBytes() - bytesBefore;
+  size_t pool = Interner::global().bytes() - poolBefore;
+
+  long long total = 0;
+  for (auto &e : emps) total += e.getSalary();
+
+  cout << label << ": sizeof " << sizeof(E) << " B, heap "
+       << heap / (1024.0 * 1024.0) << " MiB (" << (double)heap / n
+       << " B/record, pool +" << pool << " B), " << n / sec / 1e6
+       << " M records/s [checksum " << total << "]" << endl;
+}
+
+int main(int argc, char *argv[]) {
+  size_t n = (argc > 1) ? strtoull(argv[1], nullptr, 10) : 10000000;
+
+  // a fresh pool whose first string is empty, as InternedStr() makes it
+  Interner fresh;
+  uint32_t empty = fresh.intern(""), x = fresh.intern("x");
+  if (fresh.lookup(empty) != "" || fresh.lookup(x) != "x" ||
+      fresh.intern("") != empty) {
+    cout << "interner: empty string first FAILED" << endl;
+    return 1;
+  }
+
+  cout << "records: " << n << endl;
+
+  // warm the pool so its fixed cost isn't charged to the interned run
+  for (auto &g : genders) InternedStr warm(g);
+  for (auto &d : departments) InternedStr warm(d);
+  InternedStr warm("Employee");
+
+  bench<CopiedEmployee>("copied strings  ", n);
+  bench<InternedEmployee>("interned + moved", n);
+
+  cout << "pool: " << Interner::global().size() << " strings, "
+       << Interner::global().bytes() << " B" << endl;
+
+  return 0;
+}
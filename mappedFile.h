@@ -0,0 +1,45 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// read-only mapping of a whole file, for the payroll tools. the pages are
+// advised sequential: everything that maps one reads it front to back.
+
+class MappedFile {
+ public:
+  const char *data = nullptr;
+  size_t size = 0;
+
+  MappedFile() = default;
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+
+  // false if the file can't be opened, is empty, or can't be mapped
+  bool open(const char *path) {
+    int fd = ::open(path, O_RDONLY);
+    if (fd < 0) return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+      ::close(fd);
+      return false;
+    }
+    void *p = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (p == MAP_FAILED) return false;
+    madvise(p, st.st_size, MADV_SEQUENTIAL);
+    data = (const char *)p;
+    size = st.st_size;
+    return true;
+  }
+
+  ~MappedFile() {
+    if (data) munmap((void *)data, size);
+  }
+};
+
+#endif
@@ -0,0 +1,718 @@
+/*
+ * two pass assembler for a MIPS32 subset, laid out the way MARS does it
+ *
+ *   text at 00400000, data at 10010000, little endian, no delay slots
+ *
+ * instructions: add addu sub subu and or xor nor slt sltu sllv srlv srav
+ * sll srl sra mul mult multu div divu mfhi mflo mthi mtlo jr jalr syscall,
+ * addi addiu slti sltiu andi ori xori lui, lb lbu lh lhu lw sb sh sw,
+ * beq bne blez bgtz bltz bgez j jal. pseudo instructions: li la move nop
+ * not neg b beqz bnez blt bge bgt ble, lw/sw and friends on a label, and
+ * the R-type ALU ops with an immediate as the last operand (add $sp,$sp,4).
+ * $at is used by the ones that take two words.
+ *
+ * directives: .text .data .word .half .byte .space .ascii .asciiz .align,
+ * .globl and .ent/.end are accepted and ignored. comments start with '#'.
+ *
+ * with lenient set, a line that doesn't parse (the notes in
+ * `Microprocessor 8085/almostMIPS.asm` mix in pseudo-RISC and C) is left
+ * out and its message kept in `warnings` instead of failing the file.
+ */
+
+#ifndef ASMMIPS_H
+#define ASMMIPS_H
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+const uint32_t TEXT_BASE_MIPS = 0x00400000;
+const uint32_t DATA_BASE_MIPS = 0x10010000;
+
+struct ProgramMips {
+  std::vector<uint32_t> text;  // words from TEXT_BASE_MIPS
+  std::vector<int> textLine;   // source line of each word
+  std::vector<uint8_t> data;   // bytes from DATA_BASE_MIPS
+  uint32_t entry;
+};
+
+class AssemblerMips {
+ private:
+  enum Kind : uint8_t {
+    K_R3,      // rd, rs, rt (or an immediate: then the I form in `alt`)
+    K_SHIFTV,  // rd, rt, rs
+    K_SHIFT,   // rd, rt, shamt
+    K_RS,      // rs
+    K_RD,      // rd
+    K_RSRT,    // rs, rt
+    K_JALR,    // [rd,] rs
+    K_NONE,    // syscall, nop
+    K_I3,      // rt, rs, imm
+    K_LUI,     // rt, imm
+    K_MEM,     // rt, off(rs) | label
+    K_BR2,     // rs, rt, label
+    K_BR1,     // rs, label
+    K_J,       // label
+    K_LI,      // rd, imm
+    K_LA,      // rd, label
+    K_MOVE,    // rd, rs
+    K_NOT,     // rd, rs
+    K_NEG,     // rd, rs
+    K_B,       // label
+    K_BRZ,     // rs, label
+    K_BRCMP,   // rs, rt, label: slt $at + beq/bne
+  };
+
+  struct Insn {
+    Kind kind;
+    uint32_t word;  // opcode and funct bits, the rest zero
+    uint32_t alt;   // K_R3: the I form for an immediate; K_BRCMP: swap
+  };
+
+  enum OperandKind : uint8_t { O_REG, O_IMM, O_LABEL, O_MEM };
+
+  struct Operand {
+    OperandKind kind;
+    int reg;  // O_REG, O_MEM base
+    int64_t imm;
+    std::string label;  // O_LABEL, or O_MEM with a label and no base
+  };
+
+  struct Stmt {
+    const Insn *insn;
+    std::vector<Operand> ops;
+    uint32_t addr;
+    int line, words;
+  };
+
+  static uint32_t R(int fn) { return fn; }
+  static uint32_t I(int op) { return (uint32_t)op << 26; }
+  static constexpr int SUB_AS_ADDI = 1;  // alt of sub/subu: negate
+
+  const std::unordered_map<std::string, Insn> &insns() {
+    static const std::unordered_map<std::string, Insn> table = {
+        {"add", {K_R3, R(32), I(8)}},     {"addu", {K_R3, R(33), I(9)}},
+        {"sub", {K_R3, R(34), I(8) | SUB_AS_ADDI}},
+        {"subu", {K_R3, R(35), I(9) | SUB_AS_ADDI}},
+        {"and", {K_R3, R(36), I(12)}},    {"or", {K_R3, R(37), I(13)}},
+        {"xor", {K_R3, R(38), I(14)}},    {"nor", {K_R3, R(39), 0}},
+        {"slt", {K_R3, R(42), I(10)}},    {"sltu", {K_R3, R(43), I(11)}},
+        {"mul", {K_R3, I(0x1C) | 2, 0}},  {"sllv", {K_SHIFTV, R(4), 0}},
+        {"srlv", {K_SHIFTV, R(6), 0}},    {"srav", {K_SHIFTV, R(7), 0}},
+        {"sll", {K_SHIFT, R(0), 0}},      {"srl", {K_SHIFT, R(2), 0}},
+        {"sra", {K_SHIFT, R(3), 0}},      {"jr", {K_RS, R(8), 0}},
+        {"mthi", {K_RS, R(17), 0}},       {"mtlo", {K_RS, R(19), 0}},
+        {"mfhi", {K_RD, R(16), 0}},       {"mflo", {K_RD, R(18), 0}},
+        {"mult", {K_RSRT, R(24), 0}},     {"multu", {K_RSRT, R(25), 0}},
+        {"div", {K_RSRT, R(26), 0}},      {"divu", {K_RSRT, R(27), 0}},
+        {"jalr", {K_JALR, R(9), 0}},      {"syscall", {K_NONE, R(12), 0}},
+        {"nop", {K_NONE, 0, 0}},          {"addi", {K_I3, I(8), 0}},
+        {"addiu", {K_I3, I(9), 0}},       {"slti", {K_I3, I(10), 0}},
+        {"sltiu", {K_I3, I(11), 0}},      {"andi", {K_I3, I(12), 0}},
+        {"ori", {K_I3, I(13), 0}},        {"xori", {K_I3, I(14), 0}},
+        {"lui", {K_LUI, I(15), 0}},       {"lb", {K_MEM, I(32), 0}},
+        {"lh", {K_MEM, I(33), 0}},        {"lw", {K_MEM, I(35), 0}},
+        {"lbu", {K_MEM, I(36), 0}},       {"lhu", {K_MEM, I(37), 0}},
+        {"sb", {K_MEM, I(40), 0}},        {"sh", {K_MEM, I(41), 0}},
+        {"sw", {K_MEM, I(43), 0}},        {"beq", {K_BR2, I(4), 0}},
+        {"bne", {K_BR2, I(5), 0}},        {"blez", {K_BR1, I(6), 0}},
+        {"bgtz", {K_BR1, I(7), 0}},       {"bltz", {K_BR1, I(1), 0}},
+        {"bgez", {K_BR1, I(1) | 1 << 16, 0}},
+        {"j", {K_J, I(2), 0}},            {"jal", {K_J, I(3), 0}},
+        {"li", {K_LI, 0, 0}},             {"la", {K_LA, 0, 0}},
+        {"move", {K_MOVE, 0, 0}},         {"not", {K_NOT, 0, 0}},
+        {"neg", {K_NEG, 0, 0}},           {"b", {K_B, 0, 0}},
+        {"beqz", {K_BRZ, I(4), 0}},       {"bnez", {K_BRZ, I(5), 0}},
+        // slt $at, a, b then beq/bne $at, $0; alt 1 swaps a and b
+        {"blt", {K_BRCMP, I(5), 0}},      {"bge", {K_BRCMP, I(4), 0}},
+        {"bgt", {K_BRCMP, I(5), 1}},      {"ble", {K_BRCMP, I(4), 1}},
+    };
+    return table;
+  }
+
+  static int regNumber(std::string_view s) {
+    static const char *const names[32] = {
+        "zero", "at", "v0", "v1", "a0", "a1", "a2", "a3", "t0", "t1", "t2",
+        "t3",   "t4", "t5", "t6", "t7", "s0", "s1", "s2", "s3", "s4", "s5",
+        "s6",   "s7", "t8", "t9", "k0", "k1", "gp", "sp", "fp", "ra"};
+    if (s.size() < 2 || s[0] != '$') return -1;
+    s.remove_prefix(1);
+    if (s[0] >= '0' && s[0] <= '9') {
+      int n = 0;
+      for (char c : s) {
+        if (c < '0' || c > '9') return -1;
+        n = n * 10 + c - '0';
+        if (n > 31) return -1;
+      }
+      return n;
+    }
+    if (s == "s8") return 30;
+    for (int i = 0; i < 32; i++)
+      if (s == names[i]) return i;
+    return -1;
+  }
+
+  static std::string_view trim(std::string_view s) {
+    while (!s.empty() && (s.front() == ' ' || s.front() == '\t')) {
+      s.remove_prefix(1);
+    }
+    while (!s.empty() && (s.back() == ' ' || s.back() == '\t' ||
+                          s.back() == '\r')) {
+      s.remove_suffix(1);
+    }
+    return s;
+  }
+
+  static bool isIdent(std::string_view s) {
+    if (s.empty() || (s[0] >= '0' && s[0] <= '9')) return false;
+    for (char c : s)
+      if (!((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+            (c >= '0' && c <= '9') || c == '_' || c == '.'))
+        return false;
+    return true;
+  }
+
+  // decimal, 0x hex, 'c' or '\n', with a sign
+  static bool number(std::string_view s, int64_t &v) {
+    s = trim(s);
+    bool neg = false;
+    if (!s.empty() && (s[0] == '-' || s[0] == '+')) {
+      neg = s[0] == '-';
+      s.remove_prefix(1);
+    }
+    if (s.empty()) return false;
+    if (s.size() == 3 && s[0] == '\'' && s[2] == '\'') {
+      v = (uint8_t)s[1];
+    } else if (s.size() == 4 && s[0] == '\'' && s[1] == '\\' &&
+               s[3] == '\'') {
+      v = s[2] == 'n' ? '\n' : s[2] == 't' ? '\t' : s[2] == '0' ? 0 : s[2];
+    } else {
+      int base = 10;
+      if (s.size() > 2 && s[0] == '0' && (s[1] == 'x' || s[1] == 'X')) {
+        base = 16;
+        s.remove_prefix(2);
+      }
+      v = 0;
+      for (char c : s) {
+        int d = c >= '0' && c <= '9'   ? c - '0'
+                : c >= 'a' && c <= 'f' ? c - 'a' + 10
+                : c >= 'A' && c <= 'F' ? c - 'A' + 10
+                                       : 99;
+        if (d >= base) return false;
+        v = v * base + d;
+        if (v > 0xFFFFFFFFLL) return false;
+      }
+    }
+    if (neg) v = -v;
+    return true;
+  }
+
+  bool operand(std::string_view s, Operand &o) {
+    s = trim(s);
+    o = Operand{O_IMM, 0, 0, ""};
+    size_t open = s.find('(');
+    if (open != std::string_view::npos) {
+      if (s.back() != ')') return false;
+      std::string_view off = trim(s.substr(0, open));
+      o.kind = O_MEM;
+      o.reg = regNumber(trim(s.substr(open + 1, s.size() - open - 2)));
+      if (o.reg < 0) return false;
+      return off.empty() || number(off, o.imm);
+    }
+    if (!s.empty() && s[0] == '$') {
+      o.kind = O_REG;
+      return (o.reg = regNumber(s)) >= 0;
+    }
+    if (number(s, o.imm)) return true;
+    if (!isIdent(s)) return false;
+    o.kind = O_LABEL;
+    o.label = s;
+    return true;
+  }
+
+  // operand kinds each instruction kind takes ("r" register, "i"
+  // immediate, "l" label, "m" memory or label, "x" register or immediate)
+  static const char *shape(Kind k) {
+    switch (k) {
+      case K_R3:
+        return "rrx";
+      case K_SHIFTV:
+        return "rrr";
+      case K_SHIFT:
+        return "rri";
+      case K_RS:
+      case K_RD:
+        return "r";
+      case K_RSRT:
+      case K_MOVE:
+      case K_NOT:
+      case K_NEG:
+        return "rr";
+      case K_JALR:
+        return "r";  // or "rr", handled below
+      case K_NONE:
+        return "";
+      case K_I3:
+        return "rri";
+      case K_LUI:
+      case K_LI:
+        return "ri";
+      case K_MEM:
+        return "rm";
+      case K_BR2:
+      case K_BRCMP:
+        return "rrl";
+      case K_BR1:
+      case K_BRZ:
+        return "rl";
+      case K_J:
+      case K_B:
+        return "l";
+      case K_LA:
+        return "rl";
+    }
+    return "";
+  }
+
+  std::string fileName;
+  std::unordered_map<std::string, uint32_t> labels;
+  std::vector<Stmt> stmts;
+  bool lenient;
+
+  void error(int line, const std::string &msg) {
+    (lenient ? warnings : errors)
+        .push_back(fileName + ":" + std::to_string(line) + ": " + msg);
+  }
+
+  // the words an instruction takes, -1 if its operands don't fit it
+  int words(const Insn &in, const std::vector<Operand> &ops,
+            std::string &why) {
+    const char *want = shape(in.kind);
+    size_t n = strlen(want);
+    if (in.kind == K_JALR && ops.size() == 2) n = 2, want = "rr";
+    if (ops.size() != n) {
+      why = "expected " + std::to_string(n) + " operand(s)";
+      return -1;
+    }
+    for (size_t i = 0; i < n; i++) {
+      OperandKind k = ops[i].kind;
+      bool ok = want[i] == 'r'   ? k == O_REG
+                : want[i] == 'i' ? k == O_IMM
+                : want[i] == 'l' ? k == O_LABEL
+                : want[i] == 'm' ? k == O_MEM || k == O_LABEL
+                                 : k == O_REG || k == O_IMM;
+      if (!ok) {
+        why = "bad operand " + std::to_string(i + 1);
+        return -1;
+      }
+    }
+    if (in.kind == K_R3 && ops[2].kind == O_IMM && !in.alt) {
+      why = "no immediate form";
+      return -1;
+    }
+    switch (in.kind) {
+      case K_LI: {
+        int64_t v = ops[1].imm;
+        return (v >= -0x8000 && v < 0x10000) ? 1 : 2;
+      }
+      case K_LA:
+      case K_BRCMP:
+        return 2;
+      case K_MEM:
+        return ops[1].kind == O_LABEL ? 2 : 1;
+      default:
+        return 1;
+    }
+  }
+
+  bool resolve(const std::string &name, int line, uint32_t &v) {
+    auto it = labels.find(name);
+    if (it == labels.end()) {
+      error(line, "undefined label " + name);
+      return false;
+    }
+    v = it->second;
+    return true;
+  }
+
+  static uint32_t rtype(uint32_t base, int rs, int rt, int rd, int sh) {
+    return base | rs << 21 | rt << 16 | rd << 11 | (sh & 31) << 6;
+  }
+  static uint32_t itype(uint32_t base, int rs, int rt, int64_t imm) {
+    return base | rs << 21 | rt << 16 | ((uint32_t)imm & 0xFFFF);
+  }
+
+  bool fits16(int64_t v, bool zeroExtended, int line) {
+    if (zeroExtended ? (v >= 0 && v < 0x10000) : (v >= -0x8000 && v < 0x8000))
+      return true;
+    error(line, "immediate out of range");
+    return false;
+  }
+
+  // pass 2: the words of one statement, false on an error
+  bool encode(const Stmt &s, std::vector<uint32_t> &out) {
+    const Insn &in = *s.insn;
+    const auto &o = s.ops;
+    const int AT = 1;
+    uint32_t target;
+    auto branch = [&](uint32_t at, const std::string &label, int64_t &off) {
+      if (!resolve(label, s.line, target)) return false;
+      off = ((int64_t)target - (at + 4)) / 4;
+      return fits16(off, false, s.line);
+    };
+    int64_t off;
+
+    switch (in.kind) {
+      case K_R3:
+        if (o[2].kind == O_IMM) {
+          bool negate = in.alt & SUB_AS_ADDI;
+          int64_t v = negate ? -o[2].imm : o[2].imm;
+          uint32_t op = in.alt & ~SUB_AS_ADDI;
+          bool zx = op == I(12) || op == I(13) || op == I(14);
+          if (!fits16(v, zx, s.line)) return false;
+          out.push_back(itype(op, o[1].reg, o[0].reg, v));
+        } else {
+          out.push_back(rtype(in.word, o[1].reg, o[2].reg, o[0].reg, 0));
+        }
+        return true;
+      case K_SHIFTV:
+        out.push_back(rtype(in.word, o[2].reg, o[1].reg, o[0].reg, 0));
+        return true;
+      case K_SHIFT:
+        if (o[2].imm < 0 || o[2].imm > 31) {
+          error(s.line, "shift amount out of range");
+          return false;
+        }
+        out.push_back(rtype(in.word, 0, o[1].reg, o[0].reg, o[2].imm));
+        return true;
+      case K_RS:
+        out.push_back(rtype(in.word, o[0].reg, 0, 0, 0));
+        return true;
+      case K_RD:
+        out.push_back(rtype(in.word, 0, 0, o[0].reg, 0));
+        return true;
+      case K_RSRT:
+        out.push_back(rtype(in.word, o[0].reg, o[1].reg, 0, 0));
+        return true;
+      case K_JALR:
+        if (o.size() == 2)
+          out.push_back(rtype(in.word, o[1].reg, 0, o[0].reg, 0));
+        else
+          out.push_back(rtype(in.word, o[0].reg, 0, 31, 0));
+        return true;
+      case K_NONE:
+        out.push_back(in.word);
+        return true;
+      case K_I3: {
+        bool zx = in.word == I(12) || in.word == I(13) || in.word == I(14);
+        if (!fits16(o[2].imm, zx, s.line)) return false;
+        out.push_back(itype(in.word, o[1].reg, o[0].reg, o[2].imm));
+        return true;
+      }
+      case K_LUI:
+        if (!fits16(o[1].imm, true, s.line)) return false;
+        out.push_back(itype(in.word, 0, o[0].reg, o[1].imm));
+        return true;
+      case K_MEM:
+        if (o[1].kind == O_MEM) {
+          if (!fits16(o[1].imm, false, s.line)) return false;
+          out.push_back(itype(in.word, o[1].reg, o[0].reg, o[1].imm));
+        } else {
+          if (!resolve(o[1].label, s.line, target)) return false;
+          out.push_back(itype(I(15), 0, AT, (target + 0x8000) >> 16));
+          out.push_back(itype(in.word, AT, o[0].reg, target & 0xFFFF));
+        }
+        return true;
+      case K_BR2:
+        if (!branch(s.addr, o[2].label, off)) return false;
+        out.push_back(itype(in.word, o[0].reg, o[1].reg, off));
+        return true;
+      case K_BR1:
+        if (!branch(s.addr, o[1].label, off)) return false;
+        out.push_back(itype(in.word, o[0].reg, 0, off));
+        return true;
+      case K_J:
+        if (!resolve(o[0].label, s.line, target)) return false;
+        if ((target ^ (s.addr + 4)) & 0xF0000000) {
+          error(s.line, "jump out of range");
+          return false;
+        }
+        out.push_back(in.word | (target >> 2 & 0x3FFFFFF));
+        return true;
+      case K_LI: {
+        int64_t v = o[1].imm;
+        if (v >= -0x8000 && v < 0x8000) {
+          out.push_back(itype(I(9), 0, o[0].reg, v));  // addiu
+        } else if (v >= 0 && v < 0x10000) {
+          out.push_back(itype(I(13), 0, o[0].reg, v));  // ori
+        } else {
+          out.push_back(itype(I(15), 0, AT, (uint32_t)v >> 16));
+          out.push_back(itype(I(13), AT, o[0].reg, v & 0xFFFF));
+        }
+        return true;
+      }
+      case K_LA:
+        if (!resolve(o[1].label, s.line, target)) return false;
+        out.push_back(itype(I(15), 0, AT, target >> 16));
+        out.push_back(itype(I(13), AT, o[0].reg, target & 0xFFFF));
+        return true;
+      case K_MOVE:
+        out.push_back(rtype(R(33), o[1].reg, 0, o[0].reg, 0));
+        return true;
+      case K_NOT:
+        out.push_back(rtype(R(39), o[1].reg, 0, o[0].reg, 0));
+        return true;
+      case K_NEG:
+        out.push_back(rtype(R(34), 0, o[1].reg, o[0].reg, 0));
+        return true;
+      case K_B:
+        if (!branch(s.addr, o[0].label, off)) return false;
+        out.push_back(itype(I(4), 0, 0, off));
+        return true;
+      case K_BRZ:
+        if (!branch(s.addr, o[1].label, off)) return false;
+        out.push_back(itype(in.word, o[0].reg, 0, off));
+        return true;
+      case K_BRCMP: {
+        int a = o[0].reg, b = o[1].reg;
+        if (in.alt) std::swap(a, b);
+        out.push_back(rtype(R(42), a, b, AT, 0));
+        if (!branch(s.addr + 4, o[2].label, off)) return false;
+        out.push_back(itype(in.word, AT, 0, off));
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // splits on commas outside quotes
+  static std::vector<std::string_view> split(std::string_view s) {
+    std::vector<std::string_view> out;
+    size_t start = 0;
+    bool quoted = false;
+    for (size_t i = 0; i < s.size(); i++) {
+      if (s[i] == '"' && (i == 0 || s[i - 1] != '\\')) quoted = !quoted;
+      if (s[i] == ',' && !quoted) {
+        out.push_back(trim(s.substr(start, i - start)));
+        start = i + 1;
+      }
+    }
+    std::string_view last = trim(s.substr(start));
+    if (!last.empty() || !out.empty()) out.push_back(last);
+    return out;
+  }
+
+  static bool unquote(std::string_view s, std::string &out) {
+    if (s.size() < 2 || s.front() != '"' || s.back() != '"') return false;
+    out.clear();
+    for (size_t i = 1; i + 1 < s.size(); i++) {
+      char c = s[i];
+      if (c == '\\' && i + 2 < s.size()) {
+        c = s[++i];
+        c = c == 'n' ? '\n' : c == 't' ? '\t' : c == '0' ? '\0' : c;
+      }
+      out.push_back(c);
+    }
+    return true;
+  }
+
+  // directives that put bytes in .data; words holding labels are patched
+  // in pass 2
+  struct Fixup {
+    uint32_t at;
+    std::string label;
+    int line;
+  };
+  std::vector<Fixup> fixups;
+
+  bool directive(std::string_view name, std::string_view args, int line,
+                 bool &inText) {
+    std::vector<uint8_t> &d = prog.data;
+    auto align = [&](size_t n) {
+      while (d.size() % n) d.push_back(0);
+    };
+    if (name == ".text") {
+      inText = true;
+    } else if (name == ".data") {
+      inText = false;
+    } else if (name == ".globl" || name == ".global" || name == ".ent" ||
+               name == ".end") {
+    } else if (inText) {
+      error(line, std::string(name) + " in .text");
+      return false;
+    } else if (name == ".word" || name == ".half" || name == ".byte") {
+      size_t size = name == ".word" ? 4 : name == ".half" ? 2 : 1;
+      align(size);
+      for (std::string_view a : split(args)) {
+        int64_t v = 0;
+        if (!number(a, v)) {
+          if (size != 4 || !isIdent(a)) {
+            error(line, "bad value " + std::string(a));
+            return false;
+          }
+          fixups.push_back({(uint32_t)d.size(), std::string(a), line});
+        }
+        for (size_t i = 0; i < size; i++) d.push_back(v >> (8 * i));
+      }
+    } else if (name == ".space") {
+      int64_t n;
+      if (!number(args, n) || n < 0 || n > (1 << 24)) {
+        error(line, "bad .space");
+        return false;
+      }
+      d.resize(d.size() + n);
+    } else if (name == ".align") {
+      int64_t n;
+      if (!number(args, n) || n < 0 || n > 12) {
+        error(line, "bad .align");
+        return false;
+      }
+      align((size_t)1 << n);
+    } else if (name == ".ascii" || name == ".asciiz") {
+      std::string s;
+      if (!unquote(trim(args), s)) {
+        error(line, "expected a string");
+        return false;
+      }
+      d.insert(d.end(), s.begin(), s.end());
+      if (name == ".asciiz") d.push_back(0);
+    } else {
+      error(line, "unknown directive " + std::string(name));
+      return false;
+    }
+    return true;
+  }
+
+ public:
+  ProgramMips prog;
+  std::vector<std::string> errors;
+  std::vector<std::string> warnings;  // lines left out when lenient
+  size_t linesRead;
+
+  // true when there were no errors
+  bool assemble(std::string_view src, std::string_view name = "<source>",
+                bool lenientLines = false) {
+    fileName = name;
+    lenient = lenientLines;
+    labels.clear();
+    stmts.clear();
+    fixups.clear();
+    errors.clear();
+    warnings.clear();
+    prog = ProgramMips();
+    linesRead = 0;
+
+    // pass 1: parse, size, place labels
+    uint32_t pc = TEXT_BASE_MIPS;
+    bool inText = true;
+    const char *p = src.data(), *end = p + src.size();
+    int lineNo = 0;
+    while (p < end) {
+      const char *eol = (const char *)memchr(p, '\n', end - p);
+      if (!eol) eol = end;
+      std::string_view line(p, eol - p);
+      p = eol + 1;
+      lineNo++;
+      linesRead++;
+
+      // comment, minding '#' inside a string
+      bool quoted = false;
+      for (size_t i = 0; i < line.size(); i++) {
+        if (line[i] == '"') quoted = !quoted;
+        if (line[i] == '#' && !quoted) {
+          line = line.substr(0, i);
+          break;
+        }
+      }
+      line = trim(line);
+
+      // labels
+      while (true) {
+        size_t colon = line.find(':');
+        if (colon == std::string_view::npos ||
+            !isIdent(trim(line.substr(0, colon))))
+          break;
+        std::string label(trim(line.substr(0, colon)));
+        uint32_t at = inText ? pc : DATA_BASE_MIPS + prog.data.size();
+        if (!labels.emplace(label, at).second)
+          error(lineNo, "duplicate label " + label);
+        line = trim(line.substr(colon + 1));
+      }
+      if (line.empty()) continue;
+
+      size_t sp = line.find_first_of(" \t");
+      std::string_view mnem = line.substr(0, sp);
+      std::string_view rest =
+          sp == std::string_view::npos ? "" : trim(line.substr(sp));
+
+      if (mnem[0] == '.') {
+        directive(mnem, rest, lineNo, inText);
+        continue;
+      }
+      auto it = insns().find(std::string(mnem));
+      if (it == insns().end()) {
+        error(lineNo, "unknown instruction " + std::string(mnem));
+        continue;
+      }
+      if (!inText) {
+        error(lineNo, "instruction in .data");
+        continue;
+      }
+
+      Stmt s{&it->second, {}, pc, lineNo, 0};
+      bool ok = true;
+      for (std::string_view a : split(rest)) {
+        Operand o;
+        if (!operand(a, o)) {
+          error(lineNo, "bad operand " + std::string(a));
+          ok = false;
+          break;
+        }
+        s.ops.push_back(o);
+      }
+      std::string why;
+      if (ok && (s.words = words(*s.insn, s.ops, why)) < 0) {
+        error(lineNo, std::string(mnem) + ": " + why);
+        ok = false;
+      }
+      if (!ok) continue;
+      stmts.push_back(s);
+      pc += 4 * s.words;
+    }
+    if (!errors.empty()) return false;
+
+    // pass 2: encode
+    for (const Stmt &s : stmts) {
+      std::vector<uint32_t> w;
+      if (!encode(s, w)) w.clear();
+      w.resize(s.words, 0);  // a failed line (lenient) becomes nops
+      for (uint32_t word : w) {
+        prog.text.push_back(word);
+        prog.textLine.push_back(s.line);
+      }
+    }
+    for (const Fixup &f : fixups) {
+      uint32_t v;
+      if (!resolve(f.label, f.line, v)) continue;
+      memcpy(&prog.data[f.at], &v, 4);
+    }
+
+    prog.entry = TEXT_BASE_MIPS;
+    for (const char *name : {"main", "Main", "MAIN", "__start"}) {
+      auto it = labels.find(name);
+      if (it != labels.end()) prog.entry = it->second;
+    }
+    return errors.empty();
+  }
+
+  // -1 if undefined
+  int64_t lookup(const std::string &name) const {
+    auto it = labels.find(name);
+    return it == labels.end() ? -1 : (int64_t)it->second;
+  }
+};
+
+#endif
@@ -0,0 +1,455 @@
+/*
+ * functional simulator for the MIPS32 subset that asmmips.h assembles.
+ *
+ * the text segment is decoded once into DecodedMips records (operation,
+ * registers, sign/zero extended immediate, branch target) so the run loop
+ * is a switch over a dense enum with no field extraction. every record
+ * also carries the registers it reads and writes and its pipeline class,
+ * which is what the timing model in pipemips.h works from.
+ *
+ * memory: the data segment (program data plus DATA_ROOM_MIPS bytes after
+ * it) and a STACK_ROOM_MIPS stack below 7FFFF000. anything else, and an
+ * unaligned lw/sw/lh/sh, stops the run. add/addi/sub stop it on a signed
+ * overflow. no delay slots: a branch takes effect right away, like MARS
+ * with delayed branching off.
+ *
+ * syscalls: 1 print int, 4 print string, 10 exit, 11 print char,
+ * 17 exit with $a0. output goes to `output`. any other $v0 stops the run.
+ *
+ * run(n, hook) calls hook(d, pc, addr, taken) after each instruction, addr
+ * being the effective address of a load or store and taken whether a
+ * branch or jump left the fall through path. run(n) has no hook and is the
+ * fast mode.
+ */
+
+#ifndef CPUMIPS_H
+#define CPUMIPS_H
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "asmmips.h"
+
+const uint32_t STACK_TOP_MIPS = 0x7FFFF000;
+const uint32_t STACK_ROOM_MIPS = 1 << 20;
+const uint32_t DATA_ROOM_MIPS = 1 << 20;
+
+enum OpMips : uint8_t {
+  M_ADD, M_ADDU, M_SUB, M_SUBU, M_AND, M_OR, M_XOR, M_NOR, M_SLT, M_SLTU,
+  M_SLLV, M_SRLV, M_SRAV, M_SLL, M_SRL, M_SRA, M_MUL,
+  M_MULT, M_MULTU, M_DIV, M_DIVU, M_MFHI, M_MFLO, M_MTHI, M_MTLO,
+  M_JR, M_JALR, M_SYSCALL,
+  M_ADDI, M_ADDIU, M_SLTI, M_SLTIU, M_ANDI, M_ORI, M_XORI, M_LUI,
+  M_LB, M_LH, M_LW, M_LBU, M_LHU, M_SB, M_SH, M_SW,
+  M_BEQ, M_BNE, M_BLEZ, M_BGTZ, M_BLTZ, M_BGEZ, M_J, M_JAL,
+  M_ILLEGAL,
+};
+
+enum ClassMips : uint8_t {
+  CLS_ALU,
+  CLS_MULDIV,  // writes hi/lo
+  CLS_LOAD,
+  CLS_STORE,
+  CLS_BRANCH,  // conditional
+  CLS_JUMP,    // j, jal
+  CLS_JUMPREG, // jr, jalr
+  CLS_SYSCALL,
+};
+
+// register numbers in src/dst: 0 is "none" ($0 never causes a hazard),
+// hi and lo count as one
+const uint8_t REG_HILO_MIPS = 32;
+
+struct DecodedMips {
+  uint8_t op, cls;
+  uint8_t rd, rs, rt, shamt;
+  uint8_t src1, src2, dst;
+  int32_t imm;      // sign or zero extended, lui already shifted
+  uint32_t target;  // branches and j/jal
+};
+
+enum StopMips {
+  MSTOP_BUDGET,
+  MSTOP_EXIT,
+  MSTOP_SYSCALL,    // unsupported service
+  MSTOP_ADDRESS,    // unmapped or unaligned access
+  MSTOP_OVERFLOW,
+  MSTOP_ILLEGAL,
+  MSTOP_PC,         // ran out of the text segment
+};
+
+class CpuMips {
+ public:
+  uint32_t reg[32];
+  uint32_t hi, lo, pc;
+  uint64_t executed;
+  int exitCode;
+  std::string output;
+  uint32_t faultAddr;  // the address behind MSTOP_ADDRESS
+
+  void load(const ProgramMips &p) {
+    code.clear();
+    code.reserve(p.text.size());
+    for (size_t i = 0; i < p.text.size(); i++)
+      code.push_back(decode(p.text[i], TEXT_BASE_MIPS + 4 * i));
+    data.assign(((p.data.size() + 3) & ~(size_t)3) + DATA_ROOM_MIPS, 0);
+    memcpy(data.data(), p.data.data(), p.data.size());
+    stack.assign(STACK_ROOM_MIPS, 0);
+
+    memset(reg, 0, sizeof(reg));
+    reg[28] = 0x10008000;  // $gp
+    reg[29] = STACK_TOP_MIPS - 4;
+    hi = lo = 0;
+    pc = p.entry;
+    executed = 0;
+    exitCode = 0;
+    faultAddr = 0;
+    output.clear();
+  }
+
+  static DecodedMips decode(uint32_t w, uint32_t at) {
+    DecodedMips d{};
+    int op = w >> 26, fn = w & 63;
+    d.rs = w >> 21 & 31;
+    d.rt = w >> 16 & 31;
+    d.rd = w >> 11 & 31;
+    d.shamt = w >> 6 & 31;
+    d.imm = (int16_t)w;
+    d.target = at + 4 + (d.imm << 2);
+    d.op = M_ILLEGAL;
+    d.cls = CLS_ALU;
+
+    static const uint8_t special[64] = {
+        M_SLL, M_ILLEGAL, M_SRL, M_SRA, M_SLLV, M_ILLEGAL, M_SRLV, M_SRAV,
+        M_JR, M_JALR, M_ILLEGAL, M_ILLEGAL, M_SYSCALL, M_ILLEGAL, M_ILLEGAL,
+        M_ILLEGAL, M_MFHI, M_MTHI, M_MFLO, M_MTLO, M_ILLEGAL, M_ILLEGAL,
+        M_ILLEGAL, M_ILLEGAL, M_MULT, M_MULTU, M_DIV, M_DIVU, M_ILLEGAL,
+        M_ILLEGAL, M_ILLEGAL, M_ILLEGAL, M_ADD, M_ADDU, M_SUB, M_SUBU,
+        M_AND, M_OR, M_XOR, M_NOR, M_ILLEGAL, M_ILLEGAL, M_SLT, M_SLTU,
+        M_ILLEGAL, M_ILLEGAL, M_ILLEGAL, M_ILLEGAL, M_ILLEGAL, M_ILLEGAL,
+        M_ILLEGAL, M_ILLEGAL, M_ILLEGAL, M_ILLEGAL, M_ILLEGAL, M_ILLEGAL,
+        M_ILLEGAL, M_ILLEGAL, M_ILLEGAL, M_ILLEGAL, M_ILLEGAL, M_ILLEGAL,
+        M_ILLEGAL, M_ILLEGAL};
+    static const uint8_t primary[64] = {
+        M_ILLEGAL, M_ILLEGAL, M_J, M_JAL, M_BEQ, M_BNE, M_BLEZ, M_BGTZ,
+        M_ADDI, M_ADDIU, M_SLTI, M_SLTIU, M_ANDI, M_ORI, M_XORI, M_LUI,
+        M_ILLEGAL, M_ILLEGAL, M_ILLEGAL, M_ILLEGAL, M_ILLEGAL, M_ILLEGAL,
+        M_ILLEGAL, M_ILLEGAL, M_ILLEGAL, M_ILLEGAL, M_ILLEGAL, M_ILLEGAL,
+        M_ILLEGAL, M_ILLEGAL, M_ILLEGAL, M_ILLEGAL, M_LB, M_LH, M_ILLEGAL,
+        M_LW, M_LBU, M_LHU, M_ILLEGAL, M_ILLEGAL, M_SB, M_SH, M_ILLEGAL,
+        M_SW, M_ILLEGAL, M_ILLEGAL, M_ILLEGAL, M_ILLEGAL, M_ILLEGAL,
+        M_ILLEGAL, M_ILLEGAL, M_ILLEGAL, M_ILLEGAL, M_ILLEGAL, M_ILLEGAL,
+        M_ILLEGAL, M_ILLEGAL, M_ILLEGAL, M_ILLEGAL, M_ILLEGAL, M_ILLEGAL,
+        M_ILLEGAL, M_ILLEGAL, M_ILLEGAL};
+
+    if (op == 0) {
+      d.op = special[fn];
+    } else if (op == 1) {
+      d.op = d.rt == 0 ? M_BLTZ : d.rt == 1 ? M_BGEZ : M_ILLEGAL;
+    } else if (op == 0x1C) {
+      d.op = fn == 2 ? M_MUL : M_ILLEGAL;
+    } else {
+      d.op = primary[op];
+    }
+
+    switch (d.op) {
+      case M_ANDI:
+      case M_ORI:
+      case M_XORI:
+        d.imm = w & 0xFFFF;
+        break;
+      case M_LUI:
+        d.imm = (int32_t)(w << 16);
+        break;
+      case M_J:
+      case M_JAL:
+        d.target = ((at + 4) & 0xF0000000) | (w & 0x3FFFFFF) << 2;
+        break;
+    }
+
+    // what it reads and writes, and its class
+    switch (d.op) {
+      case M_SLL:
+      case M_SRL:
+      case M_SRA:
+        d.src1 = d.rt, d.dst = d.rd;
+        break;
+      case M_SLLV:
+      case M_SRLV:
+      case M_SRAV:
+        d.src1 = d.rt, d.src2 = d.rs, d.dst = d.rd;
+        break;
+      case M_MULT:
+      case M_MULTU:
+      case M_DIV:
+      case M_DIVU:
+        d.src1 = d.rs, d.src2 = d.rt, d.dst = REG_HILO_MIPS;
+        d.cls = CLS_MULDIV;
+        break;
+      case M_MTHI:
+      case M_MTLO:
+        d.src1 = d.rs, d.dst = REG_HILO_MIPS;
+        break;
+      case M_MFHI:
+      case M_MFLO:
+        d.src1 = REG_HILO_MIPS, d.dst = d.rd;
+        break;
+      case M_JR:
+        d.src1 = d.rs, d.cls = CLS_JUMPREG;
+        break;
+      case M_JALR:
+        d.src1 = d.rs, d.dst = d.rd, d.cls = CLS_JUMPREG;
+        break;
+      case M_SYSCALL:
+        d.src1 = 2, d.src2 = 4, d.cls = CLS_SYSCALL;
+        break;
+      case M_ADDI:
+      case M_ADDIU:
+      case M_SLTI:
+      case M_SLTIU:
+      case M_ANDI:
+      case M_ORI:
+      case M_XORI:
+        d.src1 = d.rs, d.dst = d.rt;
+        break;
+      case M_LUI:
+        d.dst = d.rt;
+        break;
+      case M_LB:
+      case M_LH:
+      case M_LW:
+      case M_LBU:
+      case M_LHU:
+        d.src1 = d.rs, d.dst = d.rt, d.cls = CLS_LOAD;
+        break;
+      case M_SB:
+      case M_SH:
+      case M_SW:
+        d.src1 = d.rs, d.src2 = d.rt, d.cls = CLS_STORE;
+        break;
+      case M_BEQ:
+      case M_BNE:
+        d.src1 = d.rs, d.src2 = d.rt, d.cls = CLS_BRANCH;
+        break;
+      case M_BLEZ:
+      case M_BGTZ:
+      case M_BLTZ:
+      case M_BGEZ:
+        d.src1 = d.rs, d.cls = CLS_BRANCH;
+        break;
+      case M_J:
+        d.cls = CLS_JUMP;
+        break;
+      case M_JAL:
+        d.dst = 31, d.cls = CLS_JUMP;
+        break;
+      case M_ILLEGAL:
+        break;
+      default:  // three register ALU ops and mul
+        d.src1 = d.rs, d.src2 = d.rt, d.dst = d.rd;
+    }
+    return d;
+  }
+
+  struct NoHook {
+    void operator()(const DecodedMips &, uint32_t, uint32_t, bool) {}
+  };
+
+  StopMips run(uint64_t maxInsns = UINT64_MAX) {
+    NoHook none;
+    return run(maxInsns, none);
+  }
+
+  template <class Hook>
+  StopMips run(uint64_t maxInsns, Hook &hook) {
+    uint32_t *R = reg;
+    while (maxInsns--) {
+      uint32_t index = (pc - TEXT_BASE_MIPS) >> 2;
+      if ((pc & 3) || index >= code.size()) return MSTOP_PC;
+      const DecodedMips &d = code[index];
+      uint32_t next = pc + 4, addr = 0;
+      uint32_t s = R[d.rs], t = R[d.rt];
+      bool taken = false;
+
+      switch (d.op) {
+        case M_ADD: {
+          uint32_t v = s + t;
+          if ((~(s ^ t) & (s ^ v)) >> 31) return MSTOP_OVERFLOW;
+          R[d.rd] = v;
+          break;
+        }
+        case M_ADDU: R[d.rd] = s + t; break;
+        case M_SUB: {
+          uint32_t v = s - t;
+          if (((s ^ t) & (s ^ v)) >> 31) return MSTOP_OVERFLOW;
+          R[d.rd] = v;
+          break;
+        }
+        case M_SUBU: R[d.rd] = s - t; break;
+        case M_AND: R[d.rd] = s & t; break;
+        case M_OR: R[d.rd] = s | t; break;
+        case M_XOR: R[d.rd] = s ^ t; break;
+        case M_NOR: R[d.rd] = ~(s | t); break;
+        case M_SLT: R[d.rd] = (int32_t)s < (int32_t)t; break;
+        case M_SLTU: R[d.rd] = s < t; break;
+        case M_SLLV: R[d.rd] = t << (s & 31); break;
+        case M_SRLV: R[d.rd] = t >> (s & 31); break;
+        case M_SRAV: R[d.rd] = (int32_t)t >> (s & 31); break;
+        case M_SLL: R[d.rd] = t << d.shamt; break;
+        case M_SRL: R[d.rd] = t >> d.shamt; break;
+        case M_SRA: R[d.rd] = (int32_t)t >> d.shamt; break;
+        case M_MUL: R[d.rd] = (uint32_t)((int64_t)(int32_t)s * (int32_t)t);
+          break;
+        case M_MULT: {
+          int64_t v = (int64_t)(int32_t)s * (int32_t)t;
+          lo = (uint32_t)v, hi = (uint32_t)((uint64_t)v >> 32);
+          break;
+        }
+        case M_MULTU: {
+          uint64_t v = (uint64_t)s * t;
+          lo = (uint32_t)v, hi = (uint32_t)(v >> 32);
+          break;
+        }
+        case M_DIV:
+          // divide by zero leaves hi/lo as they were, as MARS does
+          if (t && !(s == 0x80000000 && t == 0xFFFFFFFF)) {
+            lo = (int32_t)s / (int32_t)t, hi = (int32_t)s % (int32_t)t;
+          }
+          break;
+        case M_DIVU:
+          if (t) lo = s / t, hi = s % t;
+          break;
+        case M_MFHI: R[d.rd] = hi; break;
+        case M_MFLO: R[d.rd] = lo; break;
+        case M_MTHI: hi = s; break;
+        case M_MTLO: lo = s; break;
+        case M_JR:
+          next = s, taken = true;
+          break;
+        case M_JALR:
+          R[d.rd] = pc + 4, next = s, taken = true;
+          break;
+        case M_SYSCALL: {
+          StopMips why = syscall();
+          if (why != MSTOP_BUDGET) {
+            executed++;
+            hook(d, pc, 0, false);
+            return why;
+          }
+          break;
+        }
+        case M_ADDI: {
+          uint32_t v = s + d.imm;
+          if ((~(s ^ d.imm) & (s ^ v)) >> 31) return MSTOP_OVERFLOW;
+          R[d.rt] = v;
+          break;
+        }
+        case M_ADDIU: R[d.rt] = s + d.imm; break;
+        case M_SLTI: R[d.rt] = (int32_t)s < d.imm; break;
+        case M_SLTIU: R[d.rt] = s < (uint32_t)d.imm; break;
+        case M_ANDI: R[d.rt] = s & d.imm; break;
+        case M_ORI: R[d.rt] = s | d.imm; break;
+        case M_XORI: R[d.rt] = s ^ d.imm; break;
+        case M_LUI: R[d.rt] = d.imm; break;
+
+#define MIPS_ACCESS(size)                             \
+  addr = s + d.imm;                                   \
+  uint8_t *p = mapped(addr, size);                    \
+  if (!p) {                                           \
+    faultAddr = addr;                                 \
+    return MSTOP_ADDRESS;                             \
+  }
+        case M_LB: { MIPS_ACCESS(1) R[d.rt] = (int8_t)*p; break; }
+        case M_LBU: { MIPS_ACCESS(1) R[d.rt] = *p; break; }
+        case M_LH: {
+          MIPS_ACCESS(2)
+          int16_t v;
+          memcpy(&v, p, 2);
+          R[d.rt] = v;
+          break;
+        }
+        case M_LHU: {
+          MIPS_ACCESS(2)
+          uint16_t v;
+          memcpy(&v, p, 2);
+          R[d.rt] = v;
+          break;
+        }
+        case M_LW: { MIPS_ACCESS(4) memcpy(&R[d.rt], p, 4); break; }
+        case M_SB: { MIPS_ACCESS(1) *p = t; break; }
+        case M_SH: { MIPS_ACCESS(2) memcpy(p, &t, 2); break; }
+        case M_SW: { MIPS_ACCESS(4) memcpy(p, &t, 4); break; }
+#undef MIPS_ACCESS
+
+        case M_BEQ: taken = s == t; break;
+        case M_BNE: taken = s != t; break;
+        case M_BLEZ: taken = (int32_t)s <= 0; break;
+        case M_BGTZ: taken = (int32_t)s > 0; break;
+        case M_BLTZ: taken = (int32_t)s < 0; break;
+        case M_BGEZ: taken = (int32_t)s >= 0; break;
+        case M_J: next = d.target, taken = true; break;
+        case M_JAL: R[31] = pc + 4, next = d.target, taken = true; break;
+        default:
+          return MSTOP_ILLEGAL;
+      }
+      if (taken && d.cls == CLS_BRANCH) next = d.target;
+      R[0] = 0;
+      executed++;
+      hook(d, pc, addr, taken);
+      pc = next;
+    }
+    return MSTOP_BUDGET;
+  }
+
+  // the pc's source line for messages, 0 outside the text
+  static int lineAt(const ProgramMips &p, uint32_t at) {
+    uint32_t i = (at - TEXT_BASE_MIPS) >> 2;
+    return i < p.textLine.size() ? p.textLine[i] : 0;
+  }
+
+ private:
+  std::vector<DecodedMips> code;
+  std::vector<uint8_t> data;   // from DATA_BASE_MIPS
+  std::vector<uint8_t> stack;  // up to STACK_TOP_MIPS
+
+  uint8_t *mapped(uint32_t a, uint32_t size) {
+    if (a & (size - 1)) return nullptr;
+    if (a - DATA_BASE_MIPS < data.size()) return &data[a - DATA_BASE_MIPS];
+    uint32_t below = STACK_TOP_MIPS - a;
+    if (below - 1 < STACK_ROOM_MIPS) return &stack[STACK_ROOM_MIPS - below];
+    return nullptr;
+  }
+
+  StopMips syscall() {
+    switch (reg[2]) {
+      case 1:
+        output += std::to_string((int32_t)reg[4]);
+        return MSTOP_BUDGET;
+      case 4:
+        for (uint32_t a = reg[4];; a++) {
+          uint8_t *p = mapped(a, 1);
+          if (!p) {
+            faultAddr = a;
+            return MSTOP_ADDRESS;
+          }
+          if (!*p) break;
+          output.push_back(*p);
+        }
+        return MSTOP_BUDGET;
+      case 10:
+        return MSTOP_EXIT;
+      case 11:
+        output.push_back((char)reg[4]);
+        return MSTOP_BUDGET;
+      case 17:
+        exitCode = (int32_t)reg[4];
+        return MSTOP_EXIT;
+      default:
+        return MSTOP_SYSCALL;
+    }
+  }
+};
+
+#endif
@@ -0,0 +1,82 @@
+# C = A * B for 32x32 word matrices, naive i-j-k order, with
+# A[i][j] = i + j and B[i][j] = i - j; prints the sum of all of C.
+# the column walk through B is what a small data cache notices
+
+	.data
+A:	.space	4096
+B:	.space	4096
+C:	.space	4096
+
+	.text
+main:
+	la	$s0, A
+	la	$s1, B
+	la	$s2, C
+	li	$s7, 32
+
+	li	$t0, 0			# i
+init_i:
+	li	$t1, 0			# j
+init_j:
+	mul	$t2, $t0, $s7
+	add	$t2, $t2, $t1
+	sll	$t2, $t2, 2
+	add	$t3, $t0, $t1
+	add	$t4, $s0, $t2
+	sw	$t3, 0($t4)
+	sub	$t3, $t0, $t1
+	add	$t4, $s1, $t2
+	sw	$t3, 0($t4)
+	addi	$t1, $t1, 1
+	blt	$t1, $s7, init_j
+	addi	$t0, $t0, 1
+	blt	$t0, $s7, init_i
+
+	li	$t0, 0			# i
+mm_i:
+	li	$t1, 0			# j
+mm_j:
+	li	$t5, 0			# sum
+	sll	$t6, $t0, 7		# &A[i][0]
+	add	$t6, $s0, $t6
+	sll	$t7, $t1, 2		# &B[0][j]
+	add	$t7, $s1, $t7
+	li	$t2, 0			# k
+mm_k:
+	lw	$t3, 0($t6)
+	lw	$t4, 0($t7)
+	mul	$t3, $t3, $t4
+	add	$t5, $t5, $t3
+	addi	$t6, $t6, 4
+	addi	$t7, $t7, 128
+	addi	$t2, $t2, 1
+	bne	$t2, $s7, mm_k
+
+	sll	$t3, $t0, 5		# C[i][j] = sum
+	add	$t3, $t3, $t1
+	sll	$t3, $t3, 2
+	add	$t3, $s2, $t3
+	sw	$t5, 0($t3)
+	addi	$t1, $t1, 1
+	bne	$t1, $s7, mm_j
+	addi	$t0, $t0, 1
+	bne	$t0, $s7, mm_i
+
+	li	$t0, 0			# sum of C
+	li	$a0, 0
+	move	$t1, $s2
+	li	$t8, 1024
+total:
+	lw	$t3, 0($t1)
+	add	$a0, $a0, $t3
+	addi	$t1, $t1, 4
+	addi	$t0, $t0, 1
+	blt	$t0, $t8, total
+
+	li	$v0, 1
+	syscall
+	li	$v0, 11
+	li	$a0, '\n'
+	syscall
+	li	$v0, 10
+	syscall
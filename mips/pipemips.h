@@ -0,0 +1,233 @@
+/*
+ * timing for the classic five stage MIPS pipeline (IF ID EX MEM WB) and a
+ * set associative data cache, driven by the instruction trace of
+ * CpuMips::run(n, hook).
+ *
+ * PipelineMips keeps, for the instruction before, the cycle it entered each
+ * stage and, per register, the first cycle a reader can have the value.
+ * an instruction enters a stage when the one ahead of it has left that
+ * stage and its own inputs are there:
+ *
+ *   IF  = max(IF' + 1, ID', redirect)
+ *   ID  = max(IF + 1, EX', branch operands when branches resolve in ID)
+ *   EX  = max(ID + 1, MEM', operands)
+ *   MEM = max(EX + 1, WB', store data)
+ *   WB  = MEM + 1 + miss penalty
+ *
+ * with forwarding an ALU result can be used by the EX right after the
+ * producer's, a load's after its MEM (one load-use bubble), and store data
+ * can come straight from a load into MEM. without forwarding a value is
+ * readable in the ID of the cycle it is written back (write first half,
+ * read second half). branches are predicted not taken. resolving them in
+ * EX costs 2 cycles when taken; in ID, 1 cycle, but their operands have to
+ * be ready in ID. j and jal are always resolved in ID, jr and jalr like a
+ * branch. mult/div take one EX cycle. the instruction cache is perfect.
+ *
+ * CacheMips is write back, write allocate, LRU; a read or write miss costs
+ * the miss penalty, writing back a dirty line costs nothing (write buffer).
+ */
+
+#ifndef PIPEMIPS_H
+#define PIPEMIPS_H
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "cpumips.h"
+
+struct CacheConfigMips {
+  uint32_t size = 4096, block = 16, ways = 2;
+};
+
+class CacheMips {
+ public:
+  uint64_t reads = 0, writes = 0, readMisses = 0, writeMisses = 0;
+  uint64_t writeBacks = 0;
+
+  // false if the geometry isn't powers of two that fit together
+  bool configure(const CacheConfigMips &c) {
+    auto pow2 = [](uint32_t v) { return v && !(v & (v - 1)); };
+    if (!pow2(c.size) || !pow2(c.block) || !pow2(c.ways) || c.block < 4 ||
+        c.block * c.ways > c.size)
+      return false;
+    sets = c.size / (c.block * c.ways);
+    ways = c.ways;
+    blockShift = __builtin_ctz(c.block);
+    lines.assign((size_t)sets * ways, Line{0, 0, false, false});
+    clock = 0;
+    reads = writes = readMisses = writeMisses = writeBacks = 0;
+    return true;
+  }
+
+  // true on a hit
+  bool access(uint32_t addr, bool write) {
+    uint32_t blockNum = addr >> blockShift;
+    Line *set = &lines[(size_t)(blockNum & (sets - 1)) * ways];
+    uint32_t tag = blockNum / sets;
+    (write ? writes : reads)++;
+    clock++;
+
+    Line *victim = set;
+    for (uint32_t w = 0; w < ways; w++) {
+      Line &l = set[w];
+      if (l.valid && l.tag == tag) {
+        l.used = clock;
+        l.dirty |= write;
+        return true;
+      }
+      if (!l.valid || (victim->valid && l.used < victim->used)) victim = &l;
+    }
+    (write ? writeMisses : readMisses)++;
+    if (victim->valid && victim->dirty) writeBacks++;
+    *victim = Line{tag, clock, true, write};
+    return false;
+  }
+
+  uint64_t misses() const { return readMisses + writeMisses; }
+  double missRate() const {
+    return reads + writes ? (double)misses() / (reads + writes) : 0;
+  }
+
+ private:
+  struct Line {
+    uint32_t tag;
+    uint64_t used;
+    bool valid, dirty;
+  };
+  std::vector<Line> lines;
+  uint32_t sets = 1, ways = 1, blockShift = 4;
+  uint64_t clock = 0;
+};
+
+struct PipeConfigMips {
+  bool forwarding = true;
+  bool branchInId = false;
+  uint32_t missPenalty = 20;
+  CacheConfigMips cache;
+};
+
+class PipelineMips {
+ public:
+  CacheMips cache;
+  uint64_t instructions = 0;
+  uint64_t dataStalls = 0;     // waiting on an operand
+  uint64_t loadUseStalls = 0;  // the part of dataStalls a load caused
+  uint64_t controlStalls = 0;  // fetch redirected by a branch or jump
+  uint64_t memoryStalls = 0;   // data cache misses
+  uint64_t branches = 0, taken = 0;
+
+  explicit PipelineMips(const PipeConfigMips &c) : cfg(c) { reset(); }
+
+  bool ok() const { return cacheOk; }
+
+  void reset() {
+    cacheOk = cache.configure(cfg.cache);
+    instructions = dataStalls = loadUseStalls = 0;
+    controlStalls = memoryStalls = branches = taken = 0;
+    // as if an instruction had gone through just before the first one
+    pIF = -1, pID = 0, pEX = 1, pMEM = 2, pWB = 3;
+    redirect = 0;
+    for (int r = 0; r < 33; r++) ready[r] = Ready{0, 0, false};
+  }
+
+  // cycles until the last instruction so far has left WB, which is
+  // instructions + 4 + all the stalls
+  uint64_t cycles() const { return instructions ? pWB + 1 : 0; }
+  double cpi() const {
+    return instructions ? (double)cycles() / instructions : 0;
+  }
+
+  void operator()(const DecodedMips &d, uint32_t, uint32_t addr,
+                  bool tookIt) {
+    instructions++;
+
+    int64_t IF = pIF + 1;
+    if (pID > IF) IF = pID;
+    if (redirect > IF) IF = redirect;
+    int64_t dataWait = 0;
+    bool fromLoad = false;
+    auto wait = [&](int64_t &at, int64_t need, bool load) {
+      if (need <= at) return;
+      if (need - at > dataWait) dataWait = need - at, fromLoad = load;
+      at = need;
+    };
+
+    bool control = d.cls == CLS_BRANCH || d.cls == CLS_JUMPREG;
+    bool inId = control && cfg.branchInId;
+    int64_t ID = IF + 1;
+    if (pEX > ID) ID = pEX;
+    if (inId) {
+      for (uint8_t r : {d.src1, d.src2})
+        if (r) wait(ID, ready[r].id, ready[r].load);
+    }
+
+    int64_t EX = ID + 1;
+    if (pMEM > EX) EX = pMEM;
+    if (!inId) {
+      bool storeData = d.cls == CLS_STORE && cfg.forwarding;
+      for (uint8_t r : {d.src1, storeData ? (uint8_t)0 : d.src2})
+        if (r) wait(EX, ready[r].ex, ready[r].load);
+    }
+
+    int64_t MEM = EX + 1;
+    if (pWB > MEM) MEM = pWB;
+    if (d.cls == CLS_STORE && cfg.forwarding && d.src2)
+      wait(MEM, ready[d.src2].ex, ready[d.src2].load);
+
+    int64_t penalty = 0;
+    if (d.cls == CLS_LOAD || d.cls == CLS_STORE) {
+      if (!cache.access(addr, d.cls == CLS_STORE)) penalty = cfg.missPenalty;
+    }
+    int64_t WB = MEM + 1 + penalty;
+
+    // the cycles this instruction adds over WB' + 1, charged to its own
+    // miss first, then to waiting on operands, and the rest to a redirect.
+    // waits can be longer than what they cost (a value behind a miss), so
+    // they're only used to split the total
+    int64_t added = WB - pWB - 1;
+    int64_t mem = std::min(added, penalty);
+    int64_t data = std::min(added - mem, dataWait);
+    memoryStalls += mem;
+    dataStalls += data;
+    if (fromLoad) loadUseStalls += data;
+    controlStalls += added - mem - data;
+
+    if (d.dst) {
+      Ready &r = ready[d.dst];
+      r.load = d.cls == CLS_LOAD;
+      if (!cfg.forwarding) {
+        r.id = WB, r.ex = WB + 1;
+      } else if (r.load) {
+        r.id = r.ex = WB;  // end of MEM, after any miss
+      } else {
+        r.id = r.ex = EX + 1;
+      }
+    }
+
+    if (d.cls == CLS_BRANCH) {
+      branches++;
+      if (tookIt) taken++;
+    }
+    if (d.cls == CLS_JUMP)
+      redirect = ID + 1;
+    else if (control && tookIt)
+      redirect = (inId ? ID : EX) + 1;
+
+    pIF = IF, pID = ID, pEX = EX, pMEM = MEM, pWB = WB;
+  }
+
+ private:
+  struct Ready {
+    int64_t id, ex;  // first cycle the value can be used in that stage
+    bool load;
+  };
+
+  PipeConfigMips cfg;
+  bool cacheOk;
+  int64_t pIF, pID, pEX, pMEM, pWB;
+  int64_t redirect;
+  Ready ready[33];
+};
+
+#endif
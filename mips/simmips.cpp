@@ -0,0 +1,189 @@
+/*
+ * assembles and runs MIPS programs, then reports how they would do on a
+ * five stage pipeline with a data cache
+ *
+ *   ./simmips.out [--cache SIZE:BLOCK:WAYS] [--miss-penalty N]
+ *                 [--branch id|ex] [--no-forward] [--fast-only]
+ *                 [--limit INSNS] [--lenient] [-q] FILE ...
+ *
+ * every FILE is run twice from main (or the start of .text): once in the
+ * fast functional mode, timed to give simulated MIPS, and once with the
+ * PipelineMips trace hook of pipemips.h for cycles, CPI, the stalls by
+ * cause and the data cache miss rate. the defaults are a 4096:16:2 cache,
+ * a 20 cycle miss penalty, forwarding on and branches resolved in EX.
+ * the program's output is printed unless -q.
+ *
+ * --lenient leaves out lines that don't assemble instead of giving up on
+ * the file, which is what the notes in `Microprocessor 8085/almostMIPS.asm`
+ * need; the lines left out are listed.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "asmmips.h"
+#include "cpumips.h"
+#include "pipemips.h"
+
+static const char *stopName(StopMips why) {
+  switch (why) {
+    case MSTOP_BUDGET:
+      return "the instruction limit";
+    case MSTOP_EXIT:
+      return "exit";
+    case MSTOP_SYSCALL:
+      return "an unsupported syscall";
+    case MSTOP_ADDRESS:
+      return "a bad address";
+    case MSTOP_OVERFLOW:
+      return "an overflow";
+    case MSTOP_ILLEGAL:
+      return "an illegal instruction";
+    case MSTOP_PC:
+      return "running out of .text";
+  }
+  return "?";
+}
+
+static bool parseCache(const std::string &s, CacheConfigMips &c) {
+  unsigned size, block, ways;
+  char extra;
+  if (sscanf(s.c_str(), "%u:%u:%u%c", &size, &block, &ways, &extra) != 3)
+    return false;
+  c = CacheConfigMips{size, block, ways};
+  return CacheMips().configure(c);
+}
+
+int main(int argc, char *argv[]) {
+  PipeConfigMips cfg;
+  uint64_t limit = 100000000;
+  bool fastOnly = false, lenient = false, quiet = false;
+  std::vector<std::string> files;
+
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--cache" && i + 1 < argc) {
+      if (!parseCache(argv[++i], cfg.cache)) {
+        std::cerr << "simmips: bad cache " << argv[i] << "\n";
+        return 1;
+      }
+    } else if (arg == "--miss-penalty" && i + 1 < argc) {
+      cfg.missPenalty = atoi(argv[++i]);
+    } else if (arg == "--branch" && i + 1 < argc) {
+      std::string where = argv[++i];
+      if (where != "id" && where != "ex") {
+        std::cerr << "simmips: --branch takes id or ex\n";
+        return 1;
+      }
+      cfg.branchInId = where == "id";
+    } else if (arg == "--no-forward") {
+      cfg.forwarding = false;
+    } else if (arg == "--fast-only") {
+      fastOnly = true;
+    } else if (arg == "--limit" && i + 1 < argc) {
+      limit = std::max(1LL, atoll(argv[++i]));
+    } else if (arg == "--lenient") {
+      lenient = true;
+    } else if (arg == "-q") {
+      quiet = true;
+    } else {
+      files.push_back(arg);
+    }
+  }
+  if (files.empty()) {
+    std::cerr << "usage: " << argv[0]
+              << " [--cache SIZE:BLOCK:WAYS] [--miss-penalty N]"
+              << " [--branch id|ex] [--no-forward] [--fast-only]"
+              << " [--limit INSNS] [--lenient] [-q] FILE ...\n";
+    return 1;
+  }
+
+  int status = 0;
+  for (const std::string &file : files) {
+    std::ifstream in(file, std::ios::binary);
+    if (!in) {
+      std::cerr << "simmips: can't read " << file << "\n";
+      status = 1;
+      continue;
+    }
+    std::stringstream ss;
+    ss << in.rdbuf();
+    std::string src = ss.str();
+
+    AssemblerMips as;
+    if (!as.assemble(src, file, lenient)) {
+      for (auto &e : as.errors) std::cerr << e << "\n";
+      status = 1;
+      continue;
+    }
+    for (auto &w : as.warnings) std::cerr << w << " (left out)\n";
+
+    CpuMips cpu;
+    cpu.load(as.prog);
+    auto start = std::chrono::steady_clock::now();
+    StopMips why = cpu.run(limit);
+    double sec =
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - start)
+            .count();
+
+    std::cout << file << ": " << as.prog.text.size() << " words, "
+              << as.prog.data.size() << " data bytes";
+    if (!as.warnings.empty())
+      std::cout << ", " << as.warnings.size() << " lines left out";
+    std::cout << "\n";
+    if (!quiet && !cpu.output.empty()) {
+      std::cout << cpu.output;
+      if (cpu.output.back() != '\n') std::cout << "\n";
+    }
+    std::cout << "  stopped on " << stopName(why);
+    if (why == MSTOP_EXIT && cpu.exitCode)
+      std::cout << " (" << cpu.exitCode << ")";
+    if (why != MSTOP_EXIT && why != MSTOP_BUDGET) {
+      std::cout << " at " << std::hex << cpu.pc << std::dec << " (line "
+                << CpuMips::lineAt(as.prog, cpu.pc) << ")";
+      if (why == MSTOP_ADDRESS)
+        std::cout << ", address " << std::hex << cpu.faultAddr << std::dec;
+      if (why == MSTOP_SYSCALL) std::cout << ", $v0 = " << cpu.reg[2];
+    }
+    std::cout << " after " << cpu.executed << " instructions\n";
+    if (sec > 0)
+      printf("  fast mode: %.1f MIPS\n", cpu.executed / sec / 1e6);
+    if (fastOnly) continue;
+
+    PipelineMips pipe(cfg);
+    cpu.load(as.prog);
+    start = std::chrono::steady_clock::now();
+    cpu.run(limit, pipe);
+    sec = std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                        start)
+              .count();
+
+    uint64_t n = pipe.instructions;
+    printf("  pipeline: %llu cycles, CPI %.3f (%.1f MIPS simulated)\n",
+           (unsigned long long)pipe.cycles(), pipe.cpi(),
+           sec > 0 ? n / sec / 1e6 : 0.0);
+    printf("    stalls: %llu data (%llu load-use), %llu control,"
+           " %llu memory\n",
+           (unsigned long long)pipe.dataStalls,
+           (unsigned long long)pipe.loadUseStalls,
+           (unsigned long long)pipe.controlStalls,
+           (unsigned long long)pipe.memoryStalls);
+    printf("    branches: %llu, %llu taken\n",
+           (unsigned long long)pipe.branches,
+           (unsigned long long)pipe.taken);
+    const CacheMips &c = pipe.cache;
+    printf("  d-cache %u:%u:%u: %llu reads, %llu writes, %llu misses"
+           " (%.2f%%), %llu write backs\n",
+           cfg.cache.size, cfg.cache.block, cfg.cache.ways,
+           (unsigned long long)c.reads, (unsigned long long)c.writes,
+           (unsigned long long)c.misses(), 100 * c.missRate(),
+           (unsigned long long)c.writeBacks);
+  }
+  return status;
+}
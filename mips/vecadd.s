@@ -0,0 +1,74 @@
+# the array loop and add10 call from Microprocessor 8085/almostMIPS.asm,
+# written out so they assemble: c[i] = a[i] + b[i] for 64 words, then
+# the sum of c plus 10 is printed
+
+	.data
+a:	.space	256
+b:	.space	256
+c:	.space	256
+msg:	.asciiz	"sum + 10 = "
+
+	.text
+main:
+	la	$t0, a
+	la	$t1, b
+	la	$t2, c
+
+	li	$s0, 0			# fill a[i] = i, b[i] = 2i
+fill:
+	sll	$t3, $s0, 2
+	add	$t4, $t0, $t3
+	sw	$s0, 0($t4)
+	add	$t5, $t1, $t3
+	add	$t6, $s0, $s0
+	sw	$t6, 0($t5)
+	addi	$s0, $s0, 1
+	slti	$s1, $s0, 64
+	bne	$s1, $zero, fill
+
+	li	$s0, 0
+	li	$s2, 0			# sum
+loop:
+	slti	$s1, $s0, 64
+	beq	$s1, $zero, end
+
+	sll	$t3, $s0, 2		# byte offset, not the index
+	add	$t4, $t0, $t3
+	add	$t5, $t1, $t3
+	lw	$t4, 0($t4)
+	lw	$t5, 0($t5)
+	add	$t6, $t4, $t5
+	add	$t7, $t2, $t3
+	sw	$t6, 0($t7)
+	add	$s2, $s2, $t6
+
+	addi	$s0, $s0, 1
+	j	loop
+end:
+	move	$a0, $s2
+	jal	add10
+	move	$s2, $v0
+
+	li	$v0, 4
+	la	$a0, msg
+	syscall
+	li	$v0, 1
+	move	$a0, $s2
+	syscall
+	li	$v0, 11
+	li	$a0, '\n'
+	syscall
+
+	li	$v0, 10
+	syscall
+
+add10:	addi	$sp, $sp, -4
+	sw	$s1, 0($sp)
+
+	addi	$s1, $a0, 10
+	add	$v0, $s1, $0
+
+	lw	$s1, 0($sp)
+	add	$sp, $sp, 4
+
+	jr	$ra
@@ -0,0 +1,187 @@
+#ifndef MODE_COUNTER_H
+#define MODE_COUNTER_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// how often the most frequent value occurs, for codeChefAIRM.cpp and
+// anything else that wants the top count of a batch of ints, many batches
+// in a row. a ModeCounter is made once and reused: every table it has is
+// kept between batches and only the parts a batch touched are cleared, so
+// a test case costs its own size and not the size of the largest one.
+//
+// one pass finds the min and max, then:
+//
+//   Direct  max - min below max(4n, 64K): a count per value in a plain
+//           array, indexed by value - min
+//   Hash    otherwise, below RADIX_FROM values or with few distinct ones
+//           among the first n / 4 (at most SAMPLE): an open addressing
+//           table of (value, count), linear probing, doubled whenever it
+//           is half full, so it is only as big as the values are many. the
+//           slots used are listed, so clearing is O(distinct)
+//   Radix   otherwise, mostly distinct values: LSD radix sort of
+//           value - min, 8 bits a pass and only as many passes as the range
+//           needs, then the longest run. input that is already in order,
+//           either way, skips the sort
+//
+// RADIX_FROM is where radix overtakes the table on distinct values: from
+// about a thousand of them the table's doublings and misses cost more than
+// the passes. a sample that happens to repeat where the rest doesn't can
+// still pick Hash for values radix would count several times faster.
+//
+// the choice can be forced, for the benches.
+
+class ModeCounter {
+ public:
+  enum Method { Auto, Direct, Hash, Radix };
+
+  static constexpr size_t RADIX_FROM = 1024, SAMPLE = 4096;
+
+  Method lastMethod = Auto;  // what the last call used
+
+  // the highest count of any one value in v[0, n), 0 for n == 0
+  uint32_t highestFrequency(const int32_t *v, size_t n, Method m = Auto) {
+    if (n == 0) return 0;
+    int32_t lo = v[0], hi = v[0];
+    for (size_t i = 1; i < n; i++) {
+      lo = std::min(lo, v[i]);
+      hi = std::max(hi, v[i]);
+    }
+    uint32_t range = (uint32_t)hi - (uint32_t)lo;
+
+    if (m == Auto) {
+      if (range < std::max<size_t>(4 * n, 1 << 16))
+        m = Direct;
+      else if (n < RADIX_FROM)
+        m = Hash;
+      else {
+        // a small table stays in cache whatever n is; a big one misses on
+        // every value and sorting is cheaper. count what the first few
+        // values hold to see which it will be
+        size_t sample = std::min(n / 4, SAMPLE);
+        hash(v, sample);
+        m = used.size() > sample / 2 ? Radix : Hash;
+      }
+    }
+    if (m == Direct && range >= (1u << 30)) m = Hash;  // forced, too big
+    lastMethod = m;
+    if (m == Direct) return direct(v, n, lo, range);
+    if (m == Hash) return hash(v, n);
+    return radix(v, n, lo, range);
+  }
+
+ private:
+  std::vector<uint32_t> counts;  // Direct, all zero between calls
+
+  std::vector<int32_t> keys;  // Hash
+  std::vector<uint32_t> slotCounts, used;
+  std::vector<std::pair<int32_t, uint32_t>> held;  // while growing
+  size_t tableSize = 0;
+  unsigned tableShift = 0;
+
+  std::vector<uint32_t> sortA, sortB;  // Radix
+
+  uint32_t direct(const int32_t *v, size_t n, int32_t lo, uint32_t range) {
+    if (counts.size() <= range) counts.resize((size_t)range + 1, 0);
+    uint32_t *c = counts.data(), best = 0;
+    for (size_t i = 0; i < n; i++) {
+      uint32_t k = ++c[(uint32_t)v[i] - (uint32_t)lo];
+      best = k > best ? k : best;
+    }
+    // as much to clear as there were values, or the range if less
+    if (range < n) {
+      memset(c, 0, ((size_t)range + 1) * sizeof(uint32_t));
+    } else {
+      for (size_t i = 0; i < n; i++) c[(uint32_t)v[i] - (uint32_t)lo] = 0;
+    }
+    return best;
+  }
+
+  uint32_t hash(const int32_t *v, size_t n) {
+    used.clear();
+    tableSize = 0;
+    grow(1024);
+    uint32_t best = 0;
+    for (size_t i = 0; i < n; i++) {
+      int32_t x = v[i];
+      size_t s = find(x);
+      if (!slotCounts[s]) {
+        if (2 * (used.size() + 1) > tableSize) {
+          grow(2 * tableSize);
+          s = find(x);
+        }
+        keys[s] = x;
+        used.push_back(s);
+      }
+      uint32_t k = ++slotCounts[s];
+      best = k > best ? k : best;
+    }
+    for (uint32_t s : used) slotCounts[s] = 0;
+    return best;
+  }
+
+  // the slot x is in, or the empty one it would go in
+  size_t find(int32_t x) const {
+    size_t s = (uint64_t)(uint32_t)x * 0x9E3779B97F4A7C15ull >> tableShift;
+    while (slotCounts[s] && keys[s] != x) s = (s + 1) & (tableSize - 1);
+    return s;
+  }
+
+  // the table as its first `size` slots (every slot is zero that isn't
+  // listed in used), with what it holds moved over
+  void grow(size_t size) {
+    if (slotCounts.size() < size) {
+      keys.resize(size);
+      slotCounts.resize(size, 0);
+    }
+    held.clear();
+    for (uint32_t s : used) {
+      held.push_back({keys[s], slotCounts[s]});
+      slotCounts[s] = 0;
+    }
+    used.clear();
+    tableSize = size;
+    tableShift = 64 - __builtin_ctzll(size);
+    for (auto &h : held) {
+      size_t s = find(h.first);
+      keys[s] = h.first;
+      slotCounts[s] = h.second;
+      used.push_back(s);
+    }
+  }
+
+  uint32_t radix(const int32_t *v, size_t n, int32_t lo, uint32_t range) {
+    sortA.resize(n);
+    sortB.resize(n);
+    uint32_t *a = sortA.data(), *b = sortB.data();
+    size_t up = 0, down = 0;
+    a[0] = (uint32_t)v[0] - (uint32_t)lo;
+    for (size_t i = 1; i < n; i++) {
+      a[i] = (uint32_t)v[i] - (uint32_t)lo;
+      up += a[i] > a[i - 1];
+      down += a[i] < a[i - 1];
+    }
+
+    // sorted either way has its equal values together already, and
+    // sorting it again ran at a third of the speed of random input
+    int bits = range && up && down ? 32 - __builtin_clz(range) : 0;
+    for (int shift = 0; shift < bits; shift += 8) {
+      size_t start[257] = {0};
+      for (size_t i = 0; i < n; i++) start[(a[i] >> shift & 0xFF) + 1]++;
+      for (int d = 0; d < 256; d++) start[d + 1] += start[d];
+      for (size_t i = 0; i < n; i++) b[start[a[i] >> shift & 0xFF]++] = a[i];
+      std::swap(a, b);
+    }
+
+    uint32_t best = 1, run = 1;
+    for (size_t i = 1; i < n; i++) {
+      run = a[i] == a[i - 1] ? run + 1 : 1;
+      best = run > best ? run : best;
+    }
+    return best;
+  }
+};
+
+#endif
@@ -0,0 +1,144 @@
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <malloc.h>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "modeCounter.h"
+
+using namespace std;
+
+// modeCounter.h against what codeChefAIRM.cpp did before it: a new
+// unordered_map<int, int> per test case and freqMap[x] twice per value.
+// each case is T tests of n values, timed as values per second for the
+// map, for ModeCounter's own choice, and for each of its methods forced
+// (Direct is skipped where the range is too wide for an array). every
+// method has to give the same answer for every test.
+//
+// the cases are the adversarial ones for one method or another: many tiny
+// tests (per test overhead), one huge test over the whole int range (no
+// repeats, the map allocates a node per value), a huge test over a small
+// range, all values equal, a few distinct values spread over the whole
+// range (an array is out, a hash table is small), sorted input, and
+// multiples of 85229, one of the bucket counts libstdc++'s unordered_map
+// grows through, so every value lands in one bucket.
+//
+// build: g++ -O2 -march=native modeCounterBench.cpp
+// run:   ./modeCounterBench.out [scale]   (default 1: 4M values a case)
+
+struct Case {
+  string name;
+  size_t tests, n;
+  vector<int32_t> values;  // tests * n of them
+};
+
+static double secondsSince(chrono::steady_clock::time_point t) {
+  return chrono::duration<double>(chrono::steady_clock::now() - t).count();
+}
+
+static vector<Case> makeCases(size_t total) {
+  mt19937_64 rng(2024);
+  vector<Case> cases;
+  auto add = [&](string name, size_t tests, auto gen, size_t n = 0) {
+    Case c{name, tests, n ? n : total / tests, {}};
+    c.values.resize(c.tests * c.n);
+    for (size_t i = 0; i < c.values.size(); i++)
+      c.values[i] = gen(i % c.n);
+    cases.push_back(move(c));
+  };
+  add("tiny tests, full range", total / 8,
+      [&](size_t) { return (int32_t)rng(); });
+  add("one test, full range", 1, [&](size_t) { return (int32_t)rng(); });
+  add("one test, range 1000", 1,
+      [&](size_t) { return (int32_t)(rng() % 1000); });
+  add("one test, all equal", 1, [&](size_t) { return 42; });
+  add("1000 values, full range", 1, [&](size_t) {
+    return (int32_t)((rng() % 1000) * 4294967ull - 2147483648ll);
+  });
+  add("sorted, full range", 1, [&](size_t i) {
+    return (int32_t)(i * (4294967295ull / total) - 2147483648ll);
+  });
+  add("100 tests, range 4n", 100,
+      [&](size_t) { return (int32_t)(rng() % (4 * total / 100)); });
+  // 50000 distinct values: the map ends up with 85229 buckets and all of
+  // them in the first. quadratic, so this one is kept small
+  add("multiples of 85229", 1,
+      [&](size_t i) { return (int32_t)(((int64_t)i - 25000) * 85229); },
+      50000);
+  return cases;
+}
+
+// the loop codeChefAIRM.cpp had
+static uint32_t withMap(const int32_t *v, size_t n) {
+  int highestFreq = 1;
+  unordered_map<int, int> freqMap;
+  for (size_t j = 0; j < n; j++)
+    if (++freqMap[v[j]] > highestFreq)
+      highestFreq = freqMap[v[j]];
+  return n ? highestFreq : 0;
+}
+
+int main(int argc, char *argv[]) {
+  double scale = argc > 1 ? atof(argv[1]) : 1;
+  size_t total = max<size_t>(1024, (size_t)(scale * (4 << 20)));
+  int status = 0;
+
+  const char *names[] = {"auto", "direct", "hash", "radix"};
+  for (Case &c : makeCases(total)) {
+    printf("%s: %zu x %zu\n", c.name.c_str(), c.tests, c.n);
+    vector<vector<uint32_t>> got;
+    vector<string> line;
+    for (int m = ModeCounter::Auto; m <= ModeCounter::Radix; m++) {
+      if (m == ModeCounter::Direct) {
+        int32_t lo = c.values[0], hi = c.values[0];
+        for (int32_t x : c.values) {
+          lo = min(lo, x);
+          hi = max(hi, x);
+        }
+        if ((uint32_t)hi - (uint32_t)lo >= (1u << 30))
+          continue;
+      }
+      ModeCounter counter;
+      vector<uint32_t> out(c.tests);
+      int picked = -1;
+      auto t = chrono::steady_clock::now();
+      for (size_t k = 0; k < c.tests; k++) {
+        out[k] = counter.highestFrequency(&c.values[k * c.n], c.n,
+                                          (ModeCounter::Method)m);
+        if (k == 0)
+          picked = counter.lastMethod;
+      }
+      double sec = secondsSince(t);
+      char buf[96];
+      string what = m == ModeCounter::Auto
+                        ? string("auto (") + names[picked] + ")"
+                        : names[m];
+      snprintf(buf, sizeof(buf), "  %-16s %8.1f M values/s", what.c_str(),
+               c.values.size() / sec / 1e6);
+      got.push_back(move(out));
+      line.push_back(buf);
+    }
+
+    vector<uint32_t> want(c.tests);
+    auto t = chrono::steady_clock::now();
+    for (size_t k = 0; k < c.tests; k++)
+      want[k] = withMap(&c.values[k * c.n], c.n);
+    double sec = secondsSince(t);
+    printf("  %-16s %8.1f M values/s\n", "unordered_map",
+           c.values.size() / sec / 1e6);
+    // the map leaves millions of freed nodes behind, which the next big
+    // allocation would pay for
+    malloc_trim(0);
+    for (size_t i = 0; i < got.size(); i++) {
+      bool same = got[i] == want;
+      printf("%s%s\n", line[i].c_str(), same ? "" : "  WRONG");
+      if (!same)
+        status = 1;
+    }
+  }
+  return status;
+}
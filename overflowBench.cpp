@@ -0,0 +1,233 @@
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <limits>
+#include <random>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "overflowKernels.h"
+
+using namespace std;
+
+// the kernels of overflowKernels.h: dataTypeOverflow.cpp's product through
+// each mode, a check of every kernel against __int128 arithmetic on random
+// and edge values, and the throughput of each in M elements/s next to two
+// ways of doing it by hand: a plain loop that doesn't look at overflow at
+// all, and __builtin_*_overflow with an if per element.
+//
+// the operands are mostly small with one in 64 anywhere in the range, so a
+// few percent of the products overflow, like a column of money with the odd
+// bad row. the arrays are small enough to stay in cache: this times the
+// arithmetic, not the memory.
+//
+// build: g++ -O2 -march=native overflowBench.cpp
+// run:   ./overflowBench.out [N]
+
+static double secondsSince(chrono::steady_clock::time_point t) {
+  return chrono::duration<double>(chrono::steady_clock::now() - t).count();
+}
+
+static string str128(__int128 v) {
+  if (v == 0)
+    return "0";
+  bool neg = v < 0;
+  unsigned __int128 u = neg ? -(unsigned __int128)v : v;
+  string s;
+  for (; u; u /= 10)
+    s.insert(s.begin(), char('0' + u % 10));
+  return neg ? "-" + s : s;
+}
+
+template <class T>
+static vector<T> operands(size_t n, mt19937_64 &rng) {
+  vector<T> v(n);
+  const T edge[] = {0, 1, -1, numeric_limits<T>::max(),
+                    numeric_limits<T>::min(), numeric_limits<T>::max() / 2};
+  for (size_t i = 0; i < n; i++) {
+    uint64_t r = rng();
+    if (r % 512 == 0)
+      v[i] = edge[r / 512 % 6];
+    else if (r % 64 == 1)
+      v[i] = (T)rng();
+    else
+      v[i] = (T)((int64_t)(r >> 40) % 20000 - 10000);
+  }
+  return v;
+}
+
+// ---------------------------------------------------------------------------
+// checks against __int128
+
+static int failures = 0;
+
+template <class T, class Out>
+static void check(const char *what, const vector<T> &a, const vector<T> &b,
+                  bool mul, Overflow mode, bool wide, const Out *out,
+                  const uint8_t *mask, size_t count) {
+  const __int128 lo = numeric_limits<T>::min(), hi = numeric_limits<T>::max();
+  size_t want = 0;
+  for (size_t i = 0; i < a.size(); i++) {
+    __int128 x = mul ? (__int128)a[i] * b[i] : (__int128)a[i] + b[i];
+    bool over = x < lo || x > hi;
+    __int128 r = x;
+    if (!wide) {
+      if (mode == Overflow::Wrap)
+        r = (T)(typename make_unsigned<T>::type)x;
+      else if (mode == Overflow::Check)
+        r = over ? 0 : x;
+      else
+        r = x < lo ? lo : x > hi ? hi : x;
+    }
+    want += over;
+    if ((__int128)out[i] != r || mask[i] != over) {
+      printf("  %s: wrong at %zu: %s %c %s gave %s mask %d\n", what, i,
+             str128(a[i]).c_str(), mul ? '*' : '+', str128(b[i]).c_str(),
+             str128(out[i]).c_str(), mask[i]);
+      failures++;
+      return;
+    }
+  }
+  if (count != want) {
+    printf("  %s: counted %zu overflows, not %zu\n", what, count, want);
+    failures++;
+  }
+}
+
+template <class T>
+static void checkAll(size_t n, mt19937_64 &rng) {
+  using W = typename WideInt<T>::type;
+  vector<T> a = operands<T>(n, rng), b = operands<T>(n, rng), out(n);
+  vector<W> wide(n);
+  vector<uint8_t> mask(n);
+  const char *name = sizeof(T) == 4 ? "int32" : "int64";
+  for (int m = 0; m < 2; m++) {
+    bool mul = m;
+    auto narrow = [&](Overflow mode, size_t c) {
+      string what = string(name) + (mul ? " mul" : " add");
+      check(what.c_str(), a, b, mul, mode, false, out.data(), mask.data(), c);
+    };
+    T *o = out.data();
+    uint8_t *k = mask.data();
+    narrow(Overflow::Wrap,
+           mul ? batchMul<Overflow::Wrap>(&a[0], &b[0], o, k, n)
+               : batchAdd<Overflow::Wrap>(&a[0], &b[0], o, k, n));
+    narrow(Overflow::Check,
+           mul ? batchMul<Overflow::Check>(&a[0], &b[0], o, k, n)
+               : batchAdd<Overflow::Check>(&a[0], &b[0], o, k, n));
+    narrow(Overflow::Saturate,
+           mul ? batchMul<Overflow::Saturate>(&a[0], &b[0], o, k, n)
+               : batchAdd<Overflow::Saturate>(&a[0], &b[0], o, k, n));
+    size_t c = mul ? batchMulWide(&a[0], &b[0], wide.data(), k, n)
+                   : batchAddWide(&a[0], &b[0], wide.data(), k, n);
+    check("wide", a, b, mul, Overflow::Wrap, true, wide.data(), k, c);
+  }
+}
+
+// ---------------------------------------------------------------------------
+// timings
+
+template <class F>
+static void timeIt(const char *what, size_t n, F f) {
+  size_t reps = 0, over = 0;
+  auto t = chrono::steady_clock::now();
+  double sec;
+  do {
+    for (int i = 0; i < 64; i++, reps++)
+      over = f();
+  } while ((sec = secondsSince(t)) < 0.2);
+  printf("  %-24s %8.0f M/s  %5.2f%% overflow\n", what, reps * n / sec / 1e6,
+         100.0 * over / n);
+}
+
+template <class T>
+static void benchAll(size_t n, mt19937_64 &rng) {
+  using U = typename make_unsigned<T>::type;
+  using W = typename WideInt<T>::type;
+  vector<T> a = operands<T>(n, rng), b = operands<T>(n, rng), out(n);
+  vector<W> wide(n);
+  vector<uint8_t> mask(n);
+  const T *x = a.data(), *y = b.data();
+  T *o = out.data();
+  uint8_t *k = mask.data();
+
+  for (int m = 0; m < 2; m++) {
+    bool mul = m;
+    printf("%s %s, %zu elements\n", sizeof(T) == 4 ? "int32" : "int64",
+           mul ? "mul" : "add", n);
+    timeIt("plain, no overflow", n, [&]() {
+      for (size_t i = 0; i < n; i++)
+        o[i] = mul ? (T)((U)x[i] * (U)y[i]) : (T)((U)x[i] + (U)y[i]);
+      return (size_t)0;
+    });
+    timeIt("__builtin + if, checked", n, [&]() {
+      size_t c = 0;
+      for (size_t i = 0; i < n; i++) {
+        T r;
+        if (mul ? __builtin_mul_overflow(x[i], y[i], &r)
+                : __builtin_add_overflow(x[i], y[i], &r)) {
+          r = 0;
+          k[i] = 1;
+          c++;
+        } else {
+          k[i] = 0;
+        }
+        o[i] = r;
+      }
+      return c;
+    });
+    if (mul) {
+      timeIt("wrap", n,
+             [&] { return batchMul<Overflow::Wrap>(x, y, o, k, n); });
+      timeIt("checked", n,
+             [&] { return batchMul<Overflow::Check>(x, y, o, k, n); });
+      timeIt("saturating", n,
+             [&] { return batchMul<Overflow::Saturate>(x, y, o, k, n); });
+      timeIt(sizeof(T) == 4 ? "widening to int64" : "widening to int128", n,
+             [&] { return batchMulWide(x, y, wide.data(), k, n); });
+    } else {
+      timeIt("wrap", n,
+             [&] { return batchAdd<Overflow::Wrap>(x, y, o, k, n); });
+      timeIt("checked", n,
+             [&] { return batchAdd<Overflow::Check>(x, y, o, k, n); });
+      timeIt("saturating", n,
+             [&] { return batchAdd<Overflow::Saturate>(x, y, o, k, n); });
+      timeIt(sizeof(T) == 4 ? "widening to int64" : "widening to int128", n,
+             [&] { return batchAddWide(x, y, wide.data(), k, n); });
+    }
+  }
+}
+
+int main(int argc, char *argv[]) {
+  size_t n = argc > 1 ? strtoull(argv[1], nullptr, 10) : 4096;
+  if (n == 0)
+    n = 1;
+
+  // the product from dataTypeOverflow.cpp
+  int32_t a = 1234567890, b = 987654321, r;
+  int64_t w;
+  uint8_t over;
+  printf("%d * %d\n", a, b);
+  batchMul<Overflow::Wrap>(&a, &b, &r, &over, 1);
+  printf("  wrap        %d (overflow %d)\n", r, over);
+  batchMul<Overflow::Check>(&a, &b, &r, &over, 1);
+  printf("  checked     %d (overflow %d)\n", r, over);
+  batchMul<Overflow::Saturate>(&a, &b, &r, &over, 1);
+  printf("  saturating  %d (overflow %d)\n", r, over);
+  batchMulWide(&a, &b, &w, &over, 1);
+  printf("  widening    %lld (overflow %d)\n\n", (long long)w, over);
+
+  mt19937_64 rng(32);
+  // odd sizes, so the scalar tail after the blocks of 8 is checked too
+  for (size_t size : {1, 7, 8, 9, 100003}) {
+    checkAll<int32_t>(size, rng);
+    checkAll<int64_t>(size, rng);
+  }
+  printf("checks against __int128: %s\n\n", failures ? "FAILED" : "ok");
+
+  benchAll<int32_t>(n, rng);
+  benchAll<int64_t>(n, rng);
+  return failures ? 1 : 0;
+}
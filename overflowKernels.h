@@ -0,0 +1,307 @@
+#ifndef OVERFLOW_KERNELS_H
+#define OVERFLOW_KERNELS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+// batch add / multiply over arrays of int32_t or int64_t that say which
+// elements overflowed, for money and counts where a silent wrap (the
+// `int a * b` of dataTypeOverflow.cpp) is a wrong total. every kernel
+// writes a mask byte per element, 1 where the exact result doesn't fit in
+// T, and returns how many there were:
+//
+//   batchAdd<Overflow::Wrap>      out = the result mod 2^bits
+//   batchAdd<Overflow::Check>     out = the result, or 0 where it overflowed
+//   batchAdd<Overflow::Saturate>  out = the result clamped to T's range
+//   batchAddWide                  out = the exact result one size up
+//                                 (int32 -> int64, int64 -> __int128)
+//
+// and the same for batchMul. none of them branch per element. int32 lanes
+// go 8 at a time through GCC vector types, worked out exactly in 64 bits
+// and narrowed, but only on a CPU with AVX-512 (F and DQ), which has the
+// 8 x int64 multiply, compare and narrowing for it. below that gcc builds
+// those out of 128 or 256 bit pieces and they lose to one
+// __builtin_*_overflow per element (checked int32 adds at a quarter of
+// the scalar rate on SSE2, and still behind it on AVX2), so the int32
+// kernels fall back to that loop. int64 adds go 4 at a time, overflow read
+// off the signs, where there is AVX2. the vector code is compiled for its
+// extension even when the build doesn't target it and picked at run time,
+// so a plain -O2 build gets it too. int64 products have no vector multiply
+// high, so they are one at a time through __builtin_mul_overflow (imul and
+// its overflow flag), as are the __int128 results of the wide kernels.
+
+enum class Overflow { Wrap, Check, Saturate };
+
+template <class T>
+struct WideInt;
+template <>
+struct WideInt<int32_t> {
+  using type = int64_t;
+};
+template <>
+struct WideInt<int64_t> {
+  using type = __int128;
+};
+
+namespace overflow_detail {
+
+typedef int32_t I32x8 __attribute__((vector_size(32)));
+typedef int64_t I64x8 __attribute__((vector_size(64)));
+typedef int8_t I8x8 __attribute__((vector_size(8)));
+typedef int64_t I64x4 __attribute__((vector_size(32)));
+typedef uint64_t U64x4 __attribute__((vector_size(32)));
+typedef int8_t I8x4 __attribute__((vector_size(4)));
+
+struct Add {
+  static constexpr bool mul = false;
+  template <class X>
+  static X exact(X a, X b) {
+    return a + b;
+  }
+  template <class T>
+  static bool builtin(T a, T b, T *r) {
+    return __builtin_add_overflow(a, b, r);
+  }
+  // the sign of a result that overflowed: a and b had the same one
+  template <class T>
+  static bool negative(T a, T) {
+    return a < 0;
+  }
+};
+
+struct Mul {
+  static constexpr bool mul = true;
+  template <class X>
+  static X exact(X a, X b) {
+    return a * b;
+  }
+  template <class T>
+  static bool builtin(T a, T b, T *r) {
+    return __builtin_mul_overflow(a, b, r);
+  }
+  template <class T>
+  static bool negative(T a, T b) {
+    return (a < 0) != (b < 0);
+  }
+};
+
+#if defined(__x86_64__) && !(defined(__AVX512F__) && defined(__AVX512DQ__))
+#define OVERFLOW_AVX512 __attribute__((target("avx512f,avx512dq")))
+#else
+#define OVERFLOW_AVX512
+#endif
+#if defined(__x86_64__) && !defined(__AVX2__)
+#define OVERFLOW_AVX2 __attribute__((target("avx2")))
+#else
+#define OVERFLOW_AVX2
+#endif
+
+inline bool haveAvx512() {
+#if defined(__AVX512F__) && defined(__AVX512DQ__)
+  return true;
+#elif defined(__x86_64__)
+  static const bool yes = (__builtin_cpu_init(),
+                           __builtin_cpu_supports("avx512f") &&
+                               __builtin_cpu_supports("avx512dq"));
+  return yes;
+#else
+  return false;
+#endif
+}
+
+inline bool haveAvx2() {
+#if defined(__AVX2__)
+  return true;
+#elif defined(__x86_64__)
+  static const bool yes =
+      (__builtin_cpu_init(), __builtin_cpu_supports("avx2"));
+  return yes;
+#else
+  return false;
+#endif
+}
+
+// Op over n int32 lanes one at a time, into int32 (M applies) or int64
+// (batch*Wide)
+template <class Op, Overflow M, class Out>
+inline size_t scalar32(const int32_t *a, const int32_t *b, Out *out,
+                       uint8_t *mask, size_t n) {
+  size_t count = 0;
+  for (size_t i = 0; i < n; i++) {
+    bool over;
+    if constexpr (sizeof(Out) == 8) {
+      int64_t p = Op::exact((int64_t)a[i], (int64_t)b[i]);
+      over = p != (int32_t)p;
+      out[i] = p;
+    } else {
+      int32_t r;
+      over = Op::builtin(a[i], b[i], &r);
+      if (M == Overflow::Check) r = over ? 0 : r;
+      if (M == Overflow::Saturate && over)
+        r = Op::negative(a[i], b[i]) ? INT32_MIN : INT32_MAX;
+      out[i] = r;
+    }
+    mask[i] = over;
+    count += over;
+  }
+  return count;
+}
+
+// the same, 8 lanes at a time
+template <class Op, Overflow M, class Out>
+OVERFLOW_AVX512 size_t vector32(const int32_t *a, const int32_t *b, Out *out,
+                                uint8_t *mask, size_t n) {
+  constexpr bool wide = sizeof(Out) == 8;
+  size_t count = 0, i = 0;
+  for (; i + 8 <= n; i += 8) {
+    I32x8 va, vb;
+    memcpy(&va, a + i, sizeof(va));
+    memcpy(&vb, b + i, sizeof(vb));
+    // not through Op::exact: a vector that size can't be passed by value
+    // without -mavx512f (-Wpsabi)
+    I64x8 wa = __builtin_convertvector(va, I64x8);
+    I64x8 wb = __builtin_convertvector(vb, I64x8);
+    I64x8 p = Op::mul ? wa * wb : wa + wb;
+    I32x8 r = __builtin_convertvector(p, I32x8);
+    I64x8 over = p != __builtin_convertvector(r, I64x8);  // 0 or -1
+
+    if constexpr (wide) {
+      memcpy(out + i, &p, sizeof(p));
+    } else {
+      if (M == Overflow::Check) r = r & ~__builtin_convertvector(over, I32x8);
+      if (M == Overflow::Saturate) {
+        I64x8 hi = p > INT32_MAX, lo = p < INT32_MIN;
+        I64x8 c = (p & ~(hi | lo)) | (hi & INT32_MAX) | (lo & INT32_MIN);
+        r = __builtin_convertvector(c, I32x8);
+      }
+      memcpy(out + i, &r, sizeof(r));
+    }
+    I8x8 m = -__builtin_convertvector(over, I8x8);
+    uint64_t bytes;
+    memcpy(&bytes, &m, 8);
+    memcpy(mask + i, &bytes, 8);
+    count += __builtin_popcountll(bytes);
+  }
+  return count + scalar32<Op, M>(a + i, b + i, out + i, mask + i, n - i);
+}
+
+template <class Op, Overflow M, class Out>
+inline size_t run32(const int32_t *a, const int32_t *b, Out *out,
+                    uint8_t *mask, size_t n) {
+  if (haveAvx512()) return vector32<Op, M>(a, b, out, mask, n);
+  return scalar32<Op, M>(a, b, out, mask, n);
+}
+
+template <class Op, Overflow M>
+inline size_t scalar64(const int64_t *a, const int64_t *b, int64_t *out,
+                       uint8_t *mask, size_t n) {
+  size_t count = 0;
+  for (size_t i = 0; i < n; i++) {
+    int64_t r;
+    bool over = Op::builtin(a[i], b[i], &r);
+    if (M == Overflow::Check) r = over ? 0 : r;
+    if (M == Overflow::Saturate && over)
+      r = Op::negative(a[i], b[i]) ? INT64_MIN : INT64_MAX;
+    out[i] = r;
+    mask[i] = over;
+    count += over;
+  }
+  return count;
+}
+
+// int64 adds 4 at a time: a sum overflowed iff it has neither operand's sign
+template <Overflow M>
+OVERFLOW_AVX2 size_t vectorAdd64(const int64_t *a, const int64_t *b,
+                                   int64_t *out, uint8_t *mask, size_t n) {
+  size_t count = 0, i = 0;
+  for (; i + 4 <= n; i += 4) {
+    I64x4 va, vb;
+    memcpy(&va, a + i, sizeof(va));
+    memcpy(&vb, b + i, sizeof(vb));
+    I64x4 r = (I64x4)((U64x4)va + (U64x4)vb);
+    I64x4 over = ((va ^ r) & (vb ^ r)) < 0;  // 0 or -1
+    if (M == Overflow::Check) r &= ~over;
+    if (M == Overflow::Saturate)
+      r = (r & ~over) | (((va >> 63) ^ INT64_MAX) & over);
+    memcpy(out + i, &r, sizeof(r));
+    I8x4 m = -__builtin_convertvector(over, I8x4);
+    uint32_t bytes;
+    memcpy(&bytes, &m, 4);
+    memcpy(mask + i, &bytes, 4);
+    count += __builtin_popcount(bytes);
+  }
+  return count + scalar64<Add, M>(a + i, b + i, out + i, mask + i, n - i);
+}
+
+template <class Op, Overflow M>
+inline size_t run64(const int64_t *a, const int64_t *b, int64_t *out,
+                    uint8_t *mask, size_t n) {
+  if constexpr (!Op::mul)
+    if (haveAvx2()) return vectorAdd64<M>(a, b, out, mask, n);
+  return scalar64<Op, M>(a, b, out, mask, n);
+}
+
+template <class Op>
+inline size_t run64Wide(const int64_t *a, const int64_t *b, __int128 *out,
+                        uint8_t *mask, size_t n) {
+  size_t count = 0;
+  for (size_t i = 0; i < n; i++) {
+    int64_t r;
+    bool over = Op::builtin(a[i], b[i], &r);
+    out[i] = Op::exact((__int128)a[i], (__int128)b[i]);
+    mask[i] = over;
+    count += over;
+  }
+  return count;
+}
+
+}  // namespace overflow_detail
+
+template <Overflow M>
+inline size_t batchAdd(const int32_t *a, const int32_t *b, int32_t *out,
+                       uint8_t *mask, size_t n) {
+  return overflow_detail::run32<overflow_detail::Add, M>(a, b, out, mask, n);
+}
+
+template <Overflow M>
+inline size_t batchMul(const int32_t *a, const int32_t *b, int32_t *out,
+                       uint8_t *mask, size_t n) {
+  return overflow_detail::run32<overflow_detail::Mul, M>(a, b, out, mask, n);
+}
+
+template <Overflow M>
+inline size_t batchAdd(const int64_t *a, const int64_t *b, int64_t *out,
+                       uint8_t *mask, size_t n) {
+  return overflow_detail::run64<overflow_detail::Add, M>(a, b, out, mask, n);
+}
+
+template <Overflow M>
+inline size_t batchMul(const int64_t *a, const int64_t *b, int64_t *out,
+                       uint8_t *mask, size_t n) {
+  return overflow_detail::run64<overflow_detail::Mul, M>(a, b, out, mask, n);
+}
+
+inline size_t batchAddWide(const int32_t *a, const int32_t *b, int64_t *out,
+                           uint8_t *mask, size_t n) {
+  using namespace overflow_detail;
+  return run32<Add, Overflow::Wrap>(a, b, out, mask, n);
+}
+
+inline size_t batchMulWide(const int32_t *a, const int32_t *b, int64_t *out,
+                           uint8_t *mask, size_t n) {
+  using namespace overflow_detail;
+  return run32<Mul, Overflow::Wrap>(a, b, out, mask, n);
+}
+
+inline size_t batchAddWide(const int64_t *a, const int64_t *b, __int128 *out,
+                           uint8_t *mask, size_t n) {
+  return overflow_detail::run64Wide<overflow_detail::Add>(a, b, out, mask, n);
+}
+
+inline size_t batchMulWide(const int64_t *a, const int64_t *b, __int128 *out,
+                           uint8_t *mask, size_t n) {
+  return overflow_detail::run64Wide<overflow_detail::Mul>(a, b, out, mask, n);
+}
+
+#endif
@@ -0,0 +1,660 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <queue>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "mappedFile.h"
+#include "stringInterner.h"
+
+using namespace std;
+
+// columnar version of whatSortOfAccountantWouldDoThis.sh. the payroll file
+// (IDNO NAME DESIGNATION SALARY, fixed width, the column starts read off the
+// header line) is mmapped and cut into one slice per thread at line
+// boundaries. each slice counts its rows, then parses them straight into its
+// part of the columns:
+//
+//   id      int32   IDNO
+//   desig   uint16  the trimmed DESIGNATION, as its id in an Interner
+//   salary  int32   SALARY
+//   line    uint64  where the row starts in the file, to print it
+//
+// names are never decoded; the rows that get printed are read back from the
+// mapping. every query of the script's menu is then one pass over one
+// column: the shell version runs sed | awk | bc per row for the salary
+// filters, which is a process per row and quadratic in the file.
+//
+// build: g++ -O2 -march=native -pthread payrollColumnar.cpp
+// run:   ./payrollColumnar.out FILE [-q] [-j N] [QUERY ...]
+//        ./payrollColumnar.out --gen ROWS FILE
+//
+// queries: counts | count DESIGNATION | below N | above N | between LO HI |
+// first N | last N | stats | stats-hash. stats is the count, sum, average,
+// min and max of SALARY per DESIGNATION (stats-hash the same through the
+// hash tables instead of the direct arrays, to compare). without any, the
+// script's menu is run: count Developer, count Analyst, below 45000, above
+// 45000, first 5, last 5. -q prints only the totals, not the rows. --gen
+// writes ROWS made up rows in the same layout, for the timings.
+
+// ---------------------------------------------------------------------------
+// the columns
+
+static inline bool isDigit(char c) { return (unsigned)(c - '0') < 10; }
+
+// leading spaces, then digits; -1 if there are none
+static inline int64_t parseNum(const char *p, const char *e) {
+  while (p < e && *p == ' ')
+    p++;
+  if (p == e || !isDigit(*p))
+    return -1;
+  int64_t v = 0;
+  while (p < e && isDigit(*p))
+    v = v * 10 + (*p++ - '0');
+  return v;
+}
+
+// SALARY totals of one group
+struct SalaryStats {
+  size_t count = 0;
+  int64_t sum = 0;
+  int32_t min = INT32_MAX, max = INT32_MIN;
+
+  void add(int32_t s) {
+    count++;
+    sum += s;
+    min = s < min ? s : min;
+    max = s > max ? s : max;
+  }
+
+  void merge(const SalaryStats &o) {
+    count += o.count;
+    sum += o.sum;
+    min = o.min < min ? o.min : min;
+    max = o.max > max ? o.max : max;
+  }
+
+  double avg() const { return count ? (double)sum / count : 0; }
+};
+
+// group key -> SalaryStats, open addressing with linear probing. one per
+// thread, so there is no locking; it doubles at half full
+class GroupTable {
+public:
+  GroupTable() { resize(64); }
+
+  SalaryStats &at(uint32_t key) {
+    size_t i = slot(key);
+    while (keys[i] != key) {
+      if (keys[i] == EMPTY) {
+        if (2 * (used + 1) > keys.size()) {
+          resize(2 * keys.size());
+          return at(key);
+        }
+        keys[i] = key;
+        used++;
+        break;
+      }
+      i = (i + 1) & (keys.size() - 1);
+    }
+    return vals[i];
+  }
+
+  template <class F>
+  void each(F f) const {
+    for (size_t i = 0; i < keys.size(); i++)
+      if (keys[i] != EMPTY)
+        f(keys[i], vals[i]);
+  }
+
+private:
+  static constexpr uint32_t EMPTY = UINT32_MAX;
+  vector<uint32_t> keys;
+  vector<SalaryStats> vals;
+  size_t used = 0;
+  unsigned shift = 0;
+
+  size_t slot(uint32_t key) const {
+    return (uint32_t)(key * 0x9E3779B1u) >> shift;
+  }
+
+  void resize(size_t n) {
+    vector<uint32_t> oldKeys(n, EMPTY);
+    vector<SalaryStats> oldVals(n);
+    oldKeys.swap(keys);
+    oldVals.swap(vals);
+    shift = 32 - __builtin_ctzll(n);
+    used = 0;
+    for (size_t i = 0; i < oldKeys.size(); i++)
+      if (oldKeys[i] != EMPTY)
+        at(oldKeys[i]) = oldVals[i];
+  }
+};
+
+class Payroll {
+public:
+  vector<int32_t> id;
+  vector<uint16_t> desig;
+  vector<int32_t> salary;
+  vector<uint64_t> line;
+
+  Interner designations;
+  string_view header;
+
+  size_t size() const { return id.size(); }
+
+  // false with a message in err if the header or a row doesn't parse
+  bool load(const char *data, size_t size, unsigned threads, string &err) {
+    text = data;
+    textEnd = data + size;
+    const char *end = textEnd;
+    const char *nl = (const char *)memchr(data, '\n', size);
+    const char *body = nl ? nl + 1 : end;
+    header = string_view(data, body - data);
+    while (!header.empty() && (header.back() == '\n' || header.back() == '\r'))
+      header.remove_suffix(1);
+
+    size_t at[4];
+    const char *names[4] = {"IDNO", "NAME", "DESIGNATION", "SALARY"};
+    for (int c = 0; c < 4; c++) {
+      at[c] = header.find(names[c]);
+      if (at[c] == string_view::npos || (c && at[c] <= at[c - 1])) {
+        err = string("no ") + names[c] + " column in the header";
+        return false;
+      }
+    }
+    desigCol = at[2];
+    salaryCol = at[3];
+
+    // slices end just after a newline, so no row is split
+    threads = max(1u, threads);
+    vector<const char *> cut(threads + 1);
+    cut[0] = body;
+    cut[threads] = end;
+    for (unsigned t = 1; t < threads; t++) {
+      const char *p = body + (end - body) * t / threads;
+      if (p < cut[t - 1])
+        p = cut[t - 1];
+      const char *q = (const char *)memchr(p, '\n', end - p);
+      cut[t] = q ? q + 1 : end;
+    }
+
+    vector<size_t> rows(threads + 1, 0);
+    run(threads,
+        [&](unsigned t) { rows[t + 1] = countRows(cut[t], cut[t + 1]); });
+    for (unsigned t = 0; t < threads; t++)
+      rows[t + 1] += rows[t];
+
+    size_t n = rows[threads];
+    id.resize(n);
+    desig.resize(n);
+    salary.resize(n);
+    line.resize(n);
+
+    vector<Slice> slices(threads);
+    run(threads, [&](unsigned t) {
+      parse(cut[t], cut[t + 1], rows[t], slices[t]);
+    });
+
+    // local designation codes -> ids in the Interner, slice by slice so the
+    // ids come out in file order whatever the thread count
+    for (unsigned t = 0; t < threads; t++) {
+      Slice &s = slices[t];
+      if (!s.err.empty()) {
+        err = s.err;
+        return false;
+      }
+      vector<uint16_t> remap(s.names.size());
+      for (size_t k = 0; k < s.names.size(); k++) {
+        uint32_t g = designations.intern(s.names[k]);
+        if (g > UINT16_MAX) {
+          err = "more than 65536 designations";
+          return false;
+        }
+        remap[k] = g;
+      }
+      uint16_t *d = desig.data();
+      for (size_t i = rows[t]; i < rows[t + 1]; i++)
+        d[i] = remap[d[i]];
+    }
+    return true;
+  }
+
+  // -1 for a designation no row has
+  int64_t codeOf(string_view name) const { return designations.find(name); }
+
+  size_t countDesignation(int64_t code) const {
+    if (code < 0)
+      return 0;
+    const uint16_t *d = desig.data();
+    size_t n = desig.size(), count = 0;
+    for (size_t i = 0; i < n; i++)
+      count += d[i] == code;
+    return count;
+  }
+
+  // rows per designation id
+  vector<size_t> designationCounts() const {
+    vector<size_t> counts(designations.size(), 0);
+    const uint16_t *d = desig.data();
+    size_t n = desig.size();
+    for (size_t i = 0; i < n; i++)
+      counts[d[i]]++;
+    return counts;
+  }
+
+  // salary in [lo, hi] -> selection bytes (1 = row passes), like
+  // PersonStore::selectAge in hrColumnar.cpp
+  size_t selectSalary(int64_t lo, int64_t hi, uint8_t *sel) const {
+    const int32_t *s = salary.data();
+    size_t n = salary.size(), count = 0;
+    // compared as int32, so the loop stays at 8 rows per AVX2 compare
+    lo = max<int64_t>(lo, INT32_MIN);
+    hi = min<int64_t>(hi, INT32_MAX);
+    if (lo > hi) {
+      memset(sel, 0, n);
+      return 0;
+    }
+    int32_t l = lo, h = hi;
+    for (size_t i = 0; i < n; i++) {
+      uint8_t pass = (s[i] >= l) & (s[i] <= h);
+      sel[i] = pass;
+      count += pass;
+    }
+    return count;
+  }
+
+  // rows of the n smallest (or largest) IDNOs, in IDNO order. a heap of the
+  // best n so far; a block of the column is only looked at row by row if
+  // its minimum (maximum) beats the worst of those, which after the first
+  // few blocks is almost never
+  vector<size_t> byId(size_t n, bool largest) const {
+    // keyed so that "better" is always smaller
+    auto key = [&](size_t i) -> int64_t { return largest ? -id[i] : id[i]; };
+    priority_queue<pair<int64_t, size_t>> best;
+    const size_t BLOCK = 256;
+    const int32_t *v = id.data();
+
+    for (size_t b = 0; b < id.size() && n; b += BLOCK) {
+      size_t e = min(id.size(), b + BLOCK);
+      if (best.size() == n) {
+        int32_t m = v[b];
+        if (largest) {
+          for (size_t i = b; i < e; i++)
+            m = max(m, v[i]);
+        } else {
+          for (size_t i = b; i < e; i++)
+            m = min(m, v[i]);
+        }
+        if ((largest ? -(int64_t)m : m) >= best.top().first)
+          continue;
+      }
+      for (size_t i = b; i < e; i++) {
+        if (best.size() < n) {
+          best.push({key(i), i});
+        } else if (key(i) < best.top().first) {
+          best.pop();
+          best.push({key(i), i});
+        }
+      }
+    }
+
+    vector<size_t> rows;
+    for (; !best.empty(); best.pop())
+      rows.push_back(best.top().second);
+    reverse(rows.begin(), rows.end());
+    return rows;
+  }
+
+  // SALARY count/sum/min/max per designation id, the rows split over
+  // `threads`. the designation column is already dictionary encoded, so
+  // with up to DIRECT_GROUPS designations each thread adds into a plain
+  // array indexed by the id; past that (or with hash set, to compare) each
+  // thread fills a GroupTable. the per thread results are merged at the end
+  static constexpr size_t DIRECT_GROUPS = 4096;
+
+  vector<SalaryStats> salaryByDesignation(unsigned threads,
+                                          bool hash = false) const {
+    size_t groups = designations.size(), n = size();
+    threads = max(1u, threads);
+    hash = hash || groups > DIRECT_GROUPS;
+    vector<vector<SalaryStats>> direct(threads);
+    vector<GroupTable> tables(hash ? threads : 0);
+
+    run(threads, [&](unsigned t) {
+      size_t b = n * t / threads, e = n * (t + 1) / threads;
+      const uint16_t *d = desig.data();
+      const int32_t *s = salary.data();
+      if (hash) {
+        GroupTable &g = tables[t];
+        for (size_t i = b; i < e; i++)
+          g.at(d[i]).add(s[i]);
+      } else {
+        vector<SalaryStats> &g = direct[t];
+        g.resize(groups);
+        for (size_t i = b; i < e; i++)
+          g[d[i]].add(s[i]);
+      }
+    });
+
+    vector<SalaryStats> out(groups);
+    for (unsigned t = 0; t < threads; t++) {
+      if (hash)
+        tables[t].each([&](uint32_t k, const SalaryStats &v) {
+          out[k].merge(v);
+        });
+      else
+        for (size_t k = 0; k < groups; k++)
+          out[k].merge(direct[t][k]);
+    }
+    return out;
+  }
+
+  string_view row(size_t i) const {
+    const char *p = text + line[i], *e = p;
+    while (e < textEnd && *e != '\n' && *e != '\r')
+      e++;
+    return string_view(p, e - p);
+  }
+
+private:
+  const char *text = nullptr, *textEnd = nullptr;
+  size_t desigCol = 0, salaryCol = 0;
+
+  struct Slice {
+    vector<string_view> names;  // local designation code -> text
+    string err;
+  };
+
+  template <class F>
+  static void run(unsigned threads, F f) {
+    vector<thread> pool;
+    for (unsigned t = 1; t < threads; t++)
+      pool.emplace_back(f, t);
+    f(0);
+    for (auto &th : pool)
+      th.join();
+  }
+
+  static bool blank(const char *p, const char *e) {
+    for (; p < e; p++)
+      if (*p != ' ' && *p != '\r' && *p != '\t')
+        return false;
+    return true;
+  }
+
+  static size_t countRows(const char *p, const char *end) {
+    size_t n = 0;
+    while (p < end) {
+      const char *e = (const char *)memchr(p, '\n', end - p);
+      if (!e)
+        e = end;
+      n += !blank(p, e);
+      p = e + 1;
+    }
+    return n;
+  }
+
+  void parse(const char *p, const char *end, size_t row, Slice &s) {
+    unordered_map<string_view, uint16_t> local;
+    while (p < end) {
+      const char *e = (const char *)memchr(p, '\n', end - p);
+      if (!e)
+        e = end;
+      const char *next = e + 1;
+      if (e > p && e[-1] == '\r')
+        e--;
+      if (blank(p, e)) {
+        p = next;
+        continue;
+      }
+
+      size_t len = e - p;
+      int64_t i = parseNum(p, e);
+      int64_t sal = len > salaryCol ? parseNum(p + salaryCol, e) : -1;
+      if (i < 0 || sal < 0 || i > INT32_MAX || sal > INT32_MAX) {
+        if (s.err.empty())
+          s.err = "bad row at byte " + to_string(p - text) + ": " +
+                  string(p, min<size_t>(len, 80));
+        return;
+      }
+
+      const char *d = p + desigCol, *de = p + salaryCol;
+      while (d < de && *d == ' ')
+        d++;
+      while (de > d && de[-1] == ' ')
+        de--;
+      string_view name(d, de - d);
+      auto it = local.find(name);
+      if (it == local.end()) {
+        if (s.names.size() > UINT16_MAX) {
+          s.err = "more than 65536 designations";
+          return;
+        }
+        it = local.emplace(name, s.names.size()).first;
+        s.names.push_back(name);
+      }
+
+      id[row] = i;
+      desig[row] = it->second;
+      salary[row] = sal;
+      line[row] = p - text;
+      row++;
+      p = next;
+    }
+  }
+};
+
+// ---------------------------------------------------------------------------
+// made up payroll files
+
+static int generate(size_t rows, const char *path) {
+  static const char *first[] = {"John", "Jane", "Robert", "Linda", "Gary",
+                                "Sandra", "Justin", "Maria", "Kevin", "Emma"};
+  static const char *last[] = {"Doe", "Smith", "Brown", "Johnson", "Cook",
+                               "Morgan", "Bell", "Lopez", "Clark", "Young"};
+  static const char *desigs[] = {
+      "Manager",           "Sales Executive",    "Developer",
+      "HR Specialist",     "Analyst",            "Finance Executive",
+      "Finance Manager",   "Finance Specialist", "HR Executive",
+      "HR Manager",        "Marketing Executive", "Marketing Manager",
+      "Operations Manager", "Sales Manager"};
+
+  FILE *f = fopen(path, "wb");
+  if (!f) {
+    cerr << "payrollColumnar: cannot write " << path << endl;
+    return 1;
+  }
+  vector<char> buf(1 << 20);
+  setvbuf(f, buf.data(), _IOFBF, buf.size());
+  // IDNO is 6 wide in the original file, wider when the ids need it
+  int idWidth = max(6, (int)to_string(100 + rows).size() + 1);
+  fprintf(f, "%-*s%-20s%-27s%s\n", idWidth, "IDNO", "NAME", "DESIGNATION",
+          "SALARY");
+
+  // IDNOs are 101.. in a scrambled order: a stride coprime to rows
+  size_t stride = 2654435761u % max<size_t>(rows, 1);
+  auto gcd = [](size_t a, size_t b) {
+    while (b) {
+      size_t t = a % b;
+      a = b;
+      b = t;
+    }
+    return a;
+  };
+  while (rows > 1 && gcd(stride, rows) != 1)
+    stride++;
+
+  uint32_t seed = 42;
+  size_t idx = 0;
+  for (size_t r = 0; r < rows; r++) {
+    seed = seed * 1103515245 + 12345;
+    char name[32];
+    snprintf(name, sizeof(name), "%s %s", first[(seed >> 8) % 10],
+             last[(seed >> 12) % 10]);
+    fprintf(f, "%-*zu%-20s%-27s%u\n", idWidth, 101 + idx, name,
+            desigs[(seed >> 16) % 14], 30000 + (seed >> 4) % 30 * 1000);
+    idx = (idx + stride) % rows;
+  }
+  fclose(f);
+  return 0;
+}
+
+// ---------------------------------------------------------------------------
+
+static double msSince(chrono::steady_clock::time_point t) {
+  return chrono::duration<double, milli>(chrono::steady_clock::now() - t)
+      .count();
+}
+
+int main(int argc, char *argv[]) {
+  if (argc > 3 && string(argv[1]) == "--gen")
+    return generate(strtoull(argv[2], nullptr, 10), argv[3]);
+
+  bool quiet = false;
+  unsigned threads = max(1u, thread::hardware_concurrency());
+  const char *path = nullptr;
+  vector<string> q;
+  for (int i = 1; i < argc; i++) {
+    string arg = argv[i];
+    if (arg == "-q")
+      quiet = true;
+    else if (arg == "-j" && i + 1 < argc)
+      threads = max(1, atoi(argv[++i]));
+    else if (!path)
+      path = argv[i];
+    else
+      q.push_back(arg);
+  }
+  if (!path) {
+    cerr << "usage: " << argv[0] << " FILE [-q] [-j N] [QUERY ...]\n"
+         << "       " << argv[0] << " --gen ROWS FILE\n"
+         << "queries: counts | count DESIGNATION | below N | above N |"
+         << " between LO HI | first N | last N | stats | stats-hash\n";
+    return 1;
+  }
+  if (q.empty())
+    q = {"count", "Developer", "count", "Analyst", "below", "45000",
+         "above", "45000", "first", "5", "last", "5"};
+
+  MappedFile file;
+  if (!file.open(path)) {
+    cerr << "payrollColumnar: cannot map " << path << endl;
+    return 1;
+  }
+
+  auto t = chrono::steady_clock::now();
+  Payroll pay;
+  string err;
+  if (!pay.load(file.data, file.size, threads, err)) {
+    cerr << "payrollColumnar: " << path << ": " << err << endl;
+    return 1;
+  }
+  double ms = msSince(t);
+  printf("%zu rows, %zu designations, loaded in %.1f ms (%.0f MB/s, %u "
+         "threads)\n",
+         pay.size(), pay.designations.size(), ms, file.size / 1e3 / ms,
+         threads);
+
+  vector<uint8_t> sel;
+  auto printRows = [&](const vector<size_t> &rows) {
+    if (quiet)
+      return;
+    cout << pay.header << "\n";
+    for (size_t r : rows)
+      cout << pay.row(r) << "\n";
+  };
+  auto printSelected = [&](size_t count) {
+    if (quiet)
+      return;
+    cout << pay.header << "\n";
+    for (size_t r = 0; r < pay.size() && count; r++)
+      if (sel[r]) {
+        cout << pay.row(r) << "\n";
+        count--;
+      }
+  };
+
+  for (size_t i = 0; i < q.size(); i++) {
+    const string &cmd = q[i];
+    auto num = [&](size_t k) {
+      return i + k < q.size() ? strtoll(q[i + k].c_str(), nullptr, 10) : 0;
+    };
+    cout << endl;
+    t = chrono::steady_clock::now();
+
+    if (cmd == "counts") {
+      vector<size_t> counts = pay.designationCounts();
+      ms = msSince(t);
+      for (size_t d = 0; d < counts.size(); d++)
+        printf("%-27s%zu\n", string(pay.designations.lookup(d)).c_str(),
+               counts[d]);
+    } else if (cmd == "stats" || cmd == "stats-hash") {
+      vector<SalaryStats> st =
+          pay.salaryByDesignation(threads, cmd == "stats-hash");
+      ms = msSince(t);
+      printf("%-27s%10s%16s%12s%10s%10s\n", "DESIGNATION", "COUNT", "SUM",
+             "AVG", "MIN", "MAX");
+      for (size_t d = 0; d < st.size(); d++)
+        if (st[d].count)
+          printf("%-27s%10zu%16lld%12.2f%10d%10d\n",
+                 string(pay.designations.lookup(d)).c_str(), st[d].count,
+                 (long long)st[d].sum, st[d].avg(), st[d].min, st[d].max);
+      printf("%.1f M rows/s (%s, %u threads)\n",
+             pay.size() / 1e3 / max(ms, 1e-6),
+             cmd == "stats-hash" ||
+                     pay.designations.size() > Payroll::DIRECT_GROUPS
+                 ? "hash tables"
+                 : "direct arrays",
+             threads);
+    } else if (cmd == "count" && i + 1 < q.size()) {
+      size_t n = pay.countDesignation(pay.codeOf(q[++i]));
+      ms = msSince(t);
+      printf("Total Number of Employee with designation `%s`: %zu\n",
+             q[i].c_str(), n);
+    } else if ((cmd == "below" || cmd == "above") && i + 1 < q.size()) {
+      int64_t v = num(1);
+      i++;
+      sel.resize(pay.size());
+      size_t n = cmd == "below"
+                     ? pay.selectSalary(INT64_MIN, v - 1, sel.data())
+                     : pay.selectSalary(v + 1, INT64_MAX, sel.data());
+      ms = msSince(t);
+      printf("Details of Employees with Salary %s than %lld\n",
+             cmd == "below" ? "Less" : "Greater", (long long)v);
+      printSelected(n);
+      printf("Total: %zu\n", n);
+    } else if (cmd == "between" && i + 2 < q.size()) {
+      int64_t lo = num(1), hi = num(2);
+      i += 2;
+      sel.resize(pay.size());
+      size_t n = pay.selectSalary(lo, hi, sel.data());
+      ms = msSince(t);
+      printf("Details of Employees with Salary from %lld to %lld\n",
+             (long long)lo, (long long)hi);
+      printSelected(n);
+      printf("Total: %zu\n", n);
+    } else if ((cmd == "first" || cmd == "last") && i + 1 < q.size()) {
+      size_t n = max<int64_t>(0, num(1));
+      i++;
+      vector<size_t> rows = pay.byId(n, cmd == "last");
+      ms = msSince(t);
+      printf("Details of %s %zu Emp as per IDNO\n",
+             cmd == "first" ? "First" : "Last", n);
+      printRows(rows);
+    } else {
+      cerr << "payrollColumnar: don't know what to do with " << cmd << endl;
+      return 1;
+    }
+    printf("(%.2f ms)\n", ms);
+  }
+  return 0;
+}
@@ -0,0 +1,344 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#include "mappedFile.h"
+
+using namespace std;
+
+// option 8 of whatSortOfAccountantWouldDoThis.sh (grep -n STRING FILE) for
+// payroll files too big for one core. the file is mmapped and cut into
+// chunks that end at a newline; threads take chunks in turn and the hits
+// are printed chunk by chunk in file order, so the output is grep's.
+//
+// the search looks for the first and the last byte of the string at once:
+// a block of 32 (AVX2) or 16 (SSE2) positions is loaded at p and at
+// p + len - 1, both are compared against their byte, and only positions
+// where both match get a memcmp of the middle. on text like the payroll's
+// that rules out almost every position without a branch. a line is
+// reported once, on its first hit, and the search carries on after it.
+//
+// build: g++ -O2 -march=native -pthread payrollGrep.cpp
+// run:   ./payrollGrep.out FILE STRING [-c] [-j N]
+//        ./payrollGrep.out --bench FILE STRING [-j N]
+//
+// -c prints the number of matching lines instead of the lines. --bench
+// runs the search with memmem on one thread, then this one on one and on
+// N threads (default: one per core), and prints GB/s for each.
+
+// ---------------------------------------------------------------------------
+// one string, searched for in a buffer
+
+static size_t countNewlines(const char *p, const char *e) {
+  size_t n = 0;
+#if defined(__AVX2__)
+  const __m256i nl = _mm256_set1_epi8('\n');
+  for (; e - p >= 32; p += 32)
+    n += __builtin_popcount(_mm256_movemask_epi8(_mm256_cmpeq_epi8(
+        _mm256_loadu_si256((const __m256i *)p), nl)));
+#elif defined(__SSE2__)
+  const __m128i nl = _mm_set1_epi8('\n');
+  for (; e - p >= 16; p += 16)
+    n += __builtin_popcount(_mm_movemask_epi8(
+        _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)p), nl)));
+#endif
+  for (; p < e; p++)
+    n += *p == '\n';
+  return n;
+}
+
+// the blocks that are compared against the first byte are compared against
+// '\n' too, so the line count comes out of the same pass over the text:
+// reading it is what the search costs, not the compares
+class Finder {
+public:
+  explicit Finder(string_view needle) : s(needle) {}
+
+  // offset of the first match in [p, p + n), or n if there is none. the
+  // newlines before it are added to lines
+  size_t find(const char *p, size_t n, uint64_t &lines) const {
+    size_t k = s.size();
+    if (k == 0)
+      return 0;
+    if (k == 1) {
+      const char *q = (const char *)memchr(p, s[0], n);
+      lines += countNewlines(p, q ? q : p + n);
+      return q ? q - p : n;
+    }
+    if (k > n) {
+      lines += countNewlines(p, p + n);
+      return n;
+    }
+
+    // positions i with p[i] == first and p[i + k - 1] == last
+    const char first = s[0], last = s[k - 1];
+    size_t i = 0, stop = n - k + 1;
+#if defined(__AVX2__)
+    const __m256i f = _mm256_set1_epi8(first), l = _mm256_set1_epi8(last);
+    const __m256i nl = _mm256_set1_epi8('\n');
+    for (; i + 32 <= stop; i += 32) {
+      __m256i a = _mm256_loadu_si256((const __m256i *)(p + i));
+      __m256i b = _mm256_loadu_si256((const __m256i *)(p + i + k - 1));
+      uint32_t m = _mm256_movemask_epi8(
+          _mm256_and_si256(_mm256_cmpeq_epi8(a, f), _mm256_cmpeq_epi8(b, l)));
+      uint32_t breaks = _mm256_movemask_epi8(_mm256_cmpeq_epi8(a, nl));
+#elif defined(__SSE2__)
+    const __m128i f = _mm_set1_epi8(first), l = _mm_set1_epi8(last);
+    const __m128i nl = _mm_set1_epi8('\n');
+    for (; i + 16 <= stop; i += 16) {
+      __m128i a = _mm_loadu_si128((const __m128i *)(p + i));
+      __m128i b = _mm_loadu_si128((const __m128i *)(p + i + k - 1));
+      uint32_t m = _mm_movemask_epi8(
+          _mm_and_si128(_mm_cmpeq_epi8(a, f), _mm_cmpeq_epi8(b, l)));
+      uint32_t breaks = _mm_movemask_epi8(_mm_cmpeq_epi8(a, nl));
+#endif
+#if defined(__AVX2__) || defined(__SSE2__)
+      for (; m; m &= m - 1) {
+        unsigned j = __builtin_ctz(m);
+        if (memcmp(p + i + j + 1, s.data() + 1, k - 2) == 0) {
+          lines += __builtin_popcount(breaks & ((1u << j) - 1));
+          return i + j;
+        }
+      }
+      lines += __builtin_popcount(breaks);
+    }
+#endif
+    // the last few positions, or all of them without SSE2
+    for (; i < stop; i++) {
+      if (p[i] == first && p[i + k - 1] == last &&
+          memcmp(p + i + 1, s.data() + 1, k - 2) == 0)
+        return i;
+      lines += p[i] == '\n';
+    }
+    lines += countNewlines(p + stop, p + n);
+    return n;
+  }
+
+private:
+  string_view s;
+};
+
+// the same through libc, which needs a second pass for the lines
+struct MemmemFinder {
+  string_view s;
+
+  size_t find(const char *p, size_t n, uint64_t &lines) const {
+    const char *q = (const char *)memmem(p, n, s.data(), s.size());
+    lines += countNewlines(p, q ? q : p + n);
+    return q ? q - p : n;
+  }
+};
+
+// ---------------------------------------------------------------------------
+// matching lines of a chunk
+
+struct Hit {
+  uint64_t line;   // counted from the start of the chunk
+  uint64_t begin;  // offset of the line in the file
+  uint32_t len;    // without the newline
+};
+
+struct Chunk {
+  const char *begin, *end;
+  vector<Hit> hits;
+  uint64_t lines = 0;  // newlines in the chunk
+  size_t matched = 0;  // lines with a hit, also without keepHits
+  bool done = false;
+};
+
+// the lines of [c.begin, c.end) with a match, each once
+template <class F>
+static void searchChunk(const F &finder, const char *text, Chunk &c,
+                        bool keepHits) {
+  const char *p = c.begin;  // always the start of a line
+  uint64_t lines = 0;       // newlines before p
+  while (p < c.end) {
+    size_t at = finder.find(p, c.end - p, lines);
+    if (at == (size_t)(c.end - p))
+      break;
+    const char *m = p + at;
+    const char *ls = (const char *)memrchr(p, '\n', m - p);
+    ls = ls ? ls + 1 : p;
+    const char *le = (const char *)memchr(m, '\n', c.end - m);
+    if (!le)
+      le = c.end;
+    c.matched++;
+    if (keepHits)
+      c.hits.push_back(
+          Hit{lines, (uint64_t)(ls - text), (uint32_t)(le - ls)});
+    if (le == c.end)
+      break;
+    lines++;
+    p = le + 1;
+  }
+  c.lines = lines;
+}
+
+// chunks of about `size` bytes, each ending just after a newline
+static vector<Chunk> cutChunks(const char *data, size_t n, size_t size) {
+  vector<Chunk> chunks;
+  const char *p = data, *end = data + n;
+  while (p < end) {
+    const char *q = p + min<size_t>(size, end - p);
+    if (q < end) {
+      const char *nl = (const char *)memchr(q, '\n', end - q);
+      q = nl ? nl + 1 : end;
+    }
+    chunks.push_back(Chunk{p, q, {}, 0, 0, false});
+    p = q;
+  }
+  return chunks;
+}
+
+// searches every chunk on `threads` threads and calls emit(chunk, first
+// line number of the chunk) for each in file order, as soon as it and the
+// ones before it are done. returns the number of matching lines
+template <class F, class Emit>
+static size_t search(const F &finder, const MappedFile &file,
+                     unsigned threads, bool keepHits, Emit emit) {
+  vector<Chunk> chunks = cutChunks(file.data, file.size, 8 << 20);
+  atomic<size_t> next{0};
+  mutex mu;
+  condition_variable ready;
+
+  auto worker = [&]() {
+    size_t i;
+    while ((i = next++) < chunks.size()) {
+      searchChunk(finder, file.data, chunks[i], keepHits);
+      lock_guard<mutex> lock(mu);
+      chunks[i].done = true;
+      ready.notify_one();
+    }
+  };
+  vector<thread> pool;
+  for (unsigned t = 0; t < max(1u, threads); t++)
+    pool.emplace_back(worker);
+
+  size_t matched = 0;
+  uint64_t line = 1;
+  for (Chunk &c : chunks) {
+    {
+      unique_lock<mutex> lock(mu);
+      ready.wait(lock, [&] { return c.done; });
+    }
+    emit(c, line);
+    matched += c.matched;
+    line += c.lines;
+    vector<Hit>().swap(c.hits);
+  }
+  for (auto &th : pool)
+    th.join();
+  return matched;
+}
+
+// ---------------------------------------------------------------------------
+
+static double secondsSince(chrono::steady_clock::time_point t) {
+  return chrono::duration<double>(chrono::steady_clock::now() - t).count();
+}
+
+static int bench(const MappedFile &file, string_view needle,
+                 unsigned threads) {
+  auto none = [](const Chunk &, uint64_t) {};
+  double gb = file.size / 1e9;
+  printf("%.2f GB, searching for \"%.*s\"\n", gb, (int)needle.size(),
+         needle.data());
+
+  // a first pass so that every run reads the file from the page cache
+  size_t expect = search(MemmemFinder{needle}, file, 1, false, none);
+
+  auto t = chrono::steady_clock::now();
+  size_t n = search(MemmemFinder{needle}, file, 1, false, none);
+  double base = secondsSince(t);
+  printf("  memmem,        1 thread  %7.2f GB/s  %zu lines\n", gb / base, n);
+
+  Finder finder(needle);
+  for (unsigned j : {1u, threads}) {
+    t = chrono::steady_clock::now();
+    n = search(finder, file, j, false, none);
+    double sec = secondsSince(t);
+    printf("  first+last, %3u thread%s %7.2f GB/s  %zu lines  %.1fx%s\n", j,
+           j == 1 ? " " : "s", gb / sec, n, base / sec,
+           n == expect ? "" : "  WRONG");
+    if (n != expect)
+      return 1;
+    if (threads == 1)
+      break;
+  }
+  return 0;
+}
+
+int main(int argc, char *argv[]) {
+  unsigned threads = max(1u, thread::hardware_concurrency());
+  bool countOnly = false, benchmark = false;
+  vector<const char *> args;
+  for (int i = 1; i < argc; i++) {
+    string arg = argv[i];
+    if (arg == "-c")
+      countOnly = true;
+    else if (arg == "--bench")
+      benchmark = true;
+    else if (arg == "-j" && i + 1 < argc)
+      threads = max(1, atoi(argv[++i]));
+    else
+      args.push_back(argv[i]);
+  }
+  if (args.size() != 2) {
+    cerr << "usage: " << argv[0] << " FILE STRING [-c] [-j N]\n"
+         << "       " << argv[0] << " --bench FILE STRING [-j N]\n";
+    return 1;
+  }
+  string_view needle = args[1];
+  if (needle.find('\n') != string_view::npos) {
+    cerr << "payrollGrep: the string can't span lines" << endl;
+    return 1;
+  }
+
+  MappedFile file;
+  if (!file.open(args[0])) {
+    // an empty file has nothing to find
+    if (FILE *f = fopen(args[0], "rb")) {
+      fclose(f);
+      if (!benchmark)
+        puts(countOnly ? "0" : "No Match Found.");
+      return 1;
+    }
+    cerr << "payrollGrep: cannot map " << args[0] << endl;
+    return 2;
+  }
+  if (benchmark)
+    return bench(file, needle, threads);
+
+  // static: stdout still uses it when exit() flushes after main returns
+  static char buf[1 << 20];
+  setvbuf(stdout, buf, _IOFBF, sizeof(buf));
+  Finder finder(needle);
+  size_t n = search(finder, file, threads, !countOnly,
+                    [&](const Chunk &c, uint64_t line) {
+                      for (const Hit &h : c.hits)
+                        printf("%llu:%.*s\n",
+                               (unsigned long long)(line + h.line),
+                               (int)h.len, file.data + h.begin);
+                    });
+  if (countOnly)
+    printf("%zu\n", n);
+  else if (n == 0)
+    puts("No Match Found.");
+  fflush(stdout);
+  return n ? 0 : 1;
+}
@@ -0,0 +1,121 @@
+#ifndef STRING_INTERNER_H
+#define STRING_INTERNER_H
+
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// string interner for the categorical fields of the record classes (gender,
+// department, designation, author, file format...). every distinct string is
+// copied once into an arena and the records only keep its 32 bit id.
+//
+// the arena is a list of fixed blocks, so a string_view into it never moves
+// when more strings are added. one global pool (Interner::global()) is used
+// by InternedStr, a separate Interner can be made for a scoped pool and is
+// freed in one go with it.
+
+class Interner {
+ private:
+  static constexpr size_t BLOCK_SIZE = 64 * 1024;
+
+  std::vector<std::unique_ptr<char[]>> blocks;
+  size_t blockUsed = BLOCK_SIZE;
+
+  std::vector<std::unique_ptr<char[]>> bigBlocks;
+  size_t bigBytes = 0;
+
+  std::vector<std::string_view> strs;
+  std::unordered_map<std::string_view, uint32_t> ids;
+
+  std::string_view store(std::string_view s) {
+    // long strings get a block of their own
+    if (s.size() > BLOCK_SIZE / 4) {
+      bigBlocks.emplace_back(new char[s.size()]);
+      memcpy(bigBlocks.back().get(), s.data(), s.size());
+      bigBytes += s.size();
+      return std::string_view(bigBlocks.back().get(), s.size());
+    }
+
+    // blocks starts out empty, and "" (the first thing InternedStr()
+    // interns) would otherwise fit in the block that isn't there
+    if (blocks.empty() || blockUsed + s.size() > BLOCK_SIZE) {
+      blocks.emplace_back(new char[BLOCK_SIZE]);
+      blockUsed = 0;
+    }
+
+    char *dst = blocks.back().get() + blockUsed;
+    memcpy(dst, s.data(), s.size());
+    blockUsed += s.size();
+    return std::string_view(dst, s.size());
+  }
+
+ public:
+  Interner() { strs.reserve(256); }
+  Interner(const Interner &) = delete;
+  Interner &operator=(const Interner &) = delete;
+
+  uint32_t intern(std::string_view s) {
+    auto it = ids.find(s);
+    if (it != ids.end()) return it->second;
+
+    std::string_view kept = store(s);
+    uint32_t id = strs.size();
+    strs.push_back(kept);
+    ids.emplace(kept, id);
+    return id;
+  }
+
+  std::string_view lookup(uint32_t id) const { return strs[id]; }
+
+  // id of s without adding it, -1 if it was never interned
+  int64_t find(std::string_view s) const {
+    auto it = ids.find(s);
+    return (it == ids.end()) ? -1 : it->second;
+  }
+
+  size_t size() const { return strs.size(); }
+
+  // bytes held by the pool itself (arena + tables), for the benches
+  size_t bytes() const {
+    return blocks.size() * BLOCK_SIZE + bigBytes +
+           strs.capacity() * sizeof(std::string_view) +
+           ids.bucket_count() * sizeof(void *) +
+           ids.size() * (sizeof(std::string_view) + sizeof(uint32_t) +
+                         2 * sizeof(void *));
+  }
+
+  static Interner &global() {
+    static Interner pool;
+    return pool;
+  }
+};
+
+// 4 byte handle to a string in the global pool. equality is an id compare
+class InternedStr {
+ private:
+  uint32_t id;
+
+ public:
+  InternedStr() : id(Interner::global().intern("")) {}
+  InternedStr(std::string_view s) : id(Interner::global().intern(s)) {}
+  InternedStr(const std::string &s) : InternedStr(std::string_view(s)) {}
+  InternedStr(const char *s) : InternedStr(std::string_view(s)) {}
+
+  std::string_view view() const { return Interner::global().lookup(id); }
+  std::string str() const { return std::string(view()); }
+  uint32_t getId() const { return id; }
+
+  bool operator==(const InternedStr &o) const { return id == o.id; }
+  bool operator!=(const InternedStr &o) const { return id != o.id; }
+};
+
+inline std::ostream &operator<<(std::ostream &os, const InternedStr &s) {
+  return os << s.view();
+}
+
+#endif
@@ -5,11 +5,29 @@
 
 // LOX Interpreter
 
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
 #include <iostream>
 #include <map>
+#include <new>
 #include <string>
+#include <string_view>
 #include <vector>
 
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#else
+#include <chrono>
+#endif
+
+// g++ -O2 -DLOX_PROFILE token.cpp builds in the ScanProfile counters and
+// timers behind --profile; without it they are empty and compile away
+#ifndef LOX_PROFILE
+#define LOX_PROFILE 0
+#endif
+
 class Parcer;
 class Scanner;
 
@@ -63,18 +81,34 @@ enum TokenType {
   eof,
 };
 
+// every operator new in the program goes through here, so --alloc-check
+// can tell whether scanning a line allocated anything
+static size_t allocations = 0;
+
+void *operator new(std::size_t n) {
+  allocations++;
+  if (void *p = std::malloc(n ? n : 1)) return p;
+  throw std::bad_alloc();
+}
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete(void *p, std::size_t) noexcept { std::free(p); }
+
 std::map<int, int> kw;
 
 // populating the keywords
 
+// lexeme and literal point into the Scanner's source buffer, so a token
+// is only valid until the next line is scanned
 class Token {
  private:
   enum TokenType type;
-  std::string lexeme;
-  std::string literal;
+  std::string_view lexeme;
+  std::string_view literal;
   int line;
 
-  std::string enumToString() {
+ public:
+  // also names the types in ScanProfile's table
+  static const char *enumToString(TokenType type) {
     switch (type) {
       case (COMMA):
         return "COMMA";
@@ -159,54 +193,186 @@ class Token {
     }
   }
 
- public:
-  Token(TokenType type, std::string lexeme, std::string literal, int line)
+  Token(TokenType type, std::string_view lexeme, std::string_view literal,
+        int line)
       : type(type), lexeme(lexeme), literal(literal), line(line) {}
 
-  std::string toString() {
-    return enumToString() + "\t\t\t" + lexeme + "\t\t\t" + literal;
+  std::string toString() const {
+    return std::string(enumToString(type)) + "\t\t\t" + std::string(lexeme) +
+           "\t\t\t" + std::string(literal);
+  }
+
+  // toString() without building the string
+  void print(std::ostream &out) const {
+    out << enumToString(type) << "\t\t\t" << lexeme << "\t\t\t" << literal
+        << "\n";
+  }
+};
+
+// where Scanner's time goes, for --profile: tokens of each type, the bytes
+// that make no token (strings count their quotes, comments their "//"),
+// identifiers against keywords, and cycles in each phase of a line. the
+// Scanner calls these whatever LOX_PROFILE is; ScanProfile<false> has
+// nothing in it and every call is an empty inline, so they cost nothing
+template <bool on>
+class ScanProfile {
+ public:
+  enum Phase { RESET, SCAN, PRINT, PHASES };
+
+  static constexpr bool enabled = false;
+  static uint64_t now() { return 0; }
+  void input(size_t) {}
+  void token(TokenType) {}
+  void string(size_t) {}
+  void comment(size_t) {}
+  void whitespace() {}
+  void identifier(bool) {}
+  void phase(Phase, uint64_t) {}
+  void print(std::ostream &) const {}
+};
+
+template <>
+class ScanProfile<true> {
+ public:
+  enum Phase { RESET, SCAN, PRINT, PHASES };
+
+  static constexpr bool enabled = true;
+
+  // the time stamp counter where there is one
+  static uint64_t now() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return std::chrono::steady_clock::now().time_since_epoch().count();
+#endif
+  }
+
+  void input(size_t bytes) {
+    this->inputs++;
+    this->bytes += bytes;
+  }
+  void token(TokenType type) { this->tokens[type]++; }
+  void string(size_t bytes) { this->stringBytes += bytes; }
+  void comment(size_t bytes) { this->commentBytes += bytes; }
+  void whitespace() { this->whitespaceBytes++; }
+  void identifier(bool keyword) { (keyword ? keywords : identifiers)++; }
+  // since is what now() said when the phase began
+  void phase(Phase p, uint64_t since) { this->cycles[p] += now() - since; }
+
+  void print(std::ostream &out) const {
+    static const char *const phaseNames[PHASES] = {"reset", "scan", "print"};
+    auto share = [this](uint64_t n) {
+      return this->bytes ? 100.0 * n / this->bytes : 0.0;
+    };
+    std::ios::fmtflags flags = out.flags();
+    out << std::fixed << std::setprecision(1);
+    out << "profile: " << inputs << " inputs, " << bytes << " bytes\n";
+    out << "  strings     " << stringBytes << " bytes (" << share(stringBytes)
+        << "%)\n";
+    out << "  comments    " << commentBytes << " bytes ("
+        << share(commentBytes) << "%)\n";
+    out << "  whitespace  " << whitespaceBytes << " bytes ("
+        << share(whitespaceBytes) << "%)\n";
+    out << "  identifiers " << identifiers << ", keywords " << keywords
+        << "\n";
+    out << "  tokens:\n";
+    for (int t = 0; t <= eof; t++) {
+      if (!tokens[t]) continue;
+      const char *name = Token::enumToString((TokenType)t);
+      out << "    " << name;
+      for (size_t w = std::strlen(name); w < 16; w++) out << ' ';
+      out << tokens[t] << "\n";
+    }
+    out << "  cycles:\n";
+    for (int p = 0; p < PHASES; p++) {
+      out << "    " << phaseNames[p] << "\t" << cycles[p];
+      if (bytes) out << "\t(" << (double)cycles[p] / bytes << " a byte)";
+      out << "\n";
+    }
+    out.flags(flags);
   }
+
+ private:
+  uint64_t inputs = 0, bytes = 0;
+  uint64_t tokens[eof + 1] = {};
+  uint64_t stringBytes = 0, commentBytes = 0, whitespaceBytes = 0;
+  uint64_t identifiers = 0, keywords = 0;
+  uint64_t cycles[PHASES] = {};
 };
 
+using Profile = ScanProfile<LOX_PROFILE != 0>;
+
 class Parcer {
  protected:
   bool hadError;
 
-  void error(int line, std::string msg) {
+  struct Diagnostic {
+    int line;
+    const char *msg;
+    char c;  // appended to msg when not '\0'
+  };
+
+  // this input's errors, cleared with it
+  std::vector<Diagnostic> diagnostics;
+
+  void error(int line, const char *msg, char c = '\0') {
     this->hadError = true;
-    this->report(line, "", msg);
+    this->diagnostics.push_back({line, msg, c});
+    this->report(line, "", msg, c);
     return;
   }
 
-  void report(int line, std::string where, std::string msg) {
-    std::cout << "Error@ " << line << " " << where << " -> " << msg << "\n";
+  void report(int line, std::string_view where, std::string_view msg,
+              char c) {
+    std::cout << "Error@ " << line << " " << where << " -> " << msg;
+    if (c) std::cout << c;
+    std::cout << "\n";
     return;
   }
 
  public:
-  Parcer() : hadError(false) {}
+  Parcer() : hadError(false), scanner(nullptr) {}
+  ~Parcer();
+
+  Parcer(const Parcer &) = delete;
+  Parcer &operator=(const Parcer &) = delete;
+
+  void run(const std::string &src);
+
+  // runs every line of in twice and counts the allocations of the second
+  // time round, which should be none
+  size_t allocCheck(std::istream &in);
 
-  void run(std::string src);
+  // what ScanProfile collected over every run() so far
+  void printProfile(std::ostream &out) const;
+
+ private:
+  // made by the first run() and reused by the rest
+  Scanner *scanner;
 };
 
 class Scanner : protected Parcer {
  private:
   std::string src;
+  int line;
   int start;
   int current;
-  int line;
 
-  std::vector<Token *> tokens;
+  std::vector<Token> tokens;
+
+  Profile profile;
 
-  static std::map<std::string, TokenType> keywords;
+  // heterogeneous lookup: find() takes the lexeme as a string_view
+  static std::map<std::string, TokenType, std::less<>> keywords;
 
   char advance() { return this->src.at(current++); }
 
   char peek() { return (isAtEnd()) ? '\0' : this->src.at(current); }
 
   char peekNext() {
-    return (this->current + 1 > this->src.length()) ? '\0'
-                                                    : this->src.at(current + 1);
+    return (this->current + 1 >= this->src.length())
+               ? '\0'
+               : this->src.at(current + 1);
   }
 
   bool isAtEnd() { return this->current >= this->src.length(); }
@@ -219,6 +385,10 @@ class Scanner : protected Parcer {
     return true;
   }
 
+  std::string_view text(int from, int to) {
+    return std::string_view(this->src).substr(from, to - from);
+  }
+
   void string() {
     while (peek() != '"' && !isAtEnd()) {
       //!! multi line string
@@ -227,17 +397,17 @@ class Scanner : protected Parcer {
     }
 
     if (isAtEnd()) {
+      profile.string(this->current - this->start);
       error(line, "Unterminated String.");
       return;
     }
 
     // Closing "
     advance();
+    profile.string(this->current - this->start);
 
     // Trim the surrounding quotes
-    std::string value =
-        this->src.substr(this->start + 1, this->current - this->start - 2);
-    addToken(STRING, value);
+    addToken(STRING, text(this->start + 1, this->current - 1));
   }
 
   bool isDigit(char c) { return c >= '0' && c <= '9'; }
@@ -258,16 +428,15 @@ class Scanner : protected Parcer {
     }
 
     // addToken(NUMBER, std::stod(this->src.substr(start, current - start)));
-    addToken(NUMBER, this->src.substr(start, current - start));
+    addToken(NUMBER, text(start, current));
   }
 
   void identifier() {
     while (isAlphaNumeric(peek())) advance();
 
-    std::string text =
-        this->src.substr(this->start, this->current - this->start);
-    TokenType type =
-        (keywords.find(text) != keywords.end()) ? keywords[text] : IDENTIFIER;
+    auto kw = keywords.find(text(this->start, this->current));
+    TokenType type = (kw != keywords.end()) ? kw->second : IDENTIFIER;
+    profile.identifier(type != IDENTIFIER);
 
     addToken(type);
   }
@@ -277,28 +446,45 @@ class Scanner : protected Parcer {
     return;
   }
 
-  void addToken(enum TokenType type, std::string literal) {
-    std::string text = this->src.substr(start, current - start);
-    tokens.push_back(new Token(type, text, literal, line));
+  void addToken(enum TokenType type, std::string_view literal) {
+    profile.token(type);
+    tokens.emplace_back(type, text(start, current), literal, line);
     return;
   }
 
  public:
-  Scanner(std::string src) : src(src), line(1), start(0), current(0) {
-    populateKeywords();
+  Scanner() : line(1), start(0), current(0) {
+    if (keywords.empty()) populateKeywords();
   }
 
   static void populateKeywords();
 
-  // std::vector<Token *> scanTokens(std::string src) {
-  std::vector<Token *> scanTokens() {
+  Profile &stats() { return this->profile; }
+
+  // the next input. src, tokens and diagnostics keep their capacity, so
+  // once they have grown to fit the longest line so far this allocates
+  // nothing
+  void reset(std::string_view input) {
+    this->src.assign(input.data(), input.size());
+    this->profile.input(input.size());
+    this->tokens.clear();
+    this->diagnostics.clear();
+    this->hadError = false;
+    this->line = 1;
+    this->start = 0;
+    this->current = 0;
+  }
+
+  // valid until the next reset()
+  const std::vector<Token> &scanTokens() {
     while (!isAtEnd()) {
       // We are at the beginning of the next lexeme.
       this->start = this->current;
       scanToken();
     }
 
-    this->tokens.push_back(new Token(eof, "", "", line));
+    this->profile.token(eof);
+    this->tokens.emplace_back(eof, "", "", line);
     return this->tokens;
   }
 
@@ -355,18 +541,21 @@ class Scanner : protected Parcer {
       case '/':
         if (match('/')) {
           while (peek() != '\n' && !isAtEnd()) advance();
+          profile.comment(this->current - this->start);
         } else {
           addToken(SLASH);
-          break;
         }
+        break;
 
       // waste
       case ' ':
       case '\r':
       case '\t':
+        profile.whitespace();
         break;
 
       case '\n':
+        profile.whitespace();
         this->line++;
         break;
 
@@ -382,26 +571,56 @@ class Scanner : protected Parcer {
         } else if (isAlpha(c)) {
           identifier();
         } else {
-          std::string msg = "Unexpected Character ";
-          msg.push_back(c);
-          this->error(line, msg);
+          this->error(line, "Unexpected Character ", c);
         }
         break;
     }
   }
 };
 
-void Parcer::run(std::string src) {
-  Scanner *scanner = new Scanner(src);
-  std::vector<Token *> tokens = scanner->scanTokens();
+Parcer::~Parcer() { delete this->scanner; }
 
+void Parcer::run(const std::string &src) {
+  if (!this->scanner) this->scanner = new Scanner();
+  Profile &profile = this->scanner->stats();
+
+  uint64_t t = profile.now();
+  this->scanner->reset(src);
+  profile.phase(Profile::RESET, t);
+
+  t = profile.now();
+  const std::vector<Token> &tokens = this->scanner->scanTokens();
+  profile.phase(Profile::SCAN, t);
+
+  t = profile.now();
   std::cout << "the Tokens are:\n";
-  for (auto token : tokens) {
-    std::cout << token->toString() << "\n";
+  for (const Token &token : tokens) {
+    token.print(std::cout);
   }
+  profile.phase(Profile::PRINT, t);
   return;
 }
-std::map<std::string, TokenType> Scanner::keywords;
+
+void Parcer::printProfile(std::ostream &out) const {
+  if (!Profile::enabled) {
+    out << "profile: built without -DLOX_PROFILE\n";
+    return;
+  }
+  if (this->scanner) this->scanner->stats().print(out);
+}
+
+size_t Parcer::allocCheck(std::istream &in) {
+  std::vector<std::string> lines;
+  for (std::string usrIn; std::getline(in, usrIn);) lines.push_back(usrIn);
+
+  // the first time round grows the buffers to the longest line
+  for (const std::string &l : lines) run(l);
+  size_t before = allocations;
+  for (const std::string &l : lines) run(l);
+  return allocations - before;
+}
+
+std::map<std::string, TokenType, std::less<>> Scanner::keywords;
 
 void Scanner::populateKeywords() {
   keywords["and"] = AND;
@@ -422,15 +641,31 @@ void Scanner::populateKeywords() {
   keywords["while"] = WHILE;
 }
 
-int main() {
+// ./a.out                 the REPL
+// ./a.out --alloc-check   scan stdin's lines twice, fail if the second
+//                         pass allocated
+// ./a.out --profile       the REPL, then ScanProfile's summary on stderr
+//                         (needs -DLOX_PROFILE)
+int main(int argc, char *argv[]) {
   std::string usrIn;
   Parcer parser;
+  bool profile = argc > 1 && std::strcmp(argv[1], "--profile") == 0;
+
+  if (argc > 1 && std::strcmp(argv[1], "--alloc-check") == 0) {
+    size_t n = parser.allocCheck(std::cin);
+    std::cerr << "allocations scanning the input a second time: " << n
+              << "\n";
+    return n ? 1 : 0;
+  }
 
   // REPL
-  while (1) {
-    std::getline(std::cin, usrIn);
+  while (std::getline(std::cin, usrIn)) {
     parser.run(usrIn);
     std::cout << "\n";
   }
+  if (profile) {
+    std::cout.flush();
+    parser.printProfile(std::cerr);
+  }
   return 0;
 }
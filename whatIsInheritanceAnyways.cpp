@@ -1,4 +1,7 @@
 #include <iostream>
+#include <utility>
+
+#include "stringInterner.h"
 
 using namespace std;
 
@@ -6,24 +9,19 @@ class Employee {
 protected:
   string name;
   string empId;
-  string gender;
-  string department;
-  string designation;
+  InternedStr gender;
+  InternedStr department;
+  InternedStr designation;
 
   int age;
   int salary;
 
 
 public:
-  Employee(string n, string eId, int age, string g, string dept, int s) {
-    this->name = n;
-    this->empId = eId;
-    this->age = age;
-    this->gender = g;
-    this->department = dept;
-    this->salary = s;
-    this->designation = "Employee";
-  }
+  Employee(string n, string eId, int age, const string &g,
+           const string &dept, int s)
+      : name(move(n)), empId(move(eId)), gender(g), department(dept),
+        designation("Employee"), age(age), salary(s) {}
 
   void display() {
     cout << "Employee Details: " << endl;